@@ -2,14 +2,31 @@
 #include <cmath>          // Math functions (sin, cos, etc.)
 #include <cstdlib>        // Standard library for rand(), exit()
 #include <cstdio>         // Standard I/O for printf()
-#include <vector>         // STL vector for dynamic arrays
+#include <cstring>        // memcpy() for the snapshots
+#include "fan_sim.h"      // Headless rotor physics shared with the 3D version
+#include "particles.h"    // Fixed-capacity structure-of-arrays particle pool
+#include "thread_pool.h"  // Work-stealing pool for the particle update
+#include "trig_tables.h"  // Compile-time sine/cosine tables for fixed shapes
+#include "hud_text.h"     // Glyph-atlas text, drawn in one batch per frame
+#include "gl_ext.h"       // Run-time loaded GL entry points (timer queries)
+#include "profiler.h"     // Per-stage frame timings
+#include "frame_clock.h"  // Fixed-step physics clock and render-rate pacing
+#include "vertex_batch.h" // Batched replacement for glBegin/glEnd
+#include "static_layer.h" // Cached image of the parts that never move
+#include "blade_profile.h" // Compile-time blade geometry for 3, 5 and 7 blades
+#include "input_log.h"     // Input recording for reproducible benchmark runs
+#include "frame_capture.h" // Video capture through pixel buffers and a writer thread
+#include "frame_arena.h"   // Per-frame scratch memory, released all at once
+#include "alloc_tracker.h" // Heap allocations per frame
+#include "air_fluid.h"     // Grid airflow solver the particles drift in
+#include "soft_backend.h"  // Built-in CPU rasterizer, for machines without a GPU
+#include "command_queue.h" // Input commands, applied by the simulation between ticks
+#include "triple_buffer.h" // Simulation state handed to the render thread
+#include "sim_thread.h"    // Physics ticks on a thread of their own
 
 // Global variables
-float rotationAngle = 0.0f;        // Current rotation angle of fan blades (degrees)
-float rotationSpeed = 0.0f;        // Current actual rotation speed (units/frame)
-float targetRotationSpeed = 0.0f;  // Desired rotation speed for acceleration simulation
-bool fanOn = false;                // Fan power state (on/off)
-int fanSpeedLevel = 0;             // Speed level from 0 (off) to 5 (max)
+FanState fan = {};                     // Rotor state: angle, speed, power and speed level (0-5)
+FanParams fanParams = fanParams2D();   // Acceleration/deceleration tuning for the 2D fan
 
 // Color definitions using RGB arrays (each value 0.0-1.0)
 float deskColor[3] = {0.55f, 0.27f, 0.07f};      // Brown wood color
@@ -17,269 +34,358 @@ float fanColor[3] = {0.4f, 0.4f, 0.4f};          // Gray for fan parts
 float buttonColor[3] = {0.8f, 0.2f, 0.2f};       // Red for power button
 float speedButtonColor[3] = {0.2f, 0.6f, 0.2f};  // Green for speed buttons
 
-// Array of colors for the 5 fan blades (each blade gets a different color)
-float bladeColors[5][3] = {
+// Array of colors for the fan blades (each blade gets a different color)
+float bladeColors[kMaxBlades][3] = {
     {0.9f, 0.2f, 0.2f}, // Red
     {0.2f, 0.9f, 0.2f}, // Green
     {0.2f, 0.2f, 0.9f}, // Blue
     {0.9f, 0.9f, 0.2f}, // Yellow
-    {0.9f, 0.2f, 0.9f}  // Magenta
+    {0.9f, 0.2f, 0.9f}, // Magenta
+    {0.9f, 0.5f, 0.1f}, // Orange
+    {0.2f, 0.9f, 0.9f}  // Cyan
 };
+int bladeCount = 5;  // Blades on the rotor: 3, 5 or 7 (B cycles)
 
-// Vector to store air flow particle positions (pairs of x,y coordinates)
-std::vector<std::pair<float, float> > airParticles;
+// Air flow particles (positions, directions and ages in a preallocated pool)
+ParticlePool airParticles;
+const int kMaxAirParticles = 4096;          // Pool capacity
+const float kParticleSpawnPerLevel = 0.1f;  // Cone particles spawned per tick per speed level
+float particleSpawnBudget = 0.0f;           // Fractional particles carried to the next tick
+ThreadPool* particleThreads = 0;            // Worker threads for particle spawn/update/cull
 
-// Physics simulation constants
-float acceleration = 0.25f;   // Rate of speed increase when accelerating
-float deceleration = 0.15f;   // Rate of speed decrease when decelerating
+// Airflow over the whole window (square cells of 800/512 px), blown by the
+// blade disc: it draws air in at a rate and swirls it with a force that
+// both grow with the blade speed
+AirFluid airFluid;
+const int kAirGridWidth = 512;
+const int kAirGridHeight = 384;
+const float kAirDiscRadius = 75.0f;         // Cage radius
+const float kAirSourcePerSpeed = 0.008f;    // Inflow per tick per degree/tick of blade speed
+const float kAirSwirlPerSpeed = 0.003f;     // Rim acceleration (px/tick^2) per degree/tick
+
+// Control panel and status text, queued while drawing and drawn last
+TextBatch hudText;
+
+// Video recording of the window (V starts and stops it)
+FrameCapture videoCapture;
+const char* kCapturePath = "capture_2d.y4m";
+
+// Heap allocations per frame (none expected once warmed up)
+AllocMeter allocMeter = {};
+
+// Fan and air commands from the input callbacks, applied at the next physics
+// tick, and how long they took to take effect (printed on exit): to the
+// tick on the simulation's side, to the frame on the render thread's
+CommandQueue inputCommands;
+CommandLatency inputLatency = {};
+CommandLatency shownLatency = {};
+
+// Every shape of the frame, recorded while drawing and drawn in a few calls
+VertexBatch shapeBatch;
+
+// Desk, stand, motor and cage, copied into a texture and reused while that
+// is faster than drawing them (L cycles auto / always / never); anything that
+// changes their look or the window size must call layerInvalidate(backgroundLayer)
+StaticLayer backgroundLayer = {};
+
+// Frame profiler stages (graph toggled with G, history written to profile_2d.csv on exit)
+const int kStageDesk = profileStage("desk");
+const int kStageFan = profileStage("fan");
+const int kStageStand = profileStage("stand");
+const int kStageMotor = profileStage("motor");
+const int kStageCage = profileStage("cage");
+const int kStageBlades = profileStage("blades");
+const int kStageAirFlow = profileStage("airflow");
+const int kStageControls = profileStage("controls");
+const int kStageStatus = profileStage("status");
+const int kStageText = profileStage("text");
+const int kStageShapes = profileStage("shapes");
+const int kStageBackground = profileStage("background");
+const int kStageAirUpdate = profileStage("airflow_update");
+float airUpdateMs = 0.0f;  // Time in updateAirFlow() since the last snapshot (simulation thread)
+bool showProfile = false;  // Draw the frame-time graph
+
+// Physics runs at a fixed kFanTickHz on the simulation thread; frames are
+// drawn at renderHz (first command-line argument, 0 = uncapped) on the GLUT
+// thread, from the latest snapshot, with the blades interpolated between ticks
+FanState previousFan = {};     // Fan state one physics tick ago
+unsigned long physicsTicks = 0; // Ticks run since the start (input log timestamps; simulation thread)
+SimThread simulation;
+float renderAlpha = 1.0f;      // Fraction of the way from the snapshot's previousFan to its fan
+double renderHz = 60.0;        // Target frames per second, 0 = as fast as possible
+double nextFrameTime = 0.0;    // When the next frame is due (monotonic seconds)
+RateMeter rates = {};          // Measured render fps, physics Hz and CPU use
+
+// Frames are only scheduled while something moves; otherwise the program
+// waits for input with no timer running
+bool animating = false;        // Frames are being scheduled
+int timerGeneration = 0;       // Timers from an earlier animation run stop themselves
+IdleMeter idleMeter = {};      // CPU use while waiting
+
+// Particles spawn in a 60 degree cone 80-100px in front of the hub...
+const ParticleEmitter coneEmitter = {450, 350, -30 * 3.1415926f / 180.0f, 30 * 3.1415926f / 180.0f, 80, 100, 1u};
+// ...and occasionally anywhere on a ring just outside the cage
+const ParticleEmitter ringEmitter = {450, 350, 0, 2 * 3.1415926f, 75, 75, 2u};
 
 // Window dimensions
 int windowWidth = 800;   // Initial window width in pixels
 int windowHeight = 600;  // Initial window height in pixels
 
+// Everything a frame shows of the simulation, copied out after its ticks.
+// The simulation thread fills one snapshot while the render thread draws
+// another; drawing code reads only view, never the simulation's globals.
+struct SceneSnapshot {
+    FanState fan, previousFan;             // Blades are drawn between the two
+    int bladeCount;
+    int particleCount;
+    std::vector<float> particleX, particleY, particleAlpha;  // kMaxAirParticles each
+    int airGridWidth, airGridHeight;
+    float airResidual;
+    float airUpdateMs;                     // Time spent moving the air since the last snapshot drawn
+    unsigned long tick;                    // Ticks run
+    double tickTime;                       // When the last tick was due (monotonic); 0 = draw without interpolating
+    float tickMs;                          // Simulation time per tick
+    bool settled;                          // Nothing moving: no new snapshot until new input
+    unsigned commandsApplied;              // Input commands applied so far
+    float inputLatency;                    // Mean time from input to the tick that applied it, seconds
+    double unshown[COMMAND_TYPE_COUNT];    // Commands applied since the last snapshot drawn (commandsHandOff())
+};
+TripleBuffer<SceneSnapshot> snapshots;
+const SceneSnapshot* view = 0;             // The snapshot being drawn (render thread)
+bool snapshotDropped = false;              // The last publish replaced one never drawn (simulation thread)
+
 // Function to draw a circle using triangle fan primitive
-void drawCircle(float cx, float cy, float radius, int segments) {
-    glBegin(GL_TRIANGLE_FAN);     // Start drawing connected triangles from center
-    glVertex2f(cx, cy);           // Center point (all triangles share this vertex)
+// Segments is a template parameter so the unit circle comes from a compile-time table
+template <int Segments>
+void drawCircle(float cx, float cy, float radius) {
+    const CircleTable<Segments>& unit = circleTable<Segments>;  // Precomputed cos/sin
+    
+    batchBegin(shapeBatch, GL_TRIANGLE_FAN);  // Start drawing connected triangles from center
+    batchVertex(shapeBatch, cx, cy);          // Center point (all triangles share this vertex)
     
     // Create vertices around the circle
-    for (int i = 0; i <= segments; i++) {
-        float theta = 2.0f * 3.1415926f * float(i) / float(segments);  // Angle in radians
-        float x = radius * cosf(theta);  // X coordinate on circle
-        float y = radius * sinf(theta);  // Y coordinate on circle
-        glVertex2f(cx + x, cy + y);      // Add vertex position
+    for (int i = 0; i <= Segments; i++) {
+        float x = radius * unit.cosv[i];  // X coordinate on circle
+        float y = radius * unit.sinv[i];  // Y coordinate on circle
+        batchVertex(shapeBatch, cx + x, cy + y);  // Add vertex position
     }
-    glEnd();  // End drawing
+    batchEnd(shapeBatch);  // End drawing
 }
 
 // Function to draw a rectangle with rounded corners
 void drawRoundedRect(float x, float y, float width, float height, float radius) {
-    int segments = 20;  // Number of segments per quarter circle
+    const int segments = 20;  // Number of segments per corner arc
+    
+    // Corner angles step by pi/segments, i.e. a full circle every 2*segments steps
+    const CircleTable<2 * segments>& unit = circleTable<2 * segments>;
     
-    glBegin(GL_POLYGON);  // Start drawing filled polygon
+    batchBegin(shapeBatch, GL_POLYGON);  // Start drawing filled polygon
     
     // Draw top right rounded corner
     for (int i = 0; i <= segments; i++) {
-        float theta = 3.1415926f * float(i) / float(segments);  // 0 to 90 degrees
-        float px = x + width - radius + radius * cosf(theta);   // X position
-        float py = y + height - radius + radius * sinf(theta);  // Y position
-        glVertex2f(px, py);  // Add vertex
+        int k = i % (2 * segments);  // Table index for angle pi * i / segments
+        float px = x + width - radius + radius * unit.cosv[k];   // X position
+        float py = y + height - radius + radius * unit.sinv[k];  // Y position
+        batchVertex(shapeBatch, px, py);  // Add vertex
     }
     
     // Draw bottom right rounded corner (90 to 180 degrees)
     for (int i = segments; i <= 2 * segments; i++) {
-        float theta = 3.1415926f * float(i) / float(segments);
-        float px = x + width - radius + radius * cosf(theta);
-        float py = y + radius + radius * sinf(theta);
-        glVertex2f(px, py);
+        int k = i % (2 * segments);
+        float px = x + width - radius + radius * unit.cosv[k];
+        float py = y + radius + radius * unit.sinv[k];
+        batchVertex(shapeBatch, px, py);
     }
     
     // Draw bottom left rounded corner (180 to 270 degrees)
     for (int i = 2 * segments; i <= 3 * segments; i++) {
-        float theta = 3.1415926f * float(i) / float(segments);
-        float px = x + radius + radius * cosf(theta);
-        float py = y + radius + radius * sinf(theta);
-        glVertex2f(px, py);
+        int k = i % (2 * segments);
+        float px = x + radius + radius * unit.cosv[k];
+        float py = y + radius + radius * unit.sinv[k];
+        batchVertex(shapeBatch, px, py);
     }
     
     // Draw top left rounded corner (270 to 360 degrees)
     for (int i = 3 * segments; i <= 4 * segments; i++) {
-        float theta = 3.1415926f * float(i) / float(segments);
-        float px = x + radius + radius * cosf(theta);
-        float py = y + height - radius + radius * sinf(theta);
-        glVertex2f(px, py);
+        int k = i % (2 * segments);
+        float px = x + radius + radius * unit.cosv[k];
+        float py = y + height - radius + radius * unit.sinv[k];
+        batchVertex(shapeBatch, px, py);
     }
-    glEnd();  // End drawing
+    batchEnd(shapeBatch);  // End drawing
 }
 
 // Function to draw the desk surface and legs
 void drawDesk() {
-    glColor3fv(deskColor);  // Set current color to desk color
+    ProfileScope profile(kStageDesk);
+    batchColor(shapeBatch, deskColor);  // Set current color to desk color
     
     // Draw main desk surface as a quad (rectangle)
-    glBegin(GL_QUADS);
-    glVertex2f(100, 150);  // Bottom-left corner
-    glVertex2f(700, 150);  // Bottom-right corner
-    glVertex2f(700, 350);  // Top-right corner
-    glVertex2f(100, 350);  // Top-left corner
-    glEnd();
+    batchBegin(shapeBatch, GL_QUADS);
+    batchVertex(shapeBatch, 100, 150);  // Bottom-left corner
+    batchVertex(shapeBatch, 700, 150);  // Bottom-right corner
+    batchVertex(shapeBatch, 700, 350);  // Top-right corner
+    batchVertex(shapeBatch, 100, 350);  // Top-left corner
+    batchEnd(shapeBatch);
     
     // Draw four desk legs as vertical quads
-    glBegin(GL_QUADS);
+    batchBegin(shapeBatch, GL_QUADS);
     // Front left leg
-    glVertex2f(120, 50);
-    glVertex2f(140, 50);
-    glVertex2f(140, 150);
-    glVertex2f(120, 150);
+    batchVertex(shapeBatch, 120, 50);
+    batchVertex(shapeBatch, 140, 50);
+    batchVertex(shapeBatch, 140, 150);
+    batchVertex(shapeBatch, 120, 150);
     
     // Front right leg
-    glVertex2f(660, 50);
-    glVertex2f(680, 50);
-    glVertex2f(680, 150);
-    glVertex2f(660, 150);
+    batchVertex(shapeBatch, 660, 50);
+    batchVertex(shapeBatch, 680, 50);
+    batchVertex(shapeBatch, 680, 150);
+    batchVertex(shapeBatch, 660, 150);
     
     // Back left leg
-    glVertex2f(120, 350);
-    glVertex2f(140, 350);
-    glVertex2f(140, 450);
-    glVertex2f(120, 450);
+    batchVertex(shapeBatch, 120, 350);
+    batchVertex(shapeBatch, 140, 350);
+    batchVertex(shapeBatch, 140, 450);
+    batchVertex(shapeBatch, 120, 450);
     
     // Back right leg
-    glVertex2f(660, 350);
-    glVertex2f(680, 350);
-    glVertex2f(680, 450);
-    glVertex2f(660, 450);
-    glEnd();
+    batchVertex(shapeBatch, 660, 350);
+    batchVertex(shapeBatch, 680, 350);
+    batchVertex(shapeBatch, 680, 450);
+    batchVertex(shapeBatch, 660, 450);
+    batchEnd(shapeBatch);
     
     // Draw decorative lines on desk edges
-    glColor3f(deskColor[0] * 0.8, deskColor[1] * 0.8, deskColor[2] * 0.8);  // Darker shade
-    glLineWidth(2.0);  // Set line thickness
-    glBegin(GL_LINES);
+    batchColor(shapeBatch, deskColor[0] * 0.8, deskColor[1] * 0.8, deskColor[2] * 0.8);  // Darker shade
+    batchLineWidth(shapeBatch, 2.0);  // Set line thickness
+    batchBegin(shapeBatch, GL_LINES);
     // Draw outline around desk surface
-    glVertex2f(100, 150); glVertex2f(700, 150);  // Bottom edge
-    glVertex2f(700, 150); glVertex2f(700, 350);  // Right edge
-    glVertex2f(700, 350); glVertex2f(100, 350);  // Top edge
-    glVertex2f(100, 350); glVertex2f(100, 150);  // Left edge
-    glEnd();
+    batchVertex(shapeBatch, 100, 150); batchVertex(shapeBatch, 700, 150);  // Bottom edge
+    batchVertex(shapeBatch, 700, 150); batchVertex(shapeBatch, 700, 350);  // Right edge
+    batchVertex(shapeBatch, 700, 350); batchVertex(shapeBatch, 100, 350);  // Top edge
+    batchVertex(shapeBatch, 100, 350); batchVertex(shapeBatch, 100, 150);  // Left edge
+    batchEnd(shapeBatch);
 }
 
 // Function to draw the fan's stand/base
 void drawFanStand() {
+    ProfileScope profile(kStageStand);
     // Draw circular base on desk
-    glColor3f(0.2f, 0.2f, 0.2f);  // Black color
-    drawCircle(400, 250, 40, 30);  // Center at (400,250), radius 40, 30 segments
+    batchColor(shapeBatch, 0.2f, 0.2f, 0.2f);  // Black color
+    drawCircle<30>(400, 250, 40);  // Center at (400,250), radius 40, 30 segments
     
     // Draw vertical stand pole as a thick line
-    glColor3fv(fanColor);  // Use fan color
-    glLineWidth(8.0);  // Thick line
-    glBegin(GL_LINES);
-    glVertex2f(400, 250);  // Top of base
-    glVertex2f(400, 350);  // Top of stand (where fan attaches)
-    glEnd();
+    batchColor(shapeBatch, fanColor);  // Use fan color
+    batchLineWidth(shapeBatch, 8.0);  // Thick line
+    batchBegin(shapeBatch, GL_LINES);
+    batchVertex(shapeBatch, 400, 250);  // Top of base
+    batchVertex(shapeBatch, 400, 350);  // Top of stand (where fan attaches)
+    batchEnd(shapeBatch);
     
     // Draw top of stand where fan motor attaches
-    glColor3f(fanColor[0] * 0.7, fanColor[1] * 0.7, fanColor[2] * 0.7);  // Darker gray
-    drawCircle(400, 350, 15, 20);  // Small circle at top
+    batchColor(shapeBatch, fanColor[0] * 0.7, fanColor[1] * 0.7, fanColor[2] * 0.7);  // Darker gray
+    drawCircle<20>(400, 350, 15);  // Small circle at top
 }
 
 // Function to draw the safety cage around the fan blades
 void drawSafetyCage() {
+    ProfileScope profile(kStageCage);
     // Set semi-transparent gray color with alpha = 0.4 (40% opaque)
-    glColor4f(0.5f, 0.5f, 0.5f, 0.4f);
-    glLineWidth(1.5);  // Medium line thickness
+    batchColor(shapeBatch, 0.5f, 0.5f, 0.5f, 0.4f);
+    batchLineWidth(shapeBatch, 1.5);  // Medium line thickness
+    
+    // Unit vectors for the spokes and ring points, computed at compile time
+    const CircleTable<12>& spokes = circleTable<12>;  // 30 degrees between spokes
+    const CircleTable<36>& ring = circleTable<36>;    // 10 degrees per ring segment
     
     // Draw radial spokes from center to outer ring
-    glBegin(GL_LINES);
+    batchBegin(shapeBatch, GL_LINES);
     for (int i = 0; i < 12; i++) {  // 12 spokes
-        float angle = i * 30.0f;  // 30 degrees between spokes
-        float rad = angle * 3.1415926f / 180.0f;  // Convert to radians
-        glVertex2f(450, 350);  // Center of fan (not stand!)
-        glVertex2f(450 + cosf(rad) * 80, 350 + sinf(rad) * 80);  // Outer point
+        batchVertex(shapeBatch, 450, 350);  // Center of fan (not stand!)
+        batchVertex(shapeBatch, 450 + spokes.cosv[i] * 80, 350 + spokes.sinv[i] * 80);  // Outer point
     }
-    glEnd();
+    batchEnd(shapeBatch);
     
     // Draw outer ring of cage
-    glBegin(GL_LINE_LOOP);  // Connected line that forms a closed loop
+    batchBegin(shapeBatch, GL_LINE_LOOP);  // Connected line that forms a closed loop
     for (int i = 0; i < 36; i++) {  // 36 segments for smooth circle
-        float angle = i * 10.0f;  // 10 degrees per segment
-        float rad = angle * 3.1415926f / 180.0f;
-        glVertex2f(450 + cosf(rad) * 80, 350 + sinf(rad) * 80);  // Points at radius 80
+        batchVertex(shapeBatch, 450 + ring.cosv[i] * 80, 350 + ring.sinv[i] * 80);  // Points at radius 80
     }
-    glEnd();
+    batchEnd(shapeBatch);
     
     // Draw inner ring of cage (closer to blades)
-    glBegin(GL_LINE_LOOP);
+    batchBegin(shapeBatch, GL_LINE_LOOP);
     for (int i = 0; i < 36; i++) {
-        float angle = i * 10.0f;
-        float rad = angle * 3.1415926f / 180.0f;
-        glVertex2f(450 + cosf(rad) * 70, 350 + sinf(rad) * 70);  // Points at radius 70
+        batchVertex(shapeBatch, 450 + ring.cosv[i] * 70, 350 + ring.sinv[i] * 70);  // Points at radius 70
     }
-    glEnd();
+    batchEnd(shapeBatch);
 }
 
-// Function to draw a single fan blade
-// bladeAngle: angle of blade from center (in radians)
-// bladeIndex: which blade (0-4) for color selection
-void drawBlade(float bladeAngle, int bladeIndex) {
-    glColor3fv(bladeColors[bladeIndex]);  // Set blade color based on index
-    
-    glBegin(GL_TRIANGLE_FAN);  // Use triangle fan for smooth blade shape
-    
-    // Calculate blade tip position (outer edge)
-    float tipX = cosf(bladeAngle) * 60.0f;  // 60 pixels from center
-    float tipY = sinf(bladeAngle) * 60.0f;
-    
-    // Calculate blade base points (at hub, 15 degrees on each side for thickness)
-    float baseAngle1 = bladeAngle - 15.0f * 3.1415926f / 180.0f;
-    float baseAngle2 = bladeAngle + 15.0f * 3.1415926f / 180.0f;
-    
-    float baseX1 = cosf(baseAngle1) * 10.0f;  // 10 pixels from center (hub radius)
-    float baseY1 = sinf(baseAngle1) * 10.0f;
-    float baseX2 = cosf(baseAngle2) * 10.0f;
-    float baseY2 = sinf(baseAngle2) * 10.0f;
-    
-    glVertex2f(0, 0);  // Center point where blade attaches to hub
-    
-    // Create curved edge for blade
-    for (int i = 0; i <= 10; i++) {
-        float t = i / 10.0f;  // Parameter from 0 to 1
-        float angle = bladeAngle + t * 0.2f;  // Slight curve in blade
-        float radius = 10.0f + t * 50.0f;     // Interpolate from hub to tip
-        float x = cosf(angle) * radius;
-        float y = sinf(angle) * radius;
-        glVertex2f(x, y);
+// Function to draw every blade of a Blades-blade rotor from its precomputed
+// geometry (blade_profile.h): the fills, then the outlines for definition
+// (after all the fills so the outlines form one batch run)
+template <int Blades>
+void drawBladeProfile() {
+    const BladeProfile<Blades, 10>& profile = bladeProfile2D<Blades>;
+    for (int b = 0; b < Blades; b++) {
+        batchColor(shapeBatch, bladeColors[b]);  // Set blade color based on index
+        batchBegin(shapeBatch, GL_TRIANGLE_FAN);  // Hub center, curved edge, base point
+        for (int i = 0; i < profile.kFanVertices; i++) {
+            batchVertex(shapeBatch, profile.fan[b][i][0], profile.fan[b][i][1]);
+        }
+        batchEnd(shapeBatch);
+    }
+    batchColor(shapeBatch, 0.1f, 0.1f, 0.1f);  // Dark color for outline
+    batchLineWidth(shapeBatch, 1.5);
+    for (int b = 0; b < Blades; b++) {
+        batchBegin(shapeBatch, GL_LINE_LOOP);  // Base point 1, blade tip, base point 2
+        for (int i = 0; i < 3; i++) {
+            batchVertex(shapeBatch, profile.outline[b][i][0], profile.outline[b][i][1]);
+        }
+        batchEnd(shapeBatch);
     }
-    
-    glVertex2f(baseX2, baseY2);  // Close the shape
-    glEnd();
-    
-    // Draw outline around blade for definition
-    glColor3f(0.1f, 0.1f, 0.1f);  // Dark color for outline
-    glLineWidth(1.5);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(baseX1, baseY1);  // Base point 1
-    glVertex2f(tipX, tipY);      // Blade tip
-    glVertex2f(baseX2, baseY2);  // Base point 2
-    glEnd();
 }
 
 // Function to draw the fan motor housing and connection arm
 void drawFanMotor() {
+    ProfileScope profile(kStageMotor);
     // Draw motor housing at end of stand
-    glColor3fv(fanColor);
-    drawCircle(400, 350, 20, 30);  // Circle at stand top
+    batchColor(shapeBatch, fanColor);
+    drawCircle<30>(400, 350, 20);  // Circle at stand top
     
     // Draw motor face (forward facing circle)
-    glColor3f(fanColor[0] * 0.8, fanColor[1] * 0.8, fanColor[2] * 0.8);  // Darker
-    drawCircle(425, 350, 15, 20);  // Slightly offset forward
+    batchColor(shapeBatch, fanColor[0] * 0.8, fanColor[1] * 0.8, fanColor[2] * 0.8);  // Darker
+    drawCircle<20>(425, 350, 15);  // Slightly offset forward
     
     // Draw connection arm from stand to fan center
-    glColor3fv(fanColor);
-    glLineWidth(6.0);  // Thick line for arm
-    glBegin(GL_LINES);
-    glVertex2f(400, 350);  // End of stand
-    glVertex2f(450, 350);  // Center of fan blades
-    glEnd();
+    batchColor(shapeBatch, fanColor);
+    batchLineWidth(shapeBatch, 6.0);  // Thick line for arm
+    batchBegin(shapeBatch, GL_LINES);
+    batchVertex(shapeBatch, 400, 350);  // End of stand
+    batchVertex(shapeBatch, 450, 350);  // Center of fan blades
+    batchEnd(shapeBatch);
     
     // Draw fan hub (center where blades attach)
-    glColor3f(0.1f, 0.1f, 0.1f);  // Dark color
-    drawCircle(450, 350, 12, 24);  // Small dark circle
+    batchColor(shapeBatch, 0.1f, 0.1f, 0.1f);  // Dark color
+    drawCircle<24>(450, 350, 12);  // Small dark circle
 }
 
-// Function to draw all 5 fan blades with rotation
+// Function to draw all fan blades with rotation
 void drawFanBlades() {
+    ProfileScope profile(kStageBlades);
     glPushMatrix();  // Save current transformation matrix
     
     // Move coordinate system to fan center (450,350)
     glTranslatef(450, 350, 0);
     
-    // Apply rotation based on current rotationAngle
-    glRotatef(rotationAngle, 0.0f, 0.0f, 1.0f);  // Rotate around Z-axis
+    // Apply rotation based on current blade angle
+    glRotatef(fanInterpolatedAngle(view->previousFan, view->fan, renderAlpha), 0.0f, 0.0f, 1.0f);  // Rotate around Z-axis
     
-    // Draw 5 blades spaced 72 degrees apart (360/5 = 72)
-    for (int i = 0; i < 5; i++) {
-        float bladeAngle = i * 72.0f * 3.1415926f / 180.0f;  // Convert to radians
-        drawBlade(bladeAngle, i);  // Draw each blade with its color
+    // Draw the blades spaced evenly around the hub (360/count degrees apart)
+    switch (view->bladeCount) {
+        case 3: drawBladeProfile<3>(); break;
+        case 7: drawBladeProfile<7>(); break;
+        default: drawBladeProfile<5>(); break;
     }
     
     glPopMatrix();  // Restore original transformation matrix
@@ -287,186 +393,259 @@ void drawFanBlades() {
 
 // Function to draw air flow particles
 void drawAirFlow() {
-    if (!fanOn) return;  // No air flow when fan is off
-    
-    // Generate new particles randomly
-    if (airParticles.size() < 30 && rand() % 10 < fanSpeedLevel) {
-        float angle = (rand() % 60 - 30) * 3.1415926f / 180.0f;  // Random angle -30 to +30 degrees
-        float distance = 80 + rand() % 20;  // Random distance 80-100 from center
-        airParticles.push_back(std::make_pair(
-            450 + cosf(angle) * distance,  // X position
-            350 + sinf(angle) * distance   // Y position
-        ));
+    ProfileScope profile(kStageAirFlow);
+    if (!view->fan.on) return;  // No air flow when fan is off
+    
+    batchPointSize(shapeBatch, 2.5f);  // Set particle size
+    batchBegin(shapeBatch, GL_POINTS);  // Draw each particle as a point
+    for (int i = 0; i < view->particleCount; i++) {
+        // Light blue with transparency (alpha fades with distance, see updateAirFlow)
+        batchColor(shapeBatch, 0.7f, 0.8f, 1.0f, view->particleAlpha[i]);
+        batchVertex(shapeBatch, view->particleX[i], view->particleY[i]);  // Draw particle
     }
+    batchEnd(shapeBatch);
+}
+
+// Function to spawn and move air flow particles (one tick)
+void updateAirFlow() {
+    ProfileScope profile(kStageAirUpdate);
+    if (!fan.on) return;  // Particles freeze while the fan is off
     
-    // Update and draw all particles
-    glPointSize(2.5f);  // Set particle size
-    glBegin(GL_POINTS);  // Draw each particle as a point
-    for (size_t i = 0; i < airParticles.size(); i++) {
-        // Calculate distance from fan center
-        float dx = airParticles[i].first - 450;
-        float dy = airParticles[i].second - 350;
-        float dist = sqrt(dx * dx + dy * dy);
-        
-        // Remove particles that are too far away
-        if (dist > 200) {
-            airParticles.erase(airParticles.begin() + i);
-            i--;  // Adjust index since we removed an element
-            continue;
-        }
-        
-        // Move particle outward from center
-        float moveSpeed = 1.5f + fanSpeedLevel * 0.3f;  // Speed increases with fan speed
-        airParticles[i].first += dx / dist * moveSpeed;   // Move in X direction
-        airParticles[i].second += dy / dist * moveSpeed;  // Move in Y direction
-        
-        // Set particle color with transparency (fade out as particles move away)
-        float alpha = 1.0f - (dist - 80) / 120.0f;  // Alpha decreases with distance
-        glColor4f(0.7f, 0.8f, 1.0f, alpha * 0.6f);  // Light blue with transparency
-        glVertex2f(airParticles[i].first, airParticles[i].second);  // Draw particle
+    // Spawn rate scales with speed level; keep the fractional part for next tick
+    particleSpawnBudget += fan.speedLevel * kParticleSpawnPerLevel;
+    int spawnCount = (int)particleSpawnBudget;
+    particleSpawnBudget -= spawnCount;
+    particlesEmit(airParticles, coneEmitter, spawnCount, particleThreads);
+    
+    // Occasional particle in a random direction around the cage
+    if (rand() % 15 == 0) {
+        particlesEmit(airParticles, ringEmitter, 1, particleThreads);
     }
-    glEnd();
+    
+    // Blow, then give every particle the air's velocity where it is
+    FluidFan forces = {450, 350, kAirDiscRadius, fan.rotationSpeed * kAirSourcePerSpeed,
+                       fan.rotationSpeed * kAirSwirlPerSpeed};
+    fluidStep(airFluid, forces, particleThreads);
+    fluidSample(airFluid, airParticles.x.data(), airParticles.y.data(),
+                airParticles.vx.data(), airParticles.vy.data(), airParticles.count);
+    
+    // Move particles with the air, fade them and remove those that are too far away
+    AdvectParams advect;
+    advect.cx = 450;                                // Fan center
+    advect.cy = 350;
+    advect.speed = 1.0f;                            // Velocities are already pixels per tick
+    advect.fadeStart = 80.0f;                       // Fully visible up to 80px...
+    advect.fadeLength = 120.0f;                     // ...then fade out by 200px
+    advect.alphaScale = 0.6f;                       // Maximum particle opacity
+    particlesUpdate(airParticles, advect, 200, particleThreads);
 }
 
-// Main function to draw the entire fan assembly
-void drawFan() {
+// Function to draw the parts that never move
+void drawBackgroundParts() {
     // Draw components in correct order (back to front)
-    drawFanStand();     // Stand/base first
+    drawDesk();         // Desk first
+    drawFanStand();     // Stand/base
     drawFanMotor();     // Motor and connection
     drawSafetyCage();   // Cage behind blades
+    batchFlush(shapeBatch);  // Into the framebuffer, where the layer cache copies them from
+}
+
+// Function to draw everything behind the blades, from the cached copy when that is faster
+void drawBackground() {
+    ProfileScope profile(kStageBackground);
+    layerDraw(backgroundLayer, windowWidth, windowHeight, drawBackgroundParts);
+}
+
+// Main function to draw the moving parts of the fan
+void drawFan() {
+    ProfileScope profile(kStageFan);
     drawFanBlades();    // Rotating blades
     drawAirFlow();      // Air particles on top
 }
 
 // Function to draw the control panel with buttons
 void drawControls() {
+    ProfileScope profile(kStageControls);
     // Control panel background
-    glColor3f(0.2f, 0.2f, 0.2f);  // Dark gray
+    batchColor(shapeBatch, 0.2f, 0.2f, 0.2f);  // Dark gray
     drawRoundedRect(650, 400, 120, 180, 10);  // Positioned top-right
     
     // Power button - color changes based on state
-    if (fanOn) {
-        glColor3f(0.2f, 0.8f, 0.2f);  // Green when on
+    if (view->fan.on) {
+        batchColor(shapeBatch, 0.2f, 0.8f, 0.2f);  // Green when on
     } else {
-        glColor3fv(buttonColor);  // Red when off
+        batchColor(shapeBatch, buttonColor);  // Red when off
     }
     drawRoundedRect(670, 420, 80, 40, 5);  // Power button
     
-    // Draw "ON" or "OFF" text on button
-    glColor3f(1.0f, 1.0f, 1.0f);  // White text
-    glRasterPos2f(675, 440);  // Position for text
-    const char* powerText = fanOn ? "ON" : "OFF";
-    while (*powerText) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *powerText++);  // Draw each character
-    }
+    // Draw "ON" or "OFF" text on button (white)
+    textAdd(hudText, TEXT_HELVETICA_12, 675, 440, view->fan.on ? "ON" : "OFF", 1.0f, 1.0f, 1.0f);
     
     // Draw 5 speed buttons (1-5)
     for (int i = 0; i < 5; i++) {
         // Highlight current speed level
-        if ((i + 1) == fanSpeedLevel) {
-            glColor3fv(speedButtonColor);  // Bright green for active speed
+        if ((i + 1) == view->fan.speedLevel) {
+            batchColor(shapeBatch, speedButtonColor);  // Bright green for active speed
         } else {
-            glColor3f(speedButtonColor[0] * 0.5,  // Dim green for inactive
+            batchColor(shapeBatch, speedButtonColor[0] * 0.5,  // Dim green for inactive
                      speedButtonColor[1] * 0.5, 
                      speedButtonColor[2] * 0.5);
         }
         
         drawRoundedRect(670, 470 + i * 25, 80, 20, 3);  // Position each button
         
-        // Draw speed number (1-5)
-        glColor3f(1.0f, 1.0f, 1.0f);  // White text
-        glRasterPos2f(700, 485 + i * 25);
-        char speedNum = '1' + i;  // Convert index to character '1' through '5'
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, speedNum);
+        // Draw speed number (1-5) in white
+        char speedNum[2] = {(char)('1' + i), 0};  // Convert index to string "1" through "5"
+        textAdd(hudText, TEXT_HELVETICA_12, 700, 485 + i * 25, speedNum, 1.0f, 1.0f, 1.0f);
     }
     
     // Draw labels for control panel sections
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2f(660, 410);
-    const char* powerLabel = "POWER";
-    while (*powerLabel) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *powerLabel++);
-    }
-    
-    glRasterPos2f(660, 460);
-    const char* speedLabel = "SPEED";
-    while (*speedLabel) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *speedLabel++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_12, 660, 410, "POWER", 1.0f, 1.0f, 1.0f);
+    textAdd(hudText, TEXT_HELVETICA_12, 660, 460, "SPEED", 1.0f, 1.0f, 1.0f);
 }
 
 // Function to draw status information and instructions
 void drawStatus() {
-    glColor3f(0.0f, 0.0f, 0.0f);  // Black text
+    ProfileScope profile(kStageStatus);
+    // Black text; unchanged lines reuse last frame's quads
     
     // Main title
-    glRasterPos2f(50, 570);
-    const char* statusText = "VENTILATOR FAN CONTROL";
-    while (*statusText) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *statusText++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_18, 50, 570, "VENTILATOR FAN CONTROL", 0.0f, 0.0f, 0.0f);
     
     // Fan status (running/stopped)
-    glRasterPos2f(50, 550);
-    const char* fanStatus = fanOn ? "FAN: RUNNING" : "FAN: STOPPED";
-    while (*fanStatus) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *fanStatus++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_12, 50, 550, view->fan.on ? "FAN: RUNNING" : "FAN: STOPPED", 0.0f, 0.0f, 0.0f);
     
     // Current speed level
-    glRasterPos2f(50, 530);
     char speedStatus[50];
-    sprintf(speedStatus, "SPEED LEVEL: %d", fanSpeedLevel);
-    const char* speedPtr = speedStatus;
-    while (*speedPtr) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *speedPtr++);
-    }
+    sprintf(speedStatus, "SPEED LEVEL: %d", view->fan.speedLevel);
+    textAdd(hudText, TEXT_HELVETICA_12, 50, 530, speedStatus, 0.0f, 0.0f, 0.0f);
     
-    // Air flow status
-    glRasterPos2f(50, 510);
-    const char* airflowStatus = "AIR FLOW: ACTIVE";
-    while (*airflowStatus) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *airflowStatus++);
-    }
+    // Air flow solver: grid size and how well the last pressure solve converged
+    // (kept short: the CONTROLS column starts at x = 330 on the same rows)
+    char airStatus[80];
+    sprintf(airStatus, "AIR: %dx%d grid, residual %.1e", view->airGridWidth, view->airGridHeight, view->airResidual);
+    textAdd(hudText, TEXT_HELVETICA_12, 50, 510, airStatus, 0.0f, 0.0f, 0.0f);
     
     // Physics simulation status
-    glRasterPos2f(50, 490);
-    const char* accelStatus = "ACCEL/DECEL: ENABLED";
-    while (*accelStatus) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *accelStatus++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_12, 50, 490, "ACCEL/DECEL: ENABLED", 0.0f, 0.0f, 0.0f);
     
-    // Control instructions
-    glRasterPos2f(330, 540);
-    const char* inst1 = "CONTROLS:";
-    while (*inst1) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *inst1++);
+    // Diagnostics, shown with the frame-time graph (G), in the free space
+    // above the desk: two long lines between the CONTROLS column and the
+    // back-left leg (x 120-140, up to y = 450), the short ones between that
+    // leg and the fan's cage, so nothing is drawn over the scene
+    if (showProfile) {
+        // Static background: cached copy or drawn, with the times measured at the last capture
+        static const char* layerModes[] = {"auto", "always cached", "never cached"};
+        char layerStatus[100];
+        if (backgroundLayer.captures > 0) {
+            sprintf(layerStatus, "BACKGROUND: %s (%s; copy %.1f ms, draw %.1f ms)",
+                    backgroundLayer.cached ? "cached" : "drawn", layerModes[backgroundLayer.mode],
+                    backgroundLayer.copyMs, backgroundLayer.drawMs);
+        } else {
+            sprintf(layerStatus, "BACKGROUND: drawn (%s)", layerModes[backgroundLayer.mode]);
+        }
+        textAdd(hudText, TEXT_HELVETICA_10, 50, 467, layerStatus, 0.0f, 0.0f, 0.0f);
+        
+        // Input latency: mean time from a click or key to the tick that applied it and the frame that showed it
+        char inputStatus[100];
+        float toApplied, toShown;  // Only the shown side is kept on this thread
+        commandMeanLatency(shownLatency, toApplied, toShown);
+        sprintf(inputStatus, "INPUT: applied after %.1f ms, shown after %.1f ms (%ld dropped)",
+                1000.0f * view->inputLatency, 1000.0f * toShown, inputCommands.dropped);
+        textAdd(hudText, TEXT_HELVETICA_10, 50, 455, inputStatus, 0.0f, 0.0f, 0.0f);
+        
+        // Measured render rate and CPU use, physics rate and time per tick
+        char rateStatus[80];
+        sprintf(rateStatus, "RENDER: %.0f fps, CPU %.0f%%", rates.fps, rates.cpuPercent);
+        textAdd(hudText, TEXT_HELVETICA_10, 145, 440, rateStatus, 0.0f, 0.0f, 0.0f);
+        sprintf(rateStatus, "PHYSICS: %.0f Hz, %.2f ms per tick", rates.tickHz, view->tickMs);
+        textAdd(hudText, TEXT_HELVETICA_10, 145, 427, rateStatus, 0.0f, 0.0f, 0.0f);
+        
+        // CPU use during the last pause (nothing moving, waiting for input)
+        char idleStatus[80];
+        if (idleMeter.seconds > 0.0f) {
+            sprintf(idleStatus, "IDLE: %.1f%% CPU, last pause %.0f s", idleMeter.cpuPercent, idleMeter.seconds);
+        } else {
+            sprintf(idleStatus, "IDLE: no pause yet");
+        }
+        textAdd(hudText, TEXT_HELVETICA_10, 145, 414, idleStatus, 0.0f, 0.0f, 0.0f);
+        
+        // Shape batch: draw calls and vertices of the last frame
+        char batchStatus[80];
+        sprintf(batchStatus, "SHAPES: %d draw calls, %d vertices", shapeBatch.frameDrawCalls, shapeBatch.frameVertices);
+        textAdd(hudText, TEXT_HELVETICA_10, 145, 401, batchStatus, 0.0f, 0.0f, 0.0f);
+        
+        // Video capture progress (to kCapturePath)
+        char captureStatus[80];
+        if (videoCapture.active) {
+            sprintf(captureStatus, "CAPTURE: %ld frames, %ld dropped", videoCapture.written.load(),
+                    videoCapture.dropped);
+        } else {
+            sprintf(captureStatus, "CAPTURE: off (V to record)");
+        }
+        textAdd(hudText, TEXT_HELVETICA_10, 145, 388, captureStatus, 0.0f, 0.0f, 0.0f);
+        
+        // Heap allocations (steady-state frames should make none)
+        char allocStatus[80];
+        sprintf(allocStatus, "ALLOC: %ld last frame, %ld max", allocMeter.lastFrame, allocMeter.steadyMax);
+        textAdd(hudText, TEXT_HELVETICA_10, 145, 375, allocStatus, 0.0f, 0.0f, 0.0f);
+        
+        // Renderer: OpenGL, or the software rasterizer with its last frame's work
+        char rasterStatus[80];
+        if (softBackend) {
+            sprintf(rasterStatus, "RASTER: CPU, %d tris in %d bins", softBackend->flushTriangles,
+                    softBackend->flushBinEntries);
+        } else {
+            sprintf(rasterStatus, "RASTER: OpenGL");
+        }
+        textAdd(hudText, TEXT_HELVETICA_10, 145, 362, rasterStatus, 0.0f, 0.0f, 0.0f);
     }
     
-    glRasterPos2f(330, 520);
-    const char* inst2 = "Click POWER button to toggle ON/OFF";
-    while (*inst2) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *inst2++);
-    }
+    // Control instructions
+    textAdd(hudText, TEXT_HELVETICA_12, 330, 540, "CONTROLS:", 0.0f, 0.0f, 0.0f);
+    textAdd(hudText, TEXT_HELVETICA_12, 330, 520, "Click POWER button to toggle ON/OFF", 0.0f, 0.0f, 0.0f);
+    textAdd(hudText, TEXT_HELVETICA_12, 330, 500, "Click SPEED buttons 1-5 to adjust speed", 0.0f, 0.0f, 0.0f);
+    textAdd(hudText, TEXT_HELVETICA_12, 330, 480, "O: On  F: Off  R: Reset  ESC: Exit", 0.0f, 0.0f, 0.0f);
+}
+
+// Function to draw the frame-time graph and a legend of average stage times
+void drawProfile() {
+    profileDrawGraph(20, 20, 300, 100);  // Bottom-left corner, 30 fps at the top
     
-    glRasterPos2f(330, 500);
-    const char* inst3 = "Click SPEED buttons 1-5 to adjust speed";
-    while (*inst3) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *inst3++);
-    }
+    ProfileFrame average;
+    profileAverage(60, average);  // Last second at 60 fps
+    char line[64];
+    sprintf(line, "FRAME: %.2f ms", average.frameMs);
+    textAdd(hudText, TEXT_HELVETICA_10, 20, 126, line, 0.0f, 0.0f, 0.0f);
     
-    glRasterPos2f(330, 480);
-    const char* inst4 = "O: On  F: Off  R: Reset  ESC: Exit";
-    while (*inst4) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *inst4++);
+    // Two columns of "stage: cpu ms [/ gpu ms]" in the stage's graph color
+    for (int i = 0; i < profileStageCount(); i++) {
+        float color[3];
+        profileStageColor(i, color);
+        if (average.gpuMs[i] >= 0.0f) {
+            sprintf(line, "%s: %.2f / %.2f ms", profileStageName(i), average.cpuMs[i], average.gpuMs[i]);
+        } else {
+            sprintf(line, "%s: %.2f ms", profileStageName(i), average.cpuMs[i]);
+        }
+        textAdd(hudText, TEXT_HELVETICA_10, 330 + (i / 6) * 150, 108 - (i % 6) * 14, line,
+                color[0] * 0.6f, color[1] * 0.6f, color[2] * 0.6f);  // Darkened for the light background
     }
 }
 
-// Main display callback function (called by GLUT)
-void display() {
+// Draw one frame into the current framebuffer (display() adds the buffer swap)
+void renderFrame() {
+    // Build the glyph atlas on the first frame (uses the back buffer, so before clearing)
+    textInit();
+    arenaReset(frameArena);  // Last frame's scratch memory is free again
+    profileBeginFrame();
+    
     // Set background color and clear screen
     glClearColor(0.9f, 0.9f, 0.95f, 1.0f);  // Light blue-gray
-    glClear(GL_COLOR_BUFFER_BIT);  // Clear color buffer
+    if (softBackend) {
+        softBackendClear(GL_COLOR_BUFFER_BIT);
+    } else {
+        glClear(GL_COLOR_BUFFER_BIT);  // Clear color buffer
+    }
     
     // Set up 2D orthographic projection
     glMatrixMode(GL_PROJECTION);
@@ -478,73 +657,222 @@ void display() {
     glLoadIdentity();
     
     // Draw all scene components
-    drawDesk();      // Desk first (background)
-    drawFan();       // Fan on desk
-    drawControls();  // Control panel
-    drawStatus();    // Text information
-    
-    glutSwapBuffers();  // Swap front and back buffers (double buffering)
+    drawBackground();  // Desk, stand, motor and cage (cached)
+    drawFan();         // Blades and air flow on top
+    drawControls();    // Control panel
+    drawStatus();      // Text information
+    profileBegin(kStageShapes);
+    batchFlush(shapeBatch);  // Every shape above, one draw per run of like primitives
+    batchEndFrame(shapeBatch);
+    profileEnd(kStageShapes);
+    if (showProfile) drawProfile();  // Frame-time graph
+    profileBegin(kStageText);
+    textDraw(hudText);  // All queued text in one draw
+    profileEnd(kStageText);
+    if (softBackend) softBackendPresent();  // Rasterize the tiles and copy the frame into the window
+    profileEndFrame();
 }
 
-// Timer callback function for animation (called every 16ms ˜ 60fps)
-void timer(int value) {
-    // Acceleration/deceleration physics simulation
-    if (fanOn) {
-        // Accelerate toward target speed
-        if (rotationSpeed < targetRotationSpeed) {
-            rotationSpeed += acceleration;
-            if (rotationSpeed > targetRotationSpeed) {
-                rotationSpeed = targetRotationSpeed;  // Don't overshoot
-            }
-        } else if (rotationSpeed > targetRotationSpeed) {
-            rotationSpeed -= deceleration;
-            if (rotationSpeed < targetRotationSpeed) {
-                rotationSpeed = targetRotationSpeed;
+// Function to set target speed with level (0-5)
+void setTargetSpeed(int level) {
+    fanSetLevel(fan, level);  // Level 0 means fan is off, 1-5 means on
+}
+
+// Carry out one input command (the simulation's side of mouse() and keyboard())
+void applyCommand(const InputCommand& command) {
+    switch (command.type) {
+        case COMMAND_POWER_ON:
+            fan.on = true;
+            if (fan.speedLevel == 0) setTargetSpeed(3);  // Default to speed 3
+            break;
+        case COMMAND_POWER_OFF:
+            setTargetSpeed(0);
+            break;
+        case COMMAND_POWER_TOGGLE:
+            if (!fan.on) {
+                fan.on = true;
+                if (fan.speedLevel == 0) setTargetSpeed(3);
+            } else {
+                setTargetSpeed(0);
             }
-        }
-    } else {
-        // Decelerate when fan is off
-        if (rotationSpeed > 0) {
-            rotationSpeed -= deceleration * 1.5f;  // Faster deceleration when off
-            if (rotationSpeed < 0) rotationSpeed = 0;  // Stop at zero
-        }
+            break;
+        case COMMAND_SET_LEVEL:
+            setTargetSpeed(command.value);
+            break;
+        case COMMAND_LEVEL_UP:
+            if (fan.speedLevel < 5) setTargetSpeed(fan.speedLevel + 1);
+            break;
+        case COMMAND_LEVEL_DOWN:
+            if (fan.speedLevel > 0) setTargetSpeed(fan.speedLevel - 1);
+            break;
+        case COMMAND_RESET:
+            fan.on = false;
+            setTargetSpeed(0);
+            fan.rotationSpeed = 0.0f;
+            fan.targetRotationSpeed = 0.0f;
+            particlesClear(airParticles);  // Remove all air particles
+            fluidClear(airFluid);          // and still the air
+            break;
+        case COMMAND_BLADES:
+            bladeCount = bladeCount == 3 ? 5 : bladeCount == 5 ? 7 : 3;
+            break;
     }
-    
-    // Update fan rotation angle
-    if (fanOn || rotationSpeed > 0) {
-        rotationAngle += rotationSpeed;
-        if (rotationAngle >= 360.0f) {
-            rotationAngle -= 360.0f;  // Keep angle in 0-360 range
-        }
+}
+
+// Apply the commands queued since the last tick
+void applyCommands() {
+    InputCommand command;
+    while (commandPop(inputCommands, command)) {
+        applyCommand(command);
+        commandApplied(inputLatency, command, monotonicSeconds());
     }
+    inputRecordApplied(physicsTicks); // Log the input that just took effect, if recording
+}
+
+// Advance the fan and air flow by one physics tick
+void stepSimulation() {
+    // Input first, as if it had arrived between the ticks
+    applyCommands();
     
-    // Randomly add air particles when fan is on
-    if (fanOn && airParticles.size() < 25) {
-        if (rand() % 15 == 0) {  // Random chance each frame
-            float angle = (rand() % 360) * 3.1415926f / 180.0f;  // Random direction
-            airParticles.push_back(std::make_pair(
-                450 + cosf(angle) * 75,  // Start at 75px from center
-                350 + sinf(angle) * 75
-            ));
-        }
+    // Keep the last state so frames between ticks can interpolate the blades
+    previousFan = fan;
+    physicsTicks++;  // After the input, so its log entries replay before this tick
+    
+    // Acceleration/deceleration physics and blade rotation
+    fanStep(fan, fanParams, 1.0f / kFanTickHz);
+    
+    // Spawn, move and cull air particles (drawn at their latest positions),
+    // timed for the frame profiler, which ignores this thread's stages
+    double airStart = monotonicSeconds();
+    updateAirFlow();
+    airUpdateMs += (float)(1000.0 * (monotonicSeconds() - airStart));
+}
+
+// Is anything moving (or about to)? If not, the simulation can sleep until input arrives
+bool sceneAnimating() {
+    return fan.on || fan.rotationSpeed > 0.0f || airParticles.count > 0 || commandsPending(inputCommands);
+}
+
+// Size every snapshot for the largest particle pool, so publishing never allocates
+void snapshotsInit() {
+    for (SceneSnapshot& snapshot : snapshots.slots) {
+        snapshot.particleX.resize(kMaxAirParticles);
+        snapshot.particleY.resize(kMaxAirParticles);
+        snapshot.particleAlpha.resize(kMaxAirParticles);
+    }
+    tripleInit(snapshots);
+    view = &tripleFront(snapshots);
+}
+
+// Copy the state after the last tick into a snapshot for the render thread
+// (simulation thread); tickTime is when that tick was due, 0 for no interpolation
+void publishSnapshot(double tickTime) {
+    SceneSnapshot& snapshot = tripleBack(snapshots);
+    snapshot.fan = fan;
+    snapshot.previousFan = previousFan;
+    snapshot.bladeCount = bladeCount;
+    snapshot.particleCount = airParticles.count;
+    size_t particleBytes = sizeof(float) * airParticles.count;
+    memcpy(snapshot.particleX.data(), airParticles.x.data(), particleBytes);
+    memcpy(snapshot.particleY.data(), airParticles.y.data(), particleBytes);
+    memcpy(snapshot.particleAlpha.data(), airParticles.alpha.data(), particleBytes);
+    snapshot.airGridWidth = airFluid.nx;
+    snapshot.airGridHeight = airFluid.ny;
+    snapshot.airResidual = airFluid.residual;
+    snapshot.tick = physicsTicks;
+    snapshot.tickTime = tickTime;
+    snapshot.tickMs = simulation.tickMs;
+    snapshot.settled = !sceneAnimating();
+    snapshot.commandsApplied = commandsPopped(inputCommands);
+    float toShown;  // Measured by the render thread
+    commandMeanLatency(inputLatency, snapshot.inputLatency, toShown);
+    // A snapshot replaced before it was drawn comes back as this one's
+    // successor, still holding its commands and airflow time; they go out
+    // with the next one
+    if (!snapshotDropped) {
+        memset(snapshot.unshown, 0, sizeof(snapshot.unshown));
+        snapshot.airUpdateMs = 0.0f;
+    }
+    snapshot.airUpdateMs += airUpdateMs;
+    airUpdateMs = 0.0f;
+    commandsHandOff(inputLatency, snapshot.unshown);
+    snapshotDropped = triplePublish(snapshots);
+}
+
+// Switch to the newest snapshot, if the simulation has published one since
+// the last frame (render thread); returns the ticks it is ahead of the last one
+int acquireSnapshot() {
+    unsigned long lastTick = view->tick;
+    if (tripleAcquire(snapshots)) {
+        view = &tripleFront(snapshots);
+        commandsArrived(shownLatency, view->unshown);
     }
+    return (int)(view->tick - lastTick);
+}
+
+// Fraction of a tick from the snapshot's last tick to now, for interpolating the blades
+float snapshotAlpha(double now) {
+    if (view->tickTime == 0.0) return 1.0f;
+    float alpha = (float)((now - view->tickTime) * kFanTickHz);
+    return alpha < 0.0f ? 0.0f : alpha > 1.0f ? 1.0f : alpha;
+}
+
+// Stop scheduling frames until input arrives
+void sleepAnimation(double now) {
+    animating = false;
+    glutIdleFunc(NULL);
+    idleMeterSleep(idleMeter, now);
+}
+
+// Main display callback function (called by GLUT)
+void display() {
+    allocFrameBegin(allocMeter);
+    
+    // Draw the latest state the simulation thread has published, the blades
+    // interpolated up to now (the ticks themselves run on that thread)
+    double now = monotonicSeconds();
+    int ticks = acquireSnapshot();
+    renderAlpha = snapshotAlpha(now);
+    if (ticks > 0) profileAddTime(kStageAirUpdate, view->airUpdateMs);  // The ticks ran on the simulation thread
+    if (animating) rateMeterFrame(rates, ticks, now);
+    
+    // Once everything has come to rest with all input applied, draw the final state and pause
+    bool settled = animating && view->settled && view->commandsApplied == commandsPushed(inputCommands);
+    
+    renderFrame();
+    captureFrame(videoCapture, windowWidth, windowHeight);  // Read back for the video, if recording
+    glutSwapBuffers();  // Swap front and back buffers (double buffering)
+    commandsShown(shownLatency, monotonicSeconds());
     
+    if (settled) sleepAnimation(now);
+    allocFrameEnd(allocMeter);
+}
+
+// Timer callback function for animation (paced to renderHz)
+void timer(int value) {
+    if (!animating || value != timerGeneration) return;  // Paused, or a timer from before the pause
     glutPostRedisplay();  // Request screen refresh
-    glutTimerFunc(16, timer, 0);  // Call this function again in 16ms
+    glutTimerFunc(frameDelayMs(nextFrameTime, renderHz, monotonicSeconds()), timer, value);
 }
 
-// Function to set target speed with level (0-5)
-void setTargetSpeed(int level) {
-    if (level >= 0 && level <= 5) {
-        fanSpeedLevel = level;  // Update speed level
-        targetRotationSpeed = fanSpeedLevel * 2.0f;  // Calculate target speed
-        
-        // Update fan state based on speed level
-        if (fanSpeedLevel == 0) {
-            fanOn = false;  // Level 0 means fan is off
-        } else {
-            fanOn = true;  // Any speed level 1-5 means fan is on
-        }
+// Idle callback for uncapped rendering: draw again as soon as possible
+void idle() {
+    glutPostRedisplay();
+}
+
+// Redraw after input, and start scheduling frames (and ticks) again if paused
+void wakeAnimation() {
+    simWake(simulation);  // The simulation skips the pause rather than simulating it
+    if (animating) return;  // The next scheduled frame shows the change
+    animating = true;
+    double now = monotonicSeconds();
+    idleMeterWake(idleMeter, now);
+    rates.windowStart = 0.0;         // Restart the fps window
+    nextFrameTime = now;
+    if (renderHz > 0.0) {
+        glutTimerFunc(0, timer, ++timerGeneration);
+    } else {
+        glutIdleFunc(idle);
     }
 }
 
@@ -557,12 +885,7 @@ void mouse(int button, int state, int x, int y) {
         
         // Check if power button was clicked
         if (x >= 670 && x <= 750 && y >= 420 && y <= 460) {
-            if (!fanOn) {
-                fanOn = true;  // Turn fan on
-                if (fanSpeedLevel == 0) setTargetSpeed(3);  // Default to speed 3
-            } else {
-                setTargetSpeed(0);  // Turn fan off
-            }
+            commandPush(inputCommands, COMMAND_POWER_TOGGLE);
         }
         
         // Check if any speed button was clicked
@@ -571,52 +894,97 @@ void mouse(int button, int state, int x, int y) {
             int buttonY2 = buttonY1 + 20; // Bottom of button
             
             if (x >= 670 && x <= 750 && y >= buttonY1 && y <= buttonY2) {
-                setTargetSpeed(i + 1);  // Set speed to button number
+                commandPush(inputCommands, COMMAND_SET_LEVEL, i + 1);  // Set speed to button number
             }
         }
     }
+    wakeAnimation();
+}
+
+// Start recording the window to kCapturePath, or stop and report
+void toggleCapture() {
+    if (videoCapture.active) {
+        captureStop(videoCapture);
+        printf("Captured %ld frames to %s (%ld dropped)\n", videoCapture.written.load(), kCapturePath,
+               videoCapture.dropped);
+    } else if (!captureStart(videoCapture, kCapturePath, windowWidth, windowHeight,
+                             renderHz > 0.0 ? (int)renderHz : 60)) {
+        printf("Could not write %s\n", kCapturePath);
+    }
+}
+
+// Finish a recording still running at exit
+void stopCapture() {
+    if (videoCapture.active) toggleCapture();
 }
 
 // Keyboard callback function
 void keyboard(unsigned char key, int x, int y) {
     switch (key) {
-        case 'o': case 'O':  // Turn fan on
-            fanOn = true;
-            if (fanSpeedLevel == 0) setTargetSpeed(3);  // Default speed
+        case 'o': case 'O':  // Turn fan on (at speed 3 if it was off)
+            commandPush(inputCommands, COMMAND_POWER_ON);
             break;
             
         case 'f': case 'F':  // Turn fan off
-            setTargetSpeed(0);
+            commandPush(inputCommands, COMMAND_POWER_OFF);
             break;
             
         case '1': case '2': case '3': case '4': case '5':  // Set speed directly
-            setTargetSpeed(key - '0');  // Convert char to int
+            commandPush(inputCommands, COMMAND_SET_LEVEL, key - '0');  // Convert char to int
             break;
             
         case '+':  // Increase speed
-            if (fanSpeedLevel < 5) {
-                setTargetSpeed(fanSpeedLevel + 1);
-            }
+            commandPush(inputCommands, COMMAND_LEVEL_UP);
             break;
             
         case '-':  // Decrease speed
-            if (fanSpeedLevel > 0) {
-                setTargetSpeed(fanSpeedLevel - 1);
-            }
+            commandPush(inputCommands, COMMAND_LEVEL_DOWN);
             break;
             
-        case 'r': case 'R':  // Reset everything
-            fanOn = false;
-            setTargetSpeed(0);
-            rotationSpeed = 0.0f;
-            targetRotationSpeed = 0.0f;
-            airParticles.clear();  // Remove all air particles
+        case 'r': case 'R':  // Reset everything: fan, particles and air
+            commandPush(inputCommands, COMMAND_RESET);
+            break;
+            
+        case 'g': case 'G':  // Toggle the frame-time graph
+            showProfile = !showProfile;
+            break;
+            
+        case 'l': case 'L':  // Background cache: auto, always, never (to compare frame times)
+            backgroundLayer.mode = (LayerMode)((backgroundLayer.mode + 1) % 3);
+            layerInvalidate(backgroundLayer);
+            break;
+            
+        case 'b': case 'B':  // Blade count: 3, 5, 7
+            commandPush(inputCommands, COMMAND_BLADES);
+            break;
+            
+        case 'v': case 'V':  // Start/stop recording video
+            toggleCapture();
             break;
             
         case 27:  // ESC key - exit program
             exit(0);
             break;
     }
+    wakeAnimation();
+}
+
+// Write the profiler's frame history when the program exits
+void writeProfile() {
+    if (profileWriteCsv("profile_2d.csv")) {
+        printf("Frame timings written to profile_2d.csv\n");
+    }
+}
+
+// Report input latency per command type when the program exits
+void printInputLatency() {
+    printf("Input latency by command:\n");
+    commandLatencyPrint(inputLatency, shownLatency, stdout);
+}
+
+// Stop ticking before anything the simulation uses is torn down at exit
+void stopSimulation() {
+    simStop(simulation);
 }
 
 // Window reshape callback (when window is resized)
@@ -624,22 +992,57 @@ void reshape(int width, int height) {
     windowWidth = width;    // Update global width
     windowHeight = height;  // Update global height
     glViewport(0, 0, width, height);  // Set OpenGL viewport to new size
+    layerInvalidate(backgroundLayer);  // Re-capture at the new size
+    if (softBackend) rasterResize(*softBackend, width, height);
 }
 
 // Main function - program entry point
 int main(int argc, char** argv) {
     // Initialize GLUT
     glutInit(&argc, argv);
+    const char* recordPath = inputRecordArgument(argc, argv);  // --record <file>: log every input event
+    bool software = softBackendArgument(argc, argv);           // --software: draw with the CPU rasterizer
+    if (argc > 1) renderHz = atof(argv[1]);  // Render rate, e.g. 30, 60, 240 or 0 (uncapped)
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);  // Double buffering, RGB color
     glutInitWindowSize(windowWidth, windowHeight);  // Set initial window size
     glutCreateWindow("5-Blade Ventilator Fan with Air Flow & Acceleration");  // Create window
     
+    // Load GL entry points and enable GPU stage timing when the driver has timer queries
+    glExtLoad();
+    batchInit(shapeBatch);
+    profileInit(true);
+    atexit(writeProfile);
+    atexit(printInputLatency);
+    atexit(stopCapture);
+    
+    // Preallocate particle storage (no allocation while animating)
+    particlesInit(airParticles, kMaxAirParticles);
+    particleThreads = new ThreadPool((int)std::thread::hardware_concurrency());
+    fluidInit(airFluid, kAirGridWidth, kAirGridHeight, 800.0f / kAirGridWidth);
+    
+    // Software rendering gets threads of its own (the particles' run on the simulation thread)
+    if (software) softBackendStart(windowWidth, windowHeight, new ThreadPool((int)std::thread::hardware_concurrency()));
+    
     // Register callback functions
     glutDisplayFunc(display);   // Called when window needs redrawing
     glutReshapeFunc(reshape);   // Called when window is resized
     glutMouseFunc(mouse);       // Called for mouse events
     glutKeyboardFunc(keyboard); // Called for keyboard events
-    glutTimerFunc(0, timer, 0); // Start animation timer
+    
+    // Optionally log the callbacks' input for replay by render_bench
+    const InputHandlers handlers = {keyboard, mouse, 0, reshape};
+    if (recordPath && !inputRecordStart(recordPath, handlers, inputCommands, windowWidth, windowHeight, kFanTickHz)) {
+        fprintf(stderr, "could not write %s\n", recordPath);
+    }
+    
+    // Physics at kFanTickHz on the simulation thread, starting from a snapshot
+    // of the initial state; drawing paced by a timer, or by idle callbacks
+    // when uncapped, while anything moves (the first frame pauses if nothing does)
+    snapshotsInit();
+    publishSnapshot(0.0);
+    atexit(stopSimulation);  // Runs first: before the log and the capture are closed
+    simStart(simulation, kFanTickHz, 8, stepSimulation, publishSnapshot, sceneAnimating);
+    wakeAnimation();
     
     // Print instructions to console
     printf("=============================================\n");
@@ -660,7 +1063,15 @@ int main(int argc, char** argv) {
     printf("    + - Increase speed\n");
     printf("    - - Decrease speed\n");
     printf("    R - Reset system\n");
+    printf("    G - Toggle frame-time graph\n");
+    printf("    L - Background caching: auto / always / never\n");
+    printf("    B - Blade count: 3 / 5 / 7\n");
+    printf("    V - Start/stop recording video to capture_2d.y4m\n");
     printf("    ESC - Exit program\n");
+    printf("  COMMAND LINE:\n");
+    printf("    [render Hz] - Frames per second to draw (default 60, 0 = uncapped)\n");
+    printf("    --record <file> - Log all input for replay with render_bench\n");
+    printf("    --software - Draw with the built-in CPU rasterizer (no GPU needed)\n");
     
     // Start GLUT main loop (this function never returns)
     glutMainLoop();
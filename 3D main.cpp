@@ -2,17 +2,32 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <thread>
+#include "fan_sim.h"
+#include "gl_ext.h"
+#include "mesh_cache.h"
+#include "hud_text.h"
+#include "profiler.h"
+#include "frame_clock.h"
+#include "fan_farm.h"
+#include "lod.h"
+#include "vertex_batch.h"
+#include "blade_profile.h"
+#include "input_log.h"
+#include "frame_capture.h"
+#include "frame_arena.h"
+#include "alloc_tracker.h"
+#include "thread_pool.h"
+#include "room_thermal.h"
+#include "soft_backend.h"
+#include "command_queue.h"
+#include "triple_buffer.h"
+#include "sim_thread.h"
 
 // Global variables
-float rotationAngle = 0.0f;
-float rotationSpeed = 0.0f;
-float targetRotationSpeed = 0.0f;
-bool fanOn = false;
-int fanSpeedLevel = 0; // 0-5
-bool accelerating = false;
-bool decelerating = false;
-float accelerationRate = 0.5f; // How fast the fan speeds up
-float decelerationRate = 1.0f; // How fast the fan slows down
+FanState fan = {}; // Rotor state (angle, speed, power, speed level 0-5)
+FanParams fanParams = fanParams3D(); // How fast the fan speeds up / slows down
 
 // Camera control
 float cameraAngleX = 25.0f;
@@ -28,44 +43,192 @@ float fanColor[3] = {0.4f, 0.4f, 0.4f}; // Gray
 float standColor[3] = {0.2f, 0.2f, 0.2f}; // Black
 float buttonColor[3] = {0.8f, 0.2f, 0.2f}; // Red for power button
 float speedButtonColor[3] = {0.2f, 0.6f, 0.2f}; // Green for speed buttons
-float bladeColors[5][3] = {
+float bladeColors[kMaxBlades][3] = {
     {0.9f, 0.2f, 0.2f}, // Red
     {0.2f, 0.9f, 0.2f}, // Green
     {0.2f, 0.2f, 0.9f}, // Blue
     {0.9f, 0.9f, 0.2f}, // Yellow
-    {0.9f, 0.2f, 0.9f}  // Magenta
+    {0.9f, 0.2f, 0.9f}, // Magenta
+    {0.9f, 0.5f, 0.1f}, // Orange
+    {0.2f, 0.9f, 0.9f}  // Cyan
 };
+int bladeCount = 5; // Blades on the rotor: 3, 5 or 7 (B cycles)
 float cageColor[3] = {0.5f, 0.5f, 0.5f}; // Gray cage
 
 // Window dimensions
 int windowWidth = 1000;
 int windowHeight = 700;
 
-// Function to draw a cylinder
+// Meshes tessellated during the last frame (should stay 0 after start-up)
+long frameTessellations = 0;
+
+// Level of detail: the frame's camera, and per-frame counts of curved parts
+// drawn at each level and skipped outside the view
+LodView lodView;
+int lodParts[kLodLevels];
+int lodCulled = 0;
+long frameVertices = 0;      // Vertices (indices) the scene submitted last frame
+
+// HUD text from the control panel and status overlay, drawn in one batch
+TextBatch hudText;
+
+// Blades, cage supports and control panel shapes, drawn in a few calls
+VertexBatch shapeBatch;
+
+// Video recording of the window (V starts and stops it)
+FrameCapture videoCapture;
+const char* kCapturePath = "capture_3d.y4m";
+
+// Heap allocations per frame (none expected once warmed up)
+AllocMeter allocMeter = {};
+
+// Fan, camera and scene commands from the input callbacks, applied at the
+// next physics tick, and how long they took to take effect (printed on exit):
+// to the tick on the simulation's side, to the frame on the render thread's
+CommandQueue inputCommands;
+CommandLatency inputLatency = {};
+CommandLatency shownLatency = {};
+
+// Frame profiler stages (graph toggled with G, history written to profile_3d.csv on exit)
+const int kStageDesk = profileStage("desk");
+const int kStageFan = profileStage("fan");
+const int kStageStand = profileStage("stand");
+const int kStageMotor = profileStage("motor");
+const int kStageHub = profileStage("hub");
+const int kStageCage = profileStage("cage");
+const int kStageBlades = profileStage("blades");
+const int kStageControlPanel = profileStage("control_panel");
+const int kStageStatusText = profileStage("status_text");
+const int kStageText = profileStage("text");
+const int kStageShapes = profileStage("shapes");
+const int kStageFarm = profileStage("farm");
+const int kStageRoomAir = profileStage("room_air");
+bool showProfile = false; // Draw the frame-time graph
+
+// Physics runs at a fixed kFanTickHz on the simulation thread; frames are
+// drawn at renderHz (first command-line argument, 0 = uncapped) on the GLUT
+// thread, from the latest snapshot, with the blades interpolated between ticks
+FanState previousFan = {};   // Fan state one physics tick ago
+unsigned long physicsTicks = 0; // Ticks run since the start (input log timestamps; simulation thread)
+SimThread simulation;
+float renderAlpha = 1.0f;    // Fraction of the way from the snapshot's previousFan to its fan
+double renderHz = 60.0;      // Target frames per second, 0 = as fast as possible
+double nextFrameTime = 0.0;  // When the next frame is due (monotonic seconds)
+RateMeter rates = {};        // Measured render fps, physics Hz and CPU use
+
+// Frames are only scheduled while something moves; otherwise the program
+// waits for input with no timer running
+bool animating = false;      // Frames are being scheduled
+int timerGeneration = 0;     // Timers from an earlier animation run stop themselves
+IdleMeter idleMeter = {};    // CPU use while waiting
+
+// Fan farm mode (M): a grid of fans, each with its own rotor, drawn with
+// instancing in place of the desk scene
+FanFarm farm = {};
+int farmSize = 10000;        // Fans in the farm (second command-line argument)
+bool farmMode = false;
+RotorParams farmRotor = rotorParamsSlew(fanParams3D());  // Farm rotor dynamics (D toggles)
+
+// Room air (T): temperature and airflow in the room around the desk, cooled
+// by the fan, simulated kRoomTimeScale times faster than real time while shown
+RoomThermal roomAir;
+ThreadPool* roomThreads = 0;     // Worker threads for the room's stencil and pressure solve
+bool showRoomAir = false;
+const float kRoomVoxel = 0.5f;       // Voxel size, scene units
+const float kRoomTimeScale = 10.0f;  // Simulated seconds per real second
+
+// Everything a frame shows of the simulation, copied out after its ticks.
+// The simulation thread fills one snapshot while the render thread draws
+// another; drawing code reads only view, never the simulation's globals
+// (the farm's layout and the room's grid are fixed once built, and shared).
+struct SceneSnapshot {
+    FanState fan, previousFan;             // Blades are drawn between the two
+    int bladeCount;
+    float cameraAngleX, cameraAngleY, cameraDistance;
+    bool farmMode;
+    RotorBatch farmRotors;                 // Only angle and previousAngle, filled in farm mode
+    RotorModel farmRotorModel;
+    bool showRoomAir;
+    std::vector<float> sliceTemp, sliceV, sliceW;  // The room's slice through the fan, ny * nz, while shown
+    float roomDeskTemp, roomTemp;          // Mean air temperature at the desk and in the room
+    double roomTime;                       // Seconds simulated since the room was reset
+    unsigned long tick;                    // Ticks run
+    double tickTime;                       // When the last tick was due (monotonic); 0 = draw without interpolating
+    float tickMs;                          // Simulation time per tick
+    bool settled;                          // Nothing moving: no new snapshot until new input
+    unsigned commandsApplied;              // Input commands applied so far
+    float inputLatency;                    // Mean time from input to the tick that applied it, seconds
+    double unshown[COMMAND_TYPE_COUNT];    // Commands applied since the last snapshot drawn (commandsHandOff())
+};
+TripleBuffer<SceneSnapshot> snapshots;
+const SceneSnapshot* view = 0;             // The snapshot being drawn (render thread)
+bool snapshotDropped = false;              // The last publish replaced one never drawn (simulation thread)
+
+// Farthest camera zoom; the farm needs room to be seen whole
+float maxCameraDistance() {
+    return farmMode ? 300.0f : 50.0f;
+}
+
+// Level of detail of a curved part placed by the current modelview matrix:
+// its bounding sphere (center and radius) and the radius of its curve.
+// Returns -1 when the part is outside the view and need not be drawn.
+int partLevel(const float center[3], float bound, float radius, int slices) {
+    float toEye[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, toEye);
+    float screenRadius = lodScreenRadius(lodView, toEye, center, bound, radius);
+    if (screenRadius < 0.0f) {
+        lodCulled++;
+        return -1;
+    }
+    int level = lodLevel(screenRadius, slices);
+    lodParts[level]++;
+    return level;
+}
+
+// Function to draw a cylinder (tessellated once per level of detail, then drawn from the mesh cache)
 void drawCylinder(float radius, float height, int slices) {
-    GLUquadricObj *quadric = gluNewQuadric();
-    gluQuadricNormals(quadric, GLU_SMOOTH);
-    gluCylinder(quadric, radius, radius, height, slices, 1);
-    gluDeleteQuadric(quadric);
+    const float center[3] = {0.0f, 0.0f, height * 0.5f};
+    int level = partLevel(center, sqrtf(radius * radius + height * height * 0.25f), radius, slices);
+    if (level < 0) return;
+    meshDraw(meshCylinder(radius, height, lodDetail(slices, level, 3)));
 }
 
 // Function to draw a disk
 void drawDisk(float innerRadius, float outerRadius, int slices, int loops) {
-    GLUquadricObj *quadric = gluNewQuadric();
-    gluQuadricNormals(quadric, GLU_SMOOTH);
-    gluDisk(quadric, innerRadius, outerRadius, slices, loops);
-    gluDeleteQuadric(quadric);
+    meshDraw(meshDisk(innerRadius, outerRadius, slices, loops));
+}
+
+// Function to draw a sphere (replaces glutSolidSphere)
+void drawSphere(float radius, int slices, int stacks) {
+    const float center[3] = {0.0f, 0.0f, 0.0f};
+    int level = partLevel(center, radius, radius, slices);
+    if (level < 0) return;
+    meshDraw(meshSphere(radius, lodDetail(slices, level, 3), lodDetail(stacks, level, 3)));
+}
+
+// Function to draw a torus (replaces glutSolidTorus); the ring's curve sets the level
+void drawTorus(float innerRadius, float outerRadius, int sides, int rings) {
+    const float center[3] = {0.0f, 0.0f, 0.0f};
+    int level = partLevel(center, outerRadius + innerRadius, outerRadius, rings);
+    if (level < 0) return;
+    meshDraw(meshTorus(innerRadius, outerRadius, lodDetail(sides, level, 3), lodDetail(rings, level, 3)));
+}
+
+// Function to draw a cube (replaces glutSolidCube)
+void drawCube(float size) {
+    meshDraw(meshCube(size));
 }
 
 // Function to draw the desk (3D version)
 void drawDesk() {
+    ProfileScope profile(kStageDesk);
     glColor3fv(deskColor);
     
     // Desk top
     glPushMatrix();
     glTranslatef(0.0f, -2.0f, 0.0f);
     glScalef(8.0f, 0.3f, 4.0f);
-    glutSolidCube(1.0);
+    drawCube(1.0f);
     glPopMatrix();
     
     // Desk legs
@@ -80,13 +243,14 @@ void drawDesk() {
         glPushMatrix();
         glTranslatef(legPositions[i][0], legPositions[i][1], legPositions[i][2]);
         glScalef(0.2f, 2.0f, 0.2f);
-        glutSolidCube(1.0);
+        drawCube(1.0f);
         glPopMatrix();
     }
 }
 
 // Function to draw the fan stand (3D version)
 void drawFanStand() {
+    ProfileScope profile(kStageStand);
     glColor3fv(standColor);
     
     // Base on desk
@@ -106,12 +270,13 @@ void drawFanStand() {
     // Top joint
     glPushMatrix();
     glTranslatef(0.0f, 1.4f, 0.0f);
-    glutSolidSphere(0.12f, 16, 16);
+    drawSphere(0.12f, 16, 16);
     glPopMatrix();
 }
 
 // Function to draw the motor housing (3D version)
 void drawFanMotor() {
+    ProfileScope profile(kStageMotor);
     glColor3fv(fanColor);
     
     // Main motor body
@@ -138,68 +303,52 @@ void drawFanMotor() {
 
 // Function to draw the fan hub (3D version)
 void drawFanHub() {
+    ProfileScope profile(kStageHub);
     glColor3f(0.1f, 0.1f, 0.1f); // Black hub
     
     glPushMatrix();
     glTranslatef(1.0f, 1.4f, 0.0f); // Position at end of arm
     
     // Main hub
-    glutSolidSphere(0.1f, 16, 16);
+    drawSphere(0.1f, 16, 16);
     
     // Hub front
     glPushMatrix();
     glTranslatef(0.0f, 0.0f, 0.05f);
-    glutSolidSphere(0.08f, 12, 12);
+    drawSphere(0.08f, 12, 12);
     glPopMatrix();
     
     glPopMatrix();
 }
 
-// Function to draw a single fan blade (3D version)
-void drawBlade(int bladeIndex) {
-    glColor3fv(bladeColors[bladeIndex]);
-    
-    // 3D blade shape with thickness
-    glBegin(GL_QUADS);
-    
-    // Front face
-    glVertex3f(0.0f, 0.0f, 0.01f);
-    glVertex3f(0.0f, 0.0f, 0.01f);
-    glVertex3f(0.8f, 0.15f, 0.01f);
-    glVertex3f(0.8f, -0.15f, 0.01f);
-    
-    // Back face
-    glVertex3f(0.0f, 0.0f, -0.01f);
-    glVertex3f(0.8f, -0.15f, -0.01f);
-    glVertex3f(0.8f, 0.15f, -0.01f);
-    glVertex3f(0.0f, 0.0f, -0.01f);
-    
-    // Side faces
-    glVertex3f(0.0f, 0.0f, 0.01f);
-    glVertex3f(0.0f, 0.0f, -0.01f);
-    glVertex3f(0.8f, 0.15f, -0.01f);
-    glVertex3f(0.8f, 0.15f, 0.01f);
-    
-    glVertex3f(0.0f, 0.0f, 0.01f);
-    glVertex3f(0.8f, -0.15f, 0.01f);
-    glVertex3f(0.8f, -0.15f, -0.01f);
-    glVertex3f(0.0f, 0.0f, -0.01f);
-    
-    glEnd();
+// Function to draw every blade of a Blades-blade rotor (3D version), each
+// blade already rotated into place at compile time (blade_profile.h)
+template <int Blades>
+void drawBladeRotor() {
+    const BladeRotor<Blades>& rotor = bladeRotor3D<Blades>;
+    
+    // 3D blade shapes with thickness: front, back and side faces
+    batchBegin(shapeBatch, GL_QUADS);
+    for (int v = 0; v < rotor.kVertices; v++) {
+        if (v % 16 == 0) batchColor(shapeBatch, bladeColors[v / 16]);
+        if (v % 4 == 0) batchNormal(shapeBatch, rotor.normal[v][0], rotor.normal[v][1], rotor.normal[v][2]);
+        batchVertex(shapeBatch, rotor.position[v][0], rotor.position[v][1], rotor.position[v][2]);
+    }
+    batchEnd(shapeBatch);
 }
 
 // Function to draw all fan blades (3D version)
 void drawFanBlades() {
+    ProfileScope profile(kStageBlades);
     glPushMatrix();
     glTranslatef(1.0f, 1.4f, 0.0f); // Position at end of arm
-    glRotatef(rotationAngle, 0.0f, 0.0f, 1.0f); // Rotate around Z-axis
+    glRotatef(fanInterpolatedAngle(view->previousFan, view->fan, renderAlpha), 0.0f, 0.0f, 1.0f); // Rotate around Z-axis
     
-    // Draw 5 blades evenly spaced
-    for (int i = 0; i < 5; i++) {
-        glPushMatrix();
-        glRotatef(i * 72.0f, 0.0f, 0.0f, 1.0f); // 360/5 = 72 degrees
-        drawBlade(i);
-        glPopMatrix();
+    // Draw the blades evenly spaced (360/count degrees apart)
+    switch (view->bladeCount) {
+        case 3: drawBladeRotor<3>(); break;
+        case 7: drawBladeRotor<7>(); break;
+        default: drawBladeRotor<5>(); break;
     }
     
     glPopMatrix();
@@ -207,6 +356,7 @@ void drawFanBlades() {
 
 // Function to draw the safety cage (3D version)
 void drawSafetyCage() {
+    ProfileScope profile(kStageCage);
     glColor3fv(cageColor);
     
     glPushMatrix();
@@ -217,24 +367,27 @@ void drawSafetyCage() {
     glLineWidth(1.5);
     
     // Front ring
-    glutSolidTorus(0.02f, 0.85f, 8, 32);
+    drawTorus(0.02f, 0.85f, 8, 32);
     
     // Back ring
     glPushMatrix();
     glTranslatef(0.0f, 0.0f, 0.0f);
-    glutSolidTorus(0.02f, 0.85f, 8, 32);
+    drawTorus(0.02f, 0.85f, 8, 32);
     glPopMatrix();
     
     // Vertical supports
+    batchColor(shapeBatch, cageColor);
+    batchNormal(shapeBatch, 0.0f, 0.0f, 1.0f);
+    batchLineWidth(shapeBatch, 1.5f);
     for (int i = 0; i < 8; i++) {
         glPushMatrix();
         glRotatef(i * 45.0f, 0.0f, 0.0f, 1.0f);
-        glBegin(GL_LINES);
-        glVertex3f(0.0f, 0.0f, -0.05f);
-        glVertex3f(0.0f, 0.85f, -0.05f);
-        glVertex3f(0.0f, 0.0f, 0.05f);
-        glVertex3f(0.0f, 0.85f, 0.05f);
-        glEnd();
+        batchBegin(shapeBatch, GL_LINES);
+        batchVertex(shapeBatch, 0.0f, 0.0f, -0.05f);
+        batchVertex(shapeBatch, 0.0f, 0.85f, -0.05f);
+        batchVertex(shapeBatch, 0.0f, 0.0f, 0.05f);
+        batchVertex(shapeBatch, 0.0f, 0.85f, 0.05f);
+        batchEnd(shapeBatch);
         glPopMatrix();
     }
     
@@ -246,6 +399,7 @@ void drawSafetyCage() {
 
 // Function to draw the entire fan assembly
 void drawFan() {
+    ProfileScope profile(kStageFan);
     drawFanStand();
     drawFanMotor();
     drawFanHub();
@@ -253,8 +407,76 @@ void drawFan() {
     drawFanBlades();
 }
 
+// Draw every fan of the farm (interpolated like the single fan's blades)
+void drawFanFarm() {
+    ProfileScope profile(kStageFarm);
+    farm.blades = view->bladeCount;
+    farmDraw(farm, view->farmRotors, renderAlpha, lodView);
+}
+
+// Draw the shapes batched so far (with the current projection and lighting)
+void flushShapes() {
+    ProfileScope profile(kStageShapes);
+    batchFlush(shapeBatch);
+}
+
+// The room's voxel column (x) the fan's slice passes through
+int roomSliceX() {
+    return (int)((roomFan3D(0.0f).center[0] - roomAir.origin[0]) / roomAir.voxelSize);
+}
+
+// Draw the room's air in the vertical slice through the fan: translucent
+// voxels from blue (wall temperature) to red (the starting heat), with a
+// line showing where the air in every other voxel moves in the next 0.5 s
+void drawRoomAir() {
+    ProfileScope profile(kStageRoomAir);
+    flushShapes();  // The fan, lit and opaque
+    glDisable(GL_LIGHTING);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    
+    float h = roomAir.voxelSize;
+    int x = roomSliceX();
+    float sliceX = roomAir.origin[0] + (x + 0.5f) * h;
+    batchBegin(shapeBatch, GL_QUADS);
+    for (int z = 0; z < roomAir.nz; z++) {
+        for (int y = 0; y < roomAir.ny; y++) {
+            if (roomAir.open[roomIndex(roomAir, x, y, z)] == 0.0f) continue;  // The desk
+            float heat = (view->sliceTemp[z * roomAir.ny + y] - kRoomWallTemp) / (kRoomStartTemp - kRoomWallTemp);
+            heat = heat < 0.0f ? 0.0f : heat > 1.0f ? 1.0f : heat;
+            batchColor(shapeBatch, 0.2f + 0.8f * heat, 0.4f - 0.2f * heat, 1.0f - 0.8f * heat, 0.35f);
+            float y0 = roomAir.origin[1] + y * h, z0 = roomAir.origin[2] + z * h;
+            batchVertex(shapeBatch, sliceX, y0, z0);
+            batchVertex(shapeBatch, sliceX, y0 + h, z0);
+            batchVertex(shapeBatch, sliceX, y0 + h, z0 + h);
+            batchVertex(shapeBatch, sliceX, y0, z0 + h);
+        }
+    }
+    batchEnd(shapeBatch);
+    
+    batchColor(shapeBatch, 1.0f, 1.0f, 1.0f, 0.6f);
+    batchBegin(shapeBatch, GL_LINES);
+    for (int z = 0; z < roomAir.nz; z += 2) {
+        for (int y = 0; y < roomAir.ny; y += 2) {
+            int i = z * roomAir.ny + y;
+            float cy = roomAir.origin[1] + (y + 0.5f) * h, cz = roomAir.origin[2] + (z + 0.5f) * h;
+            batchVertex(shapeBatch, sliceX, cy, cz);
+            batchVertex(shapeBatch, sliceX, cy + 0.5f * view->sliceV[i], cz + 0.5f * view->sliceW[i]);
+        }
+    }
+    batchEnd(shapeBatch);
+    flushShapes();
+    
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glEnable(GL_LIGHTING);
+}
+
 // Function to draw the control panel (3D version)
 void drawControlPanel() {
+    ProfileScope profile(kStageControlPanel);
+    flushShapes();  // Blades and cage supports, with the scene's projection and lighting
     glDisable(GL_LIGHTING);
     
     glMatrixMode(GL_PROJECTION);
@@ -266,133 +488,96 @@ void drawControlPanel() {
     glPushMatrix();
     glLoadIdentity();
     
-   
-    
     // Panel border
-    glColor3f(0.3f, 0.3f, 0.4f);
-    glLineWidth(2.0);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(windowWidth - 220, 50);
-    glVertex2f(windowWidth - 30, 50);
-    glVertex2f(windowWidth - 30, 300);
-    glVertex2f(windowWidth - 220, 300);
-    glEnd();
+    batchColor(shapeBatch, 0.3f, 0.3f, 0.4f);
+    batchLineWidth(shapeBatch, 2.0f);
+    batchBegin(shapeBatch, GL_LINE_LOOP);
+    batchVertex(shapeBatch, windowWidth - 220, 50);
+    batchVertex(shapeBatch, windowWidth - 30, 50);
+    batchVertex(shapeBatch, windowWidth - 30, 300);
+    batchVertex(shapeBatch, windowWidth - 220, 300);
+    batchEnd(shapeBatch);
     
     // Title
-    glColor3f(0.9f, 0.9f, 1.0f);
-    glRasterPos2f(windowWidth - 210, 280);
-    const char* title = "FAN CONTROLS";
-    while (*title) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *title++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_18, windowWidth - 210, 280, "FAN CONTROLS", 0.9f, 0.9f, 1.0f);
     
     // Power button
-    glColor3fv(buttonColor);
-    if (fanOn) {
-        glColor3f(0.0f, 0.7f, 0.0f); // Green when on
-    }
-    glBegin(GL_QUADS);
-    glVertex2f(windowWidth - 200, 220);
-    glVertex2f(windowWidth - 100, 220);
-    glVertex2f(windowWidth - 100, 250);
-    glVertex2f(windowWidth - 200, 250);
-    glEnd();
-    
-    // Power button border
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glLineWidth(1.5);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(windowWidth - 200, 220);
-    glVertex2f(windowWidth - 100, 220);
-    glVertex2f(windowWidth - 100, 250);
-    glVertex2f(windowWidth - 200, 250);
-    glEnd();
+    batchColor(shapeBatch, buttonColor);
+    if (view->fan.on) {
+        batchColor(shapeBatch, 0.0f, 0.7f, 0.0f); // Green when on
+    }
+    batchBegin(shapeBatch, GL_QUADS);
+    batchVertex(shapeBatch, windowWidth - 200, 220);
+    batchVertex(shapeBatch, windowWidth - 100, 220);
+    batchVertex(shapeBatch, windowWidth - 100, 250);
+    batchVertex(shapeBatch, windowWidth - 200, 250);
+    batchEnd(shapeBatch);
     
     // Power button label
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2f(windowWidth - 185, 237);
-    const char* powerText = fanOn ? "POWER ON" : "POWER OFF";
-    while (*powerText) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *powerText++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_12, windowWidth - 185, 237, view->fan.on ? "POWER ON" : "POWER OFF", 1.0f, 1.0f, 1.0f);
     
     // Speed label
-    glColor3f(0.9f, 0.9f, 1.0f);
-    glRasterPos2f(windowWidth - 210, 190);
-    const char* speedLabel = "SPEED LEVEL:";
-    while (*speedLabel) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *speedLabel++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_12, windowWidth - 210, 190, "SPEED LEVEL:", 0.9f, 0.9f, 1.0f);
     
     // Speed buttons
     for (int i = 0; i < 5; i++) {
-        if (i < fanSpeedLevel) {
-            glColor3fv(speedButtonColor); // Active speed
+        if (i < view->fan.speedLevel) {
+            batchColor(shapeBatch, speedButtonColor); // Active speed
         } else {
-            glColor3f(speedButtonColor[0] * 0.3, 
-                     speedButtonColor[1] * 0.3, 
-                     speedButtonColor[2] * 0.3); // Inactive
+            batchColor(shapeBatch, speedButtonColor[0] * 0.3, 
+                       speedButtonColor[1] * 0.3, 
+                       speedButtonColor[2] * 0.3); // Inactive
         }
         
         // Button with 3D effect
-        glBegin(GL_QUADS);
-        glVertex2f(windowWidth - 200 + i * 35, 140);
-        glVertex2f(windowWidth - 170 + i * 35, 140);
-        glVertex2f(windowWidth - 170 + i * 35, 170);
-        glVertex2f(windowWidth - 200 + i * 35, 170);
-        glEnd();
-        
-        // Button border
-        glColor3f(1.0f, 1.0f, 1.0f);
-        glLineWidth(1.0);
-        glBegin(GL_LINE_LOOP);
-        glVertex2f(windowWidth - 200 + i * 35, 140);
-        glVertex2f(windowWidth - 170 + i * 35, 140);
-        glVertex2f(windowWidth - 170 + i * 35, 170);
-        glVertex2f(windowWidth - 200 + i * 35, 170);
-        glEnd();
+        batchBegin(shapeBatch, GL_QUADS);
+        batchVertex(shapeBatch, windowWidth - 200 + i * 35, 140);
+        batchVertex(shapeBatch, windowWidth - 170 + i * 35, 140);
+        batchVertex(shapeBatch, windowWidth - 170 + i * 35, 170);
+        batchVertex(shapeBatch, windowWidth - 200 + i * 35, 170);
+        batchEnd(shapeBatch);
         
         // Speed number
-        glColor3f(1.0f, 1.0f, 1.0f);
-        glRasterPos2f(windowWidth - 195 + i * 35, 155);
-        char speedNum = '1' + i;
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, speedNum);
+        char speedNum[2] = {(char)('1' + i), 0};
+        textAdd(hudText, TEXT_HELVETICA_12, windowWidth - 195 + i * 35, 155, speedNum, 1.0f, 1.0f, 1.0f);
+    }
+    
+    // Button borders, after every fill so all the buttons share the batch's runs
+    batchColor(shapeBatch, 1.0f, 1.0f, 1.0f);
+    batchLineWidth(shapeBatch, 1.5f);
+    batchBegin(shapeBatch, GL_LINE_LOOP);
+    batchVertex(shapeBatch, windowWidth - 200, 220);
+    batchVertex(shapeBatch, windowWidth - 100, 220);
+    batchVertex(shapeBatch, windowWidth - 100, 250);
+    batchVertex(shapeBatch, windowWidth - 200, 250);
+    batchEnd(shapeBatch);
+    batchLineWidth(shapeBatch, 1.0f);
+    for (int i = 0; i < 5; i++) {
+        batchBegin(shapeBatch, GL_LINE_LOOP);
+        batchVertex(shapeBatch, windowWidth - 200 + i * 35, 140);
+        batchVertex(shapeBatch, windowWidth - 170 + i * 35, 140);
+        batchVertex(shapeBatch, windowWidth - 170 + i * 35, 170);
+        batchVertex(shapeBatch, windowWidth - 200 + i * 35, 170);
+        batchEnd(shapeBatch);
     }
     
     // Current speed display
-    glColor3f(0.9f, 0.9f, 1.0f);
-    glRasterPos2f(windowWidth - 210, 110);
     char speedText[50];
-    sprintf(speedText, "Current Speed: %d", fanSpeedLevel);
-    const char* speedPtr = speedText;
-    while (*speedPtr) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *speedPtr++);
-    }
+    sprintf(speedText, "Current Speed: %d", view->fan.speedLevel);
+    textAdd(hudText, TEXT_HELVETICA_12, windowWidth - 210, 110, speedText, 0.9f, 0.9f, 1.0f);
     
     // Status indicators
-    glRasterPos2f(windowWidth - 210, 85);
-    if (accelerating) {
-        const char* accelText = "Status: Accelerating...";
-        while (*accelText) {
-            glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *accelText++);
-        }
-    } else if (decelerating) {
-        const char* decelText = "Status: Slowing down...";
-        while (*decelText) {
-            glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *decelText++);
-        }
-    } else if (fanOn && rotationSpeed > 0) {
-        const char* runningText = "Status: Running at steady speed";
-        while (*runningText) {
-            glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *runningText++);
-        }
-    } else {
-        const char* stoppedText = "Status: Stopped";
-        while (*stoppedText) {
-            glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *stoppedText++);
-        }
+    const char* statusText = "Status: Stopped";
+    if (view->fan.accelerating) {
+        statusText = "Status: Accelerating...";
+    } else if (view->fan.decelerating) {
+        statusText = "Status: Slowing down...";
+    } else if (view->fan.on && view->fan.rotationSpeed > 0) {
+        statusText = "Status: Running at steady speed";
     }
+    textAdd(hudText, TEXT_HELVETICA_10, windowWidth - 210, 85, statusText, 0.9f, 0.9f, 1.0f);
     
+    flushShapes();  // The panel, in the overlay projection
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
@@ -401,8 +586,33 @@ void drawControlPanel() {
     glEnable(GL_LIGHTING);
 }
 
+// Function to draw the frame-time graph and a legend of average stage times
+void drawProfile() {
+    profileDrawGraph(30, 30, 300, 100);
+    
+    ProfileFrame average;
+    profileAverage(60, average); // Last second at 60 fps
+    char line[64];
+    sprintf(line, "FRAME: %.2f ms", average.frameMs);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, 136, line, 1.0f, 1.0f, 1.0f);
+    
+    // Two columns of "stage: cpu ms [/ gpu ms]" in the stage's graph color
+    for (int i = 0; i < profileStageCount(); i++) {
+        float color[3];
+        profileStageColor(i, color);
+        if (average.gpuMs[i] >= 0.0f) {
+            sprintf(line, "%s: %.2f / %.2f ms", profileStageName(i), average.cpuMs[i], average.gpuMs[i]);
+        } else {
+            sprintf(line, "%s: %.2f ms", profileStageName(i), average.cpuMs[i]);
+        }
+        textAdd(hudText, TEXT_HELVETICA_10, 340 + (i / 5) * 160, 118 - (i % 5) * 14, line,
+                color[0], color[1], color[2]);
+    }
+}
+
 // Function to draw status text
 void drawStatusText() {
+    ProfileScope profile(kStageStatusText);
     glDisable(GL_LIGHTING);
     
     glMatrixMode(GL_PROJECTION);
@@ -414,52 +624,114 @@ void drawStatusText() {
     glPushMatrix();
     glLoadIdentity();
     
-    glColor3f(1.0f, 1.0f, 1.0f);
-    
     // Title
-    glRasterPos2f(30, windowHeight - 40);
-    const char* title = "3D VENTILATOR FAN SIMULATION";
-    while (*title) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *title++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_18, 30, windowHeight - 40, "3D VENTILATOR FAN SIMULATION", 1.0f, 1.0f, 1.0f);
     
     // Status
-    glRasterPos2f(30, windowHeight - 70);
     char status[100];
     sprintf(status, "FAN: %s | TARGET SPEED: %d | CURRENT SPEED: %.1f", 
-            fanOn ? "ON" : "OFF", 
-            fanSpeedLevel,
-            rotationSpeed);
-    const char* statusPtr = status;
-    while (*statusPtr) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *statusPtr++);
-    }
+            view->fan.on ? "ON" : "OFF", 
+            view->fan.speedLevel,
+            view->fan.rotationSpeed);
+    textAdd(hudText, TEXT_HELVETICA_12, 30, windowHeight - 70, status, 1.0f, 1.0f, 1.0f);
     
     // Instructions
-    glRasterPos2f(30, windowHeight - 100);
-    const char* inst1 = "CONTROLS: Left drag = rotate view | Right drag = zoom";
-    while (*inst1) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *inst1++);
-    }
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 100,
+            "CONTROLS: Left drag = rotate view | Right drag = zoom", 1.0f, 1.0f, 1.0f);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 115,
+            "Click POWER button to toggle ON/OFF | Click SPEED buttons 1-5", 1.0f, 1.0f, 1.0f);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 130,
+            "Keyboard: O=On F=Off 1-5=Speed +/-=Adjust Z/X=Zoom ESC=Exit", 1.0f, 1.0f, 1.0f);
     
-    glRasterPos2f(30, windowHeight - 115);
-    const char* inst2 = "Click POWER button to toggle ON/OFF | Click SPEED buttons 1-5";
-    while (*inst2) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *inst2++);
+    // Features
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 155,
+            "FEATURES: Realistic acceleration/deceleration | 5 colored blades | Safety cage", 1.0f, 1.0f, 1.0f);
+    
+    // Mesh cache counters
+    char meshText[100];
+    sprintf(meshText, "MESH CACHE: %d meshes | %ld draws | tessellated last frame: %ld",
+            meshStats.meshes, meshStats.draws, frameTessellations);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 170, meshText, 1.0f, 1.0f, 1.0f);
+    
+    // Text cache counters
+    char textStats[100];
+    sprintf(textStats, "TEXT: %d lines | rebuilt last frame: %d", hudText.drawnLines, hudText.drawnRebuilt);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 185, textStats, 1.0f, 1.0f, 1.0f);
+    
+    // Measured render rate, physics rate (and time per tick) and CPU use
+    char rateStats[100];
+    sprintf(rateStats, "RENDER: %.0f fps | PHYSICS: %.0f Hz (%.2f ms) | CPU: %.0f%%", rates.fps, rates.tickHz,
+            view->tickMs, rates.cpuPercent);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 200, rateStats, 1.0f, 1.0f, 1.0f);
+    
+    // Level of detail: fan farm size, draw calls and fans per level, or the
+    // single fan's curved parts per level
+    char lodStats[140];
+    if (view->farmMode) {
+        sprintf(lodStats, "FARM: %d fans | %d draw calls (%s) | levels 0/1/2: %d/%d/%d | culled: %d | rotors: %s",
+                farm.count, farm.drawCalls, farm.instanced && !softBackend ? "instanced" : "one per part per fan",
+                farm.visible[0], farm.visible[1], farm.visible[2],
+                farm.count - farm.visible[0] - farm.visible[1] - farm.visible[2],
+                view->farmRotorModel == ROTOR_TORQUE ? "torque" : "slew");
+    } else {
+        sprintf(lodStats, "LOD: parts at levels 0/1/2: %d/%d/%d | culled: %d",
+                lodParts[0], lodParts[1], lodParts[2], lodCulled);
     }
-    
-    glRasterPos2f(30, windowHeight - 130);
-    const char* inst3 = "Keyboard: O=On F=Off 1-5=Speed +/-=Adjust Z/X=Zoom ESC=Exit";
-    while (*inst3) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *inst3++);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 215, lodStats, 1.0f, 1.0f, 1.0f);
+    char vertexStats[60];
+    sprintf(vertexStats, "VERTICES: %ld last frame", frameVertices);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 230, vertexStats, 1.0f, 1.0f, 1.0f);
+    
+    char idleStatus[80];
+    if (idleMeter.seconds > 0.0f) {
+        sprintf(idleStatus, "IDLE: %.1f%% CPU over the last %.0f s pause", idleMeter.cpuPercent, idleMeter.seconds);
+    } else {
+        sprintf(idleStatus, "IDLE: no pause yet");
     }
-    
-    // Features
-    glRasterPos2f(30, windowHeight - 155);
-    const char* features = "FEATURES: Realistic acceleration/deceleration | 5 colored blades | Safety cage";
-    while (*features) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *features++);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 245, idleStatus, 1.0f, 1.0f, 1.0f);
+    char shapeStats[80];
+    sprintf(shapeStats, "SHAPES: %d draw calls, %d vertices", shapeBatch.frameDrawCalls, shapeBatch.frameVertices);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 260, shapeStats, 1.0f, 1.0f, 1.0f);
+    char captureStatus[100];
+    if (videoCapture.active) {
+        sprintf(captureStatus, "CAPTURE: %s, %ld frames written, %ld dropped",
+                kCapturePath, videoCapture.written.load(), videoCapture.dropped);
+    } else {
+        sprintf(captureStatus, "CAPTURE: off (V to record)");
     }
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 275, captureStatus, 1.0f, 1.0f, 1.0f);
+    char allocStatus[80];
+    sprintf(allocStatus, "ALLOC: %ld last frame, max %ld after warm-up", allocMeter.lastFrame, allocMeter.steadyMax);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 290, allocStatus, 1.0f, 1.0f, 1.0f);
+    char roomStatus[140];
+    if (view->showRoomAir) {
+        sprintf(roomStatus, "ROOM AIR: %dx%dx%d voxels at x%.0f speed, desk %.1f C, room %.1f C after %.0f s",
+                roomAir.nx, roomAir.ny, roomAir.nz, kRoomTimeScale, view->roomDeskTemp, view->roomTemp, view->roomTime);
+    } else {
+        sprintf(roomStatus, "ROOM AIR: hidden (T shows it)");
+    }
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 305, roomStatus, 1.0f, 1.0f, 1.0f);
+    char rasterStatus[100];
+    if (softBackend) {
+        sprintf(rasterStatus, "RASTER: software, %d triangles in %d tile bins",
+                softBackend->flushTriangles, softBackend->flushBinEntries);
+    } else {
+        sprintf(rasterStatus, "RASTER: OpenGL (--software for the CPU rasterizer)");
+    }
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 320, rasterStatus, 1.0f, 1.0f, 1.0f);
+    char inputStatus[100];
+    float toApplied, toShown; // Only the shown side is kept on this thread
+    commandMeanLatency(shownLatency, toApplied, toShown);
+    sprintf(inputStatus, "INPUT: applied after %.1f ms, shown after %.1f ms (%ld dropped)",
+            1000.0f * view->inputLatency, 1000.0f * toShown, inputCommands.dropped);
+    textAdd(hudText, TEXT_HELVETICA_10, 30, windowHeight - 335, inputStatus, 1.0f, 1.0f, 1.0f);
+    
+    if (showProfile) drawProfile();
+    
+    // Every string queued by drawControlPanel() and this function, in one draw
+    profileBegin(kStageText);
+    textDraw(hudText);
+    profileEnd(kStageText);
     
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
@@ -469,70 +741,44 @@ void drawStatusText() {
     glEnable(GL_LIGHTING);
 }
 
-// Function to handle acceleration/deceleration
-void updateFanSpeed() {
-    if (fanOn) {
-        // Calculate target speed based on speed level
-        targetRotationSpeed = fanSpeedLevel * 3.0f;
-        
-        if (rotationSpeed < targetRotationSpeed - 0.1f) {
-            // Accelerating
-            accelerating = true;
-            decelerating = false;
-            rotationSpeed += accelerationRate * 0.05f;
-            if (rotationSpeed > targetRotationSpeed) {
-                rotationSpeed = targetRotationSpeed;
-            }
-        } else if (rotationSpeed > targetRotationSpeed + 0.1f) {
-            // Decelerating (when switching to lower speed)
-            accelerating = false;
-            decelerating = true;
-            rotationSpeed -= decelerationRate * 0.05f;
-            if (rotationSpeed < targetRotationSpeed) {
-                rotationSpeed = targetRotationSpeed;
-            }
-        } else {
-            // At target speed
-            accelerating = false;
-            decelerating = false;
-            rotationSpeed = targetRotationSpeed;
-        }
+// Draw one frame into the current framebuffer (display() adds the buffer swap)
+void renderFrame() {
+    // Build the glyph atlas on the first frame (uses the back buffer, so before clearing)
+    textInit();
+    arenaReset(frameArena);  // Last frame's scratch memory is free again
+    profileBeginFrame();
+    
+    glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+    if (softBackend) {
+        softBackendClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     } else {
-        // Fan is off - decelerate to zero
-        targetRotationSpeed = 0.0f;
-        if (rotationSpeed > 0.1f) {
-            decelerating = true;
-            accelerating = false;
-            rotationSpeed -= decelerationRate * 0.1f;
-            if (rotationSpeed < 0) rotationSpeed = 0;
-        } else {
-            decelerating = false;
-            rotationSpeed = 0;
-        }
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
-}
-
-// Display function
-void display() {
-    glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluPerspective(45.0, (double)windowWidth / (double)windowHeight, 0.1, 100.0);
+    double aspect = (double)windowWidth / (double)windowHeight;
+    double zFar = view->farmMode ? 1000.0 : 100.0;
+    gluPerspective(45.0, aspect, 0.1, zFar);
     
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
     
     // Camera positioning
-    float cameraX = cameraDistance * sin(cameraAngleY * 3.14159f / 180.0f) * cos(cameraAngleX * 3.14159f / 180.0f);
-    float cameraY = cameraDistance * sin(cameraAngleX * 3.14159f / 180.0f);
-    float cameraZ = cameraDistance * cos(cameraAngleY * 3.14159f / 180.0f) * cos(cameraAngleX * 3.14159f / 180.0f);
+    float angleX = view->cameraAngleX * 3.14159f / 180.0f, angleY = view->cameraAngleY * 3.14159f / 180.0f;
+    float cameraX = view->cameraDistance * sin(angleY) * cos(angleX);
+    float cameraY = view->cameraDistance * sin(angleX);
+    float cameraZ = view->cameraDistance * cos(angleY) * cos(angleX);
     
     gluLookAt(cameraX, cameraY + 3.0f, cameraZ,
               0.0, 0.0, 0.0,
               0.0, 1.0, 0.0);
     
+    // Camera and projection for level of detail and culling
+    lodSetView(lodView, 45.0, aspect, 0.1, zFar, windowHeight);
+    for (int level = 0; level < kLodLevels; level++) lodParts[level] = 0;
+    lodCulled = 0;
+    
     // Enable lighting
     glEnable(GL_LIGHTING);
     glEnable(GL_LIGHT0);
@@ -550,30 +796,290 @@ void display() {
     glLightfv(GL_LIGHT0, GL_DIFFUSE, lightDiffuse);
     glLightfv(GL_LIGHT0, GL_SPECULAR, lightSpecular);
     
-    // Update fan speed with acceleration/deceleration
-    updateFanSpeed();
-    
-    // Update rotation angle
-    rotationAngle += rotationSpeed;
-    if (rotationAngle >= 360.0f) {
-        rotationAngle -= 360.0f;
-    }
-    
     // Draw 3D scene
-    drawDesk();
-    drawFan();
+    long tessellationsBefore = meshStats.tessellations;
+    long verticesBefore = meshStats.vertices;
+    if (view->farmMode) {
+        drawFanFarm();
+    } else {
+        drawDesk();
+        drawFan();
+        if (view->showRoomAir) drawRoomAir();
+    }
+    frameTessellations = meshStats.tessellations - tessellationsBefore;
+    frameVertices = meshStats.vertices - verticesBefore + (view->farmMode ? farm.vertices : 0);
     
     // Draw 2D overlays
     drawControlPanel();
     drawStatusText();
+    batchEndFrame(shapeBatch);
+    if (softBackend) softBackendPresent(); // Rasterize the tiles and copy the frame into the window
+    profileEndFrame();
+}
+
+// Carry out one input command (the simulation's side of mouse(), mouseMotion() and keyboard())
+void applyCommand(const InputCommand& command) {
+    switch (command.type) {
+        case COMMAND_POWER_ON: // Smooth acceleration, from speed 3 if it was at 0
+            fan.on = true;
+            if (fan.speedLevel == 0) fan.speedLevel = 3;
+            break;
+        case COMMAND_POWER_OFF: // Smooth deceleration
+            fan.on = false;
+            fan.speedLevel = 0;
+            break;
+        case COMMAND_POWER_TOGGLE:
+            fan.on = !fan.on;
+            if (!fan.on) {
+                // Start decelerating when turning off
+                fan.speedLevel = 0;
+            } else if (fan.speedLevel == 0) {
+                // Start accelerating when turning on
+                fan.speedLevel = 3;
+            }
+            break;
+        case COMMAND_SET_LEVEL:
+            if (fan.on) {
+                fan.speedLevel = command.value; // fanStep() ramps toward the new target
+            }
+            break;
+        case COMMAND_LEVEL_UP:
+            if (fan.on && fan.speedLevel < 5) {
+                fan.speedLevel++;
+            }
+            break;
+        case COMMAND_LEVEL_DOWN:
+            if (fan.on && fan.speedLevel > 1) {
+                fan.speedLevel--;
+            }
+            break;
+        case COMMAND_ORBIT:
+            cameraAngleY += command.delta[0];
+            cameraAngleX += command.delta[1];
+            if (cameraAngleX > 89.0f) cameraAngleX = 89.0f;
+            if (cameraAngleX < -89.0f) cameraAngleX = -89.0f;
+            break;
+        case COMMAND_ZOOM:
+            cameraDistance += command.delta[0];
+            if (cameraDistance < 10.0f) cameraDistance = 10.0f;
+            if (cameraDistance > maxCameraDistance()) cameraDistance = maxCameraDistance();
+            break;
+        case COMMAND_FARM:
+            farmMode = !farmMode;
+            if (cameraDistance > maxCameraDistance()) cameraDistance = maxCameraDistance();
+            break;
+        case COMMAND_ROTOR_MODEL: // The single fan's ramps, or torque and drag
+            farmRotor = farmRotor.model == ROTOR_SLEW ? rotorParamsTorque(fanParams.speedPerLevel)
+                                                      : rotorParamsSlew(fanParams);
+            farm.level = -1;  // Every fan picks up the new targets on the next tick
+            break;
+        case COMMAND_BLADES: // The farm's fans too (drawFanFarm())
+            bladeCount = bladeCount == 3 ? 5 : bladeCount == 5 ? 7 : 3;
+            break;
+        case COMMAND_ROOM_AIR: // Starting from a hot room
+            showRoomAir = !showRoomAir;
+            if (showRoomAir) roomReset(roomAir);
+            break;
+    }
+}
+
+// Apply the commands queued since the last tick
+void applyCommands() {
+    InputCommand command;
+    while (commandPop(inputCommands, command)) {
+        applyCommand(command);
+        commandApplied(inputLatency, command, monotonicSeconds());
+    }
+    inputRecordApplied(physicsTicks); // Log the input that just took effect, if recording
+}
+
+// Advance the fan by one physics tick, keeping the previous state for interpolation
+void stepSimulation() {
+    applyCommands(); // Input first, as if it had arrived between the ticks
+    previousFan = fan;
+    physicsTicks++; // After the input, so its log entries replay before this tick
+    fanStep(fan, fanParams, 1.0f / kFanTickHz);
+    
+    // Farm fans follow the control panel's power and speed
+    if (farmMode) farmStep(farm, farmRotor, fan.on ? fan.speedLevel : 0);
+    
+    // The room's air, blown by the desk fan
+    if (showRoomAir && !farmMode) {
+        roomStep(roomAir, roomFan3D(fan.rotationSpeed), kRoomTimeScale / kFanTickHz, roomThreads);
+    }
+}
+
+// Is anything moving (fans, the room's air or queued input)? If not, the
+// simulation can sleep until input arrives (a camera drag pushes commands)
+bool sceneAnimating() {
+    return fan.on || fan.rotationSpeed > 0.0f || commandsPending(inputCommands) ||
+           (farmMode && farmAnimating(farm)) || (showRoomAir && !farmMode);
+}
+
+// Size every snapshot for the farm and the room's slice, so publishing
+// never allocates (after buildFarm() and roomInit())
+void snapshotsInit() {
+    for (SceneSnapshot& snapshot : snapshots.slots) {
+        snapshot.farmRotors.angle.resize(farm.count);
+        snapshot.farmRotors.previousAngle.resize(farm.count);
+        snapshot.farmRotors.count = farm.count;
+        snapshot.sliceTemp.resize(roomAir.ny * roomAir.nz);
+        snapshot.sliceV.resize(roomAir.ny * roomAir.nz);
+        snapshot.sliceW.resize(roomAir.ny * roomAir.nz);
+    }
+    tripleInit(snapshots);
+    view = &tripleFront(snapshots);
+}
+
+// Copy the state after the last tick into a snapshot for the render thread
+// (simulation thread); tickTime is when that tick was due, 0 for no interpolation
+void publishSnapshot(double tickTime) {
+    SceneSnapshot& snapshot = tripleBack(snapshots);
+    snapshot.fan = fan;
+    snapshot.previousFan = previousFan;
+    snapshot.bladeCount = bladeCount;
+    snapshot.cameraAngleX = cameraAngleX;
+    snapshot.cameraAngleY = cameraAngleY;
+    snapshot.cameraDistance = cameraDistance;
+    snapshot.farmMode = farmMode;
+    snapshot.farmRotorModel = farmRotor.model;
+    if (farmMode) {
+        size_t rotorBytes = sizeof(float) * farm.count;
+        memcpy(snapshot.farmRotors.angle.data(), farm.rotors.angle.data(), rotorBytes);
+        memcpy(snapshot.farmRotors.previousAngle.data(), farm.rotors.previousAngle.data(), rotorBytes);
+    }
+    snapshot.showRoomAir = showRoomAir;
+    if (showRoomAir) {
+        int x = roomSliceX();
+        for (int z = 0; z < roomAir.nz; z++) {
+            for (int y = 0; y < roomAir.ny; y++) {
+                int i = roomIndex(roomAir, x, y, z);
+                snapshot.sliceTemp[z * roomAir.ny + y] = roomAir.temp[i];
+                snapshot.sliceV[z * roomAir.ny + y] = roomAir.v[i];
+                snapshot.sliceW[z * roomAir.ny + y] = roomAir.w[i];
+            }
+        }
+        snapshot.roomDeskTemp = roomMeanTemp(roomAir, roomDeskZone());
+        snapshot.roomTemp = roomMeanTemp(roomAir);
+        snapshot.roomTime = roomAir.time;
+    }
+    snapshot.tick = physicsTicks;
+    snapshot.tickTime = tickTime;
+    snapshot.tickMs = simulation.tickMs;
+    snapshot.settled = !sceneAnimating();
+    snapshot.commandsApplied = commandsPopped(inputCommands);
+    float toShown; // Measured by the render thread
+    commandMeanLatency(inputLatency, snapshot.inputLatency, toShown);
+    // A snapshot replaced before it was drawn comes back as this one's
+    // successor, still holding its commands; they go out with the next one
+    if (!snapshotDropped) memset(snapshot.unshown, 0, sizeof(snapshot.unshown));
+    commandsHandOff(inputLatency, snapshot.unshown);
+    snapshotDropped = triplePublish(snapshots);
+}
+
+// Switch to the newest snapshot, if the simulation has published one since
+// the last frame (render thread); returns the ticks it is ahead of the last one
+int acquireSnapshot() {
+    unsigned long lastTick = view->tick;
+    if (tripleAcquire(snapshots)) {
+        view = &tripleFront(snapshots);
+        commandsArrived(shownLatency, view->unshown);
+    }
+    return (int)(view->tick - lastTick);
+}
+
+// Fraction of a tick from the snapshot's last tick to now, for interpolating the blades
+float snapshotAlpha(double now) {
+    if (view->tickTime == 0.0) return 1.0f;
+    float alpha = (float)((now - view->tickTime) * kFanTickHz);
+    return alpha < 0.0f ? 0.0f : alpha > 1.0f ? 1.0f : alpha;
+}
+
+// Stop scheduling frames until input arrives
+void sleepAnimation(double now) {
+    animating = false;
+    glutIdleFunc(NULL);
+    idleMeterSleep(idleMeter, now);
+}
+
+// Display function
+void display() {
+    allocFrameBegin(allocMeter);
+    
+    // Draw the latest state the simulation thread has published, the blades
+    // interpolated up to now (the ticks themselves run on that thread)
+    double now = monotonicSeconds();
+    int ticks = acquireSnapshot();
+    renderAlpha = snapshotAlpha(now);
+    if (animating) rateMeterFrame(rates, ticks, now);
     
+    // Once everything has come to rest with all input applied, draw the final state and pause
+    bool settled = animating && view->settled && view->commandsApplied == commandsPushed(inputCommands);
+    
+    renderFrame();
+    captureFrame(videoCapture, windowWidth, windowHeight); // Read back for the video, if recording
     glutSwapBuffers();
+    commandsShown(shownLatency, monotonicSeconds());
+    
+    if (settled) sleepAnimation(now);
+    allocFrameEnd(allocMeter);
 }
 
-// Timer function for smooth animation
+// Lay out the fan farm in the single fan's colors (its models are baked on first use)
+void buildFarm() {
+    FanColors colors;
+    memcpy(colors.stand, standColor, sizeof(colors.stand));
+    memcpy(colors.motor, fanColor, sizeof(colors.motor));
+    const float hubColor[3] = {0.1f, 0.1f, 0.1f};
+    memcpy(colors.hub, hubColor, sizeof(colors.hub));
+    memcpy(colors.cage, cageColor, sizeof(colors.cage));
+    memcpy(colors.blades, bladeColors, sizeof(colors.blades));
+    farmInit(farm, farmSize, 3.0f, colors);
+    farm.blades = bladeCount;
+}
+
+// Tessellate every primitive the fan uses up front, at every level of detail, so frames only draw
+void buildMeshes() {
+    for (int level = 0; level < kLodLevels; level++) {
+        meshCylinder(0.4f, 0.2f, lodDetail(20, level, 3));      // Stand base
+        meshCylinder(0.08f, 3.0f, lodDetail(16, level, 3));     // Pole
+        meshCylinder(0.15f, 0.3f, lodDetail(20, level, 3));     // Motor body
+        meshCylinder(0.12f, 0.1f, lodDetail(16, level, 3));     // Motor face
+        meshCylinder(0.05f, 1.0f, lodDetail(12, level, 3));     // Arm
+        meshSphere(0.12f, lodDetail(16, level, 3), lodDetail(16, level, 3));  // Top joint
+        meshSphere(0.1f, lodDetail(16, level, 3), lodDetail(16, level, 3));   // Hub
+        meshSphere(0.08f, lodDetail(12, level, 3), lodDetail(12, level, 3));  // Hub front
+        meshTorus(0.02f, 0.85f, lodDetail(8, level, 3), lodDetail(32, level, 3));  // Cage rings
+    }
+    meshCube(1.0f);                   // Desk top and legs (scaled)
+}
+
+// Timer function, paced to renderHz
 void timer(int value) {
+    if (!animating || value != timerGeneration) return;  // Paused, or a timer from before the pause
+    glutPostRedisplay();
+    glutTimerFunc(frameDelayMs(nextFrameTime, renderHz, monotonicSeconds()), timer, value);
+}
+
+// Idle function for uncapped rendering
+void idle() {
     glutPostRedisplay();
-    glutTimerFunc(16, timer, 0); // ~60 FPS
+}
+
+// Redraw after input, and start scheduling frames (and ticks) again if paused
+void wakeAnimation() {
+    simWake(simulation); // The simulation skips the pause rather than simulating it
+    if (animating) return; // The next scheduled frame shows the change
+    animating = true;
+    double now = monotonicSeconds();
+    idleMeterWake(idleMeter, now);
+    rates.windowStart = 0.0;       // Restart the fps window
+    nextFrameTime = now;
+    if (renderHz > 0.0) {
+        glutTimerFunc(0, timer, ++timerGeneration);
+    } else {
+        glutIdleFunc(idle);
+    }
 }
 
 // Mouse button handler
@@ -590,19 +1096,8 @@ void mouse(int button, int state, int x, int y) {
             // Power button
             if (x >= windowWidth - 200 && x <= windowWidth - 100 &&
                 glY >= 220 && glY <= 250) {
-                fanOn = !fanOn;
-                if (!fanOn) {
-                    // Start decelerating when turning off
-                    decelerating = true;
-                    accelerating = false;
-                    fanSpeedLevel = 0;
-                } else if (fanSpeedLevel == 0) {
-                    // Start accelerating when turning on
-                    fanSpeedLevel = 3;
-                    accelerating = true;
-                    decelerating = false;
-                }
-                glutPostRedisplay();
+                commandPush(inputCommands, COMMAND_POWER_TOGGLE);
+                wakeAnimation();
                 return;
             }
             
@@ -613,17 +1108,8 @@ void mouse(int button, int state, int x, int y) {
                 
                 if (x >= buttonX1 && x <= buttonX2 &&
                     glY >= 140 && glY <= 170) {
-                    if (fanOn) {
-                        fanSpeedLevel = i + 1;
-                        if (rotationSpeed < fanSpeedLevel * 3.0f) {
-                            accelerating = true;
-                            decelerating = false;
-                        } else if (rotationSpeed > fanSpeedLevel * 3.0f) {
-                            accelerating = false;
-                            decelerating = true;
-                        }
-                    }
-                    glutPostRedisplay();
+                    commandPush(inputCommands, COMMAND_SET_LEVEL, i + 1); // Only while the fan is on
+                    wakeAnimation();
                     return;
                 }
             }
@@ -645,85 +1131,106 @@ void mouse(int button, int state, int x, int y) {
 // Mouse motion handler
 void mouseMotion(int x, int y) {
     if (mouseLeftDown) {
-        cameraAngleY += (x - lastMouseX) * 0.5f;
-        cameraAngleX += (y - lastMouseY) * 0.5f;
-        
-        if (cameraAngleX > 89.0f) cameraAngleX = 89.0f;
-        if (cameraAngleX < -89.0f) cameraAngleX = -89.0f;
+        commandPush(inputCommands, COMMAND_ORBIT, 0, (x - lastMouseX) * 0.5f, (y - lastMouseY) * 0.5f);
         
         lastMouseX = x;
         lastMouseY = y;
         
-        glutPostRedisplay();
+        wakeAnimation();
     }
     else if (mouseRightDown) {
         float zoomChange = (y - lastMouseY) * 0.1f;
-        cameraDistance += zoomChange;
-        
-        if (cameraDistance < 10.0f) cameraDistance = 10.0f;
-        if (cameraDistance > 50.0f) cameraDistance = 50.0f;
+        commandPush(inputCommands, COMMAND_ZOOM, 0, zoomChange);
         
         lastMouseX = x;
         lastMouseY = y;
         
-        glutPostRedisplay();
+        wakeAnimation();
     }
 }
 
+// Start recording the window to kCapturePath, or stop and report
+void toggleCapture() {
+    if (videoCapture.active) {
+        captureStop(videoCapture);
+        printf("Captured %ld frames to %s (%ld dropped)\n", videoCapture.written.load(), kCapturePath,
+               videoCapture.dropped);
+    } else if (!captureStart(videoCapture, kCapturePath, windowWidth, windowHeight,
+                             renderHz > 0.0 ? (int)renderHz : 60)) {
+        printf("Could not write %s\n", kCapturePath);
+    }
+}
+
+// Finish a recording still running at exit
+void stopCapture() {
+    if (videoCapture.active) toggleCapture();
+}
+
 // Keyboard handler
 void keyboard(unsigned char key, int x, int y) {
     switch (key) {
         case 'o': case 'O': // Turn on with smooth acceleration
-            fanOn = true;
-            if (fanSpeedLevel == 0) fanSpeedLevel = 3;
-            accelerating = true;
-            decelerating = false;
+            commandPush(inputCommands, COMMAND_POWER_ON);
             break;
         case 'f': case 'F': // Turn off with smooth deceleration
-            fanOn = false;
-            fanSpeedLevel = 0;
-            accelerating = false;
-            decelerating = true;
+            commandPush(inputCommands, COMMAND_POWER_OFF);
             break;
         case '1': case '2': case '3': case '4': case '5':
-            if (fanOn) {
-                fanSpeedLevel = key - '0';
-                if (rotationSpeed < fanSpeedLevel * 3.0f) {
-                    accelerating = true;
-                    decelerating = false;
-                } else if (rotationSpeed > fanSpeedLevel * 3.0f) {
-                    accelerating = false;
-                    decelerating = true;
-                }
-            }
+            commandPush(inputCommands, COMMAND_SET_LEVEL, key - '0');
             break;
         case '+': // Increase speed
-            if (fanOn && fanSpeedLevel < 5) {
-                fanSpeedLevel++;
-                accelerating = true;
-                decelerating = false;
-            }
+            commandPush(inputCommands, COMMAND_LEVEL_UP);
             break;
         case '-': // Decrease speed
-            if (fanOn && fanSpeedLevel > 1) {
-                fanSpeedLevel--;
-                accelerating = false;
-                decelerating = true;
-            }
+            commandPush(inputCommands, COMMAND_LEVEL_DOWN);
             break;
         case 'z': case 'Z': // Zoom in
-            cameraDistance -= 2.0f;
-            if (cameraDistance < 10.0f) cameraDistance = 10.0f;
+            commandPush(inputCommands, COMMAND_ZOOM, 0, -2.0f);
             break;
         case 'x': case 'X': // Zoom out
-            cameraDistance += 2.0f;
-            if (cameraDistance > 50.0f) cameraDistance = 50.0f;
+            commandPush(inputCommands, COMMAND_ZOOM, 0, 2.0f);
+            break;
+        case 'm': case 'M': // Toggle the fan farm
+            commandPush(inputCommands, COMMAND_FARM);
+            break;
+        case 'g': case 'G': // Toggle the frame-time graph
+            showProfile = !showProfile;
+            break;
+        case 'd': case 'D': // Farm rotor dynamics: the single fan's ramps, or torque and drag
+            commandPush(inputCommands, COMMAND_ROTOR_MODEL);
+            break;
+        case 'b': case 'B': // Blade count: 3, 5, 7 (the farm's fans too)
+            commandPush(inputCommands, COMMAND_BLADES);
+            break;
+        case 't': case 'T': // Show the room's air, starting from a hot room
+            commandPush(inputCommands, COMMAND_ROOM_AIR);
+            break;
+        case 'v': case 'V': // Start/stop recording video
+            toggleCapture();
             break;
         case 27: // ESC key
             exit(0);
             break;
     }
-    glutPostRedisplay();
+    wakeAnimation();
+}
+
+// Write the profiler's frame history on exit
+void writeProfile() {
+    if (profileWriteCsv("profile_3d.csv")) {
+        printf("Frame timings written to profile_3d.csv\n");
+    }
+}
+
+// Report input latency per command type on exit
+void printInputLatency() {
+    printf("Input latency by command:\n");
+    commandLatencyPrint(inputLatency, shownLatency, stdout);
+}
+
+// Stop ticking before anything the simulation uses is torn down at exit
+void stopSimulation() {
+    simStop(simulation);
 }
 
 // Reshape function
@@ -731,11 +1238,20 @@ void reshape(int width, int height) {
     windowWidth = width;
     windowHeight = height;
     glViewport(0, 0, width, height);
+    if (softBackend) rasterResize(*softBackend, width, height);
 }
 
 // Main function
 int main(int argc, char** argv) {
     glutInit(&argc, argv);
+    const char* recordPath = inputRecordArgument(argc, argv); // --record <file>: log every input event
+    bool software = softBackendArgument(argc, argv);          // --software: draw with the CPU rasterizer
+    if (argc > 1) renderHz = atof(argv[1]); // Render rate: 30, 60, 240, ... or 0 for uncapped
+    if (argc > 2) farmSize = atoi(argv[2]);  // Fans in the farm
+    if (farmSize < 0) {
+        fprintf(stderr, "usage: %s [render Hz] [farm fans >= 0] [--record <file>] [--software]\n", argv[0]);
+        return 1;
+    }
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(windowWidth, windowHeight);
     glutCreateWindow("3D Ventilator Fan with Realistic Acceleration");
@@ -749,13 +1265,46 @@ int main(int argc, char** argv) {
     // Set clear color
     glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
     
+    // Load buffer object entry points and tessellate the fan's meshes once
+    glExtLoad();
+    batchInit(shapeBatch);
+    buildMeshes();
+    buildFarm();
+    
+    // Room air simulation, on every core
+    roomThreads = new ThreadPool((int)std::thread::hardware_concurrency());
+    roomInit(roomAir, kRoomVoxel);
+    
+    // Software rendering gets threads of its own (the room's run on the simulation thread)
+    if (software) softBackendStart(windowWidth, windowHeight, new ThreadPool((int)std::thread::hardware_concurrency()));
+    
+    // Time each drawing stage (on the GPU too when timer queries are available)
+    profileInit(true);
+    atexit(writeProfile);
+    atexit(printInputLatency);
+    atexit(stopCapture);
+    
     // Register callbacks
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
     glutMouseFunc(mouse);
     glutMotionFunc(mouseMotion);
     glutKeyboardFunc(keyboard);
-    glutTimerFunc(0, timer, 0);
+    
+    // Optionally log the callbacks' input for replay by render_bench
+    const InputHandlers handlers = {keyboard, mouse, mouseMotion, reshape};
+    if (recordPath && !inputRecordStart(recordPath, handlers, inputCommands, windowWidth, windowHeight, kFanTickHz)) {
+        fprintf(stderr, "could not write %s\n", recordPath);
+    }
+    
+    // Fixed-rate physics on the simulation thread, starting from a snapshot
+    // of the initial state; frames paced by a timer, or by idle callbacks
+    // when uncapped, while anything moves (the first frame pauses if nothing does)
+    snapshotsInit();
+    publishSnapshot(0.0);
+    atexit(stopSimulation); // Runs first: before the log and the capture are closed
+    simStart(simulation, kFanTickHz, 8, stepSimulation, publishSnapshot, sceneAnimating);
+    wakeAnimation();
     
     // Print instructions
     printf("==================================================\n");
@@ -767,7 +1316,7 @@ int main(int argc, char** argv) {
     printf("  • Full 3D environment with lighting\n");
     printf("  • Rotatable and zoomable camera view\n");
     printf("  • Realistic 3D desk and fan stand\n");
-    printf("  • 5 colored 3D blades with proper spacing\n");
+    printf("  • 3, 5 or 7 colored 3D blades with proper spacing\n");
     printf("  • 3D safety cage around blades\n");
     printf("\nCONTROLS:\n");
     printf("  MOUSE:\n");
@@ -780,7 +1329,18 @@ int main(int argc, char** argv) {
     printf("    • 1-5 = Set speed level\n");
     printf("    • +/- = Adjust speed gradually\n");
     printf("    • Z/X = Zoom in/out\n");
+    printf("    • G = Toggle frame-time graph\n");
+    printf("    • M = Toggle fan farm (many instanced fans)\n");
+    printf("    • D = Farm rotor dynamics: fixed ramps / torque and drag\n");
+    printf("    • B = Blade count: 3 / 5 / 7\n");
+    printf("    • T = Show the room's air temperature and airflow (cooling at 10x speed)\n");
+    printf("    • V = Start/stop recording video to capture_3d.y4m\n");
     printf("    • ESC = Exit program\n");
+    printf("  COMMAND LINE:\n");
+    printf("    • [render Hz] = Frames per second to draw (default 60, 0 = uncapped)\n");
+    printf("    • [farm fans] = Fans in the fan farm (default 10000)\n");
+    printf("    • --record <file> = Log all input for replay with render_bench\n");
+    printf("    • --software = Draw with the built-in CPU rasterizer (no GPU needed)\n");
     printf("==================================================\n");
     printf("NOTE: Fan starts slowly and accelerates to speed 3 when turned on!\n");
     printf("      Fan slows down gradually when turned off!\n");
@@ -0,0 +1,406 @@
+#include "air_fluid.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const float kJacobiWeight = 0.8f;  // Damps the high frequencies of a 2D 5-point laplacian best
+const int kSmoothSweeps = 2;       // Before and after each coarse-grid correction
+const int kCoarsestSweeps = 64;    // The coarsest level is tiny; sweep it until it is solved
+
+// func(firstRow, endRow) for every band of kFluidBand rows
+template <typename Func>
+static void forRows(ThreadPool* threads, int rows, const Func& func) {
+    int bands = (rows + kFluidBand - 1) / kFluidBand;
+    auto band = [&](int b) {
+        int first = b * kFluidBand;
+        func(first, first + kFluidBand < rows ? first + kFluidBand : rows);
+    };
+    if (threads && bands > 1) threads->parallelFor(bands, band);
+    else for (int b = 0; b < bands; b++) band(b);
+}
+
+static inline int cellIndex(int stride, int x, int y) {
+    return (y + 1) * stride + x + 1;
+}
+
+void fluidInit(AirFluid& fluid, int nx, int ny, float cellSize) {
+    fluid.nx = nx;
+    fluid.ny = ny;
+    fluid.stride = nx + 2;
+    fluid.cellSize = cellSize;
+    fluid.damping = 0.98f;
+    size_t size = (size_t)(nx + 2) * (ny + 2);
+    fluid.u.assign(size, 0.0f);
+    fluid.v.assign(size, 0.0f);
+    fluid.nextU.assign(size, 0.0f);
+    fluid.nextV.assign(size, 0.0f);
+    fluid.residual = 0.0f;
+
+    fluid.levels.clear();
+    float h2 = 1.0f;
+    for (;;) {
+        FluidLevel level;
+        level.nx = nx;
+        level.ny = ny;
+        level.stride = nx + 2;
+        level.h2 = h2;
+        size = (size_t)(nx + 2) * (ny + 2);
+        level.p.assign(size, 0.0f);
+        level.rhs.assign(size, 0.0f);
+        level.next.assign(size, 0.0f);
+        level.residual.assign(size, 0.0f);
+        fluid.levels.push_back(level);
+        if (nx % 2 || ny % 2 || nx / 2 < 4 || ny / 2 < 4) break;
+        nx /= 2;
+        ny /= 2;
+        h2 *= 4.0f;
+    }
+}
+
+void fluidClear(AirFluid& fluid) {
+    std::fill(fluid.u.begin(), fluid.u.end(), 0.0f);
+    std::fill(fluid.v.begin(), fluid.v.end(), 0.0f);
+    for (FluidLevel& level : fluid.levels) std::fill(level.p.begin(), level.p.end(), 0.0f);
+    fluid.residual = 0.0f;
+}
+
+// Ghost cells with the sign-flipped value of their neighbour (zero on the
+// face between them), for the stencils that read across the edge directly
+static void mirrorGhosts(std::vector<float>& values, int nx, int ny, int stride) {
+    float* a = values.data();
+    for (int x = 0; x < nx; x++) {
+        a[cellIndex(stride, x, -1)] = -a[cellIndex(stride, x, 0)];
+        a[cellIndex(stride, x, ny)] = -a[cellIndex(stride, x, ny - 1)];
+    }
+    for (int y = -1; y <= ny; y++) {
+        a[cellIndex(stride, -1, y)] = -a[cellIndex(stride, 0, y)];
+        a[cellIndex(stride, nx, y)] = -a[cellIndex(stride, nx - 1, y)];
+    }
+}
+
+static void clearGhosts(std::vector<float>& values, int nx, int ny, int stride) {
+    float* a = values.data();
+    for (int x = -1; x <= nx; x++) a[cellIndex(stride, x, -1)] = a[cellIndex(stride, x, ny)] = 0.0f;
+    for (int y = 0; y < ny; y++) a[cellIndex(stride, -1, y)] = a[cellIndex(stride, nx, y)] = 0.0f;
+}
+
+// Ghost cells equal to their neighbour (velocity leaves the grid unchanged)
+static void extendGhosts(std::vector<float>& values, int nx, int ny, int stride) {
+    float* a = values.data();
+    for (int x = 0; x < nx; x++) {
+        a[cellIndex(stride, x, -1)] = a[cellIndex(stride, x, 0)];
+        a[cellIndex(stride, x, ny)] = a[cellIndex(stride, x, ny - 1)];
+    }
+    for (int y = -1; y <= ny; y++) {
+        a[cellIndex(stride, -1, y)] = a[cellIndex(stride, 0, y)];
+        a[cellIndex(stride, nx, y)] = a[cellIndex(stride, nx - 1, y)];
+    }
+}
+
+// Row kernels of the pressure solve, for cells [begin, end) of one row.
+// Pressure is zero on the grid's outer faces: a ghost cell holds 0, and the
+// missing neighbour's -p is folded into the diagonal, which is 4 plus the
+// number of grid edges the cell touches. Rows are handed over as the cells,
+// the rows below and above, and the right-hand side, all starting at x = 0.
+
+// Weighted Jacobi: next = p + w * ((neighbours - h2 * rhs) / diagonal - p)
+static void jacobiSpanScalar(const float* __restrict p, const float* __restrict below,
+                             const float* __restrict above, const float* __restrict rhs,
+                             float* __restrict next, int begin, int end, float h2, float diagonal) {
+    const float inv = 1.0f / diagonal;
+    for (int x = begin; x < end; x++) {
+        float jacobi = (p[x - 1] + p[x + 1] + below[x] + above[x] - h2 * rhs[x]) * inv;
+        next[x] = p[x] + kJacobiWeight * (jacobi - p[x]);
+    }
+}
+
+// residual = rhs - (neighbours - diagonal * p) / h2
+static void residualSpanScalar(const float* __restrict p, const float* __restrict below,
+                               const float* __restrict above, const float* __restrict rhs,
+                               float* __restrict residual, int begin, int end, float h2, float diagonal) {
+    const float invH2 = 1.0f / h2;
+    for (int x = begin; x < end; x++) {
+        residual[x] = rhs[x] - (p[x - 1] + p[x + 1] + below[x] + above[x] - diagonal * p[x]) * invH2;
+    }
+}
+
+typedef void (*SpanFunc)(const float*, const float*, const float*, const float*, float*, int, int, float, float);
+
+// SSE2 is part of every x86-64 CPU. The sweeps are limited by memory
+// bandwidth, so wider vectors don't pay off: on the test machine AVX2 was
+// no faster than SSE.
+#ifdef __SSE2__
+
+static void jacobiSpanSSE(const float* p, const float* below, const float* above, const float* rhs,
+                          float* next, int begin, int end, float h2, float diagonal) {
+    const __m128 inv = _mm_set1_ps(1.0f / diagonal);
+    const __m128 scale = _mm_set1_ps(h2);
+    const __m128 weight = _mm_set1_ps(kJacobiWeight);
+    int x = begin;
+    for (; x + 4 <= end; x += 4) {
+        __m128 center = _mm_loadu_ps(p + x);
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(p + x - 1), _mm_loadu_ps(p + x + 1)),
+                                _mm_add_ps(_mm_loadu_ps(below + x), _mm_loadu_ps(above + x)));
+        __m128 jacobi = _mm_mul_ps(_mm_sub_ps(sum, _mm_mul_ps(scale, _mm_loadu_ps(rhs + x))), inv);
+        _mm_storeu_ps(next + x, _mm_add_ps(center, _mm_mul_ps(weight, _mm_sub_ps(jacobi, center))));
+    }
+    jacobiSpanScalar(p, below, above, rhs, next, x, end, h2, diagonal);
+}
+
+static void residualSpanSSE(const float* p, const float* below, const float* above, const float* rhs,
+                            float* residual, int begin, int end, float h2, float diagonal) {
+    const __m128 invH2 = _mm_set1_ps(1.0f / h2);
+    const __m128 diag = _mm_set1_ps(diagonal);
+    int x = begin;
+    for (; x + 4 <= end; x += 4) {
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(p + x - 1), _mm_loadu_ps(p + x + 1)),
+                                _mm_add_ps(_mm_loadu_ps(below + x), _mm_loadu_ps(above + x)));
+        __m128 laplacian = _mm_mul_ps(_mm_sub_ps(sum, _mm_mul_ps(diag, _mm_loadu_ps(p + x))), invH2);
+        _mm_storeu_ps(residual + x, _mm_sub_ps(_mm_loadu_ps(rhs + x), laplacian));
+    }
+    residualSpanScalar(p, below, above, rhs, residual, x, end, h2, diagonal);
+}
+
+static const SpanFunc jacobiSpan = jacobiSpanSSE;
+static const SpanFunc residualSpan = residualSpanSSE;
+
+#else
+
+static const SpanFunc jacobiSpan = jacobiSpanScalar;
+static const SpanFunc residualSpan = residualSpanScalar;
+
+#endif
+
+// Run a row kernel over rows [first, end) of a level, writing to out: the
+// first and last cells of a row touch one more edge than the rest
+static void applySpans(SpanFunc span, FluidLevel& level, std::vector<float>& out, int first, int end) {
+    const int stride = level.stride, nx = level.nx;
+    for (int y = first; y < end; y++) {
+        int row = cellIndex(stride, 0, y);
+        const float* p = level.p.data() + row;
+        const float* rhs = level.rhs.data() + row;
+        float* o = out.data() + row;
+        float diagonal = 4.0f + (y == 0) + (y == level.ny - 1);
+        span(p, p - stride, p + stride, rhs, o, 0, 1, level.h2, diagonal + 1.0f);
+        span(p, p - stride, p + stride, rhs, o, 1, nx - 1, level.h2, diagonal);
+        span(p, p - stride, p + stride, rhs, o, nx - 1, nx, level.h2, diagonal + 1.0f);
+    }
+}
+
+// Weighted Jacobi sweeps of laplacian(p) = rhs. Each sweep reads p and
+// writes next, so bands can run in any order; the ghost cells stay 0.
+static void smooth(FluidLevel& level, int sweeps, ThreadPool* threads) {
+    for (int s = 0; s < sweeps; s++) {
+        forRows(threads, level.ny, [&](int first, int end) { applySpans(jacobiSpan, level, level.next, first, end); });
+        level.p.swap(level.next);
+    }
+}
+
+// residual = rhs - laplacian(p)
+static void computeResidual(FluidLevel& level, ThreadPool* threads) {
+    forRows(threads, level.ny, [&](int first, int end) { applySpans(residualSpan, level, level.residual, first, end); });
+}
+
+// Coarse right-hand side: the fine residual averaged over 2x2 cells
+static void restrictResidual(const FluidLevel& fine, FluidLevel& coarse, ThreadPool* threads) {
+    forRows(threads, coarse.ny, [&](int first, int end) {
+        for (int y = first; y < end; y++) {
+            const float* r0 = fine.residual.data() + cellIndex(fine.stride, 0, 2 * y);
+            const float* r1 = r0 + fine.stride;
+            float* rhs = coarse.rhs.data() + cellIndex(coarse.stride, 0, y);
+            float* p = coarse.p.data() + cellIndex(coarse.stride, 0, y);
+            for (int x = 0; x < coarse.nx; x++) {
+                rhs[x] = 0.25f * (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1]);
+                p[x] = 0.0f;  // The correction starts from zero
+            }
+        }
+    });
+}
+
+// Add the coarse correction to the fine pressure, interpolated bilinearly
+// (each fine cell takes 9/16 of its coarse cell and 3/16, 3/16, 1/16 of
+// the three nearest neighbours)
+static void prolongCorrection(FluidLevel& coarse, FluidLevel& fine, ThreadPool* threads) {
+    mirrorGhosts(coarse.p, coarse.nx, coarse.ny, coarse.stride);
+    const int cs = coarse.stride;
+    forRows(threads, fine.ny, [&](int first, int end) {
+        for (int y = first; y < end; y++) {
+            const float* e = coarse.p.data() + cellIndex(cs, 0, y / 2);
+            const float* eNear = e + ((y & 1) ? cs : -cs);  // Coarse row on this fine row's side
+            float* p = fine.p.data() + cellIndex(fine.stride, 0, y);
+            for (int x = 0; x < fine.nx; x++) {
+                int cx = x / 2, side = (x & 1) ? 1 : -1;
+                p[x] += 0.5625f * e[cx] + 0.1875f * (e[cx + side] + eNear[cx]) + 0.0625f * eNear[cx + side];
+            }
+        }
+    });
+    clearGhosts(coarse.p, coarse.nx, coarse.ny, coarse.stride);
+}
+
+static void vCycle(AirFluid& fluid, int l, ThreadPool* threads) {
+    FluidLevel& level = fluid.levels[l];
+    if (l + 1 == (int)fluid.levels.size()) {
+        smooth(level, kCoarsestSweeps, threads);
+        return;
+    }
+    FluidLevel& coarse = fluid.levels[l + 1];
+    smooth(level, kSmoothSweeps, threads);
+    computeResidual(level, threads);
+    restrictResidual(level, coarse, threads);
+    vCycle(fluid, l + 1, threads);
+    prolongCorrection(coarse, level, threads);
+    smooth(level, kSmoothSweeps, threads);
+}
+
+// Swirl from the turning blades: tangential acceleration growing toward the rim
+static void addFanSwirl(AirFluid& fluid, const FluidFan& fan) {
+    float cx = fan.cx / fluid.cellSize, cy = fan.cy / fluid.cellSize;
+    float radius = fan.radius / fluid.cellSize;
+    float swirl = fan.swirl / fluid.cellSize;
+    int x0 = std::max(0, (int)(cx - radius)), x1 = std::min(fluid.nx - 1, (int)(cx + radius));
+    int y0 = std::max(0, (int)(cy - radius)), y1 = std::min(fluid.ny - 1, (int)(cy + radius));
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            float dx = x + 0.5f - cx, dy = y + 0.5f - cy;
+            float r = sqrtf(dx * dx + dy * dy);
+            if (r >= radius || r == 0.0f) continue;
+            float a = swirl / radius;  // (swirl * r / radius) along the unit tangent (-dy, dx) / r
+            int i = cellIndex(fluid.stride, x, y);
+            fluid.u[i] -= dy * a;
+            fluid.v[i] += dx * a;
+        }
+    }
+}
+
+// Move the velocity along itself: every cell takes the (damped) velocity
+// found one tick upstream
+static void advectVelocity(AirFluid& fluid, ThreadPool* threads) {
+    const int stride = fluid.stride;
+    const float maxX = (float)(fluid.nx - 1), maxY = (float)(fluid.ny - 1);
+    const float damping = fluid.damping;
+    forRows(threads, fluid.ny, [&](int first, int end) {
+        const float* u = fluid.u.data();
+        const float* v = fluid.v.data();
+        for (int y = first; y < end; y++) {
+            for (int x = 0; x < fluid.nx; x++) {
+                int i = cellIndex(stride, x, y);
+                float px = std::min(std::max(x - u[i], 0.0f), maxX);
+                float py = std::min(std::max(y - v[i], 0.0f), maxY);
+                int x0 = std::min((int)px, fluid.nx - 2), y0 = std::min((int)py, fluid.ny - 2);
+                float fx = px - x0, fy = py - y0;
+                int j = cellIndex(stride, x0, y0);
+                float u0 = u[j] + (u[j + 1] - u[j]) * fx;
+                float u1 = u[j + stride] + (u[j + stride + 1] - u[j + stride]) * fx;
+                float v0 = v[j] + (v[j + 1] - v[j]) * fx;
+                float v1 = v[j + stride] + (v[j + stride + 1] - v[j + stride]) * fx;
+                fluid.nextU[i] = damping * (u0 + (u1 - u0) * fy);
+                fluid.nextV[i] = damping * (v0 + (v1 - v0) * fy);
+            }
+        }
+    });
+    fluid.u.swap(fluid.nextU);
+    fluid.v.swap(fluid.nextV);
+}
+
+// Right-hand side of the pressure solve: the velocity's divergence, minus the
+// air the fan draws in through its disc (which the flow should carry away)
+static void computeDivergence(AirFluid& fluid, const FluidFan& fan, ThreadPool* threads) {
+    FluidLevel& level = fluid.levels[0];
+    extendGhosts(fluid.u, fluid.nx, fluid.ny, fluid.stride);
+    extendGhosts(fluid.v, fluid.nx, fluid.ny, fluid.stride);
+    const int stride = fluid.stride;
+    forRows(threads, fluid.ny, [&](int first, int end) {
+        for (int y = first; y < end; y++) {
+            int row = cellIndex(stride, 0, y);
+            const float* __restrict u = fluid.u.data() + row;
+            const float* __restrict vBelow = fluid.v.data() + row - stride;
+            const float* __restrict vAbove = fluid.v.data() + row + stride;
+            float* __restrict rhs = level.rhs.data() + row;
+            for (int x = 0; x < fluid.nx; x++) rhs[x] = 0.5f * (u[x + 1] - u[x - 1] + vAbove[x] - vBelow[x]);
+        }
+    });
+
+    float cx = fan.cx / fluid.cellSize, cy = fan.cy / fluid.cellSize;
+    float radius = fan.radius / fluid.cellSize;
+    int x0 = std::max(0, (int)(cx - radius)), x1 = std::min(fluid.nx - 1, (int)(cx + radius));
+    int y0 = std::max(0, (int)(cy - radius)), y1 = std::min(fluid.ny - 1, (int)(cy + radius));
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            float dx = x + 0.5f - cx, dy = y + 0.5f - cy;
+            if (dx * dx + dy * dy < radius * radius) level.rhs[cellIndex(stride, x, y)] -= fan.source;
+        }
+    }
+}
+
+// Subtract the pressure gradient, leaving the velocity divergence-free
+// (apart from the fan's source)
+static void project(AirFluid& fluid, ThreadPool* threads) {
+    FluidLevel& level = fluid.levels[0];
+    mirrorGhosts(level.p, level.nx, level.ny, level.stride);
+    const int stride = fluid.stride;
+    forRows(threads, fluid.ny, [&](int first, int end) {
+        for (int y = first; y < end; y++) {
+            int row = cellIndex(stride, 0, y);
+            const float* __restrict p = level.p.data() + row;
+            const float* __restrict below = p - stride;
+            const float* __restrict above = p + stride;
+            float* __restrict u = fluid.u.data() + row;
+            float* __restrict v = fluid.v.data() + row;
+            for (int x = 0; x < fluid.nx; x++) {
+                u[x] -= 0.5f * (p[x + 1] - p[x - 1]);
+                v[x] -= 0.5f * (above[x] - below[x]);
+            }
+        }
+    });
+    clearGhosts(level.p, level.nx, level.ny, level.stride);
+}
+
+// Size of the residual left by the solve, relative to the divergence
+static float relativeResidual(AirFluid& fluid, ThreadPool* threads) {
+    FluidLevel& level = fluid.levels[0];
+    computeResidual(level, threads);
+    double residual = 0.0, rhs = 0.0;
+    for (int y = 0; y < level.ny; y++) {
+        const float* r = level.residual.data() + cellIndex(level.stride, 0, y);
+        const float* b = level.rhs.data() + cellIndex(level.stride, 0, y);
+        for (int x = 0; x < level.nx; x++) {
+            residual += r[x] * r[x];
+            rhs += b[x] * b[x];
+        }
+    }
+    return rhs > 0.0 ? (float)sqrt(residual / rhs) : 0.0f;
+}
+
+void fluidStep(AirFluid& fluid, const FluidFan& fan, ThreadPool* threads) {
+    addFanSwirl(fluid, fan);
+    advectVelocity(fluid, threads);
+    computeDivergence(fluid, fan, threads);
+    for (int cycle = 0; cycle < kFluidVCycles; cycle++) vCycle(fluid, 0, threads);
+    fluid.residual = relativeResidual(fluid, threads);
+    project(fluid, threads);
+}
+
+void fluidSample(const AirFluid& fluid, const float* x, const float* y,
+                 float* vx, float* vy, int count) {
+    const float scale = 1.0f / fluid.cellSize;
+    const float maxX = (float)(fluid.nx - 1), maxY = (float)(fluid.ny - 1);
+    const float* u = fluid.u.data();
+    const float* v = fluid.v.data();
+    for (int i = 0; i < count; i++) {
+        // Cell centers sit half a cell in from their corner
+        float px = std::min(std::max(x[i] * scale - 0.5f, 0.0f), maxX);
+        float py = std::min(std::max(y[i] * scale - 0.5f, 0.0f), maxY);
+        int x0 = std::min((int)px, fluid.nx - 2), y0 = std::min((int)py, fluid.ny - 2);
+        float fx = px - x0, fy = py - y0;
+        int j = cellIndex(fluid.stride, x0, y0);
+        int s = fluid.stride;
+        float u0 = u[j] + (u[j + 1] - u[j]) * fx, u1 = u[j + s] + (u[j + s + 1] - u[j + s]) * fx;
+        float v0 = v[j] + (v[j + 1] - v[j]) * fx, v1 = v[j + s] + (v[j + s + 1] - v[j + s]) * fx;
+        vx[i] = (u0 + (u1 - u0) * fy) * fluid.cellSize;
+        vy[i] = (v0 + (v1 - v0) * fy) * fluid.cellSize;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef AIR_FLUID_H
+#define AIR_FLUID_H
+
+#include <vector>
+
+class ThreadPool;
+
+// Incompressible 2D airflow on a grid of square cells ("stable fluids"):
+// each tick adds the fan's forces, moves the velocity field along itself
+// semi-Lagrangian style (stable at any speed), then removes its divergence by
+// solving for pressure with multigrid V-cycles of weighted Jacobi sweeps.
+// The grid's edges are open (zero pressure), so air blown out of the fan
+// leaves the window. Rows are processed in fixed bands of kFluidBand, in
+// parallel when given a thread pool; the results do not depend on the
+// thread count. No OpenGL in here.
+
+const int kFluidBand = 16;       // Rows per parallel work item
+const int kFluidVCycles = 2;     // V-cycles per tick, warm-started from the last tick's pressure
+
+// One level of the multigrid hierarchy. Arrays hold (nx + 2) * (ny + 2)
+// values: the cells plus a ring of ghost cells, which stay 0.
+struct FluidLevel {
+    int nx, ny, stride;
+    float h2;                       // Cell size squared, in fine cells
+    std::vector<float> p;           // Pressure (or its correction on coarse levels)
+    std::vector<float> rhs;         // Right-hand side of laplacian(p) = rhs
+    std::vector<float> next;        // Jacobi sweep target, swapped with p
+    std::vector<float> residual;
+};
+
+// Forces of the fan's blade disc, in window pixels
+struct FluidFan {
+    float cx, cy;       // Disc center
+    float radius;
+    float source;       // Air drawn in through the disc, per tick (divergence inside the disc)
+    float swirl;        // Tangential acceleration at the rim, pixels per tick per tick
+};
+
+struct AirFluid {
+    int nx, ny;                       // Cells
+    int stride;                       // nx + 2 (ghost cells on both sides)
+    float cellSize;                   // Pixels per cell
+    float damping;                    // Velocity kept per tick
+    std::vector<float> u, v;          // Velocity, cells per tick, at cell centers (padded like the levels)
+    std::vector<float> nextU, nextV;  // Advection target, swapped with u, v
+    std::vector<FluidLevel> levels;   // [0] is the grid itself; rhs there is the divergence
+    float residual;                   // RMS residual / RMS divergence after the last solve
+};
+
+// Grid of nx * ny cells of cellSize pixels, covering (0,0)-(nx,ny)*cellSize.
+// Levels halve the grid while both sides stay even and at least 4 cells.
+void fluidInit(AirFluid& fluid, int nx, int ny, float cellSize);
+
+// Still air
+void fluidClear(AirFluid& fluid);
+
+// Advance one tick. threads may be null to run on the caller.
+void fluidStep(AirFluid& fluid, const FluidFan& fan, ThreadPool* threads);
+
+// Velocity in pixels per tick at count points given in pixels (bilinear)
+void fluidSample(const AirFluid& fluid, const float* x, const float* y,
+                 float* vx, float* vy, int count);
+
+#endif
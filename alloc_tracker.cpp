@@ -0,0 +1,65 @@
+#include "alloc_tracker.h"
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long> allocations(0);
+static thread_local long threadAllocations = 0;  // Plain, constant-initialized: safe inside operator new
+
+// Every other form of operator new (arrays, nothrow) calls one of these
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    threadAllocations++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    threadAllocations++;
+    size_t alignment = (size_t)align;
+    size = (size + alignment - 1) / alignment * alignment;  // aligned_alloc wants a multiple
+    if (void* p = aligned_alloc(alignment, size ? size : alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    free(p);
+}
+
+long allocTotal() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+long allocThreadTotal() {
+    return threadAllocations;
+}
+
+void allocFrameBegin(AllocMeter& meter) {
+    if (meter.warmupFrames == 0) meter.warmupFrames = kAllocWarmupFrames;
+    meter.frameStart = allocThreadTotal();
+}
+
+void allocFrameEnd(AllocMeter& meter) {
+    meter.lastFrame = allocThreadTotal() - meter.frameStart;
+    meter.frames++;
+    if (meter.frames <= meter.warmupFrames) return;
+    meter.steadyTotal += meter.lastFrame;
+    if (meter.lastFrame > meter.steadyMax) meter.steadyMax = meter.lastFrame;
+#ifdef FAN_ALLOC_CHECK
+    assert(meter.lastFrame == 0 && "heap allocation in a steady-state frame");
+#endif
+}
@@ -0,0 +1,37 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+// Heap allocation accounting. Linking alloc_tracker.cpp replaces the global
+// operator new/delete with versions that count every C++ heap allocation
+// (one relaxed atomic increment each, from any thread, plus a count per
+// thread). An AllocMeter turns the calling thread's count into allocations
+// per frame, so the simulation thread's allocations don't land in the
+// render thread's frames (nor a thread pool's workers'): once warm-up is
+// over (atlases, caches and pools grown to their working size) a
+// steady-state frame should allocate nothing. Built with -DFAN_ALLOC_CHECK, a frame after warm-up
+// that allocates fails an assert; otherwise the counts are only reported.
+// malloc() calls (the GL driver's, for instance) are not counted.
+
+// C++ heap allocations made so far, by every thread
+long allocTotal();
+
+// C++ heap allocations made so far by the calling thread
+long allocThreadTotal();
+
+struct AllocMeter {
+    int warmupFrames;    // Frames not checked (default kAllocWarmupFrames)
+    int frames;          // Frames measured so far
+    long frameStart;     // allocThreadTotal() at allocFrameBegin()
+    long lastFrame;      // Allocations during the last frame
+    long steadyTotal;    // Allocations in all frames after warm-up
+    long steadyMax;      // Most allocations in one frame after warm-up
+};
+
+const int kAllocWarmupFrames = 120;
+
+// Bracket one frame on the thread that runs it (its simulation ticks too,
+// when they run on that thread); both calls must be made on that thread
+void allocFrameBegin(AllocMeter& meter);
+void allocFrameEnd(AllocMeter& meter);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef BLADE_PROFILE_H
+#define BLADE_PROFILE_H
+
+#include "trig_tables.h"
+
+// Fan blade geometry generated by the compiler for a given blade count:
+// the 2D program's curved blades and the 3D program's flat blades, every
+// blade already rotated into place around the hub. Drawing a rotor is then
+// a copy of static arrays under one rotation for the spin, with no cosf/sinf
+// or per-blade transforms at run time. The programs ship 3-, 5- and 7-blade
+// rotors and switch between them with B.
+
+const int kBladeVariants[] = {3, 5, 7};
+const int kBladeVariantCount = 3;
+const int kMaxBlades = 7;
+
+// Index of a blade count in kBladeVariants (the 5-blade rotor if not found)
+constexpr int bladeVariantIndex(int blades) {
+    for (int i = 0; i < kBladeVariantCount; i++) {
+        if (kBladeVariants[i] == blades) return i;
+    }
+    return 1;
+}
+
+// Shape of one 2D blade (pixels and radians)
+struct BladeShape {
+    double hubRadius;      // Where the curved edge leaves the hub
+    double tipRadius;      // Outer end of the curved edge and of the outline
+    double curve;          // Sweep of the curved edge from hub to tip
+    double baseHalfAngle;  // Half the blade's width at the hub
+};
+
+// The 2D program's blade: 10px hub to 60px tip, curving 0.2 rad, 30 degrees wide at the hub
+constexpr BladeShape kBladeShape2D = {10.0, 60.0, 0.2, 15.0 * kTrigPi / 180.0};
+
+// Blades spaced evenly around the hub, blade 0 along +x. Each blade is a
+// triangle fan (hub center, Steps + 1 points along the curved edge, then
+// the leading base point) and a three-point outline (trailing base, tip,
+// leading base).
+template <int Blades, int Steps>
+struct BladeProfile {
+    static constexpr int kFanVertices = Steps + 3;
+    float fan[Blades][kFanVertices][2];
+    float outline[Blades][3][2];
+
+    constexpr BladeProfile(const BladeShape& shape) : fan(), outline() {
+        for (int b = 0; b < Blades; b++) {
+            double angle = 2.0 * kTrigPi * b / Blades;
+            fan[b][0][0] = 0.0f;
+            fan[b][0][1] = 0.0f;
+            for (int i = 0; i <= Steps; i++) {
+                double t = (double)i / Steps;
+                double a = angle + t * shape.curve;
+                double r = shape.hubRadius + t * (shape.tipRadius - shape.hubRadius);
+                fan[b][i + 1][0] = (float)(constexprCos(a) * r);
+                fan[b][i + 1][1] = (float)(constexprSin(a) * r);
+            }
+            double lead = angle + shape.baseHalfAngle, trail = angle - shape.baseHalfAngle;
+            fan[b][Steps + 2][0] = (float)(constexprCos(lead) * shape.hubRadius);
+            fan[b][Steps + 2][1] = (float)(constexprSin(lead) * shape.hubRadius);
+            outline[b][0][0] = (float)(constexprCos(trail) * shape.hubRadius);
+            outline[b][0][1] = (float)(constexprSin(trail) * shape.hubRadius);
+            outline[b][1][0] = (float)(constexprCos(angle) * shape.tipRadius);
+            outline[b][1][1] = (float)(constexprSin(angle) * shape.tipRadius);
+            outline[b][2][0] = fan[b][Steps + 2][0];
+            outline[b][2][1] = fan[b][Steps + 2][1];
+        }
+    }
+};
+
+template <int Blades>
+constexpr BladeProfile<Blades, 10> bladeProfile2D = BladeProfile<Blades, 10>(kBladeShape2D);
+
+// The 3D blade: a thin wedge from the hub to 0.8 along +x, as four quads
+// (front, back and the two long sides) with one normal per quad
+constexpr float kBlade3DCorners[4][4][3] = {
+    {{0.0f, 0.0f, 0.01f}, {0.0f, 0.0f, 0.01f}, {0.8f, 0.15f, 0.01f}, {0.8f, -0.15f, 0.01f}},
+    {{0.0f, 0.0f, -0.01f}, {0.8f, -0.15f, -0.01f}, {0.8f, 0.15f, -0.01f}, {0.0f, 0.0f, -0.01f}},
+    {{0.0f, 0.0f, 0.01f}, {0.0f, 0.0f, -0.01f}, {0.8f, 0.15f, -0.01f}, {0.8f, 0.15f, 0.01f}},
+    {{0.0f, 0.0f, 0.01f}, {0.8f, -0.15f, 0.01f}, {0.8f, -0.15f, -0.01f}, {0.0f, 0.0f, -0.01f}}
+};
+constexpr float kBlade3DNormals[4][3] = {
+    {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}, {-0.184f, 0.983f, 0.0f}, {-0.184f, -0.983f, 0.0f}
+};
+
+// Every 3D blade of a rotor rotated about z into place: 16 vertices (four
+// quads) per blade, each with its face normal
+template <int Blades>
+struct BladeRotor {
+    static constexpr int kVertices = Blades * 16;
+    float position[kVertices][3];
+    float normal[kVertices][3];
+
+    constexpr BladeRotor() : position(), normal() {
+        for (int b = 0; b < Blades; b++) {
+            double angle = 2.0 * kTrigPi * b / Blades;
+            double c = constexprCos(angle), s = constexprSin(angle);
+            for (int face = 0; face < 4; face++) {
+                for (int k = 0; k < 4; k++) {
+                    int v = b * 16 + face * 4 + k;
+                    const float* p = kBlade3DCorners[face][k];
+                    const float* n = kBlade3DNormals[face];
+                    position[v][0] = (float)(c * p[0] - s * p[1]);
+                    position[v][1] = (float)(s * p[0] + c * p[1]);
+                    position[v][2] = p[2];
+                    normal[v][0] = (float)(c * n[0] - s * n[1]);
+                    normal[v][1] = (float)(s * n[0] + c * n[1]);
+                    normal[v][2] = n[2];
+                }
+            }
+        }
+    }
+};
+
+template <int Blades>
+constexpr BladeRotor<Blades> bladeRotor3D = BladeRotor<Blades>();
+
+// Sanity checks evaluated by the compiler
+static_assert(bladeProfile2D<5>.fan[0][11][0] > 58.0f && bladeProfile2D<5>.fan[0][11][1] > 11.0f,
+              "blade 0's curved edge must end at the 60px tip, 0.2 rad ahead");
+static_assert(bladeRotor3D<3>.position[16 + 2][1] > 0.0f, "blade 1 of 3 must point up-left");
+
+#endif
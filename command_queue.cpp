@@ -0,0 +1,107 @@
+#include "command_queue.h"
+#include "frame_clock.h"
+
+static const char* commandNames[COMMAND_TYPE_COUNT] = {
+    "power_on", "power_off", "power_toggle", "set_level", "level_up", "level_down", "reset",
+    "blades", "orbit", "zoom", "farm", "rotor_model", "room_air"
+};
+
+bool commandPush(CommandQueue& queue, int type, int value, float deltaX, float deltaY) {
+    unsigned tail = queue.tail.load(std::memory_order_relaxed);
+    if (tail - queue.head.load(std::memory_order_acquire) == (unsigned)kCommandQueueSize) {
+        queue.dropped++;
+        return false;
+    }
+    InputCommand& command = queue.slots[tail & (kCommandQueueSize - 1)];
+    command.type = type;
+    command.value = value;
+    command.delta[0] = deltaX;
+    command.delta[1] = deltaY;
+    command.pushed = monotonicSeconds();
+    queue.tail.store(tail + 1, std::memory_order_release);  // Publishes the slot
+    return true;
+}
+
+bool commandPop(CommandQueue& queue, InputCommand& command) {
+    unsigned head = queue.head.load(std::memory_order_relaxed);
+    if (head == queue.tail.load(std::memory_order_acquire)) return false;
+    command = queue.slots[head & (kCommandQueueSize - 1)];
+    queue.head.store(head + 1, std::memory_order_release);  // The producer may reuse the slot
+    return true;
+}
+
+bool commandsPending(const CommandQueue& queue) {
+    return queue.head.load(std::memory_order_relaxed) != queue.tail.load(std::memory_order_acquire);
+}
+
+unsigned commandsPushed(const CommandQueue& queue) {
+    return queue.tail.load(std::memory_order_relaxed);
+}
+
+unsigned commandsPopped(const CommandQueue& queue) {
+    return queue.head.load(std::memory_order_relaxed);
+}
+
+void commandApplied(CommandLatency& latency, const InputCommand& command, double now) {
+    int type = command.type;
+    double seconds = now - command.pushed;
+    latency.applied[type]++;
+    latency.appliedTotal[type] += seconds;
+    if (seconds > latency.appliedMax[type]) latency.appliedMax[type] = seconds;
+    if (latency.unshown[type] == 0.0) latency.unshown[type] = command.pushed;
+    latency.lastApplied = (float)seconds;
+}
+
+// Keep the older of two push times, 0 meaning none
+static void mergeUnshown(double& into, double pushed) {
+    if (pushed != 0.0 && (into == 0.0 || pushed < into)) into = pushed;
+}
+
+void commandsHandOff(CommandLatency& latency, double unshown[COMMAND_TYPE_COUNT]) {
+    for (int type = 0; type < COMMAND_TYPE_COUNT; type++) {
+        mergeUnshown(unshown[type], latency.unshown[type]);
+        latency.unshown[type] = 0.0;
+    }
+}
+
+void commandsArrived(CommandLatency& latency, const double unshown[COMMAND_TYPE_COUNT]) {
+    for (int type = 0; type < COMMAND_TYPE_COUNT; type++) mergeUnshown(latency.unshown[type], unshown[type]);
+}
+
+void commandsShown(CommandLatency& latency, double now) {
+    for (int type = 0; type < COMMAND_TYPE_COUNT; type++) {
+        if (latency.unshown[type] == 0.0) continue;
+        double seconds = now - latency.unshown[type];
+        latency.shown[type]++;
+        latency.shownTotal[type] += seconds;
+        if (seconds > latency.shownMax[type]) latency.shownMax[type] = seconds;
+        latency.unshown[type] = 0.0;
+        latency.lastShown = (float)seconds;
+    }
+}
+
+void commandMeanLatency(const CommandLatency& latency, float& applied, float& shown) {
+    long appliedCount = 0, shownCount = 0;
+    double appliedTotal = 0.0, shownTotal = 0.0;
+    for (int type = 0; type < COMMAND_TYPE_COUNT; type++) {
+        appliedCount += latency.applied[type];
+        appliedTotal += latency.appliedTotal[type];
+        shownCount += latency.shown[type];
+        shownTotal += latency.shownTotal[type];
+    }
+    applied = appliedCount > 0 ? (float)(appliedTotal / appliedCount) : 0.0f;
+    shown = shownCount > 0 ? (float)(shownTotal / shownCount) : 0.0f;
+}
+
+void commandLatencyPrint(const CommandLatency& applied, const CommandLatency& shown, FILE* out) {
+    for (int type = 0; type < COMMAND_TYPE_COUNT; type++) {
+        if (applied.applied[type] == 0) continue;
+        fprintf(out, "  %-12s %6ld applied after %6.2f ms (max %6.2f)", commandNames[type], applied.applied[type],
+                1000.0 * applied.appliedTotal[type] / applied.applied[type], 1000.0 * applied.appliedMax[type]);
+        if (shown.shown[type] > 0) {
+            fprintf(out, ", shown after %6.2f ms (max %6.2f)",
+                    1000.0 * shown.shownTotal[type] / shown.shown[type], 1000.0 * shown.shownMax[type]);
+        }
+        fprintf(out, "\n");
+    }
+}
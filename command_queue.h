@@ -0,0 +1,104 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <atomic>
+#include <cstdio>
+
+// Input commands from the GLUT callbacks to the simulation. The callbacks
+// don't change the fan, the camera or the simulation settings themselves:
+// they turn each event into a typed InputCommand and push it onto a
+// single-producer/single-consumer ring, and the simulation applies every
+// queued command at the start of its next tick. The ring is a fixed array
+// indexed by two counters, each written by one side only (release stores,
+// acquire loads), so neither side locks, waits or allocates, and the
+// simulation may run on another thread than the callbacks. A full ring
+// drops the command and counts it. Each command carries the time it was
+// pushed, so the programs can measure the latency from input to effect.
+
+const int kCommandQueueSize = 256;   // Commands in flight at most; a power of two
+
+enum CommandType {
+    COMMAND_POWER_ON,        // Power on (at level 3 from level 0)
+    COMMAND_POWER_OFF,
+    COMMAND_POWER_TOGGLE,    // The power button
+    COMMAND_SET_LEVEL,       // value: speed level 1-5
+    COMMAND_LEVEL_UP,
+    COMMAND_LEVEL_DOWN,
+    COMMAND_RESET,           // Stop the fan and still the air
+    COMMAND_BLADES,          // Next blade count: 3, 5, 7
+    COMMAND_ORBIT,           // delta: camera yaw and pitch change, degrees
+    COMMAND_ZOOM,            // delta[0]: camera distance change
+    COMMAND_FARM,            // Show/hide the fan farm
+    COMMAND_ROTOR_MODEL,     // Farm rotor dynamics: slew / torque
+    COMMAND_ROOM_AIR,        // Show/hide the room's air
+    COMMAND_TYPE_COUNT
+};
+
+struct InputCommand {
+    int type;                // CommandType
+    int value;
+    float delta[2];
+    double pushed;           // monotonicSeconds() when queued
+};
+
+struct CommandQueue {
+    InputCommand slots[kCommandQueueSize];
+    alignas(64) std::atomic<unsigned> head;   // Commands popped so far; written by the consumer
+    alignas(64) std::atomic<unsigned> tail;   // Commands pushed so far; written by the producer
+    long dropped;                             // Pushes refused by a full ring (producer only)
+};
+
+// Queue a command stamped with the current time (producer thread only);
+// false if the ring is full
+bool commandPush(CommandQueue& queue, int type, int value = 0, float deltaX = 0.0f, float deltaY = 0.0f);
+
+// Take the oldest queued command (consumer thread only); false if none
+bool commandPop(CommandQueue& queue, InputCommand& command);
+
+// Commands pushed but not yet popped (consumer thread only)
+bool commandsPending(const CommandQueue& queue);
+
+// Commands pushed so far (producer thread only) and popped so far (consumer
+// thread only); the producer knows its input has all been applied once a
+// count of popped commands handed back to it reaches commandsPushed()
+unsigned commandsPushed(const CommandQueue& queue);
+unsigned commandsPopped(const CommandQueue& queue);
+
+// Input-to-effect latency per command type: from commandPush() to the tick
+// that applied the command, and to the end of the first frame drawn after
+// that tick. Frames count once per type, for the type's oldest command
+// applied since the last frame (a drag's motion events share a frame).
+// With the simulation on its own thread, it keeps one CommandLatency for
+// the applied side and the render thread another for the shown side, the
+// push times of applied commands travelling between them with the state
+// (commandsHandOff(), commandsArrived()).
+struct CommandLatency {
+    long applied[COMMAND_TYPE_COUNT];
+    double appliedTotal[COMMAND_TYPE_COUNT], appliedMax[COMMAND_TYPE_COUNT];   // Seconds
+    long shown[COMMAND_TYPE_COUNT];
+    double shownTotal[COMMAND_TYPE_COUNT], shownMax[COMMAND_TYPE_COUNT];
+    double unshown[COMMAND_TYPE_COUNT];   // Push time of the oldest command applied but not drawn yet, 0 if none
+    float lastApplied, lastShown;         // Latest samples, seconds
+};
+
+// Record a command applied at time now
+void commandApplied(CommandLatency& latency, const InputCommand& command, double now);
+
+// Move the push times of the commands applied but not yet drawn into
+// unshown, keeping the older time where unshown already has one
+void commandsHandOff(CommandLatency& latency, double unshown[COMMAND_TYPE_COUNT]);
+
+// The commands in unshown (from commandsHandOff()) are in the next frame
+void commandsArrived(CommandLatency& latency, const double unshown[COMMAND_TYPE_COUNT]);
+
+// Record a frame finished at time now, showing every command applied before it
+void commandsShown(CommandLatency& latency, double now);
+
+// Mean latency to applied and to shown over all types, seconds (0 before any)
+void commandMeanLatency(const CommandLatency& latency, float& applied, float& shown);
+
+// One line per command type applied: count, mean and max latencies in ms,
+// to applied from applied and to shown from shown (may be the same object)
+void commandLatencyPrint(const CommandLatency& applied, const CommandLatency& shown, FILE* out);
+
+#endif
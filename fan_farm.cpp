@@ -0,0 +1,447 @@
+#include "fan_farm.h"
+#include "blade_profile.h"
+#include "gl_ext.h"
+#include "mesh_cache.h"
+#include "soft_backend.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+
+// Vertex layout shared by the three models: normal, color, position
+struct FarmVertex {
+    float normal[3];
+    unsigned char rgba[4];
+    float position[3];
+};
+
+struct FarmModel {
+    GLenum mode;                        // GL_QUADS, or GL_LINES for the wire cage
+    std::vector<FarmVertex> vertices;   // In the fan's coordinates (the rotor's are around its axle)
+    std::vector<unsigned int> indices;
+    GLuint vertexBuffer;                // 0 without buffer objects (drawn from the vectors)
+    GLuint indexBuffer;
+};
+
+static FarmModel bodyModels[kLodLevels];   // Stand, motor and hub, per level of detail
+static FarmModel cageModels[kLodLevels];   // Rings and supports of the safety cage
+static FarmModel rotorModels[kBladeVariantCount];  // 3, 5 and 7 blades, turned by the fan's angle
+static bool modelsBuilt = false;
+
+// Where the rotor's axle sits on the fan (drawFanBlades() in the 3D program)
+static const float kRotorPivot[3] = {1.0f, 1.4f, 0.0f};
+
+// Bounding sphere of a whole fan, from the base of the stand to the top of the cage
+static const float kFanCenter[3] = {0.7f, 0.25f, 0.0f};
+static const float kFanBound = 2.4f;
+
+// Instancing shader: places each model at its instance's position and, for
+// the rotor, turns it by the instance's blade angle; one diffuse light with
+// the vertex color as material, like the fixed-function path with GL_COLOR_MATERIAL
+static const char* kVertexShader =
+    "#version 120\n"
+    "attribute vec4 instance;  // Fan position xyz, blade angle in degrees\n"
+    "uniform float spin;       // 1 for the rotor, 0 for parts that don't turn\n"
+    "uniform vec3 pivot;       // Rotor axle position on the fan\n"
+    "void main() {\n"
+    "    float a = radians(instance.w) * spin;\n"
+    "    mat3 turn = mat3(cos(a), sin(a), 0.0, -sin(a), cos(a), 0.0, 0.0, 0.0, 1.0);\n"
+    "    vec4 eye = gl_ModelViewMatrix * vec4(turn * gl_Vertex.xyz + pivot + instance.xyz, 1.0);\n"
+    "    vec3 normal = normalize(gl_NormalMatrix * (turn * gl_Normal));\n"
+    "    vec3 light = normalize(gl_LightSource[0].position.xyz - eye.xyz);\n"
+    "    float diffuse = max(dot(normal, light), 0.0);\n"
+    "    gl_FrontColor = vec4(gl_Color.rgb * (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb +\n"
+    "                                         gl_LightSource[0].diffuse.rgb * diffuse), gl_Color.a);\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "}\n";
+
+static const char* kFragmentShader =
+    "#version 120\n"
+    "void main() {\n"
+    "    gl_FragColor = gl_Color;\n"
+    "}\n";
+
+static GLuint farmProgram = 0;
+static GLint instanceLocation = -1;
+static GLint spinLocation = -1;
+static GLint pivotLocation = -1;
+
+static void addVertex(FarmModel& model, const float m[16], const float n[3], const float p[3], const float color[3]) {
+    FarmVertex v;
+    for (int i = 0; i < 3; i++) {
+        // Modelview is rotation and translation only, so normals take the upper 3x3
+        v.normal[i] = m[i] * n[0] + m[4 + i] * n[1] + m[8 + i] * n[2];
+        v.position[i] = m[i] * p[0] + m[4 + i] * p[1] + m[8 + i] * p[2] + m[12 + i];
+        v.rgba[i] = (unsigned char)(color[i] * 255.0f + 0.5f);
+    }
+    v.rgba[3] = 255;
+    model.vertices.push_back(v);
+}
+
+// Append a cached mesh placed by the current modelview matrix (set up with
+// the same glTranslatef()/glRotatef() calls as the single fan's drawing code).
+// Quads become their outline edges in a GL_LINES model.
+static void addMesh(FarmModel& model, const Mesh& mesh, const float color[3]) {
+    float m[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    unsigned int base = (unsigned int)model.vertices.size();
+    for (size_t i = 0; i < mesh.vertices.size(); i += 6) {
+        addVertex(model, m, &mesh.vertices[i], &mesh.vertices[i + 3], color);
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i += 4) {
+        const unsigned int* q = &mesh.indices[i];
+        if (model.mode == GL_QUADS) {
+            for (int k = 0; k < 4; k++) model.indices.push_back(base + q[k]);
+        } else {
+            // Two edges per grid quad; the neighbouring quads supply the other two
+            unsigned int edges[4] = {q[0], q[1], q[1], q[2]};
+            for (int k = 0; k < 4; k++) model.indices.push_back(base + edges[k]);
+        }
+    }
+}
+
+static void addLine(FarmModel& model, const float a[3], const float b[3], const float color[3]) {
+    float m[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    const float up[3] = {0.0f, 1.0f, 0.0f};
+    unsigned int base = (unsigned int)model.vertices.size();
+    addVertex(model, m, up, a, color);
+    addVertex(model, m, up, b, color);
+    model.indices.push_back(base);
+    model.indices.push_back(base + 1);
+}
+
+// A whole rotor from its precomputed blades (see blade_profile.h)
+template <int Blades>
+static void addRotor(FarmModel& model, const FanColors& colors) {
+    static const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    const BladeRotor<Blades>& rotor = bladeRotor3D<Blades>;
+    model.mode = GL_QUADS;
+    for (int v = 0; v < rotor.kVertices; v++) {
+        model.indices.push_back((unsigned int)model.vertices.size());
+        addVertex(model, identity, rotor.normal[v], rotor.position[v], colors.blades[v / 16]);
+    }
+}
+
+static void uploadModel(FarmModel& model) {
+    if (!glExtHasBuffers) return;
+    pglGenBuffers(1, &model.vertexBuffer);
+    pglGenBuffers(1, &model.indexBuffer);
+    pglBindBuffer(GL_ARRAY_BUFFER, model.vertexBuffer);
+    pglBufferData(GL_ARRAY_BUFFER, model.vertices.size() * sizeof(FarmVertex), model.vertices.data(), GL_STATIC_DRAW);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.indexBuffer);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER, model.indices.size() * sizeof(unsigned int), model.indices.data(), GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// Bake the parts drawn by drawFanStand(), drawFanMotor() and drawFanHub()
+// at one level of detail
+static void buildBody(FarmModel& body, int level, const FanColors& colors) {
+    body.mode = GL_QUADS;
+
+    // Stand: base, pole and top joint
+    glLoadIdentity();
+    glTranslatef(0.0f, -1.7f, 0.0f);
+    glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
+    addMesh(body, meshCylinder(0.4f, 0.2f, lodDetail(20, level, 3)), colors.stand);
+    glLoadIdentity();
+    glTranslatef(0.0f, -1.6f, 0.0f);
+    glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
+    addMesh(body, meshCylinder(0.08f, 3.0f, lodDetail(16, level, 3)), colors.stand);
+    glLoadIdentity();
+    glTranslatef(0.0f, 1.4f, 0.0f);
+    addMesh(body, meshSphere(0.12f, lodDetail(16, level, 3), lodDetail(16, level, 3)), colors.stand);
+
+    // Motor: body, face and arm
+    glLoadIdentity();
+    glTranslatef(0.0f, 1.4f, 0.0f);
+    glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
+    addMesh(body, meshCylinder(0.15f, 0.3f, lodDetail(20, level, 3)), colors.motor);
+    glLoadIdentity();
+    glTranslatef(0.0f, 1.4f, 0.3f);
+    glRotatef(90.0f, 1.0f, 0.0f, 0.0f);
+    addMesh(body, meshCylinder(0.12f, 0.1f, lodDetail(16, level, 3)), colors.motor);
+    glLoadIdentity();
+    glTranslatef(0.0f, 1.4f, 0.0f);
+    glRotatef(90.0f, 0.0f, 1.0f, 0.0f);
+    addMesh(body, meshCylinder(0.05f, 1.0f, lodDetail(12, level, 3)), colors.motor);
+
+    // Hub and hub front
+    glLoadIdentity();
+    glTranslatef(1.0f, 1.4f, 0.0f);
+    addMesh(body, meshSphere(0.1f, lodDetail(16, level, 3), lodDetail(16, level, 3)), colors.hub);
+    glTranslatef(0.0f, 0.0f, 0.05f);
+    addMesh(body, meshSphere(0.08f, lodDetail(12, level, 3), lodDetail(12, level, 3)), colors.hub);
+}
+
+// The cage from drawSafetyCage(): the ring (drawn twice in the same place
+// there) and eight pairs of supports
+static void buildCage(FarmModel& cage, int level, const FanColors& colors) {
+    cage.mode = GL_LINES;
+    glLoadIdentity();
+    glTranslatef(1.0f, 1.4f, 0.0f);
+    addMesh(cage, meshTorus(0.02f, 0.85f, lodDetail(8, level, 3), lodDetail(32, level, 3)), colors.cage);
+    for (int i = 0; i < 8; i++) {
+        const float back[2][3] = {{0.0f, 0.0f, -0.05f}, {0.0f, 0.85f, -0.05f}};
+        const float front[2][3] = {{0.0f, 0.0f, 0.05f}, {0.0f, 0.85f, 0.05f}};
+        glPushMatrix();
+        glRotatef(i * 45.0f, 0.0f, 0.0f, 1.0f);
+        addLine(cage, back[0], back[1], colors.cage);
+        addLine(cage, front[0], front[1], colors.cage);
+        glPopMatrix();
+    }
+}
+
+// Bake every model: body and cage at each level of detail, and a rotor per
+// blade count (already only a few quads) around its own axle; kRotorPivot moves it onto the fan
+static void buildModels(const FanColors& colors) {
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    for (int level = 0; level < kLodLevels; level++) {
+        buildBody(bodyModels[level], level, colors);
+        buildCage(cageModels[level], level, colors);
+        uploadModel(bodyModels[level]);
+        uploadModel(cageModels[level]);
+    }
+
+    addRotor<3>(rotorModels[0], colors);
+    addRotor<5>(rotorModels[1], colors);
+    addRotor<7>(rotorModels[2], colors);
+    for (int i = 0; i < kBladeVariantCount; i++) uploadModel(rotorModels[i]);
+    glPopMatrix();
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = pglCreateShader(type);
+    pglShaderSource(shader, 1, &source, 0);
+    pglCompileShader(shader);
+    GLint ok = 0;
+    pglGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        pglGetShaderInfoLog(shader, sizeof(log), 0, log);
+        fprintf(stderr, "fan farm shader: %s\n", log);
+        return 0;
+    }
+    return shader;
+}
+
+// Build the instancing program; leaves farmProgram 0 (per-fan drawing) on failure
+static void buildProgram() {
+    GLuint vertex = compileShader(GL_VERTEX_SHADER, kVertexShader);
+    GLuint fragment = compileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+    if (!vertex || !fragment) return;
+    GLuint program = pglCreateProgram();
+    pglAttachShader(program, vertex);
+    pglAttachShader(program, fragment);
+    pglLinkProgram(program);
+    GLint ok = 0;
+    pglGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        pglGetProgramInfoLog(program, sizeof(log), 0, log);
+        fprintf(stderr, "fan farm program: %s\n", log);
+        return;
+    }
+    farmProgram = program;
+    instanceLocation = pglGetAttribLocation(program, "instance");
+    spinLocation = pglGetUniformLocation(program, "spin");
+    pivotLocation = pglGetUniformLocation(program, "pivot");
+}
+
+void farmInit(FanFarm& farm, int count, float spacing, const FanColors& colors) {
+    if (!modelsBuilt) {
+        buildModels(colors);
+        if (glExtHasInstancing) buildProgram();
+        modelsBuilt = true;
+    }
+
+    farm.count = count;
+    rotorBatchInit(farm.rotors, count);
+    farm.level = -1;
+    farm.positions.resize(count * 3);
+    farm.instances.resize(count * 4);
+    farm.levels.resize(count);
+    farm.instanced = farmProgram != 0;
+    if (!farm.blades) farm.blades = 5;
+    farm.drawCalls = 0;
+    if (farm.instanced && !farm.instanceBuffer) pglGenBuffers(1, &farm.instanceBuffer);
+
+    int side = (int)ceilf(sqrtf((float)count));
+    for (int i = 0; i < count; i++) {
+        farm.positions[i * 3] = (i % side - (side - 1) * 0.5f) * spacing;
+        farm.positions[i * 3 + 1] = 0.0f;
+        farm.positions[i * 3 + 2] = (i / side - (side - 1) * 0.5f) * spacing;
+        farm.rotors.angle[i] = farm.rotors.previousAngle[i] = (float)((i * 37) % 360);  // Not all in step
+    }
+}
+
+void farmStep(FanFarm& farm, const RotorParams& params, int level) {
+    if (level != farm.level) {
+        for (int i = 0; i < farm.count; i++) {
+            int target = level;
+            if (level > 0) {
+                target = level + i % 3 - 1;
+                if (target < 1) target = 1;
+                if (target > 5) target = 5;
+            }
+            rotorSetLevel(farm.rotors, params, i, target);
+        }
+        farm.level = level;
+    }
+    rotorBatchStep(farm.rotors, params, 1.0f / kFanTickHz, 0, farm.count);
+}
+
+bool farmAnimating(const FanFarm& farm) {
+    if (farm.level > 0) return true;
+    for (int i = 0; i < farm.count; i++) {
+        if (farm.rotors.speed[i] > 0.0f) return true;
+    }
+    return false;
+}
+
+// Point the fixed-function arrays at a model (from its buffer, or its vectors)
+static const void* bindModel(const FarmModel& model) {
+    const char* base = 0;
+    if (model.vertexBuffer) {
+        pglBindBuffer(GL_ARRAY_BUFFER, model.vertexBuffer);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.indexBuffer);
+    } else {
+        base = (const char*)model.vertices.data();
+    }
+    glNormalPointer(GL_FLOAT, sizeof(FarmVertex), base + offsetof(FarmVertex, normal));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(FarmVertex), base + offsetof(FarmVertex, rgba));
+    glVertexPointer(3, GL_FLOAT, sizeof(FarmVertex), base + offsetof(FarmVertex, position));
+    return model.indexBuffer ? 0 : (const void*)model.indices.data();
+}
+
+// Draw the fans of each level: the instances of level l are the
+// farm.visible[l] entries starting at first[l]
+static void drawInstanced(FanFarm& farm, const int first[kLodLevels]) {
+    const FarmModel* rotor = &rotorModels[bladeVariantIndex(farm.blades)];
+    int visible = first[kLodLevels - 1] + farm.visible[kLodLevels - 1];
+    pglBindBuffer(GL_ARRAY_BUFFER, farm.instanceBuffer);
+    pglBufferData(GL_ARRAY_BUFFER, visible * 4 * sizeof(float), farm.instances.data(), GL_STREAM_DRAW);
+    pglUseProgram(farmProgram);
+    pglEnableVertexAttribArray(instanceLocation);
+    pglVertexAttribDivisor(instanceLocation, 1);
+
+    for (int level = 0; level < kLodLevels; level++) {
+        if (farm.visible[level] == 0) continue;
+        const FarmModel* models[3] = {&bodyModels[level], &cageModels[level], rotor};
+        for (int m = 0; m < 3; m++) {
+            bool spin = models[m] == rotor;
+            pglUniform1f(spinLocation, spin ? 1.0f : 0.0f);
+            pglUniform3f(pivotLocation, spin ? kRotorPivot[0] : 0.0f, spin ? kRotorPivot[1] : 0.0f, 0.0f);
+            pglBindBuffer(GL_ARRAY_BUFFER, farm.instanceBuffer);
+            const float* offset = 0;
+            pglVertexAttribPointer(instanceLocation, 4, GL_FLOAT, GL_FALSE, 0, offset + first[level] * 4);
+            const void* indices = bindModel(*models[m]);
+            pglDrawElementsInstanced(models[m]->mode, (GLsizei)models[m]->indices.size(), GL_UNSIGNED_INT, indices,
+                                     farm.visible[level]);
+            farm.drawCalls++;
+            farm.vertices += (long)models[m]->indices.size() * farm.visible[level];
+        }
+    }
+
+    pglVertexAttribDivisor(instanceLocation, 0);
+    pglDisableVertexAttribArray(instanceLocation);
+    pglUseProgram(0);
+}
+
+// The software backend's view of a model
+static RasterArrays modelArrays(const FarmModel& model) {
+    RasterArrays arrays = {};
+    arrays.position = model.vertices[0].position;
+    arrays.positionSize = 3;
+    arrays.positionStride = sizeof(FarmVertex);
+    arrays.normal = model.vertices[0].normal;
+    arrays.normalStride = sizeof(FarmVertex);
+    arrays.rgba = model.vertices[0].rgba;
+    arrays.rgbaStride = sizeof(FarmVertex);
+    return arrays;
+}
+
+static void drawPerFan(FanFarm& farm, const int first[kLodLevels]) {
+    const FarmModel* rotor = &rotorModels[bladeVariantIndex(farm.blades)];
+    for (int level = 0; level < kLodLevels; level++) {
+        const FarmModel* models[3] = {&bodyModels[level], &cageModels[level], rotor};
+        for (int m = 0; m < 3 && farm.visible[level] > 0; m++) {
+            bool spin = models[m] == rotor;
+            const void* indices = softBackend ? 0 : bindModel(*models[m]);
+            RasterArrays arrays = softBackend ? modelArrays(*models[m]) : RasterArrays();
+            for (int i = first[level]; i < first[level] + farm.visible[level]; i++) {
+                const float* instance = &farm.instances[i * 4];
+                glPushMatrix();
+                glTranslatef(instance[0], instance[1], instance[2]);
+                if (spin) {
+                    glTranslatef(kRotorPivot[0], kRotorPivot[1], kRotorPivot[2]);
+                    glRotatef(instance[3], 0.0f, 0.0f, 1.0f);
+                }
+                if (softBackend) {
+                    softBackendDraw(models[m]->mode, arrays, (int)models[m]->vertices.size(),
+                                    models[m]->indices.data(), (int)models[m]->indices.size());
+                } else {
+                    glDrawElements(models[m]->mode, (GLsizei)models[m]->indices.size(), GL_UNSIGNED_INT, indices);
+                }
+                glPopMatrix();
+                farm.drawCalls++;
+                farm.vertices += (long)models[m]->indices.size();
+            }
+        }
+    }
+}
+
+void farmDraw(FanFarm& farm, const RotorBatch& rotors, float alpha, const LodView& view) {
+    farm.drawCalls = 0;
+    farm.vertices = 0;
+    for (int level = 0; level < kLodLevels; level++) farm.visible[level] = 0;
+    if (farm.count == 0) return;
+
+    // Cull each fan against the frustum and pick its level from the cage's size on screen
+    for (int i = 0; i < farm.count; i++) {
+        const float* position = &farm.positions[i * 3];
+        float center[3] = {position[0] + kFanCenter[0], position[1] + kFanCenter[1], position[2] + kFanCenter[2]};
+        float screenRadius = lodScreenRadius(view, view.camera, center, kFanBound, 0.85f);
+        int level = screenRadius < 0.0f ? -1 : lodLevel(screenRadius, 32);
+        farm.levels[i] = (signed char)level;
+        if (level >= 0) farm.visible[level]++;
+    }
+
+    // Instances grouped by level, so each level is one contiguous range
+    int first[kLodLevels], next[kLodLevels];
+    for (int level = 0, start = 0; level < kLodLevels; level++) {
+        first[level] = next[level] = start;
+        start += farm.visible[level];
+    }
+    for (int i = 0; i < farm.count; i++) {
+        if (farm.levels[i] < 0) continue;
+        float* instance = &farm.instances[next[(int)farm.levels[i]]++ * 4];
+        instance[0] = farm.positions[i * 3];
+        instance[1] = farm.positions[i * 3 + 1];
+        instance[2] = farm.positions[i * 3 + 2];
+        instance[3] = rotorInterpolatedAngle(rotors, i, alpha);
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_LIGHTING_BIT | GL_LINE_BIT | GL_CURRENT_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnable(GL_COLOR_MATERIAL);  // Vertex colors drive the lit material
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    glLineWidth(1.5f);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    if (farm.instanced && !softBackend) {
+        drawInstanced(farm, first);
+    } else {
+        drawPerFan(farm, first);
+    }
+
+    if (glExtHasBuffers) {
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    glPopClientAttrib();
+    glPopAttrib();
+}
@@ -0,0 +1,62 @@
+#ifndef FAN_FARM_H
+#define FAN_FARM_H
+
+#include <GL/glut.h>
+#include <vector>
+#include "blade_profile.h"
+#include "rotor_batch.h"
+#include "lod.h"
+
+// "Fan farm": many copies of the 3D desk fan, each with its own rotor state,
+// drawn from three shared models (body, wire cage, blade rotor) baked from
+// the mesh cache. With OpenGL 3.3 every model is one instanced draw for the
+// whole farm, the fan positions and blade angles coming from a per-instance
+// buffer; otherwise (or with the software backend) each fan costs one
+// glDrawElements() per model.
+// Fans outside the view are skipped, and the body and cage are drawn at the
+// level of detail that fits each fan's size on screen.
+
+// Colors of the fan's parts, as drawn by drawFan() in the 3D program
+struct FanColors {
+    float stand[3];
+    float motor[3];
+    float hub[3];
+    float cage[3];
+    float blades[kMaxBlades][3];  // One per blade of the largest rotor
+};
+
+struct FanFarm {
+    int count;                       // Fans in the farm
+    RotorBatch rotors;               // Rotor state of every fan, stepped together
+    int level;                       // Farm level the rotors were set for; -1 makes farmStep() set them again
+    std::vector<float> positions;    // x, y, z of each fan, in the single fan's coordinates
+    std::vector<float> instances;    // x, y, z and blade angle per visible fan, refilled by farmDraw()
+    std::vector<signed char> levels; // Level of detail of each fan in the last frame, -1 when culled
+    GLuint instanceBuffer;           // Per-instance data on the GPU (instanced path)
+    bool instanced;                  // Instanced draws; false = one draw per model per fan
+    int blades;                      // Rotor drawn on every fan: 3, 5 or 7 blades (5 by default)
+    int drawCalls;                   // Draw calls issued by the last farmDraw()
+    int visible[kLodLevels];         // Fans it drew at each level of detail
+    long vertices;                   // Vertices (indices) it submitted
+};
+
+// Lay out count fans on a square grid with the given spacing, centered on
+// the origin. The first call also bakes the shared models and compiles the
+// instancing shader (needs a current GL context and glExtLoad()).
+void farmInit(FanFarm& farm, int count, float spacing, const FanColors& colors);
+
+// One physics tick for every fan. Level 0 turns the farm off; otherwise the
+// fans run at that level, give or take one, so neighbours turn at different speeds.
+// Set farm.level to -1 after switching params to apply them to every fan.
+void farmStep(FanFarm& farm, const RotorParams& params, int level);
+
+// Is any fan in the farm on or still turning?
+bool farmAnimating(const FanFarm& farm);
+
+// Draw every fan in view with its blades interpolated alpha (0-1) of the way
+// from the previous tick, in the current modelview (camera) transform and
+// light setup; view must describe that camera and projection. rotors is
+// farm.rotors, or a copy of its angles when another thread steps the farm.
+void farmDraw(FanFarm& farm, const RotorBatch& rotors, float alpha, const LodView& view);
+
+#endif
@@ -0,0 +1,89 @@
+#include "fan_sim.h"
+#include <cmath>
+
+FanParams fanParams2D() {
+    FanParams p;
+    p.speedPerLevel = 2.0f;
+    p.accelStep = 0.25f;
+    p.decelStep = 0.15f;
+    p.offDecelStep = 0.15f * 1.5f;  // Faster deceleration when off
+    p.settleBand = 0.0f;
+    return p;
+}
+
+FanParams fanParams3D() {
+    FanParams p;
+    p.speedPerLevel = 3.0f;
+    p.accelStep = 0.5f * 0.05f;   // accelerationRate * 0.05
+    p.decelStep = 1.0f * 0.05f;   // decelerationRate * 0.05
+    p.offDecelStep = 1.0f * 0.1f; // decelerationRate * 0.1
+    p.settleBand = 0.1f;
+    return p;
+}
+
+void fanReset(FanState& fan) {
+    fan.rotationAngle = 0.0f;
+    fan.rotationSpeed = 0.0f;
+    fan.targetRotationSpeed = 0.0f;
+    fan.on = false;
+    fan.speedLevel = 0;
+    fan.accelerating = false;
+    fan.decelerating = false;
+}
+
+void fanSetLevel(FanState& fan, int level) {
+    if (level < 0 || level > 5) return;
+    fan.speedLevel = level;
+    fan.on = level > 0;
+}
+
+void fanStep(FanState& fan, const FanParams& params, float dt) {
+    float ticks = dt * kFanTickHz;  // Constants are expressed per nominal tick
+
+    if (fan.on) {
+        fan.targetRotationSpeed = fan.speedLevel * params.speedPerLevel;
+
+        if (fan.rotationSpeed < fan.targetRotationSpeed - params.settleBand) {
+            fan.accelerating = true;
+            fan.decelerating = false;
+            fan.rotationSpeed += params.accelStep * ticks;
+            if (fan.rotationSpeed > fan.targetRotationSpeed) {
+                fan.rotationSpeed = fan.targetRotationSpeed;  // Don't overshoot
+            }
+        } else if (fan.rotationSpeed > fan.targetRotationSpeed + params.settleBand) {
+            fan.accelerating = false;
+            fan.decelerating = true;
+            fan.rotationSpeed -= params.decelStep * ticks;
+            if (fan.rotationSpeed < fan.targetRotationSpeed) {
+                fan.rotationSpeed = fan.targetRotationSpeed;
+            }
+        } else {
+            fan.accelerating = false;
+            fan.decelerating = false;
+            fan.rotationSpeed = fan.targetRotationSpeed;
+        }
+    } else {
+        fan.targetRotationSpeed = 0.0f;
+        fan.accelerating = false;
+        if (fan.rotationSpeed > params.settleBand) {
+            fan.decelerating = true;
+            fan.rotationSpeed -= params.offDecelStep * ticks;
+            if (fan.rotationSpeed < 0.0f) fan.rotationSpeed = 0.0f;
+        } else {
+            fan.decelerating = false;
+            fan.rotationSpeed = 0.0f;
+        }
+    }
+
+    fan.rotationAngle += fan.rotationSpeed * ticks;
+    if (fan.rotationAngle >= 360.0f) {
+        fan.rotationAngle = fmodf(fan.rotationAngle, 360.0f);  // Keep angle in 0-360 range
+    }
+}
+
+float fanInterpolatedAngle(const FanState& previous, const FanState& current, float alpha) {
+    float delta = current.rotationAngle - previous.rotationAngle;
+    if (delta < 0.0f) delta += 360.0f;  // Wrapped past 360 during the step
+    float angle = previous.rotationAngle + delta * alpha;
+    return angle >= 360.0f ? angle - 360.0f : angle;
+}
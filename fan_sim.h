@@ -0,0 +1,48 @@
+#ifndef FAN_SIM_H
+#define FAN_SIM_H
+
+// Headless rotor simulation shared by the 2D and 3D programs.
+// No OpenGL/GLUT in here so it can be stepped millions of times per second
+// (see fan_soak.cpp) as well as from the GLUT callbacks.
+
+// Speeds are in degrees per nominal tick (the original 16 ms GLUT timer),
+// so the values shown on the HUD keep their old meaning.
+const float kFanTickHz = 60.0f;
+
+// Tuning constants for one flavour of the fan (2D and 3D differ slightly)
+struct FanParams {
+    float speedPerLevel;   // Target rotation speed per speed level
+    float accelStep;       // Speed gained per tick while below target
+    float decelStep;       // Speed lost per tick while above target
+    float offDecelStep;    // Speed lost per tick while powered off
+    float settleBand;      // Snap to target when within this distance
+};
+
+// Complete state of one fan rotor
+struct FanState {
+    float rotationAngle;        // Blade angle (degrees, 0-360)
+    float rotationSpeed;        // Current speed (degrees/tick)
+    float targetRotationSpeed;  // Speed the motor is driving toward
+    bool on;                    // Power state
+    int speedLevel;             // 0 (off) to 5 (max)
+    bool accelerating;          // Below target and speeding up
+    bool decelerating;          // Above target (or off) and slowing down
+};
+
+FanParams fanParams2D();   // Behaviour of the original 2D timer()
+FanParams fanParams3D();   // Behaviour of the original 3D updateFanSpeed()
+
+// Put the fan back to stopped, powered off, level 0
+void fanReset(FanState& fan);
+
+// Select speed level 0-5; level 0 powers the fan off, 1-5 power it on
+void fanSetLevel(FanState& fan, int level);
+
+// Advance the simulation by dt seconds
+void fanStep(FanState& fan, const FanParams& params, float dt);
+
+// Blade angle a fraction alpha (0-1) of the way from one state to the next,
+// for drawing between fixed physics steps (the blades only turn forward)
+float fanInterpolatedAngle(const FanState& previous, const FanState& current, float alpha);
+
+#endif
@@ -0,0 +1,93 @@
+// Benchmark for the airflow solver in air_fluid.cpp.
+//
+// Runs the 2D fan's forcing at full speed on a size x size grid for the given
+// number of ticks with 1..N threads and reports the time per tick (mean and
+// p99), the pressure residual left after each tick's V-cycles and the
+// divergence left in the field. Every thread count must end in the same
+// state; the run fails otherwise.
+//
+// Usage: fluid_bench [ticks] [size] [max threads]
+
+#include "air_fluid.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// The 2D program's fan at full speed, scaled to a grid of the given width in
+// the 2D window's pixels (800 wide, fan at 450,350 with a 75 px disc)
+static FluidFan benchFan() {
+    FluidFan fan;
+    fan.cx = 450;
+    fan.cy = 350;
+    fan.radius = 75;
+    fan.source = 0.08f;
+    fan.swirl = 0.03f;
+    return fan;
+}
+
+// RMS divergence of the projected field outside the fan's disc, in cells per tick per cell
+static double leftoverDivergence(const AirFluid& fluid, const FluidFan& fan) {
+    double sum = 0.0;
+    long cells = 0;
+    int s = fluid.stride;
+    for (int y = 1; y < fluid.ny - 1; y++) {
+        for (int x = 1; x < fluid.nx - 1; x++) {
+            float dx = (x + 0.5f) * fluid.cellSize - fan.cx, dy = (y + 0.5f) * fluid.cellSize - fan.cy;
+            if (dx * dx + dy * dy < (fan.radius + 2 * fluid.cellSize) * (fan.radius + 2 * fluid.cellSize)) continue;
+            int i = (y + 1) * s + x + 1;
+            double d = 0.5 * (fluid.u[i + 1] - fluid.u[i - 1] + fluid.v[i + s] - fluid.v[i - s]);
+            sum += d * d;
+            cells++;
+        }
+    }
+    return cells ? sqrt(sum / cells) : 0.0;
+}
+
+int main(int argc, char** argv) {
+    int ticks = argc > 1 ? atoi(argv[1]) : 300;
+    int size = argc > 2 ? atoi(argv[2]) : 512;
+    int maxThreads = argc > 3 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    if (ticks <= 0 || size < 8 || maxThreads < 1) {
+        fprintf(stderr, "usage: %s [ticks] [size] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    FluidFan fan = benchFan();
+    float cellSize = 800.0f / size;
+    printf("grid %dx%d (%.3f px cells), %d ticks, %d V-cycles per tick\n", size, size, cellSize, ticks, kFluidVCycles);
+    printf("%8s %10s %10s %12s %14s %16s\n", "threads", "mean ms", "p99 ms", "ticks/s", "residual", "divergence");
+
+    std::vector<float> reference;
+    bool identical = true;
+    for (int threads = 1;; threads = std::min(threads * 2, maxThreads)) {  // 1, 2, 4, ..., maxThreads
+        AirFluid fluid;
+        fluidInit(fluid, size, size, cellSize);
+        ThreadPool pool(threads);
+        std::vector<double> times;
+        times.reserve(ticks);
+        for (int t = 0; t < ticks; t++) {
+            auto start = std::chrono::steady_clock::now();
+            fluidStep(fluid, fan, &pool);
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        double total = 0.0;
+        for (double ms : times) total += ms;
+        std::sort(times.begin(), times.end());
+        double mean = total / ticks;
+        double p99 = times[std::min(times.size() - 1, (size_t)ceil(times.size() * 0.99) - 1)];
+        printf("%8d %10.3f %10.3f %12.0f %14.2e %16.2e\n", threads, mean, p99, 1000.0 / mean,
+               fluid.residual, leftoverDivergence(fluid, fan));
+
+        if (reference.empty()) reference = fluid.u;
+        else if (memcmp(reference.data(), fluid.u.data(), reference.size() * sizeof(float)) != 0) identical = false;
+        if (threads == maxThreads) break;
+    }
+    printf("same result on every thread count: %s\n", identical ? "yes" : "NO");
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+#include "frame_arena.h"
+#include <new>
+
+FrameArena frameArena;
+
+static const size_t kArenaAlignment = 16;
+
+void* arenaAlloc(FrameArena& arena, size_t bytes) {
+    bytes = (bytes + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+    arena.wanted += bytes;
+    if (arena.used + bytes <= arena.capacity) {
+        void* p = arena.block + arena.used;
+        arena.used += bytes;
+        return p;
+    }
+    void* p = ::operator new(bytes);  // Aligned to at least 16 bytes on the 64-bit targets
+    arena.overflow.push_back(p);
+    return p;
+}
+
+void arenaReset(FrameArena& arena) {
+    if (!arena.overflow.empty()) {
+        for (void* p : arena.overflow) ::operator delete(p);
+        arena.overflow.clear();
+        // Room for the whole of the frame that overflowed, plus some slack
+        ::operator delete(arena.block);
+        arena.capacity = arena.wanted + arena.wanted / 2;
+        arena.block = (unsigned char*)::operator new(arena.capacity);
+        arena.overflowFrames++;
+    }
+    arena.used = 0;
+    arena.wanted = 0;
+}
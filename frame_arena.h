@@ -0,0 +1,39 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator for data that only lives until the end of a frame (vertex
+// arrays assembled for one draw, scratch buffers). Allocating is a pointer
+// increment inside one block; the program resets the arena once per frame,
+// which releases everything at once. A frame that needs more than the block
+// holds takes the rest from the heap, and the next reset grows the block to
+// that frame's total, so after the first frames at a given workload the
+// arena allocates nothing.
+
+struct FrameArena {
+    unsigned char* block;          // capacity bytes, null before the first reset that needs one
+    size_t capacity;
+    size_t used;                   // Bytes handed out from block this frame
+    size_t wanted;                 // Bytes asked for this frame, including overflow
+    std::vector<void*> overflow;   // Heap allocations that didn't fit, freed at the next reset
+    int overflowFrames;            // Frames that overflowed (the block grew after each)
+};
+
+// The arena the drawing code shares; the programs reset it at the start of each frame
+extern FrameArena frameArena;
+
+// Uninitialized memory for bytes, 16-byte aligned, valid until the next reset
+void* arenaAlloc(FrameArena& arena, size_t bytes);
+
+template <typename T>
+T* arenaArray(FrameArena& arena, size_t count) {
+    return (T*)arenaAlloc(arena, count * sizeof(T));
+}
+
+// Start a new frame: invalidates everything handed out, frees the overflow
+// and grows the block if the frame needed more than it holds
+void arenaReset(FrameArena& arena);
+
+#endif
@@ -0,0 +1,187 @@
+#include "frame_capture.h"
+#include "gl_ext.h"
+#include <cstring>
+
+// BT.601 full-range ("C420jpeg") conversion in 8.8 fixed point
+static inline unsigned char lumaOf(int r, int g, int b) {
+    return (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+static inline unsigned char blueDifferenceOf(int r, int g, int b) {
+    return (unsigned char)(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+}
+
+static inline unsigned char redDifferenceOf(int r, int g, int b) {
+    return (unsigned char)(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+}
+
+// Convert a bottom-up BGRA image to top-down Y, Cb and Cr planes, chroma
+// averaged over 2x2 pixel blocks
+static void convertFrame(const unsigned char* bgra, int width, int height,
+                         unsigned char* y, unsigned char* cb, unsigned char* cr) {
+    for (int row = 0; row < height; row++) {
+        const unsigned char* src = bgra + (size_t)(height - 1 - row) * width * 4;
+        unsigned char* dst = y + (size_t)row * width;
+        for (int x = 0; x < width; x++) dst[x] = lumaOf(src[x * 4 + 2], src[x * 4 + 1], src[x * 4]);
+    }
+    int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    for (int row = 0; row < chromaHeight; row++) {
+        int top = row * 2, bottom = row * 2 + 1 < height ? row * 2 + 1 : row * 2;
+        const unsigned char* src0 = bgra + (size_t)(height - 1 - top) * width * 4;
+        const unsigned char* src1 = bgra + (size_t)(height - 1 - bottom) * width * 4;
+        for (int x = 0; x < chromaWidth; x++) {
+            int left = x * 2 * 4, right = (x * 2 + 1 < width ? x * 2 + 1 : x * 2) * 4;
+            int b = (src0[left] + src0[right] + src1[left] + src1[right] + 2) >> 2;
+            int g = (src0[left + 1] + src0[right + 1] + src1[left + 1] + src1[right + 1] + 2) >> 2;
+            int r = (src0[left + 2] + src0[right + 2] + src1[left + 2] + src1[right + 2] + 2) >> 2;
+            cb[(size_t)row * chromaWidth + x] = blueDifferenceOf(r, g, b);
+            cr[(size_t)row * chromaWidth + x] = redDifferenceOf(r, g, b);
+        }
+    }
+}
+
+// Writer thread: convert and write queued frames until stopped and drained
+static void writerLoop(FrameCapture* capture) {
+    size_t lumaSize = (size_t)capture->width * capture->height;
+    size_t chromaSize = (size_t)((capture->width + 1) / 2) * ((capture->height + 1) / 2);
+    std::vector<unsigned char> planes(lumaSize + 2 * chromaSize);
+    for (;;) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> guard(capture->lock);
+            capture->queued.wait(guard, [&] { return capture->queueCount > 0 || capture->stopping; });
+            if (capture->queueCount == 0) return;  // Stopping, and everything is written
+            slot = capture->queueHead;
+        }
+        convertFrame(capture->slots[slot].data(), capture->width, capture->height,
+                     &planes[0], &planes[lumaSize], &planes[lumaSize + chromaSize]);
+        fputs("FRAME\n", capture->file);
+        fwrite(planes.data(), 1, planes.size(), capture->file);
+        {
+            std::lock_guard<std::mutex> guard(capture->lock);
+            capture->queueHead = (capture->queueHead + 1) % kCaptureQueueFrames;
+            capture->queueCount--;
+        }
+        capture->written++;
+    }
+}
+
+// Slot to fill with the next frame, or -1 if the queue is full. The slot
+// stays the render thread's until publishFrame(), as the writer only reads
+// queued slots.
+static int reserveSlot(FrameCapture& capture) {
+    std::lock_guard<std::mutex> guard(capture.lock);
+    if (capture.queueCount == kCaptureQueueFrames) return -1;
+    return (capture.queueHead + capture.queueCount) % kCaptureQueueFrames;
+}
+
+static void publishFrame(FrameCapture& capture) {
+    {
+        std::lock_guard<std::mutex> guard(capture.lock);
+        capture.queueCount++;
+    }
+    capture.queued.notify_one();
+}
+
+// Queue the frame held in pixel buffer index (mapping it; its read finished long ago)
+static void queuePixelBuffer(FrameCapture& capture, int index) {
+    capture.pending[index] = false;
+    int slot = reserveSlot(capture);
+    if (slot < 0) {
+        capture.dropped++;
+        return;
+    }
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pixelBuffers[index]);
+    const void* pixels = pglMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (pixels) {
+        memcpy(capture.slots[slot].data(), pixels, capture.slots[slot].size());
+        pglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        publishFrame(capture);
+    } else {
+        capture.dropped++;
+    }
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool captureStart(FrameCapture& capture, const char* path, int width, int height, int fps) {
+    if (capture.active) captureStop(capture);
+    capture.file = fopen(path, "wb");
+    if (!capture.file) return false;
+    fprintf(capture.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+
+    capture.width = width;
+    capture.height = height;
+    size_t frameSize = (size_t)width * height * 4;
+    for (int i = 0; i < kCaptureQueueFrames; i++) capture.slots[i].resize(frameSize);
+    capture.pixelBuffers[0] = capture.pixelBuffers[1] = 0;
+    if (glExtHasPixelBuffers) {
+        pglGenBuffers(2, capture.pixelBuffers);
+        for (int i = 0; i < 2; i++) {
+            pglBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pixelBuffers[i]);
+            pglBufferData(GL_PIXEL_PACK_BUFFER, frameSize, 0, GL_STREAM_READ);
+        }
+        pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    capture.readIndex = 0;
+    capture.pending[0] = capture.pending[1] = false;
+    capture.queueHead = capture.queueCount = 0;
+    capture.stopping = false;
+    capture.frames = 0;
+    capture.written = 0;
+    capture.dropped = 0;
+    capture.writer = std::thread(writerLoop, &capture);
+    capture.active = true;
+    return true;
+}
+
+void captureFrame(FrameCapture& capture, int width, int height) {
+    if (!capture.active) return;
+    capture.frames++;
+    if (width != capture.width || height != capture.height) {
+        capture.dropped++;
+        return;
+    }
+
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    if (capture.pixelBuffers[0]) {
+        // Start this frame's read, then pick up the previous one from the other buffer
+        int index = capture.readIndex;
+        pglBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pixelBuffers[index]);
+        glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+        pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        capture.pending[index] = true;
+        capture.readIndex = 1 - index;
+        if (capture.pending[1 - index]) queuePixelBuffer(capture, 1 - index);
+    } else {
+        int slot = reserveSlot(capture);
+        if (slot < 0) {
+            capture.dropped++;
+        } else {
+            glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, capture.slots[slot].data());
+            publishFrame(capture);
+        }
+    }
+    glPopClientAttrib();
+}
+
+void captureStop(FrameCapture& capture) {
+    if (!capture.active) return;
+    // The newest frame is still in its pixel buffer
+    if (capture.pixelBuffers[0]) {
+        int last = 1 - capture.readIndex;
+        if (capture.pending[last]) queuePixelBuffer(capture, last);
+        pglDeleteBuffers(2, capture.pixelBuffers);
+        capture.pixelBuffers[0] = capture.pixelBuffers[1] = 0;
+    }
+    {
+        std::lock_guard<std::mutex> guard(capture.lock);
+        capture.stopping = true;
+    }
+    capture.queued.notify_one();
+    capture.writer.join();
+    fclose(capture.file);
+    capture.file = 0;
+    capture.active = false;
+}
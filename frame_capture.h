@@ -0,0 +1,61 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glut.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records the rendered frames to a Y4M video file (YUV 4:2:0, readable by
+// ffmpeg, mpv and most players) without stalling rendering. Each frame is
+// read back into one of two pixel buffer objects; glReadPixels() into a
+// buffer returns at once, and the copy is mapped a frame later, when the
+// GPU has long finished it. The pixels go into a small fixed queue that a
+// writer thread converts to YUV and writes out. When the queue is full (the
+// disk or the conversion can't keep up) the frame is dropped and counted
+// rather than waited for. Without pixel buffers (OpenGL 2.1) the read back
+// is a plain synchronous glReadPixels().
+
+const int kCaptureQueueFrames = 4;   // Frames read back but not yet written
+
+struct FrameCapture {
+    bool active;
+    int width, height;               // Frame size, fixed for the whole recording
+    FILE* file;
+
+    // Read back: two pixel buffers used in turn, the one not written this
+    // frame holding the previous frame
+    GLuint pixelBuffers[2];
+    int readIndex;                   // Buffer the next frame is read into
+    bool pending[2];                 // Buffer holds a frame not yet queued
+
+    // Frames handed to the writer thread, a ring of preallocated BGRA images
+    std::vector<unsigned char> slots[kCaptureQueueFrames];
+    int queueHead, queueCount;       // Guarded by lock
+    std::mutex lock;
+    std::condition_variable queued;  // Writer waits here for frames
+    std::thread writer;
+    bool stopping;                   // Guarded by lock
+
+    // Accounting, since captureStart()
+    long frames;                     // Frames offered by captureFrame()
+    std::atomic<long> written;       // Written to the file by the writer thread
+    long dropped;                    // Lost to a full queue or a window of another size
+};
+
+// Open path and start recording frames of width x height at fps frames per
+// second (the rate written into the file header). Needs a current context
+// and glExtLoad(); returns false if the file can't be created.
+bool captureStart(FrameCapture& capture, const char* path, int width, int height, int fps);
+
+// Capture the frame just rendered (call before swapping buffers). Frames of
+// a different size than the recording are dropped.
+void captureFrame(FrameCapture& capture, int width, int height);
+
+// Queue the last read back frame, write everything queued and close the file
+void captureStop(FrameCapture& capture);
+
+#endif
@@ -0,0 +1,81 @@
+#include "frame_clock.h"
+#include <chrono>
+#include <cmath>
+#include <ctime>
+
+double monotonicSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void clockInit(FixedStepClock& clock, double tickHz, int maxTicks) {
+    clock.tickSeconds = 1.0 / tickHz;
+    clock.accumulator = 0.0;
+    clock.lastTime = -1.0;
+    clock.maxTicks = maxTicks;
+}
+
+int clockAdvance(FixedStepClock& clock, double now) {
+    if (clock.lastTime < 0.0) clock.lastTime = now;
+    clock.accumulator += now - clock.lastTime;
+    clock.lastTime = now;
+
+    int ticks = (int)(clock.accumulator / clock.tickSeconds);
+    if (ticks > clock.maxTicks) {
+        // Fell far behind (window dragged, debugger, ...): catch up partially
+        // instead of simulating every missed tick in one frame
+        ticks = clock.maxTicks;
+        clock.accumulator = ticks * clock.tickSeconds;
+    }
+    clock.accumulator -= ticks * clock.tickSeconds;
+    return ticks;
+}
+
+void clockSkip(FixedStepClock& clock, double now) {
+    clock.lastTime = now;
+}
+
+void rateMeterFrame(RateMeter& meter, int ticks, double now) {
+    double cpuNow = (double)std::clock() / CLOCKS_PER_SEC;
+    if (meter.windowStart <= 0.0) {
+        meter.windowStart = now;
+        meter.cpuStart = cpuNow;
+        meter.frames = 0;
+        meter.ticks = 0;
+        return;
+    }
+    meter.frames++;
+    meter.ticks += ticks;
+
+    double elapsed = now - meter.windowStart;
+    if (elapsed < 1.0) return;
+    meter.fps = (float)(meter.frames / elapsed);
+    meter.tickHz = (float)(meter.ticks / elapsed);
+    meter.cpuPercent = (float)(100.0 * (cpuNow - meter.cpuStart) / elapsed);
+    meter.windowStart = now;
+    meter.cpuStart = cpuNow;
+    meter.frames = 0;
+    meter.ticks = 0;
+}
+
+void idleMeterSleep(IdleMeter& meter, double now) {
+    meter.sleepStart = now;
+    meter.cpuStart = (double)std::clock() / CLOCKS_PER_SEC;
+}
+
+void idleMeterWake(IdleMeter& meter, double now) {
+    if (meter.sleepStart <= 0.0) return;
+    double cpuNow = (double)std::clock() / CLOCKS_PER_SEC;
+    double elapsed = now - meter.sleepStart;
+    meter.seconds = (float)elapsed;
+    meter.cpuPercent = elapsed > 0.0 ? (float)(100.0 * (cpuNow - meter.cpuStart) / elapsed) : 0.0f;
+    meter.sleepStart = 0.0;
+}
+
+int frameDelayMs(double& nextFrameTime, double renderHz, double now) {
+    if (renderHz <= 0.0) return 0;
+    double period = 1.0 / renderHz;
+    nextFrameTime += period;
+    if (nextFrameTime < now - period) nextFrameTime = now;  // Far behind: don't try to catch up
+    double delay = nextFrameTime - now;
+    return delay > 0.0 ? (int)floor(delay * 1000.0 + 0.5) : 0;
+}
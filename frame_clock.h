@@ -0,0 +1,58 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+// Fixed-step simulation clock. Real time from a monotonic clock builds up
+// and is consumed in whole physics ticks, so the fan advances at the same
+// rate whatever the render rate; the leftover (accumulator) tells when the
+// latest tick was due, so frames can interpolate the last two physics states.
+
+// Seconds from a monotonic clock (unaffected by wall-clock changes)
+double monotonicSeconds();
+
+struct FixedStepClock {
+    double tickSeconds;   // Length of one physics tick
+    double accumulator;   // Real time not yet simulated
+    double lastTime;      // Time of the last clockAdvance(), negative before the first
+    int maxTicks;         // Most ticks run per advance; time beyond that is dropped
+};
+
+void clockInit(FixedStepClock& clock, double tickHz, int maxTicks);
+
+// Account for real time up to now; returns how many ticks to simulate
+int clockAdvance(FixedStepClock& clock, double now);
+
+// Drop the real time since the last advance (a pause with nothing moving),
+// so resuming doesn't fast-forward the simulation
+void clockSkip(FixedStepClock& clock, double now);
+
+// Render rate, physics rate and process CPU use, averaged over about a second
+struct RateMeter {
+    double windowStart;   // Monotonic time the current window began, 0 before the first frame
+    double cpuStart;      // Process CPU seconds at windowStart
+    int frames;           // Frames and ticks counted in the current window
+    int ticks;
+    float fps;            // Results of the last complete window
+    float tickHz;
+    float cpuPercent;     // Of one core; can exceed 100 with worker threads
+};
+
+// Count one rendered frame that ran the given number of physics ticks
+void rateMeterFrame(RateMeter& meter, int ticks, double now);
+
+// Process CPU use while frames are not being scheduled (waiting for input)
+struct IdleMeter {
+    double sleepStart;    // Monotonic time the current pause began, 0 while animating
+    double cpuStart;      // Process CPU seconds at sleepStart
+    float seconds;        // Length of the last finished pause
+    float cpuPercent;     // CPU use during it, percent of one core
+};
+
+// Mark the start and end of a pause; waking records its length and CPU use
+void idleMeterSleep(IdleMeter& meter, double now);
+void idleMeterWake(IdleMeter& meter, double now);
+
+// Time until the next frame for a render rate (0 = uncapped); frames are
+// scheduled from a fixed start time so timer rounding does not accumulate
+int frameDelayMs(double& nextFrameTime, double renderHz, double now);
+
+#endif
@@ -0,0 +1,121 @@
+#include "gl_ext.h"
+#include <GL/freeglut_ext.h>
+#include <cstdio>
+
+PFNGLGENBUFFERSPROC pglGenBuffers = 0;
+PFNGLDELETEBUFFERSPROC pglDeleteBuffers = 0;
+PFNGLBINDBUFFERPROC pglBindBuffer = 0;
+PFNGLBUFFERDATAPROC pglBufferData = 0;
+PFNGLBUFFERSUBDATAPROC pglBufferSubData = 0;
+bool glExtHasBuffers = false;
+PFNGLBUFFERSTORAGEPROC pglBufferStorage = 0;
+PFNGLMAPBUFFERRANGEPROC pglMapBufferRange = 0;
+PFNGLFENCESYNCPROC pglFenceSync = 0;
+PFNGLCLIENTWAITSYNCPROC pglClientWaitSync = 0;
+PFNGLDELETESYNCPROC pglDeleteSync = 0;
+bool glExtHasBufferStorage = false;
+bool glExtHasNpotTextures = false;
+PFNGLMAPBUFFERPROC pglMapBuffer = 0;
+PFNGLUNMAPBUFFERPROC pglUnmapBuffer = 0;
+bool glExtHasPixelBuffers = false;
+PFNGLGENQUERIESPROC pglGenQueries = 0;
+PFNGLDELETEQUERIESPROC pglDeleteQueries = 0;
+PFNGLQUERYCOUNTERPROC pglQueryCounter = 0;
+PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv = 0;
+PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v = 0;
+bool glExtHasTimerQuery = false;
+PFNGLCREATESHADERPROC pglCreateShader = 0;
+PFNGLSHADERSOURCEPROC pglShaderSource = 0;
+PFNGLCOMPILESHADERPROC pglCompileShader = 0;
+PFNGLGETSHADERIVPROC pglGetShaderiv = 0;
+PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog = 0;
+PFNGLCREATEPROGRAMPROC pglCreateProgram = 0;
+PFNGLATTACHSHADERPROC pglAttachShader = 0;
+PFNGLLINKPROGRAMPROC pglLinkProgram = 0;
+PFNGLGETPROGRAMIVPROC pglGetProgramiv = 0;
+PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog = 0;
+PFNGLUSEPROGRAMPROC pglUseProgram = 0;
+PFNGLGETATTRIBLOCATIONPROC pglGetAttribLocation = 0;
+PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation = 0;
+PFNGLUNIFORM1FPROC pglUniform1f = 0;
+PFNGLUNIFORM3FPROC pglUniform3f = 0;
+PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray = 0;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray = 0;
+PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer = 0;
+PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor = 0;
+PFNGLDRAWELEMENTSINSTANCEDPROC pglDrawElementsInstanced = 0;
+bool glExtHasInstancing = false;
+
+static void* glutResolver(const char* name) {
+    return (void*)glutGetProcAddress(name);
+}
+
+// Resolvers may hand out addresses for functions the driver cannot run,
+// so each group is also gated on the context version
+static bool versionAtLeast(int major, int minor) {
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int haveMajor = 0, haveMinor = 0;
+    if (!version || sscanf(version, "%d.%d", &haveMajor, &haveMinor) != 2) return false;
+    return haveMajor > major || (haveMajor == major && haveMinor >= minor);
+}
+
+void glExtLoad(GLProcResolver resolve) {
+    if (!resolve) resolve = glutResolver;
+
+    pglGenBuffers = (PFNGLGENBUFFERSPROC)resolve("glGenBuffers");
+    pglDeleteBuffers = (PFNGLDELETEBUFFERSPROC)resolve("glDeleteBuffers");
+    pglBindBuffer = (PFNGLBINDBUFFERPROC)resolve("glBindBuffer");
+    pglBufferData = (PFNGLBUFFERDATAPROC)resolve("glBufferData");
+    pglBufferSubData = (PFNGLBUFFERSUBDATAPROC)resolve("glBufferSubData");
+    glExtHasBuffers = versionAtLeast(1, 5) && pglGenBuffers && pglDeleteBuffers && pglBindBuffer && pglBufferData &&
+                      pglBufferSubData;
+
+    pglBufferStorage = (PFNGLBUFFERSTORAGEPROC)resolve("glBufferStorage");
+    pglMapBufferRange = (PFNGLMAPBUFFERRANGEPROC)resolve("glMapBufferRange");
+    pglFenceSync = (PFNGLFENCESYNCPROC)resolve("glFenceSync");
+    pglClientWaitSync = (PFNGLCLIENTWAITSYNCPROC)resolve("glClientWaitSync");
+    pglDeleteSync = (PFNGLDELETESYNCPROC)resolve("glDeleteSync");
+    glExtHasBufferStorage = versionAtLeast(4, 4) && glExtHasBuffers && pglBufferStorage && pglMapBufferRange &&
+                            pglFenceSync && pglClientWaitSync && pglDeleteSync;
+
+    glExtHasNpotTextures = versionAtLeast(2, 0);
+
+    pglMapBuffer = (PFNGLMAPBUFFERPROC)resolve("glMapBuffer");
+    pglUnmapBuffer = (PFNGLUNMAPBUFFERPROC)resolve("glUnmapBuffer");
+    glExtHasPixelBuffers = versionAtLeast(2, 1) && glExtHasBuffers && pglMapBuffer && pglUnmapBuffer;
+
+    pglGenQueries = (PFNGLGENQUERIESPROC)resolve("glGenQueries");
+    pglDeleteQueries = (PFNGLDELETEQUERIESPROC)resolve("glDeleteQueries");
+    pglQueryCounter = (PFNGLQUERYCOUNTERPROC)resolve("glQueryCounter");
+    pglGetQueryObjectiv = (PFNGLGETQUERYOBJECTIVPROC)resolve("glGetQueryObjectiv");
+    pglGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)resolve("glGetQueryObjectui64v");
+    glExtHasTimerQuery = versionAtLeast(3, 3) && pglGenQueries && pglDeleteQueries && pglQueryCounter &&
+                         pglGetQueryObjectiv && pglGetQueryObjectui64v;
+
+    pglCreateShader = (PFNGLCREATESHADERPROC)resolve("glCreateShader");
+    pglShaderSource = (PFNGLSHADERSOURCEPROC)resolve("glShaderSource");
+    pglCompileShader = (PFNGLCOMPILESHADERPROC)resolve("glCompileShader");
+    pglGetShaderiv = (PFNGLGETSHADERIVPROC)resolve("glGetShaderiv");
+    pglGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)resolve("glGetShaderInfoLog");
+    pglCreateProgram = (PFNGLCREATEPROGRAMPROC)resolve("glCreateProgram");
+    pglAttachShader = (PFNGLATTACHSHADERPROC)resolve("glAttachShader");
+    pglLinkProgram = (PFNGLLINKPROGRAMPROC)resolve("glLinkProgram");
+    pglGetProgramiv = (PFNGLGETPROGRAMIVPROC)resolve("glGetProgramiv");
+    pglGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)resolve("glGetProgramInfoLog");
+    pglUseProgram = (PFNGLUSEPROGRAMPROC)resolve("glUseProgram");
+    pglGetAttribLocation = (PFNGLGETATTRIBLOCATIONPROC)resolve("glGetAttribLocation");
+    pglGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)resolve("glGetUniformLocation");
+    pglUniform1f = (PFNGLUNIFORM1FPROC)resolve("glUniform1f");
+    pglUniform3f = (PFNGLUNIFORM3FPROC)resolve("glUniform3f");
+    pglEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)resolve("glEnableVertexAttribArray");
+    pglDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)resolve("glDisableVertexAttribArray");
+    pglVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)resolve("glVertexAttribPointer");
+    pglVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)resolve("glVertexAttribDivisor");
+    pglDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)resolve("glDrawElementsInstanced");
+    glExtHasInstancing = versionAtLeast(3, 3) && glExtHasBuffers && pglCreateShader && pglShaderSource &&
+                         pglCompileShader && pglGetShaderiv && pglGetShaderInfoLog && pglCreateProgram &&
+                         pglAttachShader && pglLinkProgram && pglGetProgramiv && pglGetProgramInfoLog &&
+                         pglUseProgram && pglGetAttribLocation && pglGetUniformLocation && pglUniform1f &&
+                         pglUniform3f && pglEnableVertexAttribArray && pglDisableVertexAttribArray &&
+                         pglVertexAttribPointer && pglVertexAttribDivisor && pglDrawElementsInstanced;
+}
@@ -0,0 +1,73 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+// Entry points beyond OpenGL 1.1, loaded at run time so the programs still
+// start (and fall back to older paths) on drivers that lack them.
+// Call glExtLoad() once a GL context is current.
+
+#include <GL/glut.h>
+#include <GL/glext.h>
+
+// Returns the address of a GL function, or null (glutGetProcAddress, eglGetProcAddress, ...)
+typedef void* (*GLProcResolver)(const char* name);
+
+// Resolve every entry point below; with no resolver, GLUT's is used
+void glExtLoad(GLProcResolver resolve = 0);
+
+// Buffer objects (OpenGL 1.5)
+extern PFNGLGENBUFFERSPROC pglGenBuffers;
+extern PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+extern PFNGLBINDBUFFERPROC pglBindBuffer;
+extern PFNGLBUFFERDATAPROC pglBufferData;
+extern PFNGLBUFFERSUBDATAPROC pglBufferSubData;
+extern bool glExtHasBuffers;
+
+// Persistently mapped buffers and fences (OpenGL 4.4 / ARB_buffer_storage)
+extern PFNGLBUFFERSTORAGEPROC pglBufferStorage;
+extern PFNGLMAPBUFFERRANGEPROC pglMapBufferRange;
+extern PFNGLFENCESYNCPROC pglFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC pglClientWaitSync;
+extern PFNGLDELETESYNCPROC pglDeleteSync;
+extern bool glExtHasBufferStorage;
+
+// Textures of any size, not just powers of two (OpenGL 2.0)
+extern bool glExtHasNpotTextures;
+
+// Mapping buffers, and reading pixels into them (pixel buffer objects, OpenGL 2.1)
+extern PFNGLMAPBUFFERPROC pglMapBuffer;
+extern PFNGLUNMAPBUFFERPROC pglUnmapBuffer;
+extern bool glExtHasPixelBuffers;
+
+// Timestamp queries (OpenGL 3.3 / ARB_timer_query)
+extern PFNGLGENQUERIESPROC pglGenQueries;
+extern PFNGLDELETEQUERIESPROC pglDeleteQueries;
+extern PFNGLQUERYCOUNTERPROC pglQueryCounter;
+extern PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v;
+extern bool glExtHasTimerQuery;
+
+// GLSL programs and instanced drawing with per-instance attributes
+// (OpenGL 3.3 / ARB_instanced_arrays)
+extern PFNGLCREATESHADERPROC pglCreateShader;
+extern PFNGLSHADERSOURCEPROC pglShaderSource;
+extern PFNGLCOMPILESHADERPROC pglCompileShader;
+extern PFNGLGETSHADERIVPROC pglGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog;
+extern PFNGLCREATEPROGRAMPROC pglCreateProgram;
+extern PFNGLATTACHSHADERPROC pglAttachShader;
+extern PFNGLLINKPROGRAMPROC pglLinkProgram;
+extern PFNGLGETPROGRAMIVPROC pglGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog;
+extern PFNGLUSEPROGRAMPROC pglUseProgram;
+extern PFNGLGETATTRIBLOCATIONPROC pglGetAttribLocation;
+extern PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation;
+extern PFNGLUNIFORM1FPROC pglUniform1f;
+extern PFNGLUNIFORM3FPROC pglUniform3f;
+extern PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray;
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray;
+extern PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer;
+extern PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor;
+extern PFNGLDRAWELEMENTSINSTANCEDPROC pglDrawElementsInstanced;
+extern bool glExtHasInstancing;
+
+#endif
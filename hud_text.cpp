@@ -0,0 +1,251 @@
+#include "hud_text.h"
+#include "frame_arena.h"
+#include "soft_backend.h"
+#include <GL/freeglut_ext.h>
+#include <cmath>
+#include <cstring>
+
+const int kFirstGlyph = 32;   // Space
+const int kLastGlyph = 126;   // Tilde
+const int kAtlasWidth = 512;
+const int kLineReserve = 128;  // Characters a new line slot has room for
+
+// Where each font's glyphs live in the atlas
+struct FontAtlas {
+    int cellWidth, cellHeight;
+    int baseline;                      // Raster y inside a cell when it was rasterized
+    int advance[kLastGlyph + 1];
+    int cellX[kLastGlyph + 1], cellY[kLastGlyph + 1];
+    bool visible[kLastGlyph + 1];      // False for glyphs with no lit pixels
+};
+
+static FontAtlas fonts[TEXT_FONT_COUNT];
+static GLuint atlasTexture = 0;
+static int atlasHeight = 0;
+static std::vector<unsigned char> atlasPixels;   // The texture's contents, for the software backend
+static RasterTexture atlasImage = {0, 0, 0};
+
+static void* glutFonts[TEXT_FONT_COUNT] = {GLUT_BITMAP_HELVETICA_10, GLUT_BITMAP_HELVETICA_12, GLUT_BITMAP_HELVETICA_18};
+
+static int glutHeight(TextFont font) { return glutBitmapHeight(glutFonts[font]); }
+static int glutWidth(TextFont font, int c) { return glutBitmapWidth(glutFonts[font], c); }
+static void glutDraw(TextFont font, int c) { glutBitmapCharacter(glutFonts[font], c); }
+static const TextGlyphSource glutGlyphs = {glutHeight, glutWidth, glutDraw};
+
+static int nextPowerOfTwo(int n) {
+    int p = 1;
+    while (p < n) p *= 2;
+    return p;
+}
+
+// Measure the fonts and assign every glyph a cell; each font starts a new row
+static void layoutAtlas(const TextGlyphSource& source) {
+    int y = 0;
+    for (int f = 0; f < TEXT_FONT_COUNT; f++) {
+        FontAtlas& font = fonts[f];
+        int height = source.height((TextFont)f);
+        int widest = 0;
+        for (int c = kFirstGlyph; c <= kLastGlyph; c++) {
+            font.advance[c] = source.width((TextFont)f, c);
+            if (font.advance[c] > widest) widest = font.advance[c];
+        }
+        // Room for a pixel of overhang on the left and for descenders below
+        // the baseline (GLUT bitmaps are offset by their x/y origin)
+        font.baseline = height / 2 + 1;
+        font.cellWidth = widest + 3;
+        font.cellHeight = font.baseline + height;
+
+        int x = 0;
+        for (int c = kFirstGlyph; c <= kLastGlyph; c++) {
+            if (x + font.cellWidth > kAtlasWidth) {
+                x = 0;
+                y += font.cellHeight;
+            }
+            font.cellX[c] = x;
+            font.cellY[c] = y;
+            x += font.cellWidth;
+        }
+        y += font.cellHeight;
+    }
+    atlasHeight = nextPowerOfTwo(y);
+}
+
+void textInit(const TextGlyphSource* source) {
+    if (atlasTexture) return;
+    if (!source) source = &glutGlyphs;
+    layoutAtlas(*source);
+    atlasPixels.assign(kAtlasWidth * atlasHeight, 0);
+    std::vector<unsigned char>& atlas = atlasPixels;
+    std::vector<unsigned char> cell;
+
+    glPushAttrib(GL_ALL_ATTRIB_BITS);
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+    glEnable(GL_SCISSOR_TEST);
+    glDrawBuffer(GL_BACK);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // Draw each glyph into the corner of the back buffer with the source
+    // itself and read it back, so the atlas holds exactly what it would draw
+    for (int f = 0; f < TEXT_FONT_COUNT; f++) {
+        FontAtlas& font = fonts[f];
+        cell.resize(font.cellWidth * font.cellHeight);
+        glViewport(0, 0, font.cellWidth, font.cellHeight);
+        glScissor(0, 0, font.cellWidth, font.cellHeight);
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        gluOrtho2D(0, font.cellWidth, 0, font.cellHeight);
+        glMatrixMode(GL_MODELVIEW);
+
+        for (int c = kFirstGlyph; c <= kLastGlyph; c++) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            glColor3f(1.0f, 1.0f, 1.0f);
+            glRasterPos2i(1, font.baseline);
+            source->draw((TextFont)f, c);
+            glReadPixels(0, 0, font.cellWidth, font.cellHeight, GL_RED, GL_UNSIGNED_BYTE, cell.data());
+
+            font.visible[c] = false;
+            for (int row = 0; row < font.cellHeight; row++) {
+                for (int col = 0; col < font.cellWidth; col++) {
+                    unsigned char lit = cell[row * font.cellWidth + col] > 127 ? 255 : 0;
+                    atlas[(font.cellY[c] + row) * kAtlasWidth + font.cellX[c] + col] = lit;
+                    if (lit) font.visible[c] = true;
+                }
+            }
+        }
+    }
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopClientAttrib();
+    glPopAttrib();
+
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &atlasTexture);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, kAtlasWidth, atlasHeight, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopClientAttrib();
+    atlasImage.alpha = atlasPixels.data();
+    atlasImage.width = kAtlasWidth;
+    atlasImage.height = atlasHeight;
+}
+
+static_assert(sizeof(TextVertex) == 24, "TextVertex must match the GL_T2F_C4UB_V3F layout");
+
+static void addVertex(TextLine& line, float s, float t, float x, float y) {
+    TextVertex v = {s, t, {line.rgba[0], line.rgba[1], line.rgba[2], line.rgba[3]}, x, y, 0.0f};
+    line.quads.push_back(v);
+}
+
+// Lay out the quads for one string, advancing like glutBitmapCharacter
+static void buildQuads(TextLine& line) {
+    const FontAtlas& font = fonts[line.font];
+    line.quads.clear();
+    float penX = floorf(line.x) - 1.0f;           // Cell origin relative to the raster position
+    float penY = floorf(line.y) - font.baseline;
+    for (const char* p = line.text.data(); *p; p++) {
+        int c = (unsigned char)*p;
+        if (c < kFirstGlyph || c > kLastGlyph) continue;
+        if (font.visible[c]) {
+            float s0 = (float)font.cellX[c] / kAtlasWidth;
+            float t0 = (float)font.cellY[c] / atlasHeight;
+            float s1 = (float)(font.cellX[c] + font.cellWidth) / kAtlasWidth;
+            float t1 = (float)(font.cellY[c] + font.cellHeight) / atlasHeight;
+            float x1 = penX + font.cellWidth, y1 = penY + font.cellHeight;
+            addVertex(line, s0, t0, penX, penY);
+            addVertex(line, s1, t0, x1, penY);
+            addVertex(line, s1, t1, x1, y1);
+            addVertex(line, s0, t1, penX, y1);
+        }
+        penX += font.advance[c];
+    }
+}
+
+void textAdd(TextBatch& batch, TextFont font, float x, float y, const char* text,
+             float r, float g, float b) {
+    if (!atlasTexture) return;  // Quads need the atlas layout
+    if (batch.lineCount == (int)batch.lines.size()) {
+        // Room for a typical status line up front, so text changing length
+        // from frame to frame doesn't reallocate
+        batch.lines.push_back(TextLine());
+        batch.lines.back().text.reserve(kLineReserve);
+        batch.lines.back().quads.reserve(kLineReserve * 4);
+    }
+    TextLine& line = batch.lines[batch.lineCount++];
+
+    unsigned char rgba[4] = {(unsigned char)(r * 255.0f + 0.5f), (unsigned char)(g * 255.0f + 0.5f),
+                             (unsigned char)(b * 255.0f + 0.5f), 255};
+    bool unchanged = !line.text.empty() && line.font == font && line.x == x && line.y == y &&
+                     memcmp(line.rgba, rgba, 4) == 0 && strcmp(line.text.data(), text) == 0;
+    if (unchanged) return;
+
+    line.font = font;
+    line.x = x;
+    line.y = y;
+    memcpy(line.rgba, rgba, 4);
+    line.text.assign(text, text + strlen(text) + 1);
+    buildQuads(line);
+    batch.rebuiltLines++;
+}
+
+void textDraw(TextBatch& batch) {
+    int lineCount = batch.lineCount;
+    batch.drawnLines = lineCount;
+    batch.drawnRebuilt = batch.rebuiltLines;
+    batch.lineCount = 0;
+    batch.rebuiltLines = 0;
+    if (!atlasTexture) return;
+
+    size_t vertexCount = 0;
+    for (int i = 0; i < lineCount; i++) vertexCount += batch.lines[i].quads.size();
+    if (vertexCount == 0) return;
+    TextVertex* vertices = arenaArray<TextVertex>(frameArena, vertexCount);
+    TextVertex* next = vertices;
+    for (int i = 0; i < lineCount; i++) {
+        const std::vector<TextVertex>& quads = batch.lines[i].quads;
+        if (!quads.empty()) memcpy(next, quads.data(), quads.size() * sizeof(TextVertex));
+        next += quads.size();
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glEnable(GL_ALPHA_TEST);                   // Glyph pixels are fully on or off
+    glAlphaFunc(GL_GREATER, 0.5f);
+    if (softBackend) {
+        RasterArrays arrays = {};
+        arrays.position = &vertices[0].x;
+        arrays.positionSize = 3;
+        arrays.positionStride = sizeof(TextVertex);
+        arrays.rgba = vertices[0].rgba;
+        arrays.rgbaStride = sizeof(TextVertex);
+        arrays.texCoord = &vertices[0].s;
+        arrays.texCoordStride = sizeof(TextVertex);
+        softBackendDraw(GL_QUADS, arrays, (int)vertexCount, 0, 0, &atlasImage);
+    } else {
+        glInterleavedArrays(GL_T2F_C4UB_V3F, 0, vertices);
+        glDrawArrays(GL_QUADS, 0, (GLsizei)vertexCount);
+    }
+    glPopClientAttrib();
+    glPopAttrib();
+}
@@ -0,0 +1,60 @@
+#ifndef HUD_TEXT_H
+#define HUD_TEXT_H
+
+#include <GL/glut.h>
+#include <vector>
+
+// Batched HUD text. The GLUT bitmap fonts are rasterized once into an alpha
+// texture atlas; strings are then drawn as textured quads, all of a frame's
+// text in one glDrawArrays() instead of a glRasterPos/glutBitmapCharacter
+// call per character. Output matches glutBitmapCharacter pixel for pixel
+// when the projection maps one unit to one pixel.
+
+enum TextFont { TEXT_HELVETICA_10, TEXT_HELVETICA_12, TEXT_HELVETICA_18, TEXT_FONT_COUNT };
+
+// Vertex layout for glInterleavedArrays(GL_T2F_C4UB_V3F)
+struct TextVertex {
+    float s, t;
+    unsigned char rgba[4];
+    float x, y, z;
+};
+
+// One string queued for drawing, kept between frames so an unchanged
+// string (same font, position, color and text) reuses its quads
+struct TextLine {
+    TextFont font;
+    float x, y;                       // Raster position, as for glRasterPos2f
+    unsigned char rgba[4];
+    std::vector<char> text;           // Zero-terminated
+    std::vector<TextVertex> quads;    // Four vertices per visible character
+};
+
+struct TextBatch {
+    std::vector<TextLine> lines;      // Slot i holds the i-th textAdd() of a frame
+    int lineCount;                    // Slots used this frame
+    int rebuiltLines;                 // Lines regenerated since the last textDraw()
+    int drawnLines, drawnRebuilt;     // Line and regenerated-line counts of the last drawn frame
+};
+
+// Where glyph shapes come from when building the atlas
+struct TextGlyphSource {
+    int (*height)(TextFont font);         // Line height, as glutBitmapHeight()
+    int (*width)(TextFont font, int c);   // Advance, as glutBitmapWidth()
+    void (*draw)(TextFont font, int c);   // Draw at the raster position, as glutBitmapCharacter()
+};
+
+// Rasterize the fonts into the atlas; with no source, GLUT's bitmap fonts
+// are used. Needs a current GL context with a visible window; draws into
+// the back buffer, so call it at the start of a frame (before glClear).
+// Later calls do nothing.
+void textInit(const TextGlyphSource* source = 0);
+
+// Queue a string at raster position (x, y) in the given color
+void textAdd(TextBatch& batch, TextFont font, float x, float y, const char* text,
+             float r, float g, float b);
+
+// Draw every queued string with the current transform, then start a new
+// frame. The quads of every line are gathered in frameArena for one draw.
+void textDraw(TextBatch& batch);
+
+#endif
@@ -0,0 +1,191 @@
+#include "input_log.h"
+#include <GL/glut.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct InputLogHeader {
+    char magic[4];                       // "FANI"
+    uint16_t version;
+    uint16_t tickHz;
+    uint16_t width, height;
+    uint32_t ticks;                      // Filled in when recording finishes
+};
+
+static_assert(sizeof(InputLogHeader) == 16, "log header must stay 16 bytes");
+static_assert(sizeof(InputEvent) == 12, "log events must stay 12 bytes");
+
+static const uint16_t kInputLogVersion = 1;
+
+// GLUT callbacks carry no user data, so the recording is a single global
+static FILE* recordFile = 0;
+static InputHandlers recordHandlers;
+static const CommandQueue* recordCommands = 0;
+static InputLogHeader recordHeader;
+static unsigned long recordTicks = 0;     // Ticks run, as of the last inputRecordApplied()
+
+// Events handled but not yet logged, from the GLUT thread to the simulation
+// thread: a single-producer/single-consumer ring like the command queue's.
+// Each event keeps the number of commands pushed before it; once the
+// simulation has applied more than that, the event has taken effect.
+const int kPendingEvents = 1024;          // A power of two
+struct PendingEvent {
+    InputEvent event;
+    unsigned commandsBefore;
+};
+static PendingEvent pendingEvents[kPendingEvents];
+static std::atomic<unsigned> pendingHead(0), pendingTail(0);
+static long unloggedEvents = 0;           // Events lost to a full ring (GLUT thread)
+
+// Queue an event for the log before its handler pushes any command (GLUT thread)
+static void recordEvent(InputEventType type, int code, int state, int x, int y) {
+    unsigned tail = pendingTail.load(std::memory_order_relaxed);
+    if (tail - pendingHead.load(std::memory_order_acquire) == (unsigned)kPendingEvents) {
+        unloggedEvents++;
+        return;
+    }
+    PendingEvent& pending = pendingEvents[tail & (kPendingEvents - 1)];
+    pending.event.type = (uint8_t)type;
+    pending.event.code = (uint8_t)code;
+    pending.event.state = (uint8_t)state;
+    pending.event.unused = 0;
+    pending.event.x = (int16_t)x;
+    pending.event.y = (int16_t)y;
+    pending.commandsBefore = commandsPushed(*recordCommands);
+    pendingTail.store(tail + 1, std::memory_order_release);  // Before the handler's commands
+}
+
+// Write the queued events that came before command number applied, stamped with tick
+static void writeEvents(unsigned applied, unsigned long tick) {
+    unsigned head = pendingHead.load(std::memory_order_relaxed);
+    unsigned tail = pendingTail.load(std::memory_order_acquire);
+    for (; head != tail; head++) {
+        PendingEvent& pending = pendingEvents[head & (kPendingEvents - 1)];
+        if ((int)(applied - pending.commandsBefore) <= 0) break;  // Not in effect yet
+        pending.event.tick = (uint32_t)tick;
+        fwrite(&pending.event, sizeof(pending.event), 1, recordFile);
+    }
+    pendingHead.store(head, std::memory_order_release);
+}
+
+void inputRecordApplied(unsigned long tick) {
+    if (!recordFile) return;
+    writeEvents(commandsPopped(*recordCommands), tick);
+    recordTicks = tick + 1;
+}
+
+static void recordKeyboard(unsigned char key, int x, int y) {
+    recordEvent(INPUT_KEYBOARD, key, 0, x, y);
+    recordHandlers.keyboard(key, x, y);
+}
+
+static void recordMouse(int button, int state, int x, int y) {
+    recordEvent(INPUT_MOUSE, button, state, x, y);
+    recordHandlers.mouse(button, state, x, y);
+}
+
+static void recordMotion(int x, int y) {
+    recordEvent(INPUT_MOTION, 0, 0, x, y);
+    recordHandlers.motion(x, y);
+}
+
+static void recordReshape(int width, int height) {
+    recordEvent(INPUT_RESHAPE, 0, 0, width, height);
+    recordHandlers.reshape(width, height);
+}
+
+// At exit, once the simulation has stopped: log the events still queued at
+// the session's end, store its length in the header and close the log
+static void finishRecording() {
+    if (!recordFile) return;
+    writeEvents(commandsPushed(*recordCommands) + 1, recordTicks);
+    if (unloggedEvents > 0) fprintf(stderr, "input log: %ld events not recorded (queue full)\n", unloggedEvents);
+    recordHeader.ticks = (uint32_t)recordTicks;
+    fseek(recordFile, 0, SEEK_SET);
+    fwrite(&recordHeader, sizeof(recordHeader), 1, recordFile);
+    fclose(recordFile);
+    recordFile = 0;
+}
+
+const char* inputRecordArgument(int& argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--record") != 0) continue;
+        const char* path = argv[i + 1];
+        for (int j = i; j + 2 <= argc; j++) argv[j] = argv[j + 2];  // Including the null at argv[argc]
+        argc -= 2;
+        return path;
+    }
+    return 0;
+}
+
+bool inputRecordStart(const char* path, const InputHandlers& handlers, const CommandQueue& commands,
+                      int width, int height, float tickHz) {
+    recordFile = fopen(path, "wb");
+    if (!recordFile) return false;
+    memcpy(recordHeader.magic, "FANI", 4);
+    recordHeader.version = kInputLogVersion;
+    recordHeader.tickHz = (uint16_t)tickHz;
+    recordHeader.width = (uint16_t)width;
+    recordHeader.height = (uint16_t)height;
+    recordHeader.ticks = 0;
+    fwrite(&recordHeader, sizeof(recordHeader), 1, recordFile);
+
+    recordHandlers = handlers;
+    recordCommands = &commands;
+    glutKeyboardFunc(recordKeyboard);
+    glutMouseFunc(recordMouse);
+    if (handlers.motion) glutMotionFunc(recordMotion);
+    glutReshapeFunc(recordReshape);
+    atexit(finishRecording);
+    return true;
+}
+
+bool inputLogLoad(InputLog& log, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    InputLogHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "FANI", 4) != 0 ||
+        header.version != kInputLogVersion) {
+        fclose(file);
+        return false;
+    }
+    log.width = header.width;
+    log.height = header.height;
+    log.tickHz = header.tickHz;
+    log.ticks = header.ticks;
+    log.events.clear();
+    InputEvent event;
+    while (fread(&event, sizeof(event), 1, file) == 1) log.events.push_back(event);
+    fclose(file);
+
+    // A session that didn't exit normally has no length: it lasted until its last event
+    if (log.ticks == 0 && !log.events.empty()) log.ticks = log.events.back().tick;
+    log.next = 0;
+    return true;
+}
+
+int inputLogReplay(InputLog& log, unsigned long tick, const InputHandlers& handlers) {
+    int delivered = 0;
+    while (log.next < log.events.size() && log.events[log.next].tick <= tick) {
+        const InputEvent& event = log.events[log.next++];
+        switch (event.type) {
+            case INPUT_KEYBOARD: handlers.keyboard(event.code, event.x, event.y); break;
+            case INPUT_MOUSE: handlers.mouse(event.code, event.state, event.x, event.y); break;
+            case INPUT_MOTION: if (handlers.motion) handlers.motion(event.x, event.y); break;
+            case INPUT_RESHAPE: handlers.reshape(event.x, event.y); break;
+        }
+        delivered++;
+    }
+    return delivered;
+}
+
+void inputLogMaxSize(const InputLog& log, int& width, int& height) {
+    width = log.width;
+    height = log.height;
+    for (const InputEvent& event : log.events) {
+        if (event.type != INPUT_RESHAPE) continue;
+        if (event.x > width) width = event.x;
+        if (event.y > height) height = event.y;
+    }
+}
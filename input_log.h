@@ -0,0 +1,79 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "command_queue.h"
+
+// Input recording and replay, for reproducible performance runs. While
+// recording, every keyboard, mouse, drag and window-size event is written to
+// a binary log stamped with the number of physics ticks run before the tick
+// that applied the input commands it queued (command_queue.h). The GLUT
+// thread queues each event for the log before handling it; the simulation
+// thread writes it out once it applies a command queued at or after the
+// event, so the stamp is the tick the event took effect on, whichever
+// thread the simulation runs on. Events that queue no commands and are
+// followed by none (a resize, a HUD key) are written at exit. Replay
+// feeds the events back into the same handlers before the tick they
+// preceded, so a headless run (render_bench) goes through exactly the same
+// simulation states as the recorded session, one frame per tick. Pauses
+// (no ticks while nothing moves) replay as events sharing one tick.
+//
+// File layout (host byte order): a 16-byte header, then 12 bytes per event.
+
+// The program's input callbacks, as registered with GLUT
+struct InputHandlers {
+    void (*keyboard)(unsigned char key, int x, int y);
+    void (*mouse)(int button, int state, int x, int y);
+    void (*motion)(int x, int y);        // Drag with a button held; null if the program has none
+    void (*reshape)(int width, int height);
+};
+
+enum InputEventType { INPUT_KEYBOARD, INPUT_MOUSE, INPUT_MOTION, INPUT_RESHAPE };
+
+struct InputEvent {
+    uint32_t tick;                       // Physics ticks run before the event
+    uint8_t type;                        // InputEventType
+    uint8_t code;                        // Key, or mouse button
+    uint8_t state;                       // Mouse button state
+    uint8_t unused;
+    int16_t x, y;                        // Pointer position, or window size for INPUT_RESHAPE
+};
+
+struct InputLog {
+    int width, height;                   // Window size when recording started
+    float tickHz;                        // Physics rate of the recording
+    uint32_t ticks;                      // Ticks the session lasted
+    std::vector<InputEvent> events;
+    size_t next;                         // Next event to replay
+};
+
+// Take "--record <file>" out of the command line (after glutInit()); null if absent
+const char* inputRecordArgument(int& argc, char** argv);
+
+// Record to path from now until exit: registers GLUT callbacks that queue
+// each event for the log, then pass it on to handlers, which push their
+// commands onto commands. Call after the program's own callbacks are
+// registered and before the simulation starts; returns false if the file
+// can't be written.
+bool inputRecordStart(const char* path, const InputHandlers& handlers, const CommandQueue& commands,
+                      int width, int height, float tickHz);
+
+// Log the events whose commands the simulation has applied so far, stamped
+// with tick, the ticks run before the current one (simulation thread, after
+// popping the tick's commands; does nothing unless recording)
+void inputRecordApplied(unsigned long tick);
+
+// Read a recorded log and rewind it; returns false if it is missing or not a log
+bool inputLogLoad(InputLog& log, const char* path);
+
+// Deliver, in order, every event not yet replayed that was recorded after at
+// most tick ticks; call with the ticks run so far before running the next
+// one. Returns the number of events delivered.
+int inputLogReplay(InputLog& log, unsigned long tick, const InputHandlers& handlers);
+
+// Largest window size in the log (its starting size or any resize)
+void inputLogMaxSize(const InputLog& log, int& width, int& height);
+
+#endif
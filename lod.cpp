@@ -0,0 +1,47 @@
+#include "lod.h"
+#include <GL/gl.h>
+#include <cmath>
+
+void lodSetView(LodView& view, double fovY, double aspect, double zNear, double zFar, int viewportHeight) {
+    glGetFloatv(GL_MODELVIEW_MATRIX, view.camera);
+    view.tanHalfFovY = (float)tan(fovY * 3.14159265358979 / 360.0);
+    view.tanHalfFovX = view.tanHalfFovY * (float)aspect;
+    view.zNear = (float)zNear;
+    view.zFar = (float)zFar;
+    view.pixelsPerUnit = viewportHeight / (2.0f * view.tanHalfFovY);
+}
+
+// Is a sphere at eye-space x, y and distance depth (in front of the camera)
+// outside the side plane through the eye with half-angle tangent t?
+static bool outsideSide(float offset, float depth, float t, float radius) {
+    // Distance of the center past the plane is (|offset| - depth * t) / sqrt(1 + t^2)
+    return fabsf(offset) - depth * t > radius * sqrtf(1.0f + t * t);
+}
+
+float lodScreenRadius(const LodView& view, const float toEye[16], const float center[3], float bound, float radius) {
+    float eye[3];
+    for (int i = 0; i < 3; i++) {
+        eye[i] = toEye[i] * center[0] + toEye[4 + i] * center[1] + toEye[8 + i] * center[2] + toEye[12 + i];
+    }
+    float depth = -eye[2];  // The camera looks down -z
+    if (depth + bound < view.zNear || depth - bound > view.zFar) return -1.0f;
+    if (outsideSide(eye[0], depth, view.tanHalfFovX, bound)) return -1.0f;
+    if (outsideSide(eye[1], depth, view.tanHalfFovY, bound)) return -1.0f;
+    if (depth < view.zNear) depth = view.zNear;  // Straddling the near plane: as close as it gets
+    return radius * view.pixelsPerUnit / depth;
+}
+
+int lodDetail(int count, int level, int minimum) {
+    int detail = count >> level;
+    return detail > minimum ? detail : minimum;
+}
+
+int lodLevel(float screenRadius, int slices) {
+    // A regular n-gon inscribed in a circle of radius r misses the curve by
+    // r * (1 - cos(pi / n)) at the middle of each side
+    for (int level = kLodLevels - 1; level > 0; level--) {
+        int n = lodDetail(slices, level, 3);
+        if (screenRadius * (1.0f - cosf(3.1415926f / n)) <= kLodTolerancePixels) return level;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef LOD_H
+#define LOD_H
+
+// Level of detail and view-frustum culling for the 3D scene. Curved parts
+// are pre-built at a few tessellation levels; each frame a part's radius is
+// projected to pixels and the coarsest level whose silhouette stays within
+// kLodTolerancePixels of the true curve is drawn. Parts whose bounding
+// sphere is outside the view frustum are skipped.
+
+const int kLodLevels = 3;                 // Level 0 is the authored detail; each level halves it
+const float kLodTolerancePixels = 1.0f;   // Allowed silhouette error on screen
+
+// The camera and perspective projection of the frame being drawn
+struct LodView {
+    float camera[16];        // World-to-eye matrix (column-major, like GL_MODELVIEW_MATRIX)
+    float tanHalfFovY;       // Tangents of the half field of view
+    float tanHalfFovX;
+    float zNear, zFar;
+    float pixelsPerUnit;     // Screen pixels per eye-space unit at distance 1
+};
+
+// Capture the current modelview matrix as the camera, with the parameters
+// passed to gluPerspective() and the viewport height in pixels
+void lodSetView(LodView& view, double fovY, double aspect, double zNear, double zFar, int viewportHeight);
+
+// Project a part: a bounding sphere (center and radius, in the coordinates
+// that toEye maps to eye space) and the radius of its curved surface.
+// Returns that curve's radius in pixels, or -1 when the sphere is outside the frustum.
+float lodScreenRadius(const LodView& view, const float toEye[16], const float center[3], float bound, float radius);
+
+// Slice/stack count of a level: count halved per level, but at least minimum
+int lodDetail(int count, int level, int minimum);
+
+// Coarsest level whose polygon of lodDetail(slices, level, 3) sides stays
+// within the tolerance of a circle screenRadius pixels across
+int lodLevel(float screenRadius, int slices);
+
+#endif
@@ -0,0 +1,208 @@
+#include "mesh_cache.h"
+#include "gl_ext.h"
+#include "soft_backend.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+MeshStats meshStats = {0, 0, 0, 0};
+
+// Fixed storage so references handed out stay valid as the cache grows
+const int kMaxMeshes = 64;
+static Mesh meshCache[kMaxMeshes];
+
+static const float kPi = 3.1415926f;
+
+static void addVertex(Mesh& mesh, float nx, float ny, float nz, float x, float y, float z) {
+    float v[6] = {nx, ny, nz, x, y, z};
+    mesh.vertices.insert(mesh.vertices.end(), v, v + 6);
+}
+
+// Quads joining a (rows+1) x (columns+1) grid of vertices laid out row by row
+static void addGridQuads(Mesh& mesh, int rows, int columns) {
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            unsigned int a = r * (columns + 1) + c;
+            unsigned int b = a + columns + 1;
+            unsigned int quad[4] = {a, a + 1, b + 1, b};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 4);
+        }
+    }
+}
+
+static void tessellateCylinder(Mesh& mesh, float radius, float height, int slices) {
+    for (int z = 0; z <= 1; z++) {
+        for (int i = 0; i <= slices; i++) {
+            float a = 2.0f * kPi * i / slices;
+            addVertex(mesh, cosf(a), sinf(a), 0.0f, radius * cosf(a), radius * sinf(a), z * height);
+        }
+    }
+    addGridQuads(mesh, 1, slices);
+}
+
+static void tessellateDisk(Mesh& mesh, float innerRadius, float outerRadius, int slices, int loops) {
+    for (int l = 0; l <= loops; l++) {
+        float r = innerRadius + (outerRadius - innerRadius) * l / loops;
+        for (int i = 0; i <= slices; i++) {
+            float a = 2.0f * kPi * i / slices;
+            addVertex(mesh, 0.0f, 0.0f, 1.0f, r * cosf(a), r * sinf(a), 0.0f);
+        }
+    }
+    addGridQuads(mesh, loops, slices);
+}
+
+static void tessellateSphere(Mesh& mesh, float radius, int slices, int stacks) {
+    for (int j = 0; j <= stacks; j++) {
+        float phi = kPi * j / stacks;  // 0 at the -z pole, pi at +z
+        float ring = sinf(phi), z = -cosf(phi);
+        for (int i = 0; i <= slices; i++) {
+            float a = 2.0f * kPi * i / slices;
+            float nx = ring * cosf(a), ny = ring * sinf(a);
+            addVertex(mesh, nx, ny, z, nx * radius, ny * radius, z * radius);
+        }
+    }
+    addGridQuads(mesh, stacks, slices);  // Pole rows are degenerate quads (triangles)
+}
+
+static void tessellateTorus(Mesh& mesh, float innerRadius, float outerRadius, int sides, int rings) {
+    for (int j = 0; j <= rings; j++) {
+        float theta = 2.0f * kPi * j / rings;  // Around the main ring
+        for (int i = 0; i <= sides; i++) {
+            float phi = 2.0f * kPi * i / sides;  // Around the tube
+            float nx = cosf(phi) * cosf(theta), ny = cosf(phi) * sinf(theta), nz = sinf(phi);
+            float dist = outerRadius + innerRadius * cosf(phi);
+            addVertex(mesh, nx, ny, nz, dist * cosf(theta), dist * sinf(theta), innerRadius * nz);
+        }
+    }
+    addGridQuads(mesh, rings, sides);
+}
+
+static void tessellateCube(Mesh& mesh, float size) {
+    // One quad per face: normal n and face axes u, v with u x v = n, so the
+    // corners below run counter-clockwise seen from outside
+    static const float faces[6][3][3] = {
+        {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},  {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+        {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},  {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},  {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}}
+    };
+    static const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    float h = size / 2.0f;
+    for (int f = 0; f < 6; f++) {
+        const float* n = faces[f][0];
+        const float* u = faces[f][1];
+        const float* v = faces[f][2];
+        for (int c = 0; c < 4; c++) {
+            float p[3];
+            for (int k = 0; k < 3; k++) p[k] = h * (n[k] + corners[c][0] * u[k] + corners[c][1] * v[k]);
+            addVertex(mesh, n[0], n[1], n[2], p[0], p[1], p[2]);
+            mesh.indices.push_back(f * 4 + c);
+        }
+    }
+}
+
+// Move a freshly tessellated mesh into buffer objects (or a display list)
+static void uploadMesh(Mesh& mesh) {
+    if (glExtHasBuffers) {
+        pglGenBuffers(1, &mesh.vertexBuffer);
+        pglBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        pglBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float),
+                      mesh.vertices.data(), GL_STATIC_DRAW);
+        pglGenBuffers(1, &mesh.indexBuffer);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+        pglBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int),
+                      mesh.indices.data(), GL_STATIC_DRAW);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    } else {
+        mesh.displayList = glGenLists(1);
+        glNewList(mesh.displayList, GL_COMPILE);
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glInterleavedArrays(GL_N3F_V3F, 0, mesh.vertices.data());
+        glDrawElements(GL_QUADS, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, mesh.indices.data());
+        glPopClientAttrib();
+        glEndList();
+    }
+}
+
+// Find a cached mesh, or tessellate and upload it on first use
+static const Mesh& findMesh(MeshKind kind, float size0, float size1, int detail0, int detail1) {
+    for (int i = 0; i < meshStats.meshes; i++) {
+        const Mesh& m = meshCache[i];
+        if (m.kind == kind && m.size[0] == size0 && m.size[1] == size1 &&
+            m.detail[0] == detail0 && m.detail[1] == detail1) {
+            return m;
+        }
+    }
+    if (meshStats.meshes == kMaxMeshes) {
+        // Handed-out references must stay valid, so nothing can be evicted,
+        // and drawing another shape's mesh would be silently wrong
+        fprintf(stderr, "mesh cache full (%d meshes): raise kMaxMeshes\n", kMaxMeshes);
+        abort();
+    }
+
+    Mesh& mesh = meshCache[meshStats.meshes++];
+    mesh.kind = kind;
+    mesh.size[0] = size0;
+    mesh.size[1] = size1;
+    mesh.detail[0] = detail0;
+    mesh.detail[1] = detail1;
+    mesh.vertexBuffer = mesh.indexBuffer = mesh.displayList = 0;
+    switch (kind) {
+        case MESH_CYLINDER: tessellateCylinder(mesh, size0, size1, detail0); break;
+        case MESH_DISK:     tessellateDisk(mesh, size0, size1, detail0, detail1); break;
+        case MESH_SPHERE:   tessellateSphere(mesh, size0, detail0, detail1); break;
+        case MESH_TORUS:    tessellateTorus(mesh, size0, size1, detail0, detail1); break;
+        case MESH_CUBE:     tessellateCube(mesh, size0); break;
+    }
+    uploadMesh(mesh);
+    meshStats.tessellations++;
+    return mesh;
+}
+
+const Mesh& meshCylinder(float radius, float height, int slices) {
+    return findMesh(MESH_CYLINDER, radius, height, slices, 1);
+}
+
+const Mesh& meshDisk(float innerRadius, float outerRadius, int slices, int loops) {
+    return findMesh(MESH_DISK, innerRadius, outerRadius, slices, loops);
+}
+
+const Mesh& meshSphere(float radius, int slices, int stacks) {
+    return findMesh(MESH_SPHERE, radius, 0.0f, slices, stacks);
+}
+
+const Mesh& meshTorus(float innerRadius, float outerRadius, int sides, int rings) {
+    return findMesh(MESH_TORUS, innerRadius, outerRadius, sides, rings);
+}
+
+const Mesh& meshCube(float size) {
+    return findMesh(MESH_CUBE, size, 0.0f, 1, 1);
+}
+
+void meshDraw(const Mesh& mesh) {
+    meshStats.draws++;
+    meshStats.vertices += (long)mesh.indices.size();
+    if (softBackend) {
+        RasterArrays arrays = {};
+        arrays.normal = &mesh.vertices[0];
+        arrays.normalStride = 6 * sizeof(float);
+        arrays.position = &mesh.vertices[3];
+        arrays.positionSize = 3;
+        arrays.positionStride = 6 * sizeof(float);
+        glGetFloatv(GL_CURRENT_COLOR, arrays.color);
+        softBackendDraw(GL_QUADS, arrays, (int)mesh.vertices.size() / 6, mesh.indices.data(), (int)mesh.indices.size());
+        return;
+    }
+    if (mesh.displayList) {
+        glCallList(mesh.displayList);
+        return;
+    }
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    pglBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+    glInterleavedArrays(GL_N3F_V3F, 0, 0);
+    glDrawElements(GL_QUADS, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glPopClientAttrib();
+}
@@ -0,0 +1,52 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <GL/glut.h>
+#include <vector>
+
+// Tessellated primitives for the 3D fan, built once and drawn many times.
+// Replaces per-call gluNewQuadric()/gluCylinder() and glutSolidSphere()/
+// glutSolidTorus()/glutSolidCube(), which re-tessellate (and allocate) every
+// frame and, for the GLUT shapes, need GLUT to be initialized.
+// Meshes live in vertex/index buffer objects, or in display lists when the
+// driver has no buffer objects.
+
+enum MeshKind { MESH_CYLINDER, MESH_DISK, MESH_SPHERE, MESH_TORUS, MESH_CUBE };
+
+struct Mesh {
+    MeshKind kind;
+    float size[2];                   // Kind-specific radii/height (see meshCylinder() etc.)
+    int detail[2];                   // Kind-specific slice/stack counts
+    std::vector<float> vertices;     // Interleaved normal + position (GL_N3F_V3F)
+    std::vector<unsigned int> indices;  // GL_QUADS, four indices per face
+    GLuint vertexBuffer;             // Buffer objects, 0 when using the display list
+    GLuint indexBuffer;
+    GLuint displayList;              // Fallback when buffer objects are unavailable
+};
+
+// Counters to check that steady-state frames do no tessellation
+struct MeshStats {
+    int meshes;                      // Primitives in the cache
+    long tessellations;              // Meshes generated since start-up
+    long draws;                      // meshDraw() calls since start-up
+    long vertices;                   // Vertices (indices) submitted by those draws
+};
+extern MeshStats meshStats;
+
+// Cached primitives; the first request for a shape tessellates and uploads it
+// (needs a current GL context), later requests return the same mesh. The
+// cache holds a fixed number of meshes and aborts if a new shape won't fit.
+// Same geometry as gluCylinder (along +z, one stack), gluDisk (z = 0 plane),
+// glutSolidSphere (poles on z), glutSolidTorus (ring in the xy plane) and
+// glutSolidCube (centered on the origin).
+const Mesh& meshCylinder(float radius, float height, int slices);
+const Mesh& meshDisk(float innerRadius, float outerRadius, int slices, int loops);
+const Mesh& meshSphere(float radius, int slices, int stacks);
+const Mesh& meshTorus(float innerRadius, float outerRadius, int sides, int rings);
+const Mesh& meshCube(float size);
+
+// Draw a cached mesh with the current color, material and transform (or
+// hand it to the software backend when that is on)
+void meshDraw(const Mesh& mesh);
+
+#endif
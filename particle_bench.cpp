@@ -0,0 +1,197 @@
+// Benchmark for the air particle pool in particles.cpp and the advection
+// kernels in particle_kernel.cpp.
+//
+// Part 1 keeps N particles alive (respawning what gets culled each tick,
+// like the 2D fan at full speed) and reports the full update cost per particle.
+// Part 2 times the advection/fade math alone for the original per-particle
+// loop (pairs, sqrt + divide) and each kernel at 10k/100k/1M particles.
+// Part 3 runs spawn + update + cull of 1M particles on 1..N threads, checks
+// that every thread count ends in the same state and reports the scaling.
+//
+// Usage: particle_bench [ticks] [max threads]
+
+#include "particles.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Small deterministic generator so every run spawns the same particles
+static unsigned int benchSeed = 1u;
+static float benchRandom() {
+    benchSeed = benchSeed * 1664525u + 1013904223u;
+    return (benchSeed >> 8) * (1.0f / 16777216.0f);  // [0, 1)
+}
+
+// Spawn one particle on the 75-200 px annulus around the fan center
+static void spawnParticle(ParticlePool& pool) {
+    float angle = benchRandom() * 2.0f * 3.1415926f;
+    float distance = 75.0f + benchRandom() * 125.0f;
+    float c = cosf(angle), s = sinf(angle);
+    particlesSpawn(pool, 450 + c * distance, 350 + s * distance, c, s);
+}
+
+// Same annulus as a deterministic emitter for the threaded runs
+static const ParticleEmitter annulusEmitter = {450, 350, 0, 2 * 3.1415926f, 75, 200, 7u};
+
+static AdvectParams benchParams() {
+    AdvectParams p;
+    p.cx = 450;
+    p.cy = 350;
+    p.speed = 3.0f;
+    p.fadeStart = 80.0f;
+    p.fadeLength = 120.0f;
+    p.alphaScale = 0.6f;
+    return p;
+}
+
+// The math the original drawAirFlow() did per particle, minus the GL calls
+static float legacyAdvect(std::vector<std::pair<float, float> >& particles, float moveSpeed) {
+    float alphaSum = 0.0f;
+    for (size_t i = 0; i < particles.size(); i++) {
+        float dx = particles[i].first - 450;
+        float dy = particles[i].second - 350;
+        float dist = sqrt(dx * dx + dy * dy);
+        particles[i].first += dx / dist * moveSpeed;
+        particles[i].second += dy / dist * moveSpeed;
+        float alpha = 1.0f - (dist - 80) / 120.0f;
+        alphaSum += alpha * 0.6f;
+    }
+    return alphaSum;  // Returned so the loop cannot be optimized away
+}
+
+static void benchPoolUpdate(int ticks) {
+    const int sizes[] = {10000, 100000, 1000000, 2000000};
+    AdvectParams params = benchParams();
+
+    printf("pool update (kernel: %s)\n", particleKernelName(particleKernelActive()));
+    printf("%10s %12s %14s %14s\n", "particles", "ticks", "ns/particle", "Mparticles/s");
+    for (int n : sizes) {
+        ParticlePool pool;
+        particlesInit(pool, n);
+        while (pool.count < n) spawnParticle(pool);
+
+        double updateSeconds = 0.0;
+        long long updated = 0;
+        for (int t = 0; t < ticks; t++) {
+            updated += pool.count;
+            auto start = std::chrono::steady_clock::now();
+            particlesUpdate(pool, params, 200, 0);
+            auto end = std::chrono::steady_clock::now();
+            updateSeconds += std::chrono::duration<double>(end - start).count();
+
+            while (pool.count < n) spawnParticle(pool);  // Refill (not timed)
+        }
+
+        double nsPerParticle = updateSeconds * 1e9 / updated;
+        printf("%10d %12d %14.3f %14.1f\n", n, ticks, nsPerParticle, updated / updateSeconds / 1e6);
+    }
+}
+
+static void benchKernels(int ticks) {
+    const int sizes[] = {10000, 100000, 1000000};
+    const ParticleKernel kernels[] = {PARTICLE_KERNEL_SCALAR, PARTICLE_KERNEL_SSE, PARTICLE_KERNEL_AVX2};
+    AdvectParams params = benchParams();
+    ParticleKernel best = particleKernelBest();
+
+    printf("\nadvection kernel only\n");
+    printf("%10s %10s %14s %10s\n", "particles", "path", "ns/particle", "speedup");
+    for (int n : sizes) {
+        ParticlePool pool;
+        particlesInit(pool, n);
+        benchSeed = 1u;
+        while (pool.count < n) spawnParticle(pool);
+
+        std::vector<std::pair<float, float> > legacy(n);
+        for (int i = 0; i < n; i++) legacy[i] = std::make_pair(pool.x[i], pool.y[i]);
+
+        float sink = 0.0f;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++) sink += legacyAdvect(legacy, params.speed);
+        auto end = std::chrono::steady_clock::now();
+        double legacyNs = std::chrono::duration<double>(end - start).count() * 1e9 / ((double)n * ticks);
+        printf("%10d %10s %14.3f %10.2f\n", n, "legacy", legacyNs, 1.0);
+
+        for (ParticleKernel kernel : kernels) {
+            if (kernel > best) continue;  // Not supported on this CPU
+            particleKernelSelect(kernel);
+            start = std::chrono::steady_clock::now();
+            for (int t = 0; t < ticks; t++) {
+                advectParticles(params, pool.x.data(), pool.y.data(), pool.vx.data(), pool.vy.data(),
+                                pool.age.data(), pool.dist.data(), pool.alpha.data(), 0, n);
+                sink += pool.alpha[t % n];
+            }
+            end = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double>(end - start).count() * 1e9 / ((double)n * ticks);
+            printf("%10d %10s %14.3f %10.2f\n", n, particleKernelName(kernel), ns, legacyNs / ns);
+        }
+        if (sink == 12345.0f) printf(" ");  // Keep the results observable
+    }
+    particleKernelSelect(best);
+}
+
+// FNV-1a over the raw bits of every live particle
+static unsigned int poolChecksum(const ParticlePool& pool) {
+    unsigned int h = 2166136261u;
+    const std::vector<float>* arrays[] = {&pool.x, &pool.y, &pool.vx, &pool.vy, &pool.age};
+    for (const std::vector<float>* a : arrays) {
+        for (int i = 0; i < pool.count; i++) {
+            unsigned int bits;
+            memcpy(&bits, &(*a)[i], sizeof(bits));
+            h = (h ^ bits) * 16777619u;
+        }
+    }
+    return h;
+}
+
+static void benchScaling(int ticks, int maxThreads) {
+    const int n = 1000000;
+    AdvectParams params = benchParams();
+    double baseSeconds = 0.0;
+    unsigned int baseChecksum = 0;
+
+    printf("\nspawn + update + cull, %d particles, chunk %d\n", n, kParticleChunk);
+    printf("%8s %12s %10s %12s %10s\n", "threads", "ms/tick", "speedup", "checksum", "same");
+    // 1, 2, 4, ... and always maxThreads itself
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    for (int threads : threadCounts) {
+        ThreadPool workers(threads);
+        ParticlePool pool;
+        particlesInit(pool, n);
+        particlesEmit(pool, annulusEmitter, n, &workers);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++) {
+            particlesUpdate(pool, params, 200, &workers);
+            particlesEmit(pool, annulusEmitter, n - pool.count, &workers);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+
+        unsigned int checksum = poolChecksum(pool);
+        if (threads == 1) {
+            baseSeconds = seconds;
+            baseChecksum = checksum;
+        }
+        printf("%8d %12.3f %10.2f %12x %10s\n", threads, seconds * 1000.0 / ticks,
+               baseSeconds / seconds, checksum, checksum == baseChecksum ? "yes" : "NO");
+    }
+}
+
+int main(int argc, char** argv) {
+    int ticks = argc > 1 ? atoi(argv[1]) : 200;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    if (maxThreads < 1) maxThreads = 1;
+    benchPoolUpdate(ticks);
+    benchKernels(ticks);
+    benchScaling(ticks, maxThreads);
+    return 0;
+}
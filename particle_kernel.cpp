@@ -0,0 +1,143 @@
+#include "particle_kernel.h"
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PARTICLE_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*AdvectFunc)(const AdvectParams&, float*, float*, const float*, const float*,
+                           float*, float*, float*, int, int);
+
+// Reference implementation; also handles the tails the SIMD loops leave over
+// (arrays never overlap, which lets the compiler keep values in registers)
+static void advectScalar(const AdvectParams& p,
+                         float* __restrict x, float* __restrict y,
+                         const float* __restrict vx, const float* __restrict vy,
+                         float* __restrict age, float* __restrict dist, float* __restrict alpha,
+                         int begin, int end) {
+    const float cx = p.cx, cy = p.cy, speed = p.speed;
+    const float fadeStart = p.fadeStart, alphaMax = p.alphaScale;
+    const float fadeScale = p.alphaScale / p.fadeLength;
+    for (int i = begin; i < end; i++) {
+        float dx = x[i] - cx;
+        float dy = y[i] - cy;
+        float d = std::sqrt(dx * dx + dy * dy);
+        float a = alphaMax - (d - fadeStart) * fadeScale;
+        a = a < alphaMax ? a : alphaMax;
+        a = (a + std::fabs(a)) * 0.5f;  // max(a, 0) without the branch GCC emits for ?:
+        dist[i] = d;
+        alpha[i] = a;
+        x[i] += vx[i] * speed;
+        y[i] += vy[i] * speed;
+        age[i] += 1.0f;
+    }
+}
+
+#ifdef PARTICLE_KERNEL_X86
+
+__attribute__((target("sse2")))
+static void advectSSE(const AdvectParams& p,
+                      float* x, float* y, const float* vx, const float* vy,
+                      float* age, float* dist, float* alpha,
+                      int begin, int end) {
+    const __m128 cx = _mm_set1_ps(p.cx);
+    const __m128 cy = _mm_set1_ps(p.cy);
+    const __m128 speed = _mm_set1_ps(p.speed);
+    const __m128 fadeStart = _mm_set1_ps(p.fadeStart);
+    const __m128 fadeScale = _mm_set1_ps(p.alphaScale / p.fadeLength);
+    const __m128 alphaMax = _mm_set1_ps(p.alphaScale);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 dx = _mm_sub_ps(px, cx);
+        __m128 dy = _mm_sub_ps(py, cy);
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 a = _mm_sub_ps(alphaMax, _mm_mul_ps(_mm_sub_ps(d, fadeStart), fadeScale));
+        a = _mm_min_ps(_mm_max_ps(a, zero), alphaMax);
+        _mm_storeu_ps(dist + i, d);
+        _mm_storeu_ps(alpha + i, a);
+        _mm_storeu_ps(x + i, _mm_add_ps(px, _mm_mul_ps(_mm_loadu_ps(vx + i), speed)));
+        _mm_storeu_ps(y + i, _mm_add_ps(py, _mm_mul_ps(_mm_loadu_ps(vy + i), speed)));
+        _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), one));
+    }
+    advectScalar(p, x, y, vx, vy, age, dist, alpha, i, end);
+}
+
+__attribute__((target("avx2")))
+static void advectAVX2(const AdvectParams& p,
+                       float* x, float* y, const float* vx, const float* vy,
+                       float* age, float* dist, float* alpha,
+                       int begin, int end) {
+    const __m256 cx = _mm256_set1_ps(p.cx);
+    const __m256 cy = _mm256_set1_ps(p.cy);
+    const __m256 speed = _mm256_set1_ps(p.speed);
+    const __m256 fadeStart = _mm256_set1_ps(p.fadeStart);
+    const __m256 fadeScale = _mm256_set1_ps(p.alphaScale / p.fadeLength);
+    const __m256 alphaMax = _mm256_set1_ps(p.alphaScale);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 dx = _mm256_sub_ps(px, cx);
+        __m256 dy = _mm256_sub_ps(py, cy);
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 a = _mm256_sub_ps(alphaMax, _mm256_mul_ps(_mm256_sub_ps(d, fadeStart), fadeScale));
+        a = _mm256_min_ps(_mm256_max_ps(a, zero), alphaMax);
+        _mm256_storeu_ps(dist + i, d);
+        _mm256_storeu_ps(alpha + i, a);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(px, _mm256_mul_ps(_mm256_loadu_ps(vx + i), speed)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(py, _mm256_mul_ps(_mm256_loadu_ps(vy + i), speed)));
+        _mm256_storeu_ps(age + i, _mm256_add_ps(_mm256_loadu_ps(age + i), one));
+    }
+    advectSSE(p, x, y, vx, vy, age, dist, alpha, i, end);
+}
+
+#endif
+
+static ParticleKernel activeKernel = particleKernelBest();
+
+ParticleKernel particleKernelBest() {
+#ifdef PARTICLE_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return PARTICLE_KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse2")) return PARTICLE_KERNEL_SSE;
+#endif
+    return PARTICLE_KERNEL_SCALAR;
+}
+
+void particleKernelSelect(ParticleKernel kernel) {
+    ParticleKernel best = particleKernelBest();
+    activeKernel = kernel > best ? best : kernel;
+}
+
+ParticleKernel particleKernelActive() {
+    return activeKernel;
+}
+
+const char* particleKernelName(ParticleKernel kernel) {
+    switch (kernel) {
+        case PARTICLE_KERNEL_AVX2: return "avx2";
+        case PARTICLE_KERNEL_SSE:  return "sse";
+        default:                   return "scalar";
+    }
+}
+
+void advectParticles(const AdvectParams& params,
+                     float* x, float* y, const float* vx, const float* vy,
+                     float* age, float* dist, float* alpha,
+                     int begin, int end) {
+    AdvectFunc func = advectScalar;
+#ifdef PARTICLE_KERNEL_X86
+    if (activeKernel == PARTICLE_KERNEL_AVX2) func = advectAVX2;
+    else if (activeKernel == PARTICLE_KERNEL_SSE) func = advectSSE;
+#endif
+    func(params, x, y, vx, vy, age, dist, alpha, begin, end);
+}
@@ -0,0 +1,40 @@
+#ifndef PARTICLE_KERNEL_H
+#define PARTICLE_KERNEL_H
+
+// Per-tick advection and fade math for the air particles, split out of the
+// draw loop so it can run over plain arrays with SIMD.
+// The AVX2 path handles 8 particles per instruction, SSE 4, with a scalar
+// fallback; the best one the CPU supports is picked at run time.
+
+// Inputs shared by every particle in one update
+struct AdvectParams {
+    float cx, cy;       // Fan center; distances are measured from here
+    float speed;        // Velocity multiplier for this tick
+    float fadeStart;    // Distance at which particles start to fade
+    float fadeLength;   // Distance over which alpha drops from alphaScale to 0
+    float alphaScale;   // Alpha of a particle before it starts fading
+};
+
+enum ParticleKernel {
+    PARTICLE_KERNEL_SCALAR,
+    PARTICLE_KERNEL_SSE,
+    PARTICLE_KERNEL_AVX2
+};
+
+// Best kernel this CPU supports
+ParticleKernel particleKernelBest();
+
+// Kernel used by advectParticles() (defaults to particleKernelBest());
+// unsupported choices fall back to the best available one
+void particleKernelSelect(ParticleKernel kernel);
+ParticleKernel particleKernelActive();
+const char* particleKernelName(ParticleKernel kernel);
+
+// For particles [begin, end): record the distance from the center and the
+// draw alpha, then move by velocity * speed and age by one tick
+void advectParticles(const AdvectParams& params,
+                     float* x, float* y, const float* vx, const float* vy,
+                     float* age, float* dist, float* alpha,
+                     int begin, int end);
+
+#endif
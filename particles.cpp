@@ -0,0 +1,154 @@
+#include "particles.h"
+#include "thread_pool.h"
+#include <cmath>
+
+void particlesInit(ParticlePool& pool, int capacity) {
+    pool.x.assign(capacity, 0.0f);
+    pool.y.assign(capacity, 0.0f);
+    pool.vx.assign(capacity, 0.0f);
+    pool.vy.assign(capacity, 0.0f);
+    pool.age.assign(capacity, 0.0f);
+    pool.dist.assign(capacity, 0.0f);
+    pool.alpha.assign(capacity, 0.0f);
+    pool.nextX.assign(capacity, 0.0f);
+    pool.nextY.assign(capacity, 0.0f);
+    pool.nextVx.assign(capacity, 0.0f);
+    pool.nextVy.assign(capacity, 0.0f);
+    pool.nextAge.assign(capacity, 0.0f);
+    pool.nextDist.assign(capacity, 0.0f);
+    pool.nextAlpha.assign(capacity, 0.0f);
+    pool.chunkAlive.assign(capacity / kParticleChunk + 1, 0);
+    pool.count = 0;
+    pool.capacity = capacity;
+    pool.spawned = 0;
+}
+
+void particlesClear(ParticlePool& pool) {
+    pool.count = 0;
+}
+
+bool particlesSpawn(ParticlePool& pool, float x, float y, float vx, float vy) {
+    if (pool.count >= pool.capacity) return false;
+    int i = pool.count++;
+    pool.x[i] = x;
+    pool.y[i] = y;
+    pool.vx[i] = vx;
+    pool.vy[i] = vy;
+    pool.age[i] = 0.0f;
+    pool.dist[i] = 0.0f;
+    pool.alpha[i] = 0.0f;
+    return true;
+}
+
+// Stateless integer hash (lowbias32), used as a counter-based random generator
+static unsigned int hashParticle(unsigned int x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Uniform [0, 1) from a seed, particle serial number and stream (0 or 1)
+static float particleRandom(unsigned int seed, unsigned int serial, unsigned int stream) {
+    unsigned int h = hashParticle(seed ^ hashParticle(serial * 2u + stream));
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+int particlesEmit(ParticlePool& pool, const ParticleEmitter& emitter, int n, ThreadPool* threads) {
+    if (n > pool.capacity - pool.count) n = pool.capacity - pool.count;
+    if (n <= 0) return 0;
+
+    int first = pool.count;
+    unsigned int serial = pool.spawned;
+    auto emitChunk = [&](int chunk) {
+        int begin = chunk * kParticleChunk;
+        int end = begin + kParticleChunk < n ? begin + kParticleChunk : n;
+        for (int j = begin; j < end; j++) {
+            float angle = emitter.minAngle +
+                (emitter.maxAngle - emitter.minAngle) * particleRandom(emitter.seed, serial + j, 0);
+            float radius = emitter.minRadius +
+                (emitter.maxRadius - emitter.minRadius) * particleRandom(emitter.seed, serial + j, 1);
+            float c = cosf(angle), s = sinf(angle);
+            int i = first + j;
+            pool.x[i] = emitter.cx + c * radius;
+            pool.y[i] = emitter.cy + s * radius;
+            pool.vx[i] = c;
+            pool.vy[i] = s;
+            pool.age[i] = 0.0f;
+            pool.dist[i] = radius;
+            pool.alpha[i] = 0.0f;
+        }
+    };
+
+    int chunks = (n + kParticleChunk - 1) / kParticleChunk;
+    if (threads) threads->parallelFor(chunks, emitChunk);
+    else for (int c = 0; c < chunks; c++) emitChunk(c);
+
+    pool.count += n;
+    pool.spawned += n;
+    return n;
+}
+
+void particlesUpdate(ParticlePool& pool, const AdvectParams& params, float maxDist,
+                     ThreadPool* threads) {
+    int count = pool.count;
+    int chunks = (count + kParticleChunk - 1) / kParticleChunk;
+    if (chunks == 0) return;
+    int* alive = pool.chunkAlive.data();
+
+    // Pass 1: advect every chunk and count the particles that stay
+    auto advectChunk = [&](int chunk) {
+        int begin = chunk * kParticleChunk;
+        int end = begin + kParticleChunk < count ? begin + kParticleChunk : count;
+        advectParticles(params, pool.x.data(), pool.y.data(), pool.vx.data(), pool.vy.data(),
+                        pool.age.data(), pool.dist.data(), pool.alpha.data(), begin, end);
+        int n = 0;
+        const float* dist = pool.dist.data();
+        for (int i = begin; i < end; i++) n += dist[i] <= maxDist;  // Culled on the pre-move distance
+        alive[chunk] = n;
+    };
+    if (threads) threads->parallelFor(chunks, advectChunk);
+    else for (int c = 0; c < chunks; c++) advectChunk(c);
+
+    // Turn the survivor counts into output offsets
+    int total = 0;
+    for (int c = 0; c < chunks; c++) {
+        int n = alive[c];
+        alive[c] = total;
+        total += n;
+    }
+    if (total == count) return;  // Nothing culled, arrays are already in place
+
+    // Pass 2: copy the survivors of each chunk to their final slots, in order
+    auto compactChunk = [&](int chunk) {
+        int begin = chunk * kParticleChunk;
+        int end = begin + kParticleChunk < count ? begin + kParticleChunk : count;
+        int out = alive[chunk];
+        const float* dist = pool.dist.data();
+        for (int i = begin; i < end; i++) {
+            if (dist[i] > maxDist) continue;
+            pool.nextX[out] = pool.x[i];
+            pool.nextY[out] = pool.y[i];
+            pool.nextVx[out] = pool.vx[i];
+            pool.nextVy[out] = pool.vy[i];
+            pool.nextAge[out] = pool.age[i];
+            pool.nextDist[out] = pool.dist[i];
+            pool.nextAlpha[out] = pool.alpha[i];
+            out++;
+        }
+    };
+    if (threads) threads->parallelFor(chunks, compactChunk);
+    else for (int c = 0; c < chunks; c++) compactChunk(c);
+
+    // Swapping vectors only exchanges pointers, nothing is reallocated
+    pool.x.swap(pool.nextX);
+    pool.y.swap(pool.nextY);
+    pool.vx.swap(pool.nextVx);
+    pool.vy.swap(pool.nextVy);
+    pool.age.swap(pool.nextAge);
+    pool.dist.swap(pool.nextDist);
+    pool.alpha.swap(pool.nextAlpha);
+    pool.count = total;
+}
@@ -0,0 +1,60 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <vector>
+#include "particle_kernel.h"
+
+class ThreadPool;
+
+// Particles are processed in chunks of this many; the chunking never depends
+// on the thread count, which keeps results identical for 1..N threads
+const int kParticleChunk = 16384;
+
+// Fixed-capacity air particle pool stored as structure-of-arrays.
+// All storage is allocated once by particlesInit(); spawning and culling
+// never allocate.
+struct ParticlePool {
+    std::vector<float> x, y;     // Position (pixels)
+    std::vector<float> vx, vy;   // Direction of travel (pixels/tick at unit speed)
+    std::vector<float> age;      // Ticks since spawn
+    std::vector<float> dist;     // Distance from the fan center (written by particlesUpdate)
+    std::vector<float> alpha;    // Draw alpha (written by particlesUpdate)
+    int count;                   // Number of live particles (stored in [0, count))
+    int capacity;                // Maximum number of live particles
+    unsigned int spawned;        // Particles emitted so far; seeds the per-particle random numbers
+
+    // Culling copies survivors of every chunk here in parallel, then swaps
+    std::vector<float> nextX, nextY, nextVx, nextVy, nextAge, nextDist, nextAlpha;
+    std::vector<int> chunkAlive;  // Survivors per chunk, then their output offsets
+};
+
+// Ring sector around (cx,cy) that particles spawn in, moving radially outward
+struct ParticleEmitter {
+    float cx, cy;                  // Center of the ring
+    float minAngle, maxAngle;      // Sector to spawn in (radians)
+    float minRadius, maxRadius;    // Distance from the center to spawn at
+    unsigned int seed;             // Different emitters should use different seeds
+};
+
+// Allocate storage for up to capacity particles and empty the pool
+void particlesInit(ParticlePool& pool, int capacity);
+
+// Remove all particles (keeps the storage)
+void particlesClear(ParticlePool& pool);
+
+// Add one particle; returns false when the pool is full
+bool particlesSpawn(ParticlePool& pool, float x, float y, float vx, float vy);
+
+// Spawn up to n particles from emitter (fewer if the pool fills up) and return
+// how many were added. Positions come from a hash of the emitter seed and the
+// particle's serial number, so they do not depend on threads or call order.
+int particlesEmit(ParticlePool& pool, const ParticleEmitter& emitter, int n, ThreadPool* threads);
+
+// Advance one tick with the SIMD advection kernel: every particle gets its
+// distance and alpha refreshed, moves by velocity * speed and ages one tick;
+// particles that were farther than maxDist from the center are then culled,
+// keeping the survivors in order. threads may be null to run on the caller.
+void particlesUpdate(ParticlePool& pool, const AdvectParams& params, float maxDist,
+                     ThreadPool* threads);
+
+#endif
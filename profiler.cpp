@@ -0,0 +1,298 @@
+#include "profiler.h"
+#include "gl_ext.h"
+#include "soft_backend.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+typedef std::chrono::steady_clock ProfileClock;
+
+struct StageInfo {
+    const char* name;
+    int depth;                       // Nesting depth when first entered, -1 before that
+};
+
+static StageInfo stages[kProfileMaxStages];
+static int stageCount = 0;
+static int depth = 0;                // Stages currently open
+static ProfileClock::time_point frameStart;
+static ProfileClock::time_point stageStart[kProfileMaxStages];
+static float stageMs[kProfileMaxStages];
+static long frameNumber = 0;
+static std::thread::id owner;        // Thread that called profileInit(); stages on others are ignored
+
+// GPU timestamps are read back a few frames late so the CPU never waits
+// on the GPU; frames sit here until their queries have been read
+const int kGpuLatency = 4;
+struct PendingFrame {
+    ProfileFrame record;
+    bool used[kProfileMaxStages];    // Stage was timed on the GPU this frame
+    GLuint beginQuery[kProfileMaxStages];
+    GLuint endQuery[kProfileMaxStages];
+};
+static PendingFrame pending[kGpuLatency];
+static bool gpuEnabled = false;
+
+// Ring buffer of finished frames. Each slot has a sequence number that is
+// odd while the slot is being written, so a reader on another thread can
+// copy a frame and retry if it was overwritten meanwhile.
+struct RingSlot {
+    std::atomic<unsigned> sequence;
+    ProfileFrame frame;
+};
+static RingSlot ring[kProfileHistory];
+static std::atomic<long> published(0);  // Frames written to the ring so far
+
+int profileStage(const char* name) {
+    for (int i = 0; i < stageCount; i++) {
+        if (strcmp(stages[i].name, name) == 0) return i;
+    }
+    if (stageCount == kProfileMaxStages) return kProfileMaxStages - 1;  // Full; share the last stage
+    stages[stageCount].name = name;
+    stages[stageCount].depth = -1;
+    return stageCount++;
+}
+
+const char* profileStageName(int stage) {
+    return stages[stage].name;
+}
+
+int profileStageCount() {
+    return stageCount;
+}
+
+void profileInit(bool gpuTimers) {
+    owner = std::this_thread::get_id();
+    gpuEnabled = gpuTimers && glExtHasTimerQuery;
+    if (!gpuEnabled) return;
+    for (int i = 0; i < kGpuLatency; i++) {
+        pglGenQueries(kProfileMaxStages, pending[i].beginQuery);
+        pglGenQueries(kProfileMaxStages, pending[i].endQuery);
+    }
+}
+
+void profileBeginFrame() {
+    frameStart = ProfileClock::now();
+}
+
+// Stages timed off the render thread (the simulation's) would interleave
+// with the frame's and issue GL queries without a context
+static bool offThread() {
+    return owner != std::thread::id() && std::this_thread::get_id() != owner;
+}
+
+void profileBegin(int stage) {
+    if (offThread()) return;
+    if (stages[stage].depth < 0) stages[stage].depth = depth;
+    depth++;
+    PendingFrame& frame = pending[frameNumber % kGpuLatency];
+    if (gpuEnabled && !frame.used[stage]) {
+        pglQueryCounter(frame.beginQuery[stage], GL_TIMESTAMP);
+        frame.used[stage] = true;
+    }
+    stageStart[stage] = ProfileClock::now();
+}
+
+void profileEnd(int stage) {
+    if (offThread()) return;
+    stageMs[stage] += std::chrono::duration<float, std::milli>(ProfileClock::now() - stageStart[stage]).count();
+    depth--;
+    // A stage entered several times is timed on the GPU from its first
+    // begin to its last end
+    PendingFrame& frame = pending[frameNumber % kGpuLatency];
+    if (gpuEnabled && frame.used[stage]) pglQueryCounter(frame.endQuery[stage], GL_TIMESTAMP);
+}
+
+void profileAddTime(int stage, float ms) {
+    if (offThread()) return;
+    if (stages[stage].depth < 0) stages[stage].depth = 0;
+    stageMs[stage] += ms;
+}
+
+static void publish(const ProfileFrame& frame) {
+    long n = published.load(std::memory_order_relaxed);
+    RingSlot& slot = ring[n % kProfileHistory];
+    unsigned sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);  // Odd: being written
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.frame = frame;
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    published.store(n + 1, std::memory_order_release);
+}
+
+// Read back a pending frame's timestamps (waits if the GPU is still behind)
+static void resolveGpu(PendingFrame& frame) {
+    for (int i = 0; i < stageCount; i++) {
+        if (!frame.used[i]) continue;
+        GLuint64 begin = 0, end = 0;
+        pglGetQueryObjectui64v(frame.beginQuery[i], GL_QUERY_RESULT, &begin);
+        pglGetQueryObjectui64v(frame.endQuery[i], GL_QUERY_RESULT, &end);
+        frame.record.gpuMs[i] = (float)((end - begin) / 1.0e6);
+        frame.used[i] = false;
+    }
+}
+
+void profileEndFrame() {
+    ProfileFrame record;
+    record.frame = frameNumber;
+    record.frameMs = std::chrono::duration<float, std::milli>(ProfileClock::now() - frameStart).count();
+    for (int i = 0; i < kProfileMaxStages; i++) {
+        record.cpuMs[i] = stageMs[i];
+        record.gpuMs[i] = -1.0f;
+        stageMs[i] = 0.0f;
+    }
+
+    if (!gpuEnabled) {
+        publish(record);
+    } else {
+        pending[frameNumber % kGpuLatency].record = record;
+        // The oldest pending frame's slot is reused next frame, so finish it now
+        long oldest = frameNumber - (kGpuLatency - 1);
+        if (oldest >= 0) {
+            PendingFrame& frame = pending[oldest % kGpuLatency];
+            resolveGpu(frame);
+            publish(frame.record);
+        }
+    }
+    frameNumber++;
+}
+
+int profileHistory(ProfileFrame* out, int maxFrames) {
+    long newest = published.load(std::memory_order_acquire);
+    long count = newest < kProfileHistory ? newest : kProfileHistory;
+    if (count > maxFrames) count = maxFrames;
+    for (long i = 0; i < count; i++) {
+        RingSlot& slot = ring[(newest - count + i) % kProfileHistory];
+        unsigned before, after;
+        do {
+            before = slot.sequence.load(std::memory_order_acquire);
+            out[i] = slot.frame;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = slot.sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+    }
+    return (int)count;
+}
+
+void profileAverage(int frames, ProfileFrame& out) {
+    static ProfileFrame recent[kProfileHistory];
+    int count = profileHistory(recent, frames < kProfileHistory ? frames : kProfileHistory);
+    int gpuSamples[kProfileMaxStages] = {};  // Frames that timed the stage on the GPU (-1 = not timed)
+    memset(&out, 0, sizeof(out));
+    out.frame = count;
+    if (count == 0) return;
+    for (int f = 0; f < count; f++) {
+        out.frameMs += recent[f].frameMs;
+        for (int s = 0; s < kProfileMaxStages; s++) {
+            out.cpuMs[s] += recent[f].cpuMs[s];
+            if (recent[f].gpuMs[s] < 0.0f) continue;
+            out.gpuMs[s] += recent[f].gpuMs[s];
+            gpuSamples[s]++;
+        }
+    }
+    out.frameMs /= count;
+    for (int s = 0; s < kProfileMaxStages; s++) {
+        out.cpuMs[s] /= count;
+        out.gpuMs[s] = gpuSamples[s] > 0 ? out.gpuMs[s] / gpuSamples[s] : -1.0f;
+    }
+}
+
+// Vertex layout for glInterleavedArrays(GL_C4UB_V2F)
+struct GraphVertex {
+    unsigned char rgba[4];
+    float x, y;
+};
+
+static const unsigned char stageColors[8][4] = {
+    {230, 80, 80, 255}, {80, 200, 80, 255}, {90, 120, 240, 255}, {230, 210, 70, 255},
+    {210, 90, 210, 255}, {70, 210, 210, 255}, {240, 150, 60, 255}, {170, 170, 170, 255}
+};
+
+void profileStageColor(int stage, float rgb[3]) {
+    for (int i = 0; i < 3; i++) rgb[i] = stageColors[stage % 8][i] / 255.0f;
+}
+
+static void addQuad(GraphVertex* v, int& n, float x0, float y0, float x1, float y1, const unsigned char* rgba) {
+    float corners[4][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+    for (int i = 0; i < 4; i++) {
+        memcpy(v[n].rgba, rgba, 4);
+        v[n].x = corners[i][0];
+        v[n].y = corners[i][1];
+        n++;
+    }
+}
+
+void profileDrawGraph(float x, float y, float width, float height) {
+    static ProfileFrame frames[kProfileHistory];
+    static GraphVertex vertices[(kProfileHistory * (kProfileMaxStages + 1) + 2) * 4];
+    const float kGraphMs = 1000.0f / 30.0f;          // Full graph height: a 30 fps frame
+    const float kBudgetMs = 1000.0f / 60.0f;         // Line at the 60 fps budget
+    const unsigned char background[4] = {0, 0, 0, 160};
+    const unsigned char budget[4] = {255, 255, 255, 255};
+
+    int columns = (int)width < kProfileHistory ? (int)width : kProfileHistory;
+    int count = profileHistory(frames, columns);
+    float scale = height / kGraphMs;
+
+    int n = 0;
+    addQuad(vertices, n, x, y, x + width, y + height, background);
+    for (int f = 0; f < count; f++) {
+        float left = x + width - count + f, bottom = y;
+        for (int s = 0; s < stageCount; s++) {
+            if (stages[s].depth != 0) continue;  // Nested stages are inside their parent's bar
+            float top = bottom + frames[f].cpuMs[s] * scale;
+            if (top > y + height) top = y + height;
+            addQuad(vertices, n, left, bottom, left + 1.0f, top, stageColors[s % 8]);
+            bottom = top;
+        }
+    }
+    float budgetY = y + kBudgetMs * scale;
+    addQuad(vertices, n, x, budgetY, x + width, budgetY + 1.0f, budget);
+
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (softBackend) {
+        RasterArrays arrays = {};
+        arrays.position = &vertices[0].x;
+        arrays.positionSize = 2;
+        arrays.positionStride = sizeof(GraphVertex);
+        arrays.rgba = vertices[0].rgba;
+        arrays.rgbaStride = sizeof(GraphVertex);
+        softBackendDraw(GL_QUADS, arrays, n);
+    } else {
+        glInterleavedArrays(GL_C4UB_V2F, 0, vertices);
+        glDrawArrays(GL_QUADS, 0, n);
+    }
+    glPopClientAttrib();
+    glPopAttrib();
+}
+
+bool profileWriteCsv(const char* path) {
+    static ProfileFrame frames[kProfileHistory];
+    int count = profileHistory(frames, kProfileHistory);
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+
+    fprintf(file, "frame,frame_ms");
+    for (int s = 0; s < stageCount; s++) fprintf(file, ",%s_cpu_ms", stages[s].name);
+    if (gpuEnabled) {
+        for (int s = 0; s < stageCount; s++) fprintf(file, ",%s_gpu_ms", stages[s].name);
+    }
+    fprintf(file, "\n");
+
+    for (int f = 0; f < count; f++) {
+        fprintf(file, "%ld,%.4f", frames[f].frame, frames[f].frameMs);
+        for (int s = 0; s < stageCount; s++) fprintf(file, ",%.4f", frames[f].cpuMs[s]);
+        if (gpuEnabled) {
+            for (int s = 0; s < stageCount; s++) fprintf(file, ",%.4f", frames[f].gpuMs[s]);
+        }
+        fprintf(file, "\n");
+    }
+    return fclose(file) == 0;
+}
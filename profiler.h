@@ -0,0 +1,68 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Per-stage frame profiler. Code marks stages with ProfileScope (or
+// profileBegin/profileEnd); each frame's CPU times, plus GPU times from GL
+// timestamp queries when the driver has them, go into a fixed ring buffer
+// of recent frames that can be drawn as a graph or written out as CSV.
+// Recording happens on the render thread (the one that called
+// profileInit(); stages entered on other threads are ignored, but their
+// measured time can be handed over with profileAddTime()); readers never
+// block it.
+
+const int kProfileMaxStages = 16;
+const int kProfileHistory = 512;     // Frames kept in the ring buffer
+
+struct ProfileFrame {
+    long frame;                      // Frame number, from 0
+    float frameMs;                   // CPU time from profileBeginFrame() to profileEndFrame()
+    float cpuMs[kProfileMaxStages];  // Time inside each stage (summed if entered more than once)
+    float gpuMs[kProfileMaxStages];  // GPU time per stage, -1 without timer queries
+};
+
+// Register a stage (or look up one with the same name) and return its id.
+// Stages entered inside another stage are nested and not stacked in the graph.
+int profileStage(const char* name);
+const char* profileStageName(int stage);
+int profileStageCount();
+
+// Enable GPU timing (needs glExtHasTimerQuery and a current context) and
+// make the calling thread the one whose stages are recorded
+void profileInit(bool gpuTimers);
+
+// Frame boundaries. Stage time recorded between frames (e.g. in a timer
+// callback) is counted in the next frame.
+void profileBeginFrame();
+void profileEndFrame();
+
+void profileBegin(int stage);
+void profileEnd(int stage);
+
+// Count ms of CPU time measured elsewhere (e.g. on the simulation thread)
+// in stage for the current frame, as a top-level stage (render thread)
+void profileAddTime(int stage, float ms);
+
+struct ProfileScope {
+    int stage;
+    explicit ProfileScope(int s) : stage(s) { profileBegin(s); }
+    ~ProfileScope() { profileEnd(stage); }
+};
+
+// Copy up to maxFrames of the newest recorded frames, oldest first; returns the count
+int profileHistory(ProfileFrame* out, int maxFrames);
+
+// Mean of the newest frames (frame field holds how many were averaged); a
+// stage's GPU mean covers only the frames that timed it, -1 if none did
+void profileAverage(int frames, ProfileFrame& out);
+
+// Graph color of a stage, for legends
+void profileStageColor(int stage, float rgb[3]);
+
+// Stacked bar per frame of the top-level stages' CPU time, one pixel
+// column per frame, in the current projection (expects pixel units)
+void profileDrawGraph(float x, float y, float width, float height);
+
+// Write every frame still in the ring buffer; returns false if the file can't be written
+bool profileWriteCsv(const char* path);
+
+#endif
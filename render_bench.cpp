@@ -0,0 +1,416 @@
+// Offscreen rendering benchmark for the 2D and 3D scenes.
+// Creates a GL context with no window through EGL (Mesa's llvmpipe on a
+// machine without a GPU), renders N frames of one scene into a pbuffer
+// while following a scripted camera path and fan-speed sequence, and
+// prints the frame-time statistics as one line of JSON. The farm scene
+// renders the 3D fan farm at a range of fan counts, with and without
+// instancing, and prints one line per run with its draw calls. With
+// --software anywhere on the command line, the scenes draw through the
+// built-in tile rasterizer (soft_backend.h) on every core instead. The
+// scenes' simulation threads are not started: each frame runs one tick,
+// publishes its snapshot and draws it, all on this thread, so runs repeat.
+//
+// Usage: render_bench [2d|2d-cache|2d-nocache|3d|farm] [frames] [warmup frames] [last frame.ppm]
+//                     [input log (2d/3d)] [video.y4m (2d/3d)] [--software]
+// An input log replaces the scripted camera and fan speeds with a recorded
+// session (frames 0 = all of it); "-" skips an optional file argument.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/glut.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "fan_sim.h"
+#include "particles.h"
+#include "thread_pool.h"
+#include "trig_tables.h"
+#include "hud_text.h"
+#include "gl_ext.h"
+#include "profiler.h"
+#include "mesh_cache.h"
+#include "frame_clock.h"
+#include "fan_farm.h"
+#include "vertex_batch.h"
+#include "static_layer.h"
+#include "blade_profile.h"
+#include "input_log.h"
+#include "frame_capture.h"
+#include "alloc_tracker.h"
+#include "frame_arena.h"
+#include "air_fluid.h"
+#include "room_thermal.h"
+#include "soft_backend.h"
+#include "command_queue.h"
+#include "triple_buffer.h"
+#include "sim_thread.h"
+
+// The scenes are compiled into this file, each in its own namespace, so
+// their drawing code can be called without GLUT. Every header they include
+// is already included above, so the include guards keep those at global scope.
+namespace scene2d {
+#include "2D main.cpp"
+}
+namespace scene3d {
+#include "3D main.cpp"
+}
+
+// GLUT's bitmap fonts need glutInit() (and with it an X display), so HUD
+// text is rasterized from plain boxes of roughly Helvetica's metrics.
+// The text batch still draws the same number of quads.
+static const int benchFontHeight[TEXT_FONT_COUNT] = {13, 15, 23};
+static const int benchFontWidth[TEXT_FONT_COUNT] = {6, 7, 10};
+
+static int benchGlyphHeight(TextFont font) {
+    return benchFontHeight[font];
+}
+
+static int benchGlyphWidth(TextFont font, int c) {
+    return c == ' ' ? benchFontWidth[font] / 2 : benchFontWidth[font];
+}
+
+static void benchGlyphDraw(TextFont font, int c) {
+    static const GLubyte solid[64] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    int advance = benchGlyphWidth(font, c);
+    int height = c == ' ' ? 0 : benchFontHeight[font] * 7 / 10;  // Cap height
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBitmap(advance - 1, height, 0, 0, (float)advance, 0, solid);  // Rows of at most 2 bytes
+}
+
+static const TextGlyphSource benchGlyphs = {benchGlyphHeight, benchGlyphWidth, benchGlyphDraw};
+
+// Save the framebuffer as a binary PPM, to check what was rendered
+static bool writeSnapshot(const char* path, int width, int height) {
+    std::vector<unsigned char> pixels(width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--) fwrite(&pixels[y * width * 3], 1, width * 3, file);  // Top row first
+    return fclose(file) == 0;
+}
+
+static void* eglResolver(const char* name) {
+    return (void*)eglGetProcAddress(name);
+}
+
+// Make a current compatibility-profile context rendering into a pbuffer
+static bool createContext(int width, int height) {
+    EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) return false;
+
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT) return false;
+    return eglMakeCurrent(display, surface, surface, context) == EGL_TRUE;
+}
+
+// Fan levels the script steps through, one every two seconds at 60 fps
+static const int kLevelScript[] = {3, 5, 1, 4, 0, 2};
+static const int kFramesPerLevel = 120;
+
+static int scriptedLevel(int frame) {
+    return kLevelScript[(frame / kFramesPerLevel) % (sizeof(kLevelScript) / sizeof(kLevelScript[0]))];
+}
+
+// Milliseconds for renderFrame() plus glFinish(), so a software
+// rasterizer's deferred work is counted in the frame that queued it
+template <typename Render>
+static double timeFrame(Render render) {
+    auto start = std::chrono::steady_clock::now();
+    render();
+    glFinish();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Recorded input to replay instead of the level script (null = script)
+static InputLog* replayLog = 0;
+
+// Video recording of the frames, to measure what capturing costs (inactive unless requested)
+static FrameCapture benchCapture;
+
+// Heap allocations per frame (simulation tick and drawing), checked after the warm-up frames
+static AllocMeter benchAllocs = {};
+
+// Draw with the software rasterizer (--software)
+static bool benchSoftware = false;
+
+static void run2D(int frames, std::vector<double>& times) {
+    using namespace scene2d;
+    batchInit(shapeBatch);
+    particlesInit(airParticles, kMaxAirParticles);
+    particleThreads = new ThreadPool((int)std::thread::hardware_concurrency());
+    fluidInit(airFluid, kAirGridWidth, kAirGridHeight, 800.0f / kAirGridWidth);
+    if (benchSoftware) softBackendStart(windowWidth, windowHeight, particleThreads);
+    reshape(windowWidth, windowHeight);
+    textInit(&benchGlyphs);
+    snapshotsInit();
+
+    const InputHandlers handlers = {keyboard, mouse, 0, reshape};
+    animating = true;  // Input handlers then leave frame scheduling alone (no GLUT here)
+    for (int f = 0; f < frames; f++) {
+        if (replayLog) {
+            inputLogReplay(*replayLog, physicsTicks, handlers);
+        } else {
+            setTargetSpeed(scriptedLevel(f));
+        }
+        allocFrameBegin(benchAllocs);
+        stepSimulation();
+        publishSnapshot(0.0);
+        acquireSnapshot();
+        times.push_back(timeFrame([] {
+            renderFrame();
+            captureFrame(benchCapture, windowWidth, windowHeight);
+        }));
+        allocFrameEnd(benchAllocs);
+    }
+}
+
+static void setup3D() {
+    using namespace scene3d;
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glShadeModel(GL_SMOOTH);
+    batchInit(shapeBatch);
+    buildMeshes();
+    roomThreads = new ThreadPool((int)std::thread::hardware_concurrency());
+    roomInit(roomAir, kRoomVoxel);
+    if (benchSoftware) softBackendStart(windowWidth, windowHeight, roomThreads);
+    reshape(windowWidth, windowHeight);
+    textInit(&benchGlyphs);
+    snapshotsInit();
+}
+
+// Vertices the 3D scene submitted in each frame rendered by run3D()
+static std::vector<double> vertexCounts;
+
+// Render frames of the 3D scene (the desk fan, or the farm in farm mode),
+// orbiting at the given mean camera distance
+static void run3D(int frames, float distance, std::vector<double>& times) {
+    using namespace scene3d;
+    const InputHandlers handlers = {keyboard, mouse, mouseMotion, reshape};
+    animating = true;  // Input handlers then leave frame scheduling alone (no GLUT here)
+    for (int f = 0; f < frames; f++) {
+        if (replayLog) {
+            // The recorded session drives the fan, the camera and farm mode
+            inputLogReplay(*replayLog, physicsTicks, handlers);
+            allocFrameBegin(benchAllocs);
+            stepSimulation();
+            publishSnapshot(0.0);
+            acquireSnapshot();
+            times.push_back(timeFrame([] {
+                renderFrame();
+                captureFrame(benchCapture, windowWidth, windowHeight);
+            }));
+            allocFrameEnd(benchAllocs);
+            vertexCounts.push_back((double)frameVertices);
+            continue;
+        }
+        fanSetLevel(fan, scriptedLevel(f));
+        allocFrameBegin(benchAllocs);
+        stepSimulation();
+        // One orbit around the fan over the run, bobbing up/down and in/out
+        float t = (float)f / frames;
+        cameraAngleY = -30.0f + 360.0f * t;
+        cameraAngleX = 25.0f + 20.0f * sinf(4.0f * 3.1415926f * t);
+        cameraDistance = distance * (1.0f + 0.4f * sinf(6.0f * 3.1415926f * t));
+        publishSnapshot(0.0);
+        acquireSnapshot();
+        times.push_back(timeFrame([] {
+            renderFrame();
+            captureFrame(benchCapture, windowWidth, windowHeight);
+        }));
+        allocFrameEnd(benchAllocs);
+        vertexCounts.push_back((double)frameVertices);
+    }
+}
+
+// Fan counts the farm scene steps through
+static const int kFarmSizes[] = {1, 10, 100, 1000, 10000};
+
+struct FrameStats {
+    double mean, p50, p99, max;
+};
+
+static double meanAfter(const std::vector<double>& values, int warmup) {
+    double total = 0.0;
+    for (size_t i = warmup; i < values.size(); i++) total += values[i];
+    return total / (values.size() - warmup);
+}
+
+static FrameStats frameStats(const std::vector<double>& times, int warmup) {
+    std::vector<double> measured(times.begin() + warmup, times.end());
+    double total = 0.0;
+    for (double t : measured) total += t;
+    std::sort(measured.begin(), measured.end());
+    FrameStats stats;
+    stats.mean = total / measured.size();
+    stats.p50 = measured[measured.size() / 2];
+    stats.p99 = measured[std::min(measured.size() - 1, (size_t)ceil(measured.size() * 0.99) - 1)];
+    stats.max = measured.back();
+    return stats;
+}
+
+// Every farm size, instanced (when the driver can) and one draw per part per fan
+static void runFarm(int frames, int warmup, std::vector<double>& times) {
+    using namespace scene3d;
+    farmMode = true;
+    for (int fans : kFarmSizes) {
+        for (int instanced = 1; instanced >= 0; instanced--) {
+            farmSize = fans;
+            buildFarm();
+            snapshotsInit();  // Sized for the new farm
+            if (instanced && (!farm.instanced || softBackend)) continue;  // No instancing here
+            farm.instanced = instanced != 0;
+
+            times.clear();
+            vertexCounts.clear();
+            float extent = ceilf(sqrtf((float)fans)) * 3.0f;  // Grid width at 3 units per fan
+            benchAllocs.frames = 0;  // A new farm warms up again (instance data, culling lists)
+            run3D(warmup + frames, 15.0f + extent, times);
+            FrameStats stats = frameStats(times, warmup);
+            printf("{\"scene\": \"farm\", \"fans\": %d, \"path\": \"%s\", \"draw_calls\": %d, "
+                   "\"vertices_per_frame\": %.0f, \"frames\": %d, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+                   "\"p99_ms\": %.4f, \"max_ms\": %.4f, \"fps\": %.1f}\n",
+                   fans, instanced ? "instanced" : "per_fan", farm.drawCalls, meanAfter(vertexCounts, warmup),
+                   frames, stats.mean, stats.p50, stats.p99, stats.max, 1000.0 / stats.mean);
+            fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    benchSoftware = softBackendArgument(argc, argv);
+    const char* scene = argc > 1 ? argv[1] : "3d";
+    // 2D with the background layer cached only when faster, always, or never
+    LayerMode layerMode = strcmp(scene, "2d-cache") == 0 ? LAYER_CACHED :
+                          strcmp(scene, "2d-nocache") == 0 ? LAYER_DRAWN : LAYER_AUTO;
+    bool is2D = strcmp(scene, "2d") == 0 || layerMode != LAYER_AUTO;
+    bool isFarm = strcmp(scene, "farm") == 0;
+    int frames = argc > 2 ? atoi(argv[2]) : (isFarm ? 30 : 600);  // Per run for the farm
+    int warmup = argc > 3 ? atoi(argv[3]) : (isFarm ? 3 : 30);    // Not counted: atlas, meshes, caches
+    const char* logPath = argc > 5 && strcmp(argv[5], "-") != 0 ? argv[5] : 0;  // Recorded session to replay
+    const char* capturePath = argc > 6 && strcmp(argv[6], "-") != 0 ? argv[6] : 0;  // Video of the frames
+    if ((!is2D && !isFarm && strcmp(scene, "3d") != 0) || (frames <= 0 && !logPath) || warmup < 0 ||
+        (isFarm && (logPath || capturePath))) {
+        fprintf(stderr, "usage: %s [2d|2d-cache|2d-nocache|3d|farm] [frames] [warmup frames] [last frame.ppm] "
+                        "[input log (2d/3d)] [video.y4m (2d/3d)] [--software]\n", argv[0]);
+        return 1;
+    }
+
+    int width = is2D ? scene2d::windowWidth : scene3d::windowWidth;
+    int height = is2D ? scene2d::windowHeight : scene3d::windowHeight;
+    static InputLog log;
+    if (logPath) {
+        if (!inputLogLoad(log, logPath)) {
+            fprintf(stderr, "could not read input log %s\n", logPath);
+            return 1;
+        }
+        // One frame per recorded tick, up to the whole session (frames 0 = all of it)
+        int logFrames = (int)log.ticks - warmup;
+        if (logFrames <= 0) {
+            fprintf(stderr, "%s lasts %u ticks, not more than the %d warmup frames\n", logPath, log.ticks, warmup);
+            return 1;
+        }
+        if (log.tickHz != kFanTickHz) {
+            fprintf(stderr, "%s was recorded at %.0f ticks per second, not %.0f\n", logPath, log.tickHz, kFanTickHz);
+            return 1;
+        }
+        frames = frames > 0 && frames < logFrames ? frames : logFrames;
+        inputLogMaxSize(log, width, height);  // Room for the window at its largest
+        replayLog = &log;
+    }
+    if (!createContext(width, height)) {
+        fprintf(stderr, "could not create an offscreen OpenGL context through EGL\n");
+        return 1;
+    }
+
+    glExtLoad(eglResolver);  // Before either scene's setup
+    if (capturePath && !captureStart(benchCapture, capturePath, width, height, (int)kFanTickHz)) {
+        fprintf(stderr, "could not write %s\n", capturePath);
+        return 1;
+    }
+
+    std::vector<double> times;
+    times.reserve(warmup + frames);
+    vertexCounts.reserve(warmup + frames);
+    benchAllocs.warmupFrames = warmup > 0 ? warmup : 1;  // The first frame builds the atlas either way
+    if (is2D) {
+        scene2d::backgroundLayer.mode = layerMode;
+        run2D(warmup + frames, times);
+    } else {
+        setup3D();
+        if (isFarm) {
+            runFarm(frames, warmup, times);
+        } else {
+            run3D(warmup + frames, 25.0f, times);
+        }
+    }
+
+    if (argc > 4 && strcmp(argv[4], "-") != 0 && !writeSnapshot(argv[4], width, height)) {
+        fprintf(stderr, "could not write %s\n", argv[4]);
+        return 1;
+    }
+
+    if (isFarm) return 0;  // One line per run already printed
+
+    FrameStats stats = frameStats(times, warmup);
+    char renderer[64];
+    if (softBackend) {
+        snprintf(renderer, sizeof(renderer), "software, %d threads", softBackend->threads->threadCount());
+    } else {
+        snprintf(renderer, sizeof(renderer), "%s", (const char*)glGetString(GL_RENDERER));
+    }
+    printf("{\"scene\": \"%s\", \"renderer\": \"%s\", \"width\": %d, \"height\": %d, "
+           "\"frames\": %d, \"warmup\": %d, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, "
+           "\"max_ms\": %.4f, \"fps\": %.1f",
+           scene, renderer, width, height, frames, warmup,
+           stats.mean, stats.p50, stats.p99, stats.max, 1000.0 / stats.mean);
+    if (!is2D) printf(", \"vertices_per_frame\": %.0f", meanAfter(vertexCounts, warmup));  // Cached meshes only
+    if (is2D) {
+        const StaticLayer& layer = scene2d::backgroundLayer;
+        printf(", \"background\": \"%s\", \"background_copy_ms\": %.3f, \"background_draw_ms\": %.3f",
+               layer.cached ? "cached" : "drawn", layer.copyMs, layer.drawMs);  // Measured at capture
+    }
+    const VertexBatch& shapes = is2D ? scene2d::shapeBatch : scene3d::shapeBatch;
+    printf(", \"shape_draw_calls\": %d, \"shape_vertices\": %d", shapes.frameDrawCalls, shapes.frameVertices);  // Last frame
+    if (softBackend) {
+        printf(", \"raster_triangles\": %d, \"raster_bin_entries\": %d", softBackend->flushTriangles,
+               softBackend->flushBinEntries);  // Last frame
+    }
+    printf(", \"heap_allocs_after_warmup\": %ld, \"heap_allocs_max_frame\": %ld",
+           benchAllocs.steadyTotal, benchAllocs.steadyMax);
+    if (replayLog) printf(", \"input_events\": %zu", replayLog->next);  // Replayed within the frames run
+    if (benchCapture.active) {
+        captureStop(benchCapture);  // Writes out the queue: not timed
+        printf(", \"capture_frames\": %ld, \"capture_written\": %ld, \"capture_dropped\": %ld",
+               benchCapture.frames, benchCapture.written.load(), benchCapture.dropped);
+    }
+    printf("}\n");
+    return 0;
+}
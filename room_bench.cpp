@@ -0,0 +1,121 @@
+// Benchmark for the room air simulation in room_thermal.cpp.
+//
+// Time to cool: starts the room hot with the 3D fan held at levels 0 (off),
+// 1, 3 and 5, and reports the simulated time until the air at the desk
+// (roomDeskZone()) and the room as a whole have lost half and 90% of their
+// excess heat over the walls, with the throughput it took.
+//
+// Scaling: runs the fan at full speed on grids of 1, 0.5, 0.25 and 0.125
+// unit voxels with 1..N threads and reports voxel updates per second. Every
+// thread count must end in the same state; the run fails otherwise.
+//
+// Usage: room_bench [voxel size] [max threads] [max simulated seconds]
+
+#include "room_thermal.h"
+#include "fan_sim.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+const float kBenchTick = 0.1f;   // Simulated seconds per roomStep()
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Fraction of the starting excess over the wall temperature still left
+static float excessLeft(float temp) {
+    return (temp - kRoomWallTemp) / (kRoomStartTemp - kRoomWallTemp);
+}
+
+static void printTime(double seconds) {
+    if (seconds < 0.0) printf(" %10s", "-");
+    else printf(" %10.0f", seconds);
+}
+
+static void timeToCool(float voxelSize, int threads, float maxSeconds) {
+    RoomThermal room;
+    roomInit(room, voxelSize);
+    ThreadPool pool(threads);
+    RoomBox zone = roomDeskZone();
+    float speedPerLevel = fanParams3D().speedPerLevel;
+    printf("time to cool: %dx%dx%d voxels of %.3f units, %d threads, up to %.0f simulated s\n",
+           room.nx, room.ny, room.nz, voxelSize, threads, maxSeconds);
+    printf("%6s %10s %10s %10s %10s %10s %12s\n", "level", "desk 50%", "desk 90%", "room 50%", "room 90%",
+           "wall s", "Mvoxel/s");
+    for (int level : {0, 1, 3, 5}) {
+        roomReset(room);
+        RoomFan fan = roomFan3D(level * speedPerLevel);
+        double deskHalf = -1.0, deskCool = -1.0, roomHalf = -1.0, roomCool = -1.0;
+        auto start = std::chrono::steady_clock::now();
+        while (room.time < maxSeconds && (deskCool < 0.0 || roomCool < 0.0)) {
+            roomStep(room, fan, kBenchTick, &pool);
+            float desk = excessLeft(roomMeanTemp(room, zone)), whole = excessLeft(roomMeanTemp(room));
+            if (deskHalf < 0.0 && desk <= 0.5f) deskHalf = room.time;
+            if (deskCool < 0.0 && desk <= 0.1f) deskCool = room.time;
+            if (roomHalf < 0.0 && whole <= 0.5f) roomHalf = room.time;
+            if (roomCool < 0.0 && whole <= 0.1f) roomCool = room.time;
+        }
+        double wall = secondsSince(start);
+        printf("%6d", level);
+        printTime(deskHalf);
+        printTime(deskCool);
+        printTime(roomHalf);
+        printTime(roomCool);
+        printf(" %10.2f %12.1f\n", wall, room.voxelUpdates / wall * 1e-6);
+        fflush(stdout);
+    }
+}
+
+// Voxel updates per second for every grid size and thread count; false if
+// any thread count ends in a different state from one thread
+static bool scaling(int maxThreads) {
+    const float sizes[] = {1.0f, 0.5f, 0.25f, 0.125f};
+    const float simulated = 2.0f;  // Seconds per run
+    RoomFan fan = roomFan3D(5 * fanParams3D().speedPerLevel);
+    printf("\nscaling: fan at level 5, %.0f simulated s per run\n", simulated);
+    printf("%10s %8s %8s %10s %12s %10s %10s\n", "voxels", "threads", "substeps", "ms/step", "Mvoxel/s", "speedup",
+           "residual");
+    bool identical = true;
+    for (float size : sizes) {
+        std::vector<float> reference;
+        double single = 0.0;
+        for (int threads = 1;; threads = std::min(threads * 2, maxThreads)) {  // 1, 2, 4, ..., maxThreads
+            RoomThermal room;
+            roomInit(room, size);
+            ThreadPool pool(threads);
+            int steps = (int)(simulated / kBenchTick);
+            auto start = std::chrono::steady_clock::now();
+            for (int s = 0; s < steps; s++) roomStep(room, fan, kBenchTick, &pool);
+            double wall = secondsSince(start);
+            double rate = room.voxelUpdates / wall;
+            if (threads == 1) single = rate;
+            printf("%10d %8d %8d %10.3f %12.1f %9.2fx %10.2e\n", room.nx * room.ny * room.nz, threads, room.substeps,
+                   wall * 1000.0 / steps, rate * 1e-6, rate / single, room.residual);
+            fflush(stdout);
+
+            if (reference.empty()) reference = room.temp;
+            else if (memcmp(reference.data(), room.temp.data(), reference.size() * sizeof(float)) != 0) identical = false;
+            if (threads == maxThreads) break;
+        }
+    }
+    printf("same result on every thread count: %s\n", identical ? "yes" : "NO");
+    return identical;
+}
+
+int main(int argc, char** argv) {
+    float voxelSize = argc > 1 ? (float)atof(argv[1]) : 0.5f;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    float maxSeconds = argc > 3 ? (float)atof(argv[3]) : 3600.0f;
+    if (voxelSize <= 0.0f || maxThreads < 1 || maxSeconds <= 0.0f) {
+        fprintf(stderr, "usage: %s [voxel size] [max threads] [max simulated seconds]\n", argv[0]);
+        return 1;
+    }
+    timeToCool(voxelSize, maxThreads, maxSeconds);
+    return scaling(maxThreads) ? 0 : 1;
+}
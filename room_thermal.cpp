@@ -0,0 +1,708 @@
+#include "room_thermal.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The room, in the 3D scene's coordinates: the desk stands on the floor in
+// the middle, the fan blows toward +z (the camera's starting side)
+static const RoomBox kRoomBounds = {{-10.0f, -4.0f, -8.0f}, {10.0f, 6.0f, 8.0f}};
+
+// Solid parts of drawDesk(): the top and the four legs (the fan's stand is
+// thinner than a voxel and left out)
+static const RoomBox kDeskParts[] = {
+    {{-4.0f, -2.15f, -2.0f}, {4.0f, -1.85f, 2.0f}},
+    {{-3.9f, -4.0f, -1.9f}, {-3.7f, -2.0f, -1.7f}},
+    {{3.7f, -4.0f, -1.9f}, {3.9f, -2.0f, -1.7f}},
+    {{-3.9f, -4.0f, 1.7f}, {-3.7f, -2.0f, 1.9f}},
+    {{3.7f, -4.0f, 1.7f}, {3.9f, -2.0f, 1.9f}},
+};
+
+const float kAirPerSpeed = 0.25f;   // Air speed at the blades (units/s) per degree per tick of rotation
+const float kJacobiWeight = 0.85f;  // Near 6/7, which damps the high frequencies of a 7-point laplacian best
+const int kSmoothSweeps = 2;        // Per side of each correction: 1 leaves 40x the residual, 3 costs 50% more
+const int kCoarsestSweeps = 16;     // The coarsest level: more leave the same residual (see vCycle())
+const float kTiny = 1e-20f;         // Slower air than this (units/s) is still
+
+// func(tile, firstRow, endRow, firstSlab, endSlab) for every tile of a
+// grid of ny rows by nz slabs
+template <typename Func>
+static void forTiles(ThreadPool* threads, int ny, int nz, const Func& func) {
+    int rowTiles = (ny + kRoomTileRows - 1) / kRoomTileRows;
+    int slabTiles = (nz + kRoomTileSlabs - 1) / kRoomTileSlabs;
+    auto tile = [&](int t) {
+        int firstRow = (t % rowTiles) * kRoomTileRows, firstSlab = (t / rowTiles) * kRoomTileSlabs;
+        func(t, firstRow, std::min(firstRow + kRoomTileRows, ny), firstSlab, std::min(firstSlab + kRoomTileSlabs, nz));
+    };
+    int tiles = rowTiles * slabTiles;
+    if (threads && tiles > 1) threads->parallelFor(tiles, tile);
+    else for (int t = 0; t < tiles; t++) tile(t);
+}
+
+static inline int levelIndex(const RoomLevel& level, int x, int y, int z) {
+    return (z + 1) * level.strideZ + (y + 1) * level.strideY + x + 1;
+}
+
+void roomInit(RoomThermal& room, float voxelSize) {
+    room.voxelSize = voxelSize;
+    for (int a = 0; a < 3; a++) room.origin[a] = kRoomBounds.min[a];
+    room.nx = std::max(1, (int)lroundf((kRoomBounds.max[0] - kRoomBounds.min[0]) / voxelSize));
+    room.ny = std::max(1, (int)lroundf((kRoomBounds.max[1] - kRoomBounds.min[1]) / voxelSize));
+    room.nz = std::max(1, (int)lroundf((kRoomBounds.max[2] - kRoomBounds.min[2]) / voxelSize));
+    room.strideY = room.nx + 2;
+    room.strideZ = room.strideY * (room.ny + 2);
+    room.diffusivity = 0.02f;
+    room.mixingLength = 0.05f;
+    room.drag = 0.05f;
+    room.thrustRate = 20.0f;
+
+    size_t size = (size_t)room.strideZ * (room.nz + 2);
+    room.temp.assign(size, 0.0f);
+    room.u.assign(size, 0.0f);
+    room.v.assign(size, 0.0f);
+    room.w.assign(size, 0.0f);
+    room.nextTemp.assign(size, 0.0f);
+    room.nextU.assign(size, 0.0f);
+    room.nextV.assign(size, 0.0f);
+    room.nextW.assign(size, 0.0f);
+    int tiles = ((room.ny + kRoomTileRows - 1) / kRoomTileRows) * ((room.nz + kRoomTileSlabs - 1) / kRoomTileSlabs);
+    room.tileSpeed.assign(tiles * 3, 0.0f);
+    room.tileSums.assign(tiles * 2, 0.0);
+
+    // Multigrid levels halve the grid while every side stays even and at
+    // least 4 voxels. The room is 20x10x16 units, so with any of the voxel
+    // sizes 1, 0.5, 0.25 or 0.125 the last level is 10x5x8 voxels (400)
+    room.levels.clear();
+    int nx = room.nx, ny = room.ny, nz = room.nz;
+    float h2 = 1.0f;
+    for (;;) {
+        RoomLevel level;
+        level.nx = nx;
+        level.ny = ny;
+        level.nz = nz;
+        level.strideY = nx + 2;
+        level.strideZ = (nx + 2) * (ny + 2);
+        level.h2 = h2;
+        size_t levelSize = (size_t)level.strideZ * (nz + 2);
+        level.p.assign(levelSize, 0.0f);
+        level.rhs.assign(levelSize, 0.0f);
+        level.next.assign(levelSize, 0.0f);
+        level.residual.assign(levelSize, 0.0f);
+        level.air.assign(levelSize, 0.0f);
+        level.neighbours.assign(levelSize, 0.0f);
+        level.inverse.assign(levelSize, 0.0f);
+        room.levels.push_back(level);
+        if (nx % 2 || ny % 2 || nz % 2 || nx / 2 < 4 || ny / 2 < 4 || nz / 2 < 4) break;
+        nx /= 2;
+        ny /= 2;
+        nz /= 2;
+        h2 *= 4.0f;
+    }
+
+    // A voxel is solid when a desk part covers any of its middle half, so
+    // legs thinner than a voxel still block the air
+    room.open.assign(size, 1.0f);
+    RoomLevel& fine = room.levels[0];
+    float h = voxelSize;
+    for (int z = 0; z < room.nz; z++) {
+        for (int y = 0; y < room.ny; y++) {
+            for (int x = 0; x < room.nx; x++) {
+                float center[3] = {room.origin[0] + (x + 0.5f) * h, room.origin[1] + (y + 0.5f) * h,
+                                   room.origin[2] + (z + 0.5f) * h};
+                bool solid = false;
+                for (const RoomBox& part : kDeskParts) {
+                    bool covered = true;
+                    for (int a = 0; a < 3; a++) {
+                        covered = covered && part.min[a] < center[a] + 0.25f * h && part.max[a] > center[a] - 0.25f * h;
+                    }
+                    solid = solid || covered;
+                }
+                room.open[roomIndex(room, x, y, z)] = solid ? 0.0f : 1.0f;
+                fine.air[roomIndex(room, x, y, z)] = solid ? 0.0f : 1.0f;
+            }
+        }
+    }
+    for (size_t l = 1; l < room.levels.size(); l++) {
+        const RoomLevel& child = room.levels[l - 1];
+        RoomLevel& level = room.levels[l];
+        for (int z = 0; z < level.nz; z++) {
+            for (int y = 0; y < level.ny; y++) {
+                for (int x = 0; x < level.nx; x++) {
+                    float air = 0.0f;
+                    for (int c = 0; c < 8; c++) {
+                        air = std::max(air, child.air[levelIndex(child, 2 * x + (c & 1), 2 * y + (c >> 1 & 1), 2 * z + (c >> 2))]);
+                    }
+                    level.air[levelIndex(level, x, y, z)] = air;
+                }
+            }
+        }
+    }
+    for (RoomLevel& level : room.levels) {
+        const int sy = level.strideY, sz = level.strideZ;
+        const float* air = level.air.data();
+        for (int z = 0; z < level.nz; z++) {
+            for (int y = 0; y < level.ny; y++) {
+                for (int x = 0; x < level.nx; x++) {
+                    int i = levelIndex(level, x, y, z);
+                    float count = air[i] * (air[i - 1] + air[i + 1] + air[i - sy] + air[i + sy] + air[i - sz] + air[i + sz]);
+                    level.neighbours[i] = count;
+                    level.inverse[i] = count > 0.0f ? 1.0f / count : 0.0f;
+                }
+            }
+        }
+    }
+    roomReset(room);
+}
+
+void roomReset(RoomThermal& room) {
+    // Ghosts of every array keep the wall's values: kRoomWallTemp, no velocity
+    std::fill(room.temp.begin(), room.temp.end(), kRoomWallTemp);
+    std::fill(room.nextTemp.begin(), room.nextTemp.end(), kRoomWallTemp);
+    for (int z = 0; z < room.nz; z++) {
+        for (int y = 0; y < room.ny; y++) {
+            int row = roomIndex(room, 0, y, z);
+            std::fill(room.temp.begin() + row, room.temp.begin() + row + room.nx, kRoomStartTemp);
+        }
+    }
+    std::fill(room.u.begin(), room.u.end(), 0.0f);
+    std::fill(room.v.begin(), room.v.end(), 0.0f);
+    std::fill(room.w.begin(), room.w.end(), 0.0f);
+    for (RoomLevel& level : room.levels) std::fill(level.p.begin(), level.p.end(), 0.0f);
+    for (int a = 0; a < 3; a++) room.maxSpeed[a] = 0.0f;
+    room.residual = 0.0f;
+    room.substeps = 0;
+    room.time = 0.0;
+    room.voxelUpdates = 0.0;
+}
+
+// One substep's constants, with the substep length folded in
+struct StencilConstants {
+    float diffusion;    // dt * diffusivity / h^2
+    float mixing;       // dt * mixingLength / h^2
+    float transport;    // dt / h
+    float keep;         // 1 - dt * drag
+};
+
+// The arrays a substep reads and writes
+struct StencilArrays {
+    const float* temp;
+    const float* u;
+    const float* v;
+    const float* w;
+    const float* open;
+    float* nextTemp;
+    float* nextU;
+    float* nextV;
+    float* nextW;
+    int sy, sz;         // Index steps in y and z
+};
+
+// Row kernels: count voxels from index first. Each neighbour n gets the weight
+//   a_n = dt * (D / h^2 + upwind speed toward the voxel / h),
+// D = diffusivity + mixingLength * (|u| + |v| + |w|), and
+//   q' = q + sum over n of a_n * (q_n - q)
+// for temperature (solid neighbours masked out: no heat flows into the desk)
+// and for each velocity component (solid voxels and walls hold 0: no slip).
+// The substep is short enough that the weights sum to at most 1, so every
+// new value lies between old ones. Velocities fading below kTiny are set
+// to 0 rather than left to become denormals, which are slow to compute with.
+static inline float flushTiny(float value) {
+    return fabsf(value) < kTiny ? 0.0f : value;
+}
+
+static void stencilRowScalar(const StencilArrays& a, const StencilConstants& k, int first, int count) {
+    const int sy = a.sy, sz = a.sz;
+    for (int i = first; i < first + count; i++) {
+        float uc = a.u[i], vc = a.v[i], wc = a.w[i];
+        float base = k.diffusion + k.mixing * (fabsf(uc) + fabsf(vc) + fabsf(wc));
+        float aW = base + std::max(uc, 0.0f) * k.transport, aE = base - std::min(uc, 0.0f) * k.transport;
+        float aS = base + std::max(vc, 0.0f) * k.transport, aN = base - std::min(vc, 0.0f) * k.transport;
+        float aB = base + std::max(wc, 0.0f) * k.transport, aF = base - std::min(wc, 0.0f) * k.transport;
+
+        const float* t = a.temp;
+        const float* o = a.open;
+        float tc = t[i];
+        float heat = aW * o[i - 1] * (t[i - 1] - tc) + aE * o[i + 1] * (t[i + 1] - tc) +
+                     aS * o[i - sy] * (t[i - sy] - tc) + aN * o[i + sy] * (t[i + sy] - tc) +
+                     aB * o[i - sz] * (t[i - sz] - tc) + aF * o[i + sz] * (t[i + sz] - tc);
+        a.nextTemp[i] = tc + o[i] * heat;
+
+        float keep = k.keep * o[i];
+        const float* q = a.u;
+        a.nextU[i] = flushTiny(keep * (uc + aW * (q[i - 1] - uc) + aE * (q[i + 1] - uc) + aS * (q[i - sy] - uc) +
+                             aN * (q[i + sy] - uc) + aB * (q[i - sz] - uc) + aF * (q[i + sz] - uc)));
+        q = a.v;
+        a.nextV[i] = flushTiny(keep * (vc + aW * (q[i - 1] - vc) + aE * (q[i + 1] - vc) + aS * (q[i - sy] - vc) +
+                             aN * (q[i + sy] - vc) + aB * (q[i - sz] - vc) + aF * (q[i + sz] - vc)));
+        q = a.w;
+        a.nextW[i] = flushTiny(keep * (wc + aW * (q[i - 1] - wc) + aE * (q[i + 1] - wc) + aS * (q[i - sy] - wc) +
+                             aN * (q[i + sy] - wc) + aB * (q[i - sz] - wc) + aF * (q[i + sz] - wc)));
+    }
+}
+
+// Four voxels at a time with SSE2, which every x86-64 compiler enables.
+// A voxel reads its six neighbours in five arrays and writes four, spread
+// over three slabs; the loads, not the arithmetic, set the pace.
+#ifdef __SSE2__
+
+// Sum of a_n * (q_n - q) over the six neighbours of the 4 voxels at index i
+static inline __m128 upwindSumSSE(const float* q, int i, int sy, int sz, __m128 qc,
+                                     __m128 aW, __m128 aE, __m128 aS, __m128 aN, __m128 aB, __m128 aF) {
+    __m128 x = _mm_add_ps(_mm_mul_ps(aW, _mm_sub_ps(_mm_loadu_ps(q + i - 1), qc)),
+                          _mm_mul_ps(aE, _mm_sub_ps(_mm_loadu_ps(q + i + 1), qc)));
+    __m128 y = _mm_add_ps(_mm_mul_ps(aS, _mm_sub_ps(_mm_loadu_ps(q + i - sy), qc)),
+                          _mm_mul_ps(aN, _mm_sub_ps(_mm_loadu_ps(q + i + sy), qc)));
+    __m128 z = _mm_add_ps(_mm_mul_ps(aB, _mm_sub_ps(_mm_loadu_ps(q + i - sz), qc)),
+                          _mm_mul_ps(aF, _mm_sub_ps(_mm_loadu_ps(q + i + sz), qc)));
+    return _mm_add_ps(_mm_add_ps(x, y), z);
+}
+
+static inline __m128 flushTinySSE(__m128 value, __m128 signBit, __m128 tiny) {
+    return _mm_and_ps(value, _mm_cmpge_ps(_mm_andnot_ps(signBit, value), tiny));
+}
+
+static void stencilRowSSE(const StencilArrays& a, const StencilConstants& k, int first, int count) {
+    const int sy = a.sy, sz = a.sz;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 diffusion = _mm_set1_ps(k.diffusion);
+    const __m128 mixing = _mm_set1_ps(k.mixing);
+    const __m128 transport = _mm_set1_ps(k.transport);
+    const __m128 keepAll = _mm_set1_ps(k.keep);
+    const __m128 tiny = _mm_set1_ps(kTiny);
+    const float* o = a.open;
+    int i = first, end = first + count;
+    for (; i + 4 <= end; i += 4) {
+        __m128 uc = _mm_loadu_ps(a.u + i), vc = _mm_loadu_ps(a.v + i), wc = _mm_loadu_ps(a.w + i);
+        __m128 speed = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signBit, uc), _mm_andnot_ps(signBit, vc)),
+                                  _mm_andnot_ps(signBit, wc));
+        __m128 base = _mm_add_ps(diffusion, _mm_mul_ps(mixing, speed));
+        __m128 aW = _mm_add_ps(base, _mm_mul_ps(_mm_max_ps(uc, zero), transport));
+        __m128 aE = _mm_sub_ps(base, _mm_mul_ps(_mm_min_ps(uc, zero), transport));
+        __m128 aS = _mm_add_ps(base, _mm_mul_ps(_mm_max_ps(vc, zero), transport));
+        __m128 aN = _mm_sub_ps(base, _mm_mul_ps(_mm_min_ps(vc, zero), transport));
+        __m128 aB = _mm_add_ps(base, _mm_mul_ps(_mm_max_ps(wc, zero), transport));
+        __m128 aF = _mm_sub_ps(base, _mm_mul_ps(_mm_min_ps(wc, zero), transport));
+        __m128 openC = _mm_loadu_ps(o + i);
+
+        // Temperature, with each weight masked by the neighbour being air
+        __m128 tc = _mm_loadu_ps(a.temp + i);
+        __m128 heat = upwindSumSSE(a.temp, i, sy, sz, tc,
+                                      _mm_mul_ps(aW, _mm_loadu_ps(o + i - 1)), _mm_mul_ps(aE, _mm_loadu_ps(o + i + 1)),
+                                      _mm_mul_ps(aS, _mm_loadu_ps(o + i - sy)), _mm_mul_ps(aN, _mm_loadu_ps(o + i + sy)),
+                                      _mm_mul_ps(aB, _mm_loadu_ps(o + i - sz)), _mm_mul_ps(aF, _mm_loadu_ps(o + i + sz)));
+        _mm_storeu_ps(a.nextTemp + i, _mm_add_ps(tc, _mm_mul_ps(openC, heat)));
+
+        __m128 keep = _mm_mul_ps(keepAll, openC);
+        __m128 nu = _mm_mul_ps(keep, _mm_add_ps(uc, upwindSumSSE(a.u, i, sy, sz, uc, aW, aE, aS, aN, aB, aF)));
+        __m128 nv = _mm_mul_ps(keep, _mm_add_ps(vc, upwindSumSSE(a.v, i, sy, sz, vc, aW, aE, aS, aN, aB, aF)));
+        __m128 nw = _mm_mul_ps(keep, _mm_add_ps(wc, upwindSumSSE(a.w, i, sy, sz, wc, aW, aE, aS, aN, aB, aF)));
+        _mm_storeu_ps(a.nextU + i, flushTinySSE(nu, signBit, tiny));
+        _mm_storeu_ps(a.nextV + i, flushTinySSE(nv, signBit, tiny));
+        _mm_storeu_ps(a.nextW + i, flushTinySSE(nw, signBit, tiny));
+    }
+    stencilRowScalar(a, k, i, end - i);
+}
+
+static void (*const stencilRow)(const StencilArrays&, const StencilConstants&, int, int) = stencilRowSSE;
+
+#else
+
+static void (*const stencilRow)(const StencilArrays&, const StencilConstants&, int, int) = stencilRowScalar;
+
+#endif
+
+// One substep over every voxel. A tile runs its slabs in z order, so the
+// slabs below, at and above the row being updated (tile rows + 2 rows of
+// each of the five input arrays) are still in cache when they are needed
+// again, instead of whole planes of a large grid.
+static void stencilPass(RoomThermal& room, const StencilConstants& k, ThreadPool* threads) {
+    StencilArrays a;
+    a.temp = room.temp.data();
+    a.u = room.u.data();
+    a.v = room.v.data();
+    a.w = room.w.data();
+    a.open = room.open.data();
+    a.nextTemp = room.nextTemp.data();
+    a.nextU = room.nextU.data();
+    a.nextV = room.nextV.data();
+    a.nextW = room.nextW.data();
+    a.sy = room.strideY;
+    a.sz = room.strideZ;
+    forTiles(threads, room.ny, room.nz, [&](int, int firstRow, int endRow, int firstSlab, int endSlab) {
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) stencilRow(a, k, roomIndex(room, 0, y, z), room.nx);
+        }
+    });
+    room.temp.swap(room.nextTemp);
+    room.u.swap(room.nextU);
+    room.v.swap(room.nextV);
+    room.w.swap(room.nextW);
+}
+
+// Bring the air in the fan's disc (one voxel thick) toward its speed along the axis
+static void applyThrust(RoomThermal& room, const RoomFan& fan, float speed, float dt) {
+    float blend = std::min(1.0f, dt * room.thrustRate);
+    float h = room.voxelSize;
+    const int size[3] = {room.nx, room.ny, room.nz};
+    int lo[3], hi[3];
+    for (int a = 0; a < 3; a++) {
+        lo[a] = std::max(0, (int)floorf((fan.center[a] - fan.radius - room.origin[a]) / h));
+        hi[a] = std::min(size[a] - 1, (int)floorf((fan.center[a] + fan.radius - room.origin[a]) / h));
+    }
+    for (int z = lo[2]; z <= hi[2]; z++) {
+        for (int y = lo[1]; y <= hi[1]; y++) {
+            for (int x = lo[0]; x <= hi[0]; x++) {
+                float d[3] = {room.origin[0] + (x + 0.5f) * h - fan.center[0],
+                              room.origin[1] + (y + 0.5f) * h - fan.center[1],
+                              room.origin[2] + (z + 0.5f) * h - fan.center[2]};
+                float along = d[0] * fan.axis[0] + d[1] * fan.axis[1] + d[2] * fan.axis[2];
+                float radial2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] - along * along;
+                int i = roomIndex(room, x, y, z);
+                if (fabsf(along) > 0.5f * h || radial2 > fan.radius * fan.radius || room.open[i] == 0.0f) continue;
+                room.u[i] += (speed * fan.axis[0] - room.u[i]) * blend;
+                room.v[i] += (speed * fan.axis[1] - room.v[i]) * blend;
+                room.w[i] += (speed * fan.axis[2] - room.w[i]) * blend;
+            }
+        }
+    }
+}
+
+// Pressure solve of laplacian(p) = rhs on the air voxels. The walls and the
+// desk are closed: a missing neighbour is left out of the stencil (zero
+// pressure gradient through it), so the diagonal is the number of
+// neighbours holding air. Solid voxels and ghosts keep p = 0, which lets
+// the kernels sum all six neighbours without masking them.
+
+// Row kernels of the pressure solve, for count voxels from p (and the other
+// arrays at the same index); sy and sz step to the neighbouring rows.
+
+// Weighted Jacobi: next = p + w * ((neighbours - h2 * rhs) / n - p), with
+// inverse[i] = 1 / n for air and 0 for solid voxels, which so stay at 0
+static void jacobiSpanScalar(const float* __restrict p, const float* __restrict rhs, const float* __restrict inverse,
+                             const float* __restrict, float* __restrict next, int count, int sy, int sz, float h2) {
+    for (int x = 0; x < count; x++) {
+        float sum = p[x - 1] + p[x + 1] + p[x - sy] + p[x + sy] + p[x - sz] + p[x + sz];
+        next[x] = (1.0f - kJacobiWeight) * p[x] + kJacobiWeight * inverse[x] * (sum - h2 * rhs[x]);
+    }
+}
+
+// residual = rhs - (neighbours - n * p) / h2 on air voxels (rhs is 0 elsewhere)
+static void residualSpanScalar(const float* __restrict p, const float* __restrict rhs, const float* __restrict neighbours,
+                               const float* __restrict air, float* __restrict residual, int count, int sy, int sz,
+                               float h2) {
+    const float invH2 = 1.0f / h2;
+    for (int x = 0; x < count; x++) {
+        float sum = p[x - 1] + p[x + 1] + p[x - sy] + p[x + sy] + p[x - sz] + p[x + sz];
+        residual[x] = rhs[x] - air[x] * (sum - neighbours[x] * p[x]) * invH2;
+    }
+}
+
+typedef void (*SpanFunc)(const float*, const float*, const float*, const float*, float*, int, int, int, float);
+
+#ifdef __SSE2__
+
+static inline __m128 neighbourSumSSE(const float* p, int x, int sy, int sz) {
+    return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(p + x - 1), _mm_loadu_ps(p + x + 1)),
+                                 _mm_add_ps(_mm_loadu_ps(p + x - sy), _mm_loadu_ps(p + x + sy))),
+                      _mm_add_ps(_mm_loadu_ps(p + x - sz), _mm_loadu_ps(p + x + sz)));
+}
+
+static void jacobiSpanSSE(const float* p, const float* rhs, const float* inverse, const float* air,
+                          float* next, int count, int sy, int sz, float h2) {
+    const __m128 keep = _mm_set1_ps(1.0f - kJacobiWeight);
+    const __m128 weight = _mm_set1_ps(kJacobiWeight);
+    const __m128 scale = _mm_set1_ps(h2);
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128 source = _mm_sub_ps(neighbourSumSSE(p, x, sy, sz), _mm_mul_ps(scale, _mm_loadu_ps(rhs + x)));
+        __m128 jacobi = _mm_mul_ps(_mm_mul_ps(weight, _mm_loadu_ps(inverse + x)), source);
+        _mm_storeu_ps(next + x, _mm_add_ps(_mm_mul_ps(keep, _mm_loadu_ps(p + x)), jacobi));
+    }
+    jacobiSpanScalar(p + x, rhs + x, inverse + x, air + x, next + x, count - x, sy, sz, h2);
+}
+
+static void residualSpanSSE(const float* p, const float* rhs, const float* neighbours, const float* air,
+                            float* residual, int count, int sy, int sz, float h2) {
+    const __m128 invH2 = _mm_set1_ps(1.0f / h2);
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128 laplacian = _mm_sub_ps(neighbourSumSSE(p, x, sy, sz),
+                                      _mm_mul_ps(_mm_loadu_ps(neighbours + x), _mm_loadu_ps(p + x)));
+        __m128 scaled = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(air + x), laplacian), invH2);
+        _mm_storeu_ps(residual + x, _mm_sub_ps(_mm_loadu_ps(rhs + x), scaled));
+    }
+    residualSpanScalar(p + x, rhs + x, neighbours + x, air + x, residual + x, count - x, sy, sz, h2);
+}
+
+static const SpanFunc jacobiSpan = jacobiSpanSSE;
+static const SpanFunc residualSpan = residualSpanSSE;
+
+#else
+
+static const SpanFunc jacobiSpan = jacobiSpanScalar;
+static const SpanFunc residualSpan = residualSpanScalar;
+
+#endif
+
+// Weighted Jacobi sweeps; each reads p and writes next, so tiles can run in any order
+static void smooth(RoomLevel& level, int sweeps, ThreadPool* threads) {
+    for (int s = 0; s < sweeps; s++) {
+        forTiles(threads, level.ny, level.nz, [&](int, int firstRow, int endRow, int firstSlab, int endSlab) {
+            for (int z = firstSlab; z < endSlab; z++) {
+                for (int y = firstRow; y < endRow; y++) {
+                    int row = levelIndex(level, 0, y, z);
+                    jacobiSpan(level.p.data() + row, level.rhs.data() + row, level.inverse.data() + row,
+                               level.air.data() + row, level.next.data() + row, level.nx, level.strideY,
+                               level.strideZ, level.h2);
+                }
+            }
+        });
+        level.p.swap(level.next);
+    }
+}
+
+// residual = rhs - laplacian(p)
+static void computeResidual(RoomLevel& level, ThreadPool* threads) {
+    forTiles(threads, level.ny, level.nz, [&](int, int firstRow, int endRow, int firstSlab, int endSlab) {
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) {
+                int row = levelIndex(level, 0, y, z);
+                residualSpan(level.p.data() + row, level.rhs.data() + row, level.neighbours.data() + row,
+                             level.air.data() + row, level.residual.data() + row, level.nx, level.strideY,
+                             level.strideZ, level.h2);
+            }
+        }
+    });
+}
+
+// Coarse right-hand side: the fine residual averaged over 2x2x2 voxels
+static void restrictResidual(const RoomLevel& fine, RoomLevel& coarse, ThreadPool* threads) {
+    const int sy = fine.strideY, sz = fine.strideZ;
+    forTiles(threads, coarse.ny, coarse.nz, [&](int, int firstRow, int endRow, int firstSlab, int endSlab) {
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) {
+                const float* r = fine.residual.data() + levelIndex(fine, 0, 2 * y, 2 * z);
+                float* rhs = coarse.rhs.data() + levelIndex(coarse, 0, y, z);
+                float* p = coarse.p.data() + levelIndex(coarse, 0, y, z);
+                for (int x = 0; x < coarse.nx; x++) {
+                    const float* c = r + 2 * x;
+                    rhs[x] = 0.125f * (c[0] + c[1] + c[sy] + c[sy + 1] + c[sz] + c[sz + 1] + c[sz + sy] + c[sz + sy + 1]);
+                    p[x] = 0.0f;  // The correction starts from zero
+                }
+            }
+        }
+    });
+}
+
+// Add the coarse correction to the fine pressure, each voxel taking its coarse voxel's
+static void prolongCorrection(const RoomLevel& coarse, RoomLevel& fine, ThreadPool* threads) {
+    forTiles(threads, fine.ny, fine.nz, [&](int, int firstRow, int endRow, int firstSlab, int endSlab) {
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) {
+                const float* e = coarse.p.data() + levelIndex(coarse, 0, y / 2, z / 2);
+                const float* air = fine.air.data() + levelIndex(fine, 0, y, z);
+                float* p = fine.p.data() + levelIndex(fine, 0, y, z);
+                for (int x = 0; x < fine.nx; x++) p[x] += air[x] * e[x / 2];
+            }
+        }
+    });
+}
+
+// One V-cycle from level l down. The coarsest level is only smoothed, not
+// solved exactly: the residual left after a tick comes from the fine
+// levels and the piecewise-constant prolongation (which keeps corrections
+// out of the desk), and stays the same from 16 coarsest sweeps up.
+static void vCycle(RoomThermal& room, int l, ThreadPool* threads) {
+    RoomLevel& level = room.levels[l];
+    if (l + 1 == (int)room.levels.size()) {
+        smooth(level, kCoarsestSweeps, threads);
+        return;
+    }
+    RoomLevel& coarse = room.levels[l + 1];
+    smooth(level, kSmoothSweeps, threads);
+    computeResidual(level, threads);
+    restrictResidual(level, coarse, threads);
+    vCycle(room, l + 1, threads);
+    prolongCorrection(coarse, level, threads);
+    smooth(level, kSmoothSweeps, threads);
+}
+
+// Right-hand side of the pressure solve: the velocity's divergence, less its
+// mean so that a closed room has a solution (what flows in must flow out)
+static void computeDivergence(RoomThermal& room, ThreadPool* threads) {
+    RoomLevel& level = room.levels[0];
+    const int sy = room.strideY, sz = room.strideZ;
+    forTiles(threads, room.ny, room.nz, [&](int t, int firstRow, int endRow, int firstSlab, int endSlab) {
+        const float* __restrict u = room.u.data();
+        const float* __restrict v = room.v.data();
+        const float* __restrict w = room.w.data();
+        const float* __restrict air = level.air.data();
+        float* __restrict rhs = level.rhs.data();
+        double sum = 0.0, count = 0.0;
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) {
+                for (int i = roomIndex(room, 0, y, z), end = i + room.nx; i < end; i++) {
+                    rhs[i] = air[i] * 0.5f * (u[i + 1] - u[i - 1] + v[i + sy] - v[i - sy] + w[i + sz] - w[i - sz]);
+                    sum += rhs[i];
+                    count += air[i];
+                }
+            }
+        }
+        room.tileSums[t * 2] = sum;
+        room.tileSums[t * 2 + 1] = count;
+    });
+
+    double sum = 0.0, count = 0.0;
+    for (size_t t = 0; t < room.tileSums.size(); t += 2) {
+        sum += room.tileSums[t];
+        count += room.tileSums[t + 1];
+    }
+    float mean = count > 0.0 ? (float)(sum / count) : 0.0f;
+    forTiles(threads, room.ny, room.nz, [&](int, int firstRow, int endRow, int firstSlab, int endSlab) {
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) {
+                for (int i = roomIndex(room, 0, y, z), end = i + room.nx; i < end; i++) level.rhs[i] -= level.air[i] * mean;
+            }
+        }
+    });
+}
+
+// Subtract the pressure gradient, leaving the velocity divergence-free, and
+// note the fastest air of each tile for the next tick's substep length
+static void project(RoomThermal& room, ThreadPool* threads) {
+    const RoomLevel& level = room.levels[0];
+    const int sy = room.strideY, sz = room.strideZ;
+    forTiles(threads, room.ny, room.nz, [&](int t, int firstRow, int endRow, int firstSlab, int endSlab) {
+        const float* __restrict p = level.p.data();
+        const float* __restrict air = level.air.data();
+        float* __restrict u = room.u.data();
+        float* __restrict v = room.v.data();
+        float* __restrict w = room.w.data();
+        float fastest[3] = {0.0f, 0.0f, 0.0f};
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) {
+                for (int i = roomIndex(room, 0, y, z), end = i + room.nx; i < end; i++) {
+                    // A closed neighbour has this voxel's pressure: no gradient toward it
+                    float pc = p[i];
+                    u[i] -= air[i] * 0.5f * (air[i + 1] * (p[i + 1] - pc) + air[i - 1] * (pc - p[i - 1]));
+                    v[i] -= air[i] * 0.5f * (air[i + sy] * (p[i + sy] - pc) + air[i - sy] * (pc - p[i - sy]));
+                    w[i] -= air[i] * 0.5f * (air[i + sz] * (p[i + sz] - pc) + air[i - sz] * (pc - p[i - sz]));
+                    fastest[0] = std::max(fastest[0], fabsf(u[i]));
+                    fastest[1] = std::max(fastest[1], fabsf(v[i]));
+                    fastest[2] = std::max(fastest[2], fabsf(w[i]));
+                }
+            }
+        }
+        for (int a = 0; a < 3; a++) room.tileSpeed[t * 3 + a] = fastest[a];
+    });
+    for (int a = 0; a < 3; a++) room.maxSpeed[a] = 0.0f;
+    for (size_t t = 0; t < room.tileSpeed.size(); t += 3) {
+        for (int a = 0; a < 3; a++) room.maxSpeed[a] = std::max(room.maxSpeed[a], room.tileSpeed[t + a]);
+    }
+}
+
+// Size of the residual left by the solve, relative to the divergence
+static float relativeResidual(RoomThermal& room, ThreadPool* threads) {
+    RoomLevel& level = room.levels[0];
+    computeResidual(level, threads);
+    forTiles(threads, room.ny, room.nz, [&](int t, int firstRow, int endRow, int firstSlab, int endSlab) {
+        double residual = 0.0, rhs = 0.0;
+        for (int z = firstSlab; z < endSlab; z++) {
+            for (int y = firstRow; y < endRow; y++) {
+                for (int i = roomIndex(room, 0, y, z), end = i + room.nx; i < end; i++) {
+                    residual += level.residual[i] * level.residual[i];
+                    rhs += level.rhs[i] * level.rhs[i];
+                }
+            }
+        }
+        room.tileSums[t * 2] = residual;
+        room.tileSums[t * 2 + 1] = rhs;
+    });
+    double residual = 0.0, rhs = 0.0;
+    for (size_t t = 0; t < room.tileSums.size(); t += 2) {
+        residual += room.tileSums[t];
+        rhs += room.tileSums[t + 1];
+    }
+    return rhs > 0.0 ? (float)sqrt(residual / rhs) : 0.0f;
+}
+
+void roomStep(RoomThermal& room, const RoomFan& fan, float dt, ThreadPool* threads) {
+    // Longest substep for which the weights of the fastest voxel sum to 1.
+    // The stencil never speeds air up and the disc only up to its own speed,
+    // so the speeds at the start of the tick bound the whole tick.
+    float speed = std::max(fan.airSpeed, 0.0f);
+    float fastest = 0.0f;
+    for (int a = 0; a < 3; a++) fastest += std::max(room.maxSpeed[a], speed * fabsf(fan.axis[a]));
+    float h = room.voxelSize;
+    float mixing = room.diffusivity + room.mixingLength * fastest;
+    float stable = 1.0f / (6.0f * mixing / (h * h) + fastest / h);
+    room.substeps = std::max(1, (int)ceilf(dt / stable));
+
+    float sub = dt / room.substeps;
+    StencilConstants k;
+    k.diffusion = sub * room.diffusivity / (h * h);
+    k.mixing = sub * room.mixingLength / (h * h);
+    k.transport = sub / h;
+    k.keep = 1.0f - sub * room.drag;
+    for (int s = 0; s < room.substeps; s++) {
+        applyThrust(room, fan, speed, sub);
+        stencilPass(room, k, threads);
+    }
+
+    computeDivergence(room, threads);
+    for (int cycle = 0; cycle < kRoomVCycles; cycle++) vCycle(room, 0, threads);
+    room.residual = relativeResidual(room, threads);
+    project(room, threads);
+
+    room.time += dt;
+    room.voxelUpdates += (double)room.substeps * room.nx * room.ny * room.nz;
+}
+
+RoomFan roomFan3D(float rotationSpeed) {
+    // Blades at the end of the motor arm (drawFanBlades()), turning about z
+    RoomFan fan;
+    fan.center[0] = 1.0f;
+    fan.center[1] = 1.4f;
+    fan.center[2] = 0.0f;
+    fan.axis[0] = 0.0f;
+    fan.axis[1] = 0.0f;
+    fan.axis[2] = 1.0f;
+    fan.radius = 0.85f;  // The safety cage's rings
+    fan.airSpeed = kAirPerSpeed * rotationSpeed;
+    return fan;
+}
+
+RoomBox roomDeskZone() {
+    RoomBox zone = {{-4.0f, -1.85f, 0.5f}, {4.0f, 2.0f, 5.0f}};
+    return zone;
+}
+
+float roomMeanTemp(const RoomThermal& room, const RoomBox& box) {
+    double sum = 0.0;
+    long count = 0;
+    float h = room.voxelSize;
+    for (int z = 0; z < room.nz; z++) {
+        float cz = room.origin[2] + (z + 0.5f) * h;
+        if (cz < box.min[2] || cz > box.max[2]) continue;
+        for (int y = 0; y < room.ny; y++) {
+            float cy = room.origin[1] + (y + 0.5f) * h;
+            if (cy < box.min[1] || cy > box.max[1]) continue;
+            for (int x = 0; x < room.nx; x++) {
+                float cx = room.origin[0] + (x + 0.5f) * h;
+                int i = roomIndex(room, x, y, z);
+                if (cx < box.min[0] || cx > box.max[0] || room.open[i] == 0.0f) continue;
+                sum += room.temp[i];
+                count++;
+            }
+        }
+    }
+    return count ? (float)(sum / count) : kRoomWallTemp;
+}
+
+float roomMeanTemp(const RoomThermal& room) {
+    return roomMeanTemp(room, kRoomBounds);
+}
@@ -0,0 +1,107 @@
+#ifndef ROOM_THERMAL_H
+#define ROOM_THERMAL_H
+
+#include <vector>
+
+class ThreadPool;
+
+// Air temperature and velocity in a voxel grid filling a room around the 3D
+// scene's desk (the desk from drawDesk() is solid). The fan's blade disc
+// pushes the air along its axis; each tick moves temperature and velocity
+// with one fused advection-diffusion stencil (first-order upwind transport,
+// 7-point diffusion with extra mixing where the air moves), run as explicit
+// substeps short enough to stay stable and never overshoot, then removes
+// the velocity's divergence with a multigrid pressure solve on the air
+// voxels (closed walls and desk), so the jet turns at the walls and comes
+// back around the room. The room is closed; its walls, floor and ceiling
+// are held at kRoomWallTemp and are the only way heat leaves.
+//
+// The grid is cut into tiles of kRoomTileRows x kRoomTileSlabs rows, run in
+// parallel when given a thread pool; a tile's three neighbouring slabs stay
+// in cache while it sweeps along z. Every voxel reads only the previous
+// substep, so results do not depend on the thread count. No OpenGL in here.
+// Distances are scene units, times seconds, temperatures degrees C.
+
+const int kRoomTileRows = 8;          // Rows (y) per tile
+const int kRoomTileSlabs = 16;        // Slabs (z) per tile
+const float kRoomWallTemp = 20.0f;    // Walls, floor and ceiling
+const float kRoomStartTemp = 30.0f;   // Air after roomReset()
+const int kRoomVCycles = 2;           // Pressure V-cycles per tick, from the last tick's pressure (1: 5x the residual)
+
+// Axis-aligned box in scene units
+struct RoomBox {
+    float min[3], max[3];
+};
+
+// The fan's blade disc as seen by the air
+struct RoomFan {
+    float center[3];
+    float axis[3];       // Unit vector the air is blown along
+    float radius;
+    float airSpeed;      // Speed the disc pushes the air toward, units per second
+};
+
+// One level of the pressure solve's multigrid hierarchy, padded like the
+// room's arrays; the ghosts and solid voxels stay 0
+struct RoomLevel {
+    int nx, ny, nz, strideY, strideZ;
+    float h2;                        // Voxel size squared, in fine voxels
+    std::vector<float> p;            // Pressure (or its correction on coarse levels)
+    std::vector<float> rhs;          // Right-hand side of laplacian(p) = rhs
+    std::vector<float> next;         // Jacobi sweep target, swapped with p
+    std::vector<float> residual;
+    std::vector<float> air;          // 1 for voxels holding air (on coarse levels, any of their 8)
+    std::vector<float> neighbours;   // Neighbours holding air (0 for solid voxels)
+    std::vector<float> inverse;      // 1 / neighbours, or 0
+};
+
+struct RoomThermal {
+    int nx, ny, nz;                     // Voxels
+    int strideY, strideZ;               // Index steps in y and z (one ghost voxel on every side)
+    float voxelSize;
+    float origin[3];                    // Minimum corner of the room
+    float diffusivity;                  // Mixing in still air, units^2 per second
+    float mixingLength;                 // Extra mixing per unit of air speed (|u|+|v|+|w|), units
+    float drag;                         // Velocity lost per second
+    float thrustRate;                   // How fast the disc brings air to its speed, per second
+    std::vector<float> temp, u, v, w;   // Per voxel, padded; ghosts hold the wall's values
+    std::vector<float> nextTemp, nextU, nextV, nextW;  // Substep targets, swapped with the above
+    std::vector<float> open;            // 1 where heat flows: air voxels and the walls (ghosts)
+    std::vector<RoomLevel> levels;      // [0] is the grid itself; rhs there is the divergence
+    std::vector<float> tileSpeed;       // Fastest |u|, |v|, |w| of each tile after the last step
+    std::vector<double> tileSums;       // Each tile's part of a sum over the room (added up in tile order)
+    float maxSpeed[3];                  // Fastest |u|, |v|, |w| in the room; sets the substep length
+    float residual;                     // RMS residual / RMS divergence after the last solve
+    int substeps;                       // Substeps run by the last roomStep()
+    double time;                        // Seconds simulated since roomReset()
+    double voxelUpdates;                // Voxel substeps run since roomReset()
+};
+
+// The room around the 3D scene's desk, in voxels of voxelSize units, with
+// the air at kRoomStartTemp and still
+void roomInit(RoomThermal& room, float voxelSize);
+
+// Hot, still air again
+void roomReset(RoomThermal& room);
+
+// Advance dt seconds. threads may be null to run on the caller.
+void roomStep(RoomThermal& room, const RoomFan& fan, float dt, ThreadPool* threads);
+
+// The 3D scene's fan (drawFan()) turning at rotationSpeed degrees per tick
+RoomFan roomFan3D(float rotationSpeed);
+
+// Where someone at the desk sits: above the desk top and in front of the fan
+RoomBox roomDeskZone();
+
+// Mean air temperature of the voxels whose centers lie in box
+float roomMeanTemp(const RoomThermal& room, const RoomBox& box);
+
+// Mean air temperature of the whole room
+float roomMeanTemp(const RoomThermal& room);
+
+// Index of voxel (x, y, z) in the padded arrays
+inline int roomIndex(const RoomThermal& room, int x, int y, int z) {
+    return (z + 1) * room.strideZ + (y + 1) * room.strideY + x + 1;
+}
+
+#endif
@@ -0,0 +1,292 @@
+#include "rotor_batch.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ROTOR_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+RotorParams rotorParamsSlew(const FanParams& fan) {
+    RotorParams p = {};
+    p.model = ROTOR_SLEW;
+    p.speedPerLevel = fan.speedPerLevel;
+    p.accelStep = fan.accelStep;
+    p.decelStep = fan.decelStep;
+    p.offDecelStep = fan.offDecelStep;
+    p.settleBand = fan.settleBand;
+    return p;
+}
+
+RotorParams rotorParamsTorque(float speedPerLevel) {
+    RotorParams p = {};
+    p.model = ROTOR_TORQUE;
+    p.speedPerLevel = speedPerLevel;
+    p.inertia = 4.0f;
+    p.friction = 0.04f;
+    p.drag = 0.003f;
+    p.stopSpeed = 0.05f;
+    return p;
+}
+
+float rotorLevelTorque(const RotorParams& params, int level) {
+    float w = level * params.speedPerLevel;
+    return params.friction * w + params.drag * w * w;
+}
+
+void rotorBatchInit(RotorBatch& batch, int count) {
+    batch.count = count;
+    batch.angle.assign(count, 0.0f);
+    batch.previousAngle.assign(count, 0.0f);
+    batch.speed.assign(count, 0.0f);
+    batch.target.assign(count, 0.0f);
+    batch.torque.assign(count, 0.0f);
+    batch.level.assign(count, 0);
+}
+
+void rotorSetLevel(RotorBatch& batch, const RotorParams& params, int i, int level) {
+    if (level < 0 || level > 5) return;
+    batch.level[i] = (signed char)level;
+    batch.target[i] = level * params.speedPerLevel;
+    batch.torque[i] = params.model == ROTOR_TORQUE ? rotorLevelTorque(params, level) : 0.0f;
+}
+
+void rotorBatchRetarget(RotorBatch& batch, const RotorParams& params) {
+    for (int i = 0; i < batch.count; i++) rotorSetLevel(batch, params, i, batch.level[i]);
+}
+
+float rotorInterpolatedAngle(const RotorBatch& batch, int i, float alpha) {
+    float delta = batch.angle[i] - batch.previousAngle[i];
+    if (delta < 0.0f) delta += 360.0f;  // Wrapped past 360 during the step
+    float angle = batch.previousAngle[i] + delta * alpha;
+    return angle >= 360.0f ? angle - 360.0f : angle;
+}
+
+// Arrays and per-step constants shared by every kernel
+struct RotorArrays {
+    float* __restrict angle;
+    float* __restrict previousAngle;
+    float* __restrict speed;
+    const float* __restrict target;
+    const float* __restrict torque;
+};
+
+struct StepConstants {
+    float ticks;           // Nominal ticks in this step
+    float accel;           // ROTOR_SLEW: accelStep * ticks, and so on
+    float decel, offDecel, band;
+    float feed;            // ROTOR_TORQUE: ticks / inertia
+    float frictionFeed;    // friction * feed
+    float dragFeed;        // drag * feed
+    float stopSpeed;
+};
+
+typedef void (*StepFunc)(const RotorArrays&, const StepConstants&, int, int);
+
+// Reference implementations; they also handle the tails the SIMD loops leave
+// over. Both turn the blades by the new speed and wrap the angle, which stays
+// below 720 degrees, so subtracting 360 gives fmodf()'s result exactly.
+
+static void slewScalar(const RotorArrays& a, const StepConstants& c, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        float w = a.speed[i], t = a.target[i];
+        float decel = t > 0.0f ? c.decel : c.offDecel;  // Powered off slows down faster
+        float up = w + c.accel;
+        up = up > t ? t : up;                           // Don't overshoot
+        float down = w - decel;
+        down = down < t ? t : down;
+        float next = w < t - c.band ? up : (w > t + c.band ? down : t);
+        float angle = a.angle[i] + next * c.ticks;
+        a.previousAngle[i] = a.angle[i];
+        a.speed[i] = next;
+        a.angle[i] = angle >= 360.0f ? angle - 360.0f : angle;
+    }
+}
+
+// Semi-implicit Euler: the losses use the new speed, linearized around the
+// old one, which stays stable (and non-negative) for any step size
+static void torqueScalar(const RotorArrays& a, const StepConstants& c, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        float w = a.speed[i], tq = a.torque[i];
+        float next = (w + c.feed * tq) / (1.0f + c.frictionFeed + c.dragFeed * w);
+        next = tq <= 0.0f && next < c.stopSpeed ? 0.0f : next;
+        float angle = a.angle[i] + next * c.ticks;
+        a.previousAngle[i] = a.angle[i];
+        a.speed[i] = next;
+        a.angle[i] = angle >= 360.0f ? angle - 360.0f : angle;
+    }
+}
+
+#ifdef ROTOR_KERNEL_X86
+
+// SSE2 has no blend instruction: pick b where mask is set, else a
+__attribute__((target("sse2")))
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+__attribute__((target("sse2")))
+static inline __m128 wrapAngle4(__m128 angle) {
+    const __m128 full = _mm_set1_ps(360.0f);
+    return _mm_sub_ps(angle, _mm_and_ps(_mm_cmpge_ps(angle, full), full));
+}
+
+__attribute__((target("sse2")))
+static void slewSSE(const RotorArrays& a, const StepConstants& c, int begin, int end) {
+    const __m128 ticks = _mm_set1_ps(c.ticks);
+    const __m128 accel = _mm_set1_ps(c.accel);
+    const __m128 decelOn = _mm_set1_ps(c.decel);
+    const __m128 decelOff = _mm_set1_ps(c.offDecel);
+    const __m128 band = _mm_set1_ps(c.band);
+    const __m128 zero = _mm_setzero_ps();
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 w = _mm_loadu_ps(a.speed + i);
+        __m128 t = _mm_loadu_ps(a.target + i);
+        __m128 decel = select4(_mm_cmpgt_ps(t, zero), decelOff, decelOn);
+        __m128 up = _mm_min_ps(_mm_add_ps(w, accel), t);
+        __m128 down = _mm_max_ps(_mm_sub_ps(w, decel), t);
+        __m128 next = select4(_mm_cmpgt_ps(w, _mm_add_ps(t, band)), t, down);
+        next = select4(_mm_cmplt_ps(w, _mm_sub_ps(t, band)), next, up);
+        __m128 angle = _mm_loadu_ps(a.angle + i);
+        _mm_storeu_ps(a.previousAngle + i, angle);
+        _mm_storeu_ps(a.speed + i, next);
+        _mm_storeu_ps(a.angle + i, wrapAngle4(_mm_add_ps(angle, _mm_mul_ps(next, ticks))));
+    }
+    slewScalar(a, c, i, end);
+}
+
+__attribute__((target("sse2")))
+static void torqueSSE(const RotorArrays& a, const StepConstants& c, int begin, int end) {
+    const __m128 ticks = _mm_set1_ps(c.ticks);
+    const __m128 feed = _mm_set1_ps(c.feed);
+    const __m128 base = _mm_set1_ps(1.0f + c.frictionFeed);
+    const __m128 dragFeed = _mm_set1_ps(c.dragFeed);
+    const __m128 stopSpeed = _mm_set1_ps(c.stopSpeed);
+    const __m128 zero = _mm_setzero_ps();
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 w = _mm_loadu_ps(a.speed + i);
+        __m128 tq = _mm_loadu_ps(a.torque + i);
+        __m128 next = _mm_div_ps(_mm_add_ps(w, _mm_mul_ps(feed, tq)),
+                                 _mm_add_ps(base, _mm_mul_ps(dragFeed, w)));
+        __m128 stopped = _mm_and_ps(_mm_cmple_ps(tq, zero), _mm_cmplt_ps(next, stopSpeed));
+        next = _mm_andnot_ps(stopped, next);
+        __m128 angle = _mm_loadu_ps(a.angle + i);
+        _mm_storeu_ps(a.previousAngle + i, angle);
+        _mm_storeu_ps(a.speed + i, next);
+        _mm_storeu_ps(a.angle + i, wrapAngle4(_mm_add_ps(angle, _mm_mul_ps(next, ticks))));
+    }
+    torqueScalar(a, c, i, end);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 wrapAngle8(__m256 angle) {
+    const __m256 full = _mm256_set1_ps(360.0f);
+    return _mm256_sub_ps(angle, _mm256_and_ps(_mm256_cmp_ps(angle, full, _CMP_GE_OQ), full));
+}
+
+__attribute__((target("avx2")))
+static void slewAVX2(const RotorArrays& a, const StepConstants& c, int begin, int end) {
+    const __m256 ticks = _mm256_set1_ps(c.ticks);
+    const __m256 accel = _mm256_set1_ps(c.accel);
+    const __m256 decelOn = _mm256_set1_ps(c.decel);
+    const __m256 decelOff = _mm256_set1_ps(c.offDecel);
+    const __m256 band = _mm256_set1_ps(c.band);
+    const __m256 zero = _mm256_setzero_ps();
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 w = _mm256_loadu_ps(a.speed + i);
+        __m256 t = _mm256_loadu_ps(a.target + i);
+        __m256 decel = _mm256_blendv_ps(decelOff, decelOn, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+        __m256 up = _mm256_min_ps(_mm256_add_ps(w, accel), t);
+        __m256 down = _mm256_max_ps(_mm256_sub_ps(w, decel), t);
+        __m256 next = _mm256_blendv_ps(t, down, _mm256_cmp_ps(w, _mm256_add_ps(t, band), _CMP_GT_OQ));
+        next = _mm256_blendv_ps(next, up, _mm256_cmp_ps(w, _mm256_sub_ps(t, band), _CMP_LT_OQ));
+        __m256 angle = _mm256_loadu_ps(a.angle + i);
+        _mm256_storeu_ps(a.previousAngle + i, angle);
+        _mm256_storeu_ps(a.speed + i, next);
+        _mm256_storeu_ps(a.angle + i, wrapAngle8(_mm256_add_ps(angle, _mm256_mul_ps(next, ticks))));
+    }
+    slewSSE(a, c, i, end);
+}
+
+__attribute__((target("avx2")))
+static void torqueAVX2(const RotorArrays& a, const StepConstants& c, int begin, int end) {
+    const __m256 ticks = _mm256_set1_ps(c.ticks);
+    const __m256 feed = _mm256_set1_ps(c.feed);
+    const __m256 base = _mm256_set1_ps(1.0f + c.frictionFeed);
+    const __m256 dragFeed = _mm256_set1_ps(c.dragFeed);
+    const __m256 stopSpeed = _mm256_set1_ps(c.stopSpeed);
+    const __m256 zero = _mm256_setzero_ps();
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 w = _mm256_loadu_ps(a.speed + i);
+        __m256 tq = _mm256_loadu_ps(a.torque + i);
+        __m256 next = _mm256_div_ps(_mm256_add_ps(w, _mm256_mul_ps(feed, tq)),
+                                    _mm256_add_ps(base, _mm256_mul_ps(dragFeed, w)));
+        __m256 stopped = _mm256_and_ps(_mm256_cmp_ps(tq, zero, _CMP_LE_OQ),
+                                       _mm256_cmp_ps(next, stopSpeed, _CMP_LT_OQ));
+        next = _mm256_andnot_ps(stopped, next);
+        __m256 angle = _mm256_loadu_ps(a.angle + i);
+        _mm256_storeu_ps(a.previousAngle + i, angle);
+        _mm256_storeu_ps(a.speed + i, next);
+        _mm256_storeu_ps(a.angle + i, wrapAngle8(_mm256_add_ps(angle, _mm256_mul_ps(next, ticks))));
+    }
+    torqueSSE(a, c, i, end);
+}
+
+#endif
+
+static RotorKernel activeKernel = rotorKernelBest();
+
+RotorKernel rotorKernelBest() {
+#ifdef ROTOR_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return ROTOR_KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse2")) return ROTOR_KERNEL_SSE;
+#endif
+    return ROTOR_KERNEL_SCALAR;
+}
+
+void rotorKernelSelect(RotorKernel kernel) {
+    RotorKernel best = rotorKernelBest();
+    activeKernel = kernel > best ? best : kernel;
+}
+
+RotorKernel rotorKernelActive() {
+    return activeKernel;
+}
+
+const char* rotorKernelName(RotorKernel kernel) {
+    switch (kernel) {
+        case ROTOR_KERNEL_AVX2: return "avx2";
+        case ROTOR_KERNEL_SSE:  return "sse";
+        default:                return "scalar";
+    }
+}
+
+void rotorBatchStep(RotorBatch& batch, const RotorParams& params, float dt, int begin, int end) {
+    RotorArrays arrays = {batch.angle.data(), batch.previousAngle.data(), batch.speed.data(),
+                          batch.target.data(), batch.torque.data()};
+    StepConstants c;
+    c.ticks = dt * kFanTickHz;  // Constants are expressed per nominal tick, as in fanStep()
+    c.accel = params.accelStep * c.ticks;
+    c.decel = params.decelStep * c.ticks;
+    c.offDecel = params.offDecelStep * c.ticks;
+    c.band = params.settleBand;
+    c.feed = params.model == ROTOR_TORQUE ? c.ticks / params.inertia : 0.0f;
+    c.frictionFeed = params.friction * c.feed;
+    c.dragFeed = params.drag * c.feed;
+    c.stopSpeed = params.stopSpeed;
+
+    bool slew = params.model == ROTOR_SLEW;
+    StepFunc func = slew ? slewScalar : torqueScalar;
+#ifdef ROTOR_KERNEL_X86
+    if (activeKernel == ROTOR_KERNEL_AVX2) func = slew ? slewAVX2 : torqueAVX2;
+    else if (activeKernel == ROTOR_KERNEL_SSE) func = slew ? slewSSE : torqueSSE;
+#endif
+    func(arrays, c, begin, end);
+}
@@ -0,0 +1,90 @@
+#ifndef ROTOR_BATCH_H
+#define ROTOR_BATCH_H
+
+#include <vector>
+#include "fan_sim.h"
+
+// Rotor simulation for many fans at once (the fan farm, fan_soak's batch
+// mode). State is stored as structure-of-arrays and every fan runs the same
+// branch-free update, so the AVX2 path steps 8 fans per instruction, SSE 4,
+// with a scalar fallback; the best one the CPU supports is picked at run time.
+// Speeds are in degrees per nominal tick, as in fan_sim.h.
+
+enum RotorModel {
+    ROTOR_SLEW,    // Fixed-rate ramps toward the level's speed: fanStep()'s behaviour
+    ROTOR_TORQUE   // Inertia, motor torque per level, friction and aerodynamic drag
+};
+
+struct RotorParams {
+    RotorModel model;
+    float speedPerLevel;   // Steady speed at each level (both models)
+
+    // ROTOR_SLEW: the constants of FanParams
+    float accelStep;       // Speed gained per tick while below target
+    float decelStep;       // Speed lost per tick while above target
+    float offDecelStep;    // Speed lost per tick while powered off
+    float settleBand;      // Snap to target when within this distance
+
+    // ROTOR_TORQUE: inertia * dw/dt = motor torque - friction * w - drag * w^2.
+    // The motor torque of a level is what balances the losses at that level's
+    // speed, so both models settle at the same speeds.
+    float inertia;
+    float friction;        // Bearing losses, proportional to speed
+    float drag;            // Aerodynamic drag, proportional to speed squared
+    float stopSpeed;       // An unpowered rotor slower than this stops
+};
+
+// The behaviour of fanStep() with these constants, reproduced bit for bit
+// (as long as a rotor turns less than 360 degrees per step)
+RotorParams rotorParamsSlew(const FanParams& fan);
+
+// Torque model settling at level * speedPerLevel. A stopped rotor reaches
+// 90% of its level's speed in 1.5-3 s (the top levels fastest) and coasts
+// to a stop in 6-8 s, slowing down less as its speed drops.
+RotorParams rotorParamsTorque(float speedPerLevel);
+
+// Motor torque the torque model applies at a speed level
+float rotorLevelTorque(const RotorParams& params, int level);
+
+// Every fan's state; index i in each array is fan i
+struct RotorBatch {
+    std::vector<float> angle;          // Blade angle (degrees, 0-360)
+    std::vector<float> previousAngle;  // Angle before the last step, for interpolation
+    std::vector<float> speed;          // Degrees per tick
+    std::vector<float> target;         // Steady speed of the fan's level (0 when off)
+    std::vector<float> torque;         // Motor torque of the fan's level (0 when off)
+    std::vector<signed char> level;    // Speed level 0 (off) to 5
+    int count;
+};
+
+// Storage for count fans, all stopped at level 0 and angle 0
+void rotorBatchInit(RotorBatch& batch, int count);
+
+// Select speed level 0-5 for fan i (0 powers it off)
+void rotorSetLevel(RotorBatch& batch, const RotorParams& params, int i, int level);
+
+// Recompute every fan's target and torque after switching params
+void rotorBatchRetarget(RotorBatch& batch, const RotorParams& params);
+
+// Advance fans [begin, end) by dt seconds
+void rotorBatchStep(RotorBatch& batch, const RotorParams& params, float dt, int begin, int end);
+
+// Fan i's blade angle a fraction alpha (0-1) of the way through the last step
+float rotorInterpolatedAngle(const RotorBatch& batch, int i, float alpha);
+
+enum RotorKernel {
+    ROTOR_KERNEL_SCALAR,
+    ROTOR_KERNEL_SSE,
+    ROTOR_KERNEL_AVX2
+};
+
+// Best kernel this CPU supports
+RotorKernel rotorKernelBest();
+
+// Kernel used by rotorBatchStep() (defaults to rotorKernelBest());
+// unsupported choices fall back to the best available one
+void rotorKernelSelect(RotorKernel kernel);
+RotorKernel rotorKernelActive();
+const char* rotorKernelName(RotorKernel kernel);
+
+#endif
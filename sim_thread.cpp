@@ -0,0 +1,62 @@
+#include "sim_thread.h"
+#include <chrono>
+
+static void simLoop(SimThread* sim) {
+    std::unique_lock<std::mutex> guard(sim->lock);
+    clockSkip(sim->clock, monotonicSeconds());
+    while (!sim->stopping) {
+        guard.unlock();
+        double now = monotonicSeconds();
+        int ticks = clockAdvance(sim->clock, now);
+        if (ticks > 0) {
+            for (int i = 0; i < ticks; i++) sim->step();
+            sim->tickMs = (float)(1000.0 * (monotonicSeconds() - now) / ticks);
+            sim->publish(now - sim->clock.accumulator);
+        }
+        bool animating = sim->animating();
+        guard.lock();
+
+        if (!animating) {
+            // Nothing moves: wait for input, then start the clock afresh
+            sim->wake.wait(guard, [sim] { return sim->wakeRequested || sim->stopping; });
+            sim->wakeRequested = false;
+            clockSkip(sim->clock, monotonicSeconds());
+            continue;
+        }
+        sim->wakeRequested = false;  // Already awake
+        double wait = sim->clock.tickSeconds - sim->clock.accumulator - (monotonicSeconds() - now);
+        if (wait > 0.0) {
+            sim->wake.wait_for(guard, std::chrono::duration<double>(wait), [sim] { return sim->stopping; });
+        }
+    }
+}
+
+void simStart(SimThread& sim, double tickHz, int maxTicks, void (*step)(), void (*publish)(double tickTime),
+              bool (*animating)()) {
+    clockInit(sim.clock, tickHz, maxTicks);
+    sim.step = step;
+    sim.publish = publish;
+    sim.animating = animating;
+    sim.tickMs = 0.0f;
+    sim.wakeRequested = false;
+    sim.stopping = false;
+    sim.thread = std::thread(simLoop, &sim);
+}
+
+void simWake(SimThread& sim) {
+    {
+        std::lock_guard<std::mutex> guard(sim.lock);
+        sim.wakeRequested = true;
+    }
+    sim.wake.notify_one();
+}
+
+void simStop(SimThread& sim) {
+    if (!sim.thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> guard(sim.lock);
+        sim.stopping = true;
+    }
+    sim.wake.notify_one();
+    sim.thread.join();
+}
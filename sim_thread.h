@@ -0,0 +1,40 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "frame_clock.h"
+
+// Runs a program's fixed-step simulation on a thread of its own, so a slow
+// frame never holds up physics and a slow tick never holds up drawing. The
+// thread runs the ticks real time calls for (a FixedStepClock), hands the
+// state after them to the renderer through the program's publish function,
+// and sleeps until the next tick is due. Once nothing moves it sleeps until
+// simWake() (input arrived) instead, and the pause is not simulated.
+
+struct SimThread {
+    FixedStepClock clock;
+    void (*step)();                    // One physics tick
+    void (*publish)(double tickTime);  // Hand over the state after the ticks; tickTime is when the last one was due
+    bool (*animating)();               // False lets the thread sleep until simWake()
+    float tickMs;                      // Mean time spent in step() over the last batch (simulation thread)
+
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;      // The thread sleeps here between ticks and while paused
+    bool wakeRequested;                // Guarded by lock
+    bool stopping;                     // Guarded by lock
+};
+
+// Start ticking at tickHz, running at most maxTicks ticks to catch up after a stall
+void simStart(SimThread& sim, double tickHz, int maxTicks, void (*step)(), void (*publish)(double tickTime),
+              bool (*animating)());
+
+// Resume ticking if the simulation is paused (call after queuing input)
+void simWake(SimThread& sim);
+
+// Finish the current batch of ticks and join the thread; safe to call twice
+void simStop(SimThread& sim);
+
+#endif
@@ -0,0 +1,122 @@
+#include "soft_backend.h"
+#include <cstring>
+
+SoftRaster* softBackend = 0;
+static SoftRaster backendRaster;
+
+bool softBackendArgument(int& argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--software") != 0) continue;
+        for (int j = i; j + 1 <= argc; j++) argv[j] = argv[j + 1];  // Including the null at argv[argc]
+        argc--;
+        return true;
+    }
+    return false;
+}
+
+void softBackendStart(int width, int height, ThreadPool* threads) {
+    rasterInit(backendRaster, width, height, threads);
+    softBackend = &backendRaster;
+}
+
+void softBackendClear(GLbitfield mask) {
+    float rgba[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, rgba);
+    rasterClear(*softBackend, rgba, (mask & GL_COLOR_BUFFER_BIT) != 0, (mask & GL_DEPTH_BUFFER_BIT) != 0);
+}
+
+// Read the state a draw uses back from OpenGL. The scenes only use
+// GL_LIGHT0, GL_LESS, GL_SRC_ALPHA/GL_ONE_MINUS_SRC_ALPHA blending,
+// GL_GREATER alpha tests and GL_AMBIENT_AND_DIFFUSE color material, so
+// the functions themselves are not read.
+static void captureState(RasterState& s) {
+    glGetFloatv(GL_PROJECTION_MATRIX, s.projection);
+    glGetIntegerv(GL_VIEWPORT, s.viewport);
+
+    s.lighting = glIsEnabled(GL_LIGHTING) != 0;
+    if (s.lighting) {
+        bool light0 = glIsEnabled(GL_LIGHT0) != 0;
+        glGetLightfv(GL_LIGHT0, GL_POSITION, s.lightPosition);  // Already in eye space
+        glGetLightfv(GL_LIGHT0, GL_AMBIENT, s.lightAmbient);
+        glGetLightfv(GL_LIGHT0, GL_DIFFUSE, s.lightDiffuse);
+        glGetLightfv(GL_LIGHT0, GL_SPECULAR, s.lightSpecular);
+        if (!light0) {
+            memset(s.lightAmbient, 0, sizeof(s.lightAmbient));
+            memset(s.lightDiffuse, 0, sizeof(s.lightDiffuse));
+            memset(s.lightSpecular, 0, sizeof(s.lightSpecular));
+        }
+        glGetFloatv(GL_LIGHT_MODEL_AMBIENT, s.sceneAmbient);
+        glGetMaterialfv(GL_FRONT, GL_AMBIENT, s.materialAmbient);
+        glGetMaterialfv(GL_FRONT, GL_DIFFUSE, s.materialDiffuse);
+        glGetMaterialfv(GL_FRONT, GL_SPECULAR, s.materialSpecular);
+        glGetMaterialfv(GL_FRONT, GL_EMISSION, s.materialEmission);
+        glGetMaterialfv(GL_FRONT, GL_SHININESS, &s.shininess);
+        s.colorMaterial = glIsEnabled(GL_COLOR_MATERIAL) != 0;
+        s.normalize = glIsEnabled(GL_NORMALIZE) != 0;
+    }
+
+    GLint shadeModel, polygonMode[2];
+    glGetIntegerv(GL_SHADE_MODEL, &shadeModel);
+    glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+    s.smooth = shadeModel == GL_SMOOTH;
+    s.wireframe = polygonMode[0] == GL_LINE;
+    glGetFloatv(GL_LINE_WIDTH, &s.lineWidth);
+    glGetFloatv(GL_POINT_SIZE, &s.pointSize);
+
+    GLboolean depthMask;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    s.depthTest = glIsEnabled(GL_DEPTH_TEST) != 0;
+    s.depthWrite = depthMask != 0;
+    s.blend = glIsEnabled(GL_BLEND) != 0;
+    s.alphaTest = glIsEnabled(GL_ALPHA_TEST) != 0;
+    glGetFloatv(GL_ALPHA_TEST_REF, &s.alphaRef);
+}
+
+static RasterMode rasterMode(GLenum mode) {
+    switch (mode) {
+        case GL_POINTS: return RASTER_POINTS;
+        case GL_LINES: return RASTER_LINES;
+        case GL_TRIANGLES: return RASTER_TRIANGLES;
+        default: return RASTER_QUADS;
+    }
+}
+
+void softBackendDraw(GLenum mode, const RasterArrays& arrays, int vertexCount, const unsigned int* indices,
+                     int indexCount, const RasterTexture* texture) {
+    RasterState state;
+    captureState(state);
+    state.texture.alpha = 0;
+    if (texture) state.texture = *texture;
+    RasterArrays transformed = arrays;
+    glGetFloatv(GL_MODELVIEW_MATRIX, transformed.modelview);
+    rasterDraw(*softBackend, state, transformed, rasterMode(mode), vertexCount, indices, indexCount);
+}
+
+void softBackendPresent() {
+    SoftRaster& raster = *softBackend;
+    rasterFlush(raster);
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TRANSFORM_BIT | GL_CURRENT_BIT);
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_ALPHA_TEST);
+    glDisable(GL_TEXTURE_2D);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glRasterPos2f(-1.0f, -1.0f);  // The viewport's bottom-left corner
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glDrawPixels(raster.width, raster.height, GL_RGBA, GL_UNSIGNED_BYTE, raster.color.data());
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glPopClientAttrib();
+    glPopAttrib();
+}
@@ -0,0 +1,40 @@
+#ifndef SOFT_BACKEND_H
+#define SOFT_BACKEND_H
+
+#include <GL/glut.h>
+#include "soft_raster.h"
+
+// Software rendering of the fan scenes for machines without a GPU: the
+// scenes keep setting transforms, lights and enables with OpenGL calls
+// (cheap state changes; the window needs a context anyway), but every draw
+// path (vertex_batch, mesh_cache, hud_text, fan_farm, the profiler graph)
+// checks softBackend and, when it is set, hands its vertex arrays and the
+// current OpenGL state to the tile rasterizer in soft_raster.h instead of
+// drawing. The cached 2D background is drawn every frame, and the farm
+// draws one fan at a time. renderFrame() ends with softBackendPresent(),
+// which copies the finished framebuffer into the window.
+
+extern SoftRaster* softBackend;   // Null: draw with OpenGL
+
+// Remove "--software" from the command line; true if it was there
+bool softBackendArgument(int& argc, char** argv);
+
+// Draw into a width x height software framebuffer from now on, running the
+// tiles on threads (null: on the caller)
+void softBackendStart(int width, int height, ThreadPool* threads);
+
+// glClear() of the software framebuffer, with the current clear color
+void softBackendClear(GLbitfield mask);
+
+// Draw like glDrawArrays()/glDrawElements() (GL_POINTS, GL_LINES,
+// GL_TRIANGLES or GL_QUADS) with the current modelview, projection,
+// viewport, lighting, material, shade model, polygon mode, line width,
+// point size, depth, blend and alpha test state. A texture, if given,
+// modulates the alpha.
+void softBackendDraw(GLenum mode, const RasterArrays& arrays, int vertexCount, const unsigned int* indices = 0,
+                     int indexCount = 0, const RasterTexture* texture = 0);
+
+// Rasterize what is left and copy the framebuffer into the window's back buffer
+void softBackendPresent();
+
+#endif
@@ -0,0 +1,527 @@
+#include "soft_raster.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+const int kSubpixel = 256;          // Sub-pixel steps per pixel (8 bits)
+const float kGuardBand = 4.0f;      // x and y are clipped at this many times w: far outside the viewport,
+                                    // so only the near and far planes cut what is seen
+const int kReserveTriangles = 1 << 14;
+const int kReserveBinEntries = 1 << 16;
+
+// A vertex in window coordinates: pixels, depth 0-1, and 1/w for
+// perspective-correct interpolation
+struct WindowVertex {
+    float x, y, z, invW;
+    float rgba[4];
+    float st[2];
+};
+
+static float clamp01(float x) {
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static unsigned char toByte(float x) {
+    return (unsigned char)(clamp01(x) * 255.0f + 0.5f);
+}
+
+void rasterResize(SoftRaster& raster, int width, int height) {
+    raster.width = width > 1 ? width : 1;
+    raster.height = height > 1 ? height : 1;
+    raster.tilesX = (raster.width + kRasterTile - 1) / kRasterTile;
+    raster.tilesY = (raster.height + kRasterTile - 1) / kRasterTile;
+    raster.color.assign(raster.width * raster.height, 0);
+    raster.depth.assign(raster.width * raster.height, 1.0f);
+    raster.binStart.assign(raster.tilesX * raster.tilesY + 1, 0);
+    raster.states.clear();
+    raster.triangles.clear();
+}
+
+void rasterInit(SoftRaster& raster, int width, int height, ThreadPool* threads) {
+    raster.threads = threads;
+    raster.flushTriangles = raster.flushBinEntries = 0;
+    raster.triangles.reserve(kReserveTriangles);
+    raster.binEntries.reserve(kReserveBinEntries);
+    raster.states.reserve(256);
+    raster.vertices.reserve(4096);
+    rasterResize(raster, width, height);
+    const float black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    rasterClear(raster, black, true, true);
+}
+
+void rasterClear(SoftRaster& raster, const float rgba[4], bool clearColor, bool clearDepth) {
+    rasterFlush(raster);
+    if (clearColor) {
+        unsigned int pixel;
+        unsigned char* bytes = (unsigned char*)&pixel;
+        for (int i = 0; i < 4; i++) bytes[i] = toByte(rgba[i]);
+        std::fill(raster.color.begin(), raster.color.end(), pixel);
+    }
+    if (clearDepth) std::fill(raster.depth.begin(), raster.depth.end(), 1.0f);
+}
+
+// ---- Vertex stage ----
+
+// Light one vertex as the fixed-function pipeline does with GL_LIGHT0
+// alone: no attenuation or spot cone, infinite viewer, one-sided
+static void lightVertex(const RasterState& s, const float eye[3], const float normal[3], const float vertexColor[4],
+                        float out[4]) {
+    const float* ambient = s.colorMaterial ? vertexColor : s.materialAmbient;
+    const float* diffuse = s.colorMaterial ? vertexColor : s.materialDiffuse;
+    float l[3];
+    for (int i = 0; i < 3; i++) {
+        l[i] = s.lightPosition[3] != 0.0f ? s.lightPosition[i] / s.lightPosition[3] - eye[i] : s.lightPosition[i];
+    }
+    float length = sqrtf(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+    if (length > 0.0f) {
+        for (int i = 0; i < 3; i++) l[i] /= length;
+    }
+    float nDotL = normal[0] * l[0] + normal[1] * l[1] + normal[2] * l[2];
+    float specular = 0.0f;
+    if (nDotL > 0.0f) {
+        float h[3] = {l[0], l[1], l[2] + 1.0f};  // Halfway to the viewer along +z
+        float hLength = sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+        float nDotH = hLength > 0.0f ? (normal[0] * h[0] + normal[1] * h[1] + normal[2] * h[2]) / hLength : 0.0f;
+        specular = powf(nDotH > 0.0f ? nDotH : 0.0f, s.shininess);
+    } else {
+        nDotL = 0.0f;
+    }
+    for (int i = 0; i < 3; i++) {
+        out[i] = clamp01(s.materialEmission[i] + s.sceneAmbient[i] * ambient[i] + s.lightAmbient[i] * ambient[i] +
+                         nDotL * s.lightDiffuse[i] * diffuse[i] + specular * s.lightSpecular[i] * s.materialSpecular[i]);
+    }
+    out[3] = clamp01(diffuse[3]);
+}
+
+// Inverse of the modelview's upper 3x3 (row-major), which carries normals
+// (as row vectors) to eye space; false if it is singular
+static bool normalMatrix(const float* m, float out[9]) {
+    float a = m[0], b = m[4], c = m[8];
+    float d = m[1], e = m[5], f = m[9];
+    float g = m[2], h = m[6], k = m[10];
+    float det = a * (e * k - f * h) - b * (d * k - f * g) + c * (d * h - e * g);
+    if (det == 0.0f) return false;
+    float inv = 1.0f / det;
+    out[0] = (e * k - f * h) * inv;
+    out[1] = (c * h - b * k) * inv;
+    out[2] = (b * f - c * e) * inv;
+    out[3] = (f * g - d * k) * inv;
+    out[4] = (a * k - c * g) * inv;
+    out[5] = (c * d - a * f) * inv;
+    out[6] = (d * h - e * g) * inv;
+    out[7] = (b * g - a * h) * inv;
+    out[8] = (a * e - b * d) * inv;
+    return true;
+}
+
+// Transform and light every vertex of the arrays into raster.vertices
+static void transformVertices(SoftRaster& raster, const RasterState& s, const RasterArrays& a, int count) {
+    raster.vertices.resize(count);
+    const float* m = a.modelview;
+    const float* p = s.projection;
+    float inverse[9];
+    bool normals = s.lighting && normalMatrix(m, inverse);
+    for (int i = 0; i < count; i++) {
+        RasterVertex& out = raster.vertices[i];
+        const float* position = (const float*)((const char*)a.position + i * a.positionStride);
+        float z = a.positionSize > 2 ? position[2] : 0.0f;
+        float eye[3];
+        for (int k = 0; k < 3; k++) eye[k] = m[k] * position[0] + m[4 + k] * position[1] + m[8 + k] * z + m[12 + k];
+        for (int k = 0; k < 4; k++) out.clip[k] = p[k] * eye[0] + p[4 + k] * eye[1] + p[8 + k] * eye[2] + p[12 + k];
+
+        float color[4];
+        if (a.rgba) {
+            const unsigned char* rgba = a.rgba + i * a.rgbaStride;
+            for (int k = 0; k < 4; k++) color[k] = rgba[k] * (1.0f / 255.0f);
+        } else {
+            for (int k = 0; k < 4; k++) color[k] = a.color[k];
+        }
+        if (s.lighting) {
+            float n[3] = {0.0f, 0.0f, 1.0f}, eyeNormal[3];
+            if (a.normal) {
+                const float* normal = (const float*)((const char*)a.normal + i * a.normalStride);
+                n[0] = normal[0];
+                n[1] = normal[1];
+                n[2] = normal[2];
+            }
+            for (int k = 0; k < 3; k++) {
+                eyeNormal[k] = normals ? n[0] * inverse[k] + n[1] * inverse[3 + k] + n[2] * inverse[6 + k] : n[k];
+            }
+            if (s.normalize) {
+                float length = sqrtf(eyeNormal[0] * eyeNormal[0] + eyeNormal[1] * eyeNormal[1] + eyeNormal[2] * eyeNormal[2]);
+                if (length > 0.0f) {
+                    for (int k = 0; k < 3; k++) eyeNormal[k] /= length;
+                }
+            }
+            lightVertex(s, eye, eyeNormal, color, out.rgba);
+        } else {
+            for (int k = 0; k < 4; k++) out.rgba[k] = clamp01(color[k]);
+        }
+
+        out.st[0] = out.st[1] = 0.0f;
+        if (s.texture.alpha && a.texCoord) {
+            const float* st = (const float*)((const char*)a.texCoord + i * a.texCoordStride);
+            out.st[0] = st[0];
+            out.st[1] = st[1];
+        }
+    }
+}
+
+// ---- Clipping ----
+
+// Signed distance to clip plane 0-5 (near, far, then the guard band's
+// right, left, top, bottom); negative is outside
+static float planeDistance(const float* c, int plane) {
+    switch (plane) {
+        case 0: return c[3] + c[2];
+        case 1: return c[3] - c[2];
+        case 2: return kGuardBand * c[3] - c[0];
+        case 3: return kGuardBand * c[3] + c[0];
+        case 4: return kGuardBand * c[3] - c[1];
+        default: return kGuardBand * c[3] + c[1];
+    }
+}
+
+static int outcode(const RasterVertex& v) {
+    int code = 0;
+    for (int plane = 0; plane < 6; plane++) {
+        if (planeDistance(v.clip, plane) < 0.0f) code |= 1 << plane;
+    }
+    return code;
+}
+
+static RasterVertex lerpVertex(const RasterVertex& a, const RasterVertex& b, float t) {
+    RasterVertex v;
+    for (int k = 0; k < 4; k++) v.clip[k] = a.clip[k] + (b.clip[k] - a.clip[k]) * t;
+    for (int k = 0; k < 4; k++) v.rgba[k] = a.rgba[k] + (b.rgba[k] - a.rgba[k]) * t;
+    for (int k = 0; k < 2; k++) v.st[k] = a.st[k] + (b.st[k] - a.st[k]) * t;
+    return v;
+}
+
+static WindowVertex toWindow(const RasterVertex& v, const int* viewport) {
+    WindowVertex w;
+    w.invW = 1.0f / v.clip[3];
+    w.x = viewport[0] + (v.clip[0] * w.invW + 1.0f) * 0.5f * viewport[2];
+    w.y = viewport[1] + (v.clip[1] * w.invW + 1.0f) * 0.5f * viewport[3];
+    w.z = clamp01((v.clip[2] * w.invW + 1.0f) * 0.5f);
+    for (int k = 0; k < 4; k++) w.rgba[k] = v.rgba[k];
+    w.st[0] = v.st[0];
+    w.st[1] = v.st[1];
+    return w;
+}
+
+// ---- Triangle setup ----
+
+static void setupTriangle(SoftRaster& raster, int state, const WindowVertex* v0, const WindowVertex* v1,
+                          const WindowVertex* v2) {
+    long long x0 = lrintf(v0->x * kSubpixel), y0 = lrintf(v0->y * kSubpixel);
+    long long x1 = lrintf(v1->x * kSubpixel), y1 = lrintf(v1->y * kSubpixel);
+    long long x2 = lrintf(v2->x * kSubpixel), y2 = lrintf(v2->y * kSubpixel);
+    long long area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+    if (area == 0) return;
+    if (area < 0) {
+        // Counter-clockwise from here on: inside is left of every edge
+        std::swap(v1, v2);
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+    }
+
+    // Pixels whose centers (i + 0.5) can be inside, clamped to the framebuffer
+    const int half = kSubpixel / 2;
+    int minX = (int)((std::min(x0, std::min(x1, x2)) - half + kSubpixel - 1) >> 8);
+    int maxX = (int)((std::max(x0, std::max(x1, x2)) - half) >> 8);
+    int minY = (int)((std::min(y0, std::min(y1, y2)) - half + kSubpixel - 1) >> 8);
+    int maxY = (int)((std::max(y0, std::max(y1, y2)) - half) >> 8);
+    minX = std::max(minX, 0);
+    minY = std::max(minY, 0);
+    maxX = std::min(maxX, raster.width - 1);
+    maxY = std::min(maxY, raster.height - 1);
+    if (minX > maxX || minY > maxY) return;
+
+    RasterTriangle t;
+    t.minX = minX;
+    t.minY = minY;
+    t.maxX = maxX;
+    t.maxY = maxY;
+    t.state = state;
+
+    // Edge k runs from corner k to corner k + 1. Pixel centers exactly on an
+    // edge belong to the triangle only for left edges (going down) and top
+    // edges (horizontal, going left); the others lose 1 so the test is >= 0.
+    const long long xs[3] = {x0, x1, x2}, ys[3] = {y0, y1, y2};
+    long long px = (long long)minX * kSubpixel + half, py = (long long)minY * kSubpixel + half;
+    for (int k = 0; k < 3; k++) {
+        int next = (k + 1) % 3;
+        long long dx = xs[next] - xs[k], dy = ys[next] - ys[k];
+        bool topLeft = dy < 0 || (dy == 0 && dx < 0);
+        t.edge[k] = dx * (py - ys[k]) - dy * (px - xs[k]) - (topLeft ? 0 : 1);
+        t.stepX[k] = -dy * kSubpixel;
+        t.stepY[k] = dx * kSubpixel;
+    }
+
+    // Attribute planes from the snapped corners
+    const WindowVertex* v[3] = {v0, v1, v2};
+    double fx[3], fy[3];
+    for (int k = 0; k < 3; k++) {
+        fx[k] = (double)xs[k] / kSubpixel;
+        fy[k] = (double)ys[k] / kSubpixel;
+    }
+    double ex1 = fx[1] - fx[0], ey1 = fy[1] - fy[0], ex2 = fx[2] - fx[0], ey2 = fy[2] - fy[0];
+    double det = ex1 * ey2 - ex2 * ey1;
+    double cx = minX + 0.5 - fx[0], cy = minY + 0.5 - fy[0];
+    float values[3][8];
+    for (int k = 0; k < 3; k++) {
+        float invW = v[k]->invW;
+        values[k][0] = v[k]->z;
+        values[k][1] = invW;
+        for (int c = 0; c < 4; c++) values[k][2 + c] = v[k]->rgba[c] * invW;
+        values[k][6] = v[k]->st[0] * invW;
+        values[k][7] = v[k]->st[1] * invW;
+    }
+    for (int a = 0; a < 8; a++) {
+        double d1 = values[1][a] - values[0][a], d2 = values[2][a] - values[0][a];
+        double ddx = (d1 * ey2 - d2 * ey1) / det, ddy = (d2 * ex1 - d1 * ex2) / det;
+        t.dx[a] = (float)ddx;
+        t.dy[a] = (float)ddy;
+        t.base[a] = (float)(values[0][a] + ddx * cx + ddy * cy);
+    }
+    t.affine = v0->invW == v1->invW && v0->invW == v2->invW;
+    t.w = 1.0f / v0->invW;
+
+    raster.triangles.push_back(t);
+}
+
+// Clip a triangle against the near and far planes (and the guard band),
+// then set up the convex polygon left as a fan of triangles
+static void clipTriangle(SoftRaster& raster, int state, const RasterVertex& a, const RasterVertex& b,
+                         const RasterVertex& c) {
+    const int* viewport = raster.states[state].viewport;
+    int codeA = outcode(a), codeB = outcode(b), codeC = outcode(c);
+    if (codeA & codeB & codeC) return;  // All outside one plane
+    if ((codeA | codeB | codeC) == 0) {
+        WindowVertex w[3] = {toWindow(a, viewport), toWindow(b, viewport), toWindow(c, viewport)};
+        setupTriangle(raster, state, &w[0], &w[1], &w[2]);
+        return;
+    }
+
+    RasterVertex buffers[2][9];  // Each plane adds at most one corner
+    RasterVertex* in = buffers[0];
+    RasterVertex* out = buffers[1];
+    in[0] = a;
+    in[1] = b;
+    in[2] = c;
+    int count = 3;
+    int planes = codeA | codeB | codeC;
+    for (int plane = 0; plane < 6 && count >= 3; plane++) {
+        if (!(planes & (1 << plane))) continue;
+        int kept = 0;
+        for (int i = 0; i < count; i++) {
+            const RasterVertex& p = in[i];
+            const RasterVertex& q = in[(i + 1) % count];
+            float dp = planeDistance(p.clip, plane), dq = planeDistance(q.clip, plane);
+            if (dp >= 0.0f) out[kept++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f)) out[kept++] = lerpVertex(p, q, dp / (dp - dq));
+        }
+        std::swap(in, out);
+        count = kept;
+    }
+    if (count < 3) return;
+    WindowVertex w[9];
+    for (int i = 0; i < count; i++) w[i] = toWindow(in[i], viewport);
+    for (int i = 1; i + 1 < count; i++) setupTriangle(raster, state, &w[0], &w[i], &w[i + 1]);
+}
+
+// A line as a quad width pixels across, widened vertically when it runs
+// more across than up (like OpenGL's aliased lines), else horizontally
+static void clipLine(SoftRaster& raster, int state, const RasterVertex& a, const RasterVertex& b, float width) {
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int plane = 0; plane < 6; plane++) {
+        float da = planeDistance(a.clip, plane), db = planeDistance(b.clip, plane);
+        if (da < 0.0f && db < 0.0f) return;
+        if (da < 0.0f) t0 = std::max(t0, da / (da - db));
+        if (db < 0.0f) t1 = std::min(t1, da / (da - db));
+    }
+    if (t0 > t1) return;
+    const int* viewport = raster.states[state].viewport;
+    WindowVertex p = toWindow(t0 > 0.0f ? lerpVertex(a, b, t0) : a, viewport);
+    WindowVertex q = toWindow(t1 < 1.0f ? lerpVertex(a, b, t1) : b, viewport);
+    float half = std::max(1.0f, floorf(width + 0.5f)) * 0.5f;
+    bool across = fabsf(q.x - p.x) >= fabsf(q.y - p.y);
+    float ox = across ? 0.0f : half, oy = across ? half : 0.0f;
+    WindowVertex corners[4] = {p, q, q, p};
+    corners[0].x -= ox; corners[0].y -= oy;
+    corners[1].x -= ox; corners[1].y -= oy;
+    corners[2].x += ox; corners[2].y += oy;
+    corners[3].x += ox; corners[3].y += oy;
+    setupTriangle(raster, state, &corners[0], &corners[1], &corners[2]);
+    setupTriangle(raster, state, &corners[0], &corners[2], &corners[3]);
+}
+
+// A point as a square size pixels across
+static void clipPoint(SoftRaster& raster, int state, const RasterVertex& a, float size) {
+    if (outcode(a)) return;
+    WindowVertex p = toWindow(a, raster.states[state].viewport);
+    float half = std::max(1.0f, floorf(size + 0.5f)) * 0.5f;
+    WindowVertex corners[4] = {p, p, p, p};
+    corners[0].x -= half; corners[0].y -= half;
+    corners[1].x += half; corners[1].y -= half;
+    corners[2].x += half; corners[2].y += half;
+    corners[3].x -= half; corners[3].y += half;
+    setupTriangle(raster, state, &corners[0], &corners[1], &corners[2]);
+    setupTriangle(raster, state, &corners[0], &corners[2], &corners[3]);
+}
+
+void rasterDraw(SoftRaster& raster, const RasterState& state, const RasterArrays& arrays, RasterMode mode,
+                int vertexCount, const unsigned int* indices, int indexCount) {
+    if (vertexCount <= 0) return;
+    raster.states.push_back(state);
+    int s = (int)raster.states.size() - 1;
+    transformVertices(raster, state, arrays, vertexCount);
+
+    int count = indices ? indexCount : vertexCount;
+    int corners = mode == RASTER_POINTS ? 1 : mode == RASTER_LINES ? 2 : mode == RASTER_TRIANGLES ? 3 : 4;
+    for (int first = 0; first + corners <= count; first += corners) {
+        RasterVertex v[4];
+        for (int k = 0; k < corners; k++) v[k] = raster.vertices[indices ? indices[first + k] : first + k];
+        if (!state.smooth) {
+            // Flat shading: the whole primitive takes its last vertex's color
+            for (int k = 0; k + 1 < corners; k++) {
+                for (int c = 0; c < 4; c++) v[k].rgba[c] = v[corners - 1].rgba[c];
+            }
+        }
+        if (mode == RASTER_POINTS) {
+            clipPoint(raster, s, v[0], state.pointSize);
+        } else if (mode == RASTER_LINES) {
+            clipLine(raster, s, v[0], v[1], state.lineWidth);
+        } else if (state.wireframe) {
+            for (int k = 0; k < corners; k++) clipLine(raster, s, v[k], v[(k + 1) % corners], state.lineWidth);
+        } else {
+            clipTriangle(raster, s, v[0], v[1], v[2]);
+            if (corners == 4) clipTriangle(raster, s, v[0], v[2], v[3]);
+        }
+    }
+}
+
+// ---- Tiles ----
+
+// Fill one tile with its triangles, in the order they were drawn
+static void rasterizeTile(SoftRaster& raster, int tile) {
+    int left = (tile % raster.tilesX) * kRasterTile, bottom = (tile / raster.tilesX) * kRasterTile;
+    int right = std::min(left + kRasterTile, raster.width) - 1;
+    int top = std::min(bottom + kRasterTile, raster.height) - 1;
+    for (int b = raster.binStart[tile]; b < raster.binStart[tile + 1]; b++) {
+        const RasterTriangle& t = raster.triangles[raster.binEntries[b]];
+        const RasterState& s = raster.states[t.state];
+        int x0 = std::max(t.minX, left), x1 = std::min(t.maxX, right);
+        int y0 = std::max(t.minY, bottom), y1 = std::min(t.maxY, top);
+        bool depthWrite = s.depthTest && s.depthWrite;  // As in OpenGL, no depth test means no depth writes
+        const RasterTexture& texture = s.texture;
+
+        for (int y = y0; y <= y1; y++) {
+            int column = x0 - t.minX, row = y - t.minY;
+            long long e0 = t.edge[0] + t.stepX[0] * column + t.stepY[0] * row;
+            long long e1 = t.edge[1] + t.stepX[1] * column + t.stepY[1] * row;
+            long long e2 = t.edge[2] + t.stepX[2] * column + t.stepY[2] * row;
+            float a[8];
+            for (int k = 0; k < 8; k++) a[k] = t.base[k] + t.dx[k] * column + t.dy[k] * row;
+            unsigned char* color = (unsigned char*)&raster.color[y * raster.width];
+            float* depth = &raster.depth[y * raster.width];
+
+            for (int x = x0; x <= x1; x++) {
+                if ((e0 | e1 | e2) >= 0) {
+                    float z = a[0];
+                    if (!s.depthTest || z < depth[x]) {
+                        float w = t.affine ? t.w : 1.0f / a[1];
+                        float r = a[2] * w, g = a[3] * w, bl = a[4] * w, alpha = clamp01(a[5] * w);
+                        if (texture.alpha) {
+                            int u = std::min(std::max((int)floorf(a[6] * w * texture.width), 0), texture.width - 1);
+                            int v = std::min(std::max((int)floorf(a[7] * w * texture.height), 0), texture.height - 1);
+                            alpha *= texture.alpha[v * texture.width + u] * (1.0f / 255.0f);
+                        }
+                        if (!s.alphaTest || alpha > s.alphaRef) {
+                            unsigned char* out = color + x * 4;
+                            if (s.blend) {
+                                float keep = 1.0f - alpha;
+                                out[0] = toByte(clamp01(r) * alpha + out[0] * (1.0f / 255.0f) * keep);
+                                out[1] = toByte(clamp01(g) * alpha + out[1] * (1.0f / 255.0f) * keep);
+                                out[2] = toByte(clamp01(bl) * alpha + out[2] * (1.0f / 255.0f) * keep);
+                                out[3] = toByte(alpha * alpha + out[3] * (1.0f / 255.0f) * keep);
+                            } else {
+                                out[0] = toByte(r);
+                                out[1] = toByte(g);
+                                out[2] = toByte(bl);
+                                out[3] = toByte(alpha);
+                            }
+                            if (depthWrite) depth[x] = z;
+                        }
+                    }
+                }
+                e0 += t.stepX[0];
+                e1 += t.stepX[1];
+                e2 += t.stepX[2];
+                for (int k = 0; k < 8; k++) a[k] += t.dx[k];
+            }
+        }
+    }
+}
+
+// Sort the triangles by the tiles their bounds touch: count each tile's
+// share, then fill each tile's range in draw order
+static void binTriangles(SoftRaster& raster) {
+    std::vector<int>& start = raster.binStart;
+    std::fill(start.begin(), start.end(), 0);
+    for (size_t i = 0; i < raster.triangles.size(); i++) {
+        const RasterTriangle& t = raster.triangles[i];
+        for (int ty = t.minY / kRasterTile; ty <= t.maxY / kRasterTile; ty++) {
+            for (int tx = t.minX / kRasterTile; tx <= t.maxX / kRasterTile; tx++) start[ty * raster.tilesX + tx + 1]++;
+        }
+    }
+    for (size_t t = 1; t < start.size(); t++) start[t] += start[t - 1];
+    raster.binEntries.resize(start.back());
+    for (size_t i = 0; i < raster.triangles.size(); i++) {
+        const RasterTriangle& t = raster.triangles[i];
+        for (int ty = t.minY / kRasterTile; ty <= t.maxY / kRasterTile; ty++) {
+            for (int tx = t.minX / kRasterTile; tx <= t.maxX / kRasterTile; tx++) {
+                raster.binEntries[start[ty * raster.tilesX + tx]++] = (int)i;
+            }
+        }
+    }
+    // Filling moved each start to the next tile's; shift them back
+    for (size_t t = start.size() - 1; t > 0; t--) start[t] = start[t - 1];
+    start[0] = 0;
+}
+
+void rasterFlush(SoftRaster& raster) {
+    if (raster.triangles.empty()) {
+        raster.states.clear();
+        return;
+    }
+    binTriangles(raster);
+    int tiles = raster.tilesX * raster.tilesY;
+    auto tile = [&](int t) { rasterizeTile(raster, t); };
+    if (raster.threads && tiles > 1) raster.threads->parallelFor(tiles, tile);
+    else for (int t = 0; t < tiles; t++) tile(t);
+
+    raster.flushTriangles = (int)raster.triangles.size();
+    raster.flushBinEntries = (int)raster.binEntries.size();
+    raster.triangles.clear();
+    raster.states.clear();
+}
+
+bool rasterWritePpm(const SoftRaster& raster, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", raster.width, raster.height);
+    std::vector<unsigned char> row(raster.width * 3);
+    for (int y = raster.height - 1; y >= 0; y--) {  // Top row first
+        const unsigned char* pixels = (const unsigned char*)&raster.color[y * raster.width];
+        for (int x = 0; x < raster.width; x++) {
+            row[x * 3] = pixels[x * 4];
+            row[x * 3 + 1] = pixels[x * 4 + 1];
+            row[x * 3 + 2] = pixels[x * 4 + 2];
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,120 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <vector>
+
+class ThreadPool;
+
+// CPU rasterizer for the fan scenes: the part of the fixed-function OpenGL
+// pipeline they draw with (GL_LIGHT0 lighting of each vertex, flat or
+// Gouraud shading, depth test, alpha blending, an alpha-tested texture for
+// HUD text, wireframe polygons, wide lines and square points).
+// Draws are transformed, lit, clipped and set up as they arrive;
+// rasterFlush() sorts the triangles into the kRasterTile x kRasterTile
+// pixel tiles they touch and fills the tiles in parallel, each running its
+// own triangles in draw order, so the pixels do not depend on the thread
+// count. Lines and points become two triangles each. Coverage uses 8 bits
+// of sub-pixel precision and a top-left fill rule, so triangles sharing an
+// edge never touch a pixel twice (translucent quads blend evenly).
+// No OpenGL in here.
+
+const int kRasterTile = 64;   // Tile side in pixels
+
+enum RasterMode { RASTER_POINTS, RASTER_LINES, RASTER_TRIANGLES, RASTER_QUADS };
+
+// Alpha-only texture, sampled nearest and multiplied into the color
+// (GL_MODULATE); pixels must stay valid until the next rasterFlush()
+struct RasterTexture {
+    const unsigned char* alpha;
+    int width, height;
+};
+
+// The fixed-function state of one draw (see soft_backend.cpp for where
+// each field comes from in OpenGL)
+struct RasterState {
+    float projection[16];            // Eye to clip space, column-major
+    int viewport[4];                 // x, y, width, height in pixels
+    bool lighting;                   // GL_LIGHTING with GL_LIGHT0
+    float lightPosition[4];          // Eye space; w = 0 for a directional light
+    float lightAmbient[4], lightDiffuse[4], lightSpecular[4];
+    float sceneAmbient[4];           // GL_LIGHT_MODEL_AMBIENT
+    float materialAmbient[4], materialDiffuse[4], materialSpecular[4], materialEmission[4];
+    float shininess;
+    bool colorMaterial;              // Vertex colors are the ambient and diffuse material
+    bool normalize;                  // GL_NORMALIZE: unit normals after the modelview
+    bool smooth;                     // GL_SMOOTH; flat takes each primitive's last vertex color
+    bool wireframe;                  // Polygon mode GL_LINE: triangles and quads drawn as edges
+    float lineWidth, pointSize;
+    bool depthTest, depthWrite;      // GL_LESS
+    bool blend;                      // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+    bool alphaTest;                  // GL_GREATER alphaRef
+    float alphaRef;
+    RasterTexture texture;           // alpha null for none
+};
+
+// Vertex arrays of one draw, like the client arrays of glDrawElements();
+// strides are in bytes
+struct RasterArrays {
+    const float* position; int positionSize, positionStride;   // 2 or 3 coordinates
+    const float* normal; int normalStride;                      // Null: (0, 0, 1)
+    const unsigned char* rgba; int rgbaStride;                  // Null: color
+    const float* texCoord; int texCoordStride;                  // Read when the state has a texture
+    float color[4];
+    float modelview[16];             // Object to eye space, column-major
+};
+
+// A vertex after lighting, in clip space
+struct RasterVertex {
+    float clip[4];
+    float rgba[4];
+    float st[2];
+};
+
+// A triangle set up for its tiles: edge functions in 1/256 pixel units
+// stepped per pixel, and attribute planes (depth, 1/w, and color and
+// texture coordinates over w) at the center of pixel (minX, minY)
+struct RasterTriangle {
+    int minX, minY, maxX, maxY;      // Pixels it may cover, inside the framebuffer
+    int state;                       // Index into SoftRaster::states
+    bool affine;                     // Same w at every corner: no divide per pixel
+    float w;                         // That w
+    long long edge[3], stepX[3], stepY[3];
+    float base[8], dx[8], dy[8];     // z, 1/w, r, g, b, a, s, t
+};
+
+struct SoftRaster {
+    int width, height;
+    int tilesX, tilesY;
+    std::vector<unsigned int> color;            // RGBA bytes, bottom row first (as glReadPixels())
+    std::vector<float> depth;
+    std::vector<RasterState> states;            // One per draw since the last flush
+    std::vector<RasterTriangle> triangles;      // Set up, waiting for rasterFlush()
+    std::vector<int> binStart;                  // Tile t's triangles are binEntries[binStart[t]..binStart[t + 1])
+    std::vector<int> binEntries;                // Triangle indices by tile, in draw order within each
+    std::vector<RasterVertex> vertices;         // Vertex stage output of the current draw
+    ThreadPool* threads;                        // Null runs the tiles on the caller
+    int flushTriangles, flushBinEntries;        // Triangles and tile bin entries of the last flush
+};
+
+// A width x height framebuffer, cleared to black and the far plane, with
+// room for a typical frame's triangles so steady frames do not allocate
+void rasterInit(SoftRaster& raster, int width, int height, ThreadPool* threads);
+
+// New framebuffer size; drops anything not flushed
+void rasterResize(SoftRaster& raster, int width, int height);
+
+// Fill the color (rgba 0-1) and/or depth buffer, after flushing what came before
+void rasterClear(SoftRaster& raster, const float rgba[4], bool clearColor, bool clearDepth);
+
+// Transform, light, clip and set up vertexCount vertices of arrays, or the
+// indexCount vertices picked by indices when that is not null
+void rasterDraw(SoftRaster& raster, const RasterState& state, const RasterArrays& arrays, RasterMode mode,
+                int vertexCount, const unsigned int* indices, int indexCount);
+
+// Rasterize every binned triangle into the framebuffer
+void rasterFlush(SoftRaster& raster);
+
+// Save the framebuffer (after a flush) as a binary PPM, top row first
+bool rasterWritePpm(const SoftRaster& raster, const char* path);
+
+#endif
@@ -0,0 +1,86 @@
+#include "static_layer.h"
+#include "gl_ext.h"
+#include "soft_backend.h"
+#include <chrono>
+
+// Draw the cached copy as one quad mapping texel centers onto pixel centers
+static void drawCopy(const StaticLayer& layer) {
+    const float quad[4][5] = {
+        {0.0f, 0.0f, 0.0f, 0.0f, 0.0f},
+        {1.0f, 0.0f, (float)layer.width, 0.0f, 0.0f},
+        {1.0f, 1.0f, (float)layer.width, (float)layer.height, 0.0f},
+        {0.0f, 1.0f, 0.0f, (float)layer.height, 0.0f},
+    };
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisable(GL_BLEND);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, layer.texture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glInterleavedArrays(GL_T2F_V3F, 0, quad);
+    glDrawArrays(GL_QUADS, 0, 4);
+    glPopClientAttrib();
+    glPopAttrib();
+}
+
+// Copy the bottom-left width x height pixels of the framebuffer into the texture
+static void capture(StaticLayer& layer, int width, int height) {
+    glPushAttrib(GL_TEXTURE_BIT);
+    if (!layer.texture) glGenTextures(1, &layer.texture);
+    glBindTexture(GL_TEXTURE_2D, layer.texture);
+    if (layer.width != width || layer.height != height) {
+        // New size: allocate and copy in one call
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 0, 0, width, height, 0);
+        layer.width = width;
+        layer.height = height;
+    } else {
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    }
+    glPopAttrib();
+    layer.valid = true;
+    layer.captures++;
+}
+
+// Milliseconds for one call plus glFinish()
+template <typename Draw>
+static float timeDraw(Draw draw) {
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    draw();
+    glFinish();
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void layerDraw(StaticLayer& layer, int width, int height, void (*draw)()) {
+    if (layer.mode == LAYER_DRAWN || !glExtHasNpotTextures || softBackend) {
+        layer.cached = false;
+        draw();
+        return;
+    }
+    if (!layer.valid || layer.width != width || layer.height != height) {
+        draw();
+        capture(layer, width, height);
+        // Both ways leave the same pixels, so time each over this frame's
+        // background; the copy's first draw is a warm-up (shader compiles)
+        drawCopy(layer);
+        layer.copyMs = timeDraw([&] { drawCopy(layer); });
+        layer.drawMs = timeDraw(draw);
+        layer.cached = layer.mode == LAYER_CACHED || layer.copyMs < layer.drawMs;
+        return;
+    }
+    if (layer.cached) {
+        drawCopy(layer);
+    } else {
+        draw();
+    }
+}
+
+void layerInvalidate(StaticLayer& layer) {
+    layer.valid = false;
+}
@@ -0,0 +1,39 @@
+#ifndef STATIC_LAYER_H
+#define STATIC_LAYER_H
+
+#include <GL/glut.h>
+
+// Cache for the part of a frame that never changes (the 2D desk, stand,
+// motor and cage). The layer is drawn as usual once, then copied out of the
+// framebuffer into a texture with glCopyTexImage2D(); later frames can draw
+// that texture as one screen-sized quad instead of rasterizing the parts.
+// Whether that is a win depends on the renderer: a GPU textures a screen in
+// a fraction of the time, but a single-core software rasterizer can spend
+// longer texturing every pixel than filling a few flat shapes. So each
+// capture times one draw of each kind, and the automatic mode uses the faster.
+// Needs non-power-of-two textures (OpenGL 2.0); without them, or with the
+// software backend on, the layer is drawn every frame.
+
+enum LayerMode { LAYER_AUTO, LAYER_CACHED, LAYER_DRAWN };
+
+struct StaticLayer {
+    LayerMode mode;
+    GLuint texture;
+    int width, height;   // Size of the cached image, 0 before the first capture
+    bool valid;          // False after layerInvalidate(): re-capture on the next frame
+    bool cached;         // The last frame used the cached copy
+    float drawMs;        // Time to draw the parts / the cached copy, measured
+    float copyMs;        // at the last capture (including glFinish())
+    int captures;        // Times the layer has been captured
+};
+
+// Draw the layer into the viewport, which must be width x height pixels with
+// one unit per pixel from (0, 0): either the cached copy, or draw(), which
+// draws the parts themselves and must leave them in the framebuffer (flush
+// any batching). Captures and times both when there is no valid copy.
+void layerDraw(StaticLayer& layer, int width, int height, void (*draw)());
+
+// Drop the cached copy (window resized, colors changed, mode changed)
+void layerInvalidate(StaticLayer& layer);
+
+#endif
@@ -0,0 +1,112 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int threads)
+    : slots(threads < 1 ? 1 : threads), generation(0), stopping(false),
+      jobFunc(0), jobContext(0), pending(0) {
+    for (size_t i = 0; i < slots.size(); i++) {
+        slots[i].generation = 0;
+        slots[i].next = 0;
+        slots[i].end = 0;
+    }
+    for (int i = 1; i < threadCount(); i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+// Take the next chunk of job from our own range, or steal the last one of another thread.
+// A worker that woke up late must not pick up chunks of a newer job with an old function.
+bool ThreadPool::takeChunk(int slot, unsigned int job, int& chunk) {
+    {
+        Slot& own = slots[slot];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.generation == job && own.next < own.end) {
+            chunk = own.next++;
+            return true;
+        }
+    }
+    int n = threadCount();
+    for (int i = 1; i < n; i++) {
+        Slot& victim = slots[(slot + i) % n];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.generation == job && victim.next < victim.end) {
+            chunk = --victim.end;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(int chunkCount, ChunkFunc func, void* context) {
+    if (chunkCount <= 0) return;
+
+    // Nothing to share: skip the handshake with the workers
+    if (threadCount() == 1 || chunkCount == 1) {
+        for (int c = 0; c < chunkCount; c++) func(context, c);
+        return;
+    }
+
+    unsigned int job;
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        job = ++generation;
+        jobFunc = func;
+        jobContext = context;
+        pending.store(chunkCount);
+
+        // Even split of the chunk range, earlier threads get the remainder
+        int n = threadCount();
+        int begin = 0;
+        for (int i = 0; i < n; i++) {
+            int size = chunkCount / n + (i < chunkCount % n ? 1 : 0);
+            std::lock_guard<std::mutex> slotGuard(slots[i].lock);
+            slots[i].generation = job;
+            slots[i].next = begin;
+            slots[i].end = begin + size;
+            begin += size;
+        }
+    }
+    jobReady.notify_all();
+
+    int chunk;
+    while (takeChunk(0, job, chunk)) {
+        func(context, chunk);
+        pending.fetch_sub(1);
+    }
+
+    std::unique_lock<std::mutex> guard(jobLock);
+    jobDone.wait(guard, [this] { return pending.load() == 0; });
+}
+
+void ThreadPool::workerLoop(int slot) {
+    unsigned int seen = 0;
+    for (;;) {
+        ChunkFunc func;
+        void* context;
+        {
+            std::unique_lock<std::mutex> guard(jobLock);
+            jobReady.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            func = jobFunc;
+            context = jobContext;
+        }
+
+        int chunk;
+        while (takeChunk(slot, seen, chunk)) {
+            func(context, chunk);
+            if (pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> guard(jobLock);
+                jobDone.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small work-stealing thread pool for data-parallel loops.
+// parallelFor() splits chunk indices evenly over the calling thread and the
+// workers; each thread takes chunks from the front of its own range and,
+// once that is empty, steals from the back of the others. Which thread runs
+// a chunk is not fixed, so callers must make chunks independent to get
+// results that do not depend on the thread count.
+class ThreadPool {
+public:
+    // threads counts the calling thread, so 1 means "run everything inline"
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    int threadCount() const { return (int)slots.size(); }
+
+    // Run func(chunk) for every chunk in [0, chunkCount) and wait for all of them.
+    // The callable is passed by address, so this never allocates.
+    template <typename Func>
+    void parallelFor(int chunkCount, const Func& func) {
+        run(chunkCount, &invoke<Func>, (void*)&func);
+    }
+
+private:
+    typedef void (*ChunkFunc)(void* context, int chunk);
+
+    template <typename Func>
+    static void invoke(void* context, int chunk) {
+        (*(const Func*)context)(chunk);
+    }
+
+    // Chunks [next, end) of job generation still to run for one thread; guarded by lock
+    struct Slot {
+        std::mutex lock;
+        unsigned int generation;
+        int next;
+        int end;
+    };
+
+    void run(int chunkCount, ChunkFunc func, void* context);
+    void workerLoop(int slot);
+    bool takeChunk(int slot, unsigned int job, int& chunk);
+
+    std::vector<Slot> slots;            // One per thread, slot 0 is the caller
+    std::vector<std::thread> workers;   // Threads for slots 1..n-1
+
+    std::mutex jobLock;                 // Guards the fields below
+    std::condition_variable jobReady;   // Workers wait here between jobs
+    std::condition_variable jobDone;    // Caller waits here for stragglers
+    unsigned int generation;            // Bumped for every job
+    bool stopping;
+    ChunkFunc jobFunc;
+    void* jobContext;
+    std::atomic<int> pending;           // Chunks of the current job not finished yet
+};
+
+#endif
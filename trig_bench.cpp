@@ -0,0 +1,187 @@
+// Benchmark for the fixed-shape geometry in 2D main.cpp.
+// Generates the vertices of one frame's circles, rounded rectangle and
+// safety cage two ways: with the original per-vertex cosf/sinf loops and
+// with the compile-time tables from trig_tables.h. Reports trig calls and
+// time per frame for each, plus the largest difference between the two.
+//
+// Usage: trig_bench [frames]
+
+#include "trig_tables.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Vertex sink standing in for glVertex2f()
+struct VertexSink {
+    float xy[2048];
+    int count;
+};
+
+static long trigCalls = 0;  // cosf/sinf calls made by the legacy loops
+
+static float countedCos(float a) { trigCalls++; return cosf(a); }
+static float countedSin(float a) { trigCalls++; return sinf(a); }
+
+static inline void emit(VertexSink& sink, float x, float y) {
+    sink.xy[sink.count * 2] = x;
+    sink.xy[sink.count * 2 + 1] = y;
+    sink.count++;
+}
+
+// Original loops from 2D main.cpp, with glVertex2f() replaced by emit()
+
+static void legacyCircle(VertexSink& sink, float cx, float cy, float radius, int segments) {
+    emit(sink, cx, cy);
+    for (int i = 0; i <= segments; i++) {
+        float theta = 2.0f * 3.1415926f * float(i) / float(segments);
+        emit(sink, cx + radius * countedCos(theta), cy + radius * countedSin(theta));
+    }
+}
+
+static void legacyRoundedRect(VertexSink& sink, float x, float y, float width, float height, float radius) {
+    const int segments = 20;
+    for (int i = 0; i <= segments; i++) {
+        float theta = 3.1415926f * float(i) / float(segments);
+        emit(sink, x + width - radius + radius * countedCos(theta), y + height - radius + radius * countedSin(theta));
+    }
+    for (int i = segments; i <= 2 * segments; i++) {
+        float theta = 3.1415926f * float(i) / float(segments);
+        emit(sink, x + width - radius + radius * countedCos(theta), y + radius + radius * countedSin(theta));
+    }
+    for (int i = 2 * segments; i <= 3 * segments; i++) {
+        float theta = 3.1415926f * float(i) / float(segments);
+        emit(sink, x + radius + radius * countedCos(theta), y + radius + radius * countedSin(theta));
+    }
+    for (int i = 3 * segments; i <= 4 * segments; i++) {
+        float theta = 3.1415926f * float(i) / float(segments);
+        emit(sink, x + radius + radius * countedCos(theta), y + height - radius + radius * countedSin(theta));
+    }
+}
+
+static void legacyCage(VertexSink& sink) {
+    for (int i = 0; i < 12; i++) {
+        float rad = i * 30.0f * 3.1415926f / 180.0f;
+        emit(sink, 450, 350);
+        emit(sink, 450 + countedCos(rad) * 80, 350 + countedSin(rad) * 80);
+    }
+    for (int i = 0; i < 36; i++) {
+        float rad = i * 10.0f * 3.1415926f / 180.0f;
+        emit(sink, 450 + countedCos(rad) * 80, 350 + countedSin(rad) * 80);
+    }
+    for (int i = 0; i < 36; i++) {
+        float rad = i * 10.0f * 3.1415926f / 180.0f;
+        emit(sink, 450 + countedCos(rad) * 70, 350 + countedSin(rad) * 70);
+    }
+}
+
+static void legacyFrame(VertexSink& sink) {
+    sink.count = 0;
+    legacyRoundedRect(sink, 650, 400, 120, 180, 10);  // Control panel
+    legacyRoundedRect(sink, 670, 420, 80, 40, 5);     // Power button
+    for (int i = 0; i < 5; i++) legacyRoundedRect(sink, 670, 470 + i * 25, 80, 20, 3);  // Speed buttons
+    legacyCircle(sink, 400, 250, 40, 30);           // Stand base
+    legacyCircle(sink, 400, 350, 15, 20);           // Motor housing
+    legacyCircle(sink, 400, 350, 20, 30);
+    legacyCircle(sink, 425, 350, 15, 20);
+    legacyCage(sink);
+    legacyCircle(sink, 450, 350, 12, 24);           // Hub
+}
+
+// Table-driven versions, matching the new code in 2D main.cpp
+
+template <int Segments>
+static void tableCircle(VertexSink& sink, float cx, float cy, float radius) {
+    const CircleTable<Segments>& unit = circleTable<Segments>;
+    emit(sink, cx, cy);
+    for (int i = 0; i <= Segments; i++) {
+        emit(sink, cx + radius * unit.cosv[i], cy + radius * unit.sinv[i]);
+    }
+}
+
+static void tableRoundedRect(VertexSink& sink, float x, float y, float width, float height, float radius) {
+    const int segments = 20;
+    const CircleTable<2 * segments>& unit = circleTable<2 * segments>;
+    for (int i = 0; i <= segments; i++) {
+        int k = i % (2 * segments);
+        emit(sink, x + width - radius + radius * unit.cosv[k], y + height - radius + radius * unit.sinv[k]);
+    }
+    for (int i = segments; i <= 2 * segments; i++) {
+        int k = i % (2 * segments);
+        emit(sink, x + width - radius + radius * unit.cosv[k], y + radius + radius * unit.sinv[k]);
+    }
+    for (int i = 2 * segments; i <= 3 * segments; i++) {
+        int k = i % (2 * segments);
+        emit(sink, x + radius + radius * unit.cosv[k], y + radius + radius * unit.sinv[k]);
+    }
+    for (int i = 3 * segments; i <= 4 * segments; i++) {
+        int k = i % (2 * segments);
+        emit(sink, x + radius + radius * unit.cosv[k], y + height - radius + radius * unit.sinv[k]);
+    }
+}
+
+static void tableCage(VertexSink& sink) {
+    const CircleTable<12>& spokes = circleTable<12>;
+    const CircleTable<36>& ring = circleTable<36>;
+    for (int i = 0; i < 12; i++) {
+        emit(sink, 450, 350);
+        emit(sink, 450 + spokes.cosv[i] * 80, 350 + spokes.sinv[i] * 80);
+    }
+    for (int i = 0; i < 36; i++) emit(sink, 450 + ring.cosv[i] * 80, 350 + ring.sinv[i] * 80);
+    for (int i = 0; i < 36; i++) emit(sink, 450 + ring.cosv[i] * 70, 350 + ring.sinv[i] * 70);
+}
+
+static void tableFrame(VertexSink& sink) {
+    sink.count = 0;
+    tableRoundedRect(sink, 650, 400, 120, 180, 10);
+    tableRoundedRect(sink, 670, 420, 80, 40, 5);
+    for (int i = 0; i < 5; i++) tableRoundedRect(sink, 670, 470 + i * 25, 80, 20, 3);
+    tableCircle<30>(sink, 400, 250, 40);
+    tableCircle<20>(sink, 400, 350, 15);
+    tableCircle<30>(sink, 400, 350, 20);
+    tableCircle<20>(sink, 425, 350, 15);
+    tableCage(sink);
+    tableCircle<24>(sink, 450, 350, 12);
+}
+
+int main(int argc, char** argv) {
+    int frames = 200000;
+    if (argc > 1) frames = atoi(argv[1]);
+    if (frames <= 0) {
+        fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    static VertexSink legacy, table;
+    double checksum = 0.0;  // Keeps the optimizer from dropping the loops
+
+    trigCalls = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        legacyFrame(legacy);
+        checksum += legacy.xy[f % (legacy.count * 2)];
+    }
+    double legacySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long legacyTrig = trigCalls / frames;
+
+    trigCalls = 0;
+    start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        tableFrame(table);
+        checksum += table.xy[f % (table.count * 2)];
+    }
+    double tableSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long tableTrig = trigCalls / frames;
+
+    float maxError = 0.0f;  // Largest vertex difference, in pixels
+    for (int i = 0; i < legacy.count * 2; i++) {
+        maxError = fmaxf(maxError, fabsf(legacy.xy[i] - table.xy[i]));
+    }
+
+    printf("vertices per frame: %d (legacy) / %d (table)\n", legacy.count, table.count);
+    printf("%-8s %12s %14s\n", "path", "trig/frame", "ns/frame");
+    printf("%-8s %12ld %14.1f\n", "legacy", legacyTrig, legacySeconds * 1e9 / frames);
+    printf("%-8s %12ld %14.1f\n", "table", tableTrig, tableSeconds * 1e9 / frames);
+    printf("max vertex difference: %.6f px (checksum %.1f)\n", maxError, checksum);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef TRIG_TABLES_H
+#define TRIG_TABLES_H
+
+// Compile-time sine/cosine tables for shapes whose angles never change
+// (circles, rounded rectangles, the safety cage). circleTable<N> holds the
+// unit vectors for N equal steps around the circle, built by the compiler,
+// so drawing those shapes costs no cosf/sinf calls at run time.
+
+constexpr double kTrigPi = 3.14159265358979323846;
+
+// Taylor series after reducing x to [-pi, pi]; accurate to double precision
+constexpr double constexprSin(double x) {
+    while (x > kTrigPi) x -= 2.0 * kTrigPi;
+    while (x < -kTrigPi) x += 2.0 * kTrigPi;
+    double term = x, sum = x;
+    for (int n = 1; n < 20; n++) {
+        term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constexprCos(double x) {
+    return constexprSin(x + kTrigPi / 2.0);
+}
+
+// Unit vectors at angles 2*pi*i/Segments for i = 0..Segments (the last
+// entry repeats the first so closed shapes can run one step past the end)
+template <int Segments>
+struct CircleTable {
+    float cosv[Segments + 1];
+    float sinv[Segments + 1];
+
+    constexpr CircleTable() : cosv(), sinv() {
+        for (int i = 0; i <= Segments; i++) {
+            double angle = 2.0 * kTrigPi * i / Segments;
+            cosv[i] = (float)constexprCos(angle);
+            sinv[i] = (float)constexprSin(angle);
+        }
+    }
+};
+
+template <int Segments>
+constexpr CircleTable<Segments> circleTable = CircleTable<Segments>();
+
+// Sanity checks evaluated by the compiler
+static_assert(circleTable<4>.cosv[0] == 1.0f, "cos(0) must be 1");
+static_assert(circleTable<4>.sinv[1] > 0.9999999f && circleTable<4>.cosv[1] < 1e-7f &&
+              circleTable<4>.cosv[1] > -1e-7f, "quarter turn must be (0, 1)");
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Latest-value hand-off from one writer thread to one reader thread. Three
+// copies of T: the writer fills its back copy and publishes it, swapping it
+// with the middle one; the reader swaps its front copy with the middle one
+// whenever a newer one has been published. The swaps are single atomic
+// exchanges, so neither thread ever waits for the other, and each owns its
+// copy outright until it swaps it away: the reader always sees a complete
+// T, the newest one published, and a slow reader only makes the writer's
+// older copies go unread.
+
+const int kTripleFresh = 4;   // Set in middle while it holds a copy the reader hasn't taken
+
+template <typename T>
+struct TripleBuffer {
+    T slots[3];
+    std::atomic<int> middle;  // Slot index, | kTripleFresh when newer than the reader's
+    int back;                 // The writer's slot
+    int front;                // The reader's slot
+};
+
+// Give each thread its slot; nothing is published yet (the reader sees slots[2])
+template <typename T>
+void tripleInit(TripleBuffer<T>& buffer) {
+    buffer.back = 0;
+    buffer.middle.store(1, std::memory_order_relaxed);
+    buffer.front = 2;
+}
+
+// The copy the writer fills next
+template <typename T>
+T& tripleBack(TripleBuffer<T>& buffer) {
+    return buffer.slots[buffer.back];
+}
+
+// Publish the back copy. Returns true if it replaced a copy the reader
+// never took; that copy, still intact, is the new back copy.
+template <typename T>
+bool triplePublish(TripleBuffer<T>& buffer) {
+    int previous = buffer.middle.exchange(buffer.back | kTripleFresh, std::memory_order_acq_rel);
+    buffer.back = previous & ~kTripleFresh;
+    return (previous & kTripleFresh) != 0;
+}
+
+// Take the newest published copy, if there is one the reader doesn't have;
+// returns true if the front copy changed
+template <typename T>
+bool tripleAcquire(TripleBuffer<T>& buffer) {
+    if (!(buffer.middle.load(std::memory_order_relaxed) & kTripleFresh)) return false;
+    int previous = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+    buffer.front = previous & ~kTripleFresh;
+    return true;
+}
+
+// The copy the reader holds
+template <typename T>
+const T& tripleFront(const TripleBuffer<T>& buffer) {
+    return buffer.slots[buffer.front];
+}
+
+#endif
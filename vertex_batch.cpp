@@ -0,0 +1,271 @@
+#include "vertex_batch.h"
+#include "gl_ext.h"
+#include "soft_backend.h"
+#include <cstddef>
+#include <cstring>
+
+// Ring of kRingSegments equal parts; a flush is written inside one segment,
+// and a fence placed on leaving a segment is waited on before reusing it
+const int kRingSegments = 4;
+const GLsizeiptr kInitialRingSize = 1 << 20;
+
+void batchInit(VertexBatch& batch) {
+    batch.vertices.clear();
+    batch.runs.clear();
+    batch.primitive.clear();
+    batchColor(batch, 1.0f, 1.0f, 1.0f);
+    batchNormal(batch, 0.0f, 0.0f, 1.0f);
+    batch.lineWidth = 1.0f;
+    batch.pointSize = 1.0f;
+    batch.drawCalls = batch.drawnVertices = 0;
+    batch.frameDrawCalls = batch.frameVertices = 0;
+}
+
+void batchColor(VertexBatch& batch, float r, float g, float b, float a) {
+    float color[4] = {r, g, b, a};
+    for (int i = 0; i < 4; i++) {
+        float c = color[i] < 0.0f ? 0.0f : (color[i] > 1.0f ? 1.0f : color[i]);
+        batch.rgba[i] = (unsigned char)(c * 255.0f + 0.5f);
+    }
+}
+
+void batchColor(VertexBatch& batch, const float rgb[3]) {
+    batchColor(batch, rgb[0], rgb[1], rgb[2]);
+}
+
+void batchNormal(VertexBatch& batch, float x, float y, float z) {
+    batch.normal[0] = x;
+    batch.normal[1] = y;
+    batch.normal[2] = z;
+}
+
+void batchLineWidth(VertexBatch& batch, float width) {
+    batch.lineWidth = width;
+}
+
+void batchPointSize(VertexBatch& batch, float size) {
+    batch.pointSize = size;
+}
+
+void batchBegin(VertexBatch& batch, GLenum mode) {
+    batch.primitiveMode = mode;
+    batch.primitive.clear();
+    glGetFloatv(GL_MODELVIEW_MATRIX, batch.transform);
+}
+
+void batchVertex(VertexBatch& batch, float x, float y, float z) {
+    const float* m = batch.transform;  // Column-major
+    const float* n = batch.normal;
+    BatchVertex v;
+    memcpy(v.rgba, batch.rgba, 4);
+    for (int i = 0; i < 3; i++) {
+        v.position[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+        v.normal[i] = m[i] * n[0] + m[4 + i] * n[1] + m[8 + i] * n[2];  // Rotation only: no scaled parts are batched
+    }
+    batch.primitive.push_back(v);
+}
+
+// Append to the last run if it has the same mode and size, else start a new one
+static void extendRun(VertexBatch& batch, GLenum mode, float size, int count) {
+    if (!batch.runs.empty()) {
+        BatchRun& last = batch.runs.back();
+        if (last.mode == mode && last.size == size) {
+            last.count += count;
+            return;
+        }
+    }
+    BatchRun run = {mode, size, (int)batch.vertices.size() - count, count};
+    batch.runs.push_back(run);
+}
+
+void batchEnd(VertexBatch& batch) {
+    const std::vector<BatchVertex>& p = batch.primitive;
+    std::vector<BatchVertex>& out = batch.vertices;
+    int n = (int)p.size();
+    size_t start = out.size();
+    GLenum mode = GL_TRIANGLES;
+    float size = 0.0f;
+    switch (batch.primitiveMode) {
+        case GL_POINTS:
+            out.insert(out.end(), p.begin(), p.end());
+            mode = GL_POINTS;
+            size = batch.pointSize;
+            break;
+        case GL_LINES:
+            out.insert(out.end(), p.begin(), p.begin() + (n & ~1));
+            mode = GL_LINES;
+            size = batch.lineWidth;
+            break;
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            for (int i = 0; i + 1 < n; i++) {
+                out.push_back(p[i]);
+                out.push_back(p[i + 1]);
+            }
+            if (batch.primitiveMode == GL_LINE_LOOP && n > 2) {
+                out.push_back(p[n - 1]);
+                out.push_back(p[0]);
+            }
+            mode = GL_LINES;
+            size = batch.lineWidth;
+            break;
+        case GL_TRIANGLES:
+            out.insert(out.end(), p.begin(), p.begin() + n / 3 * 3);
+            break;
+        case GL_TRIANGLE_STRIP:
+            for (int i = 0; i + 2 < n; i++) {
+                // Every other triangle swaps its first two vertices to keep the winding
+                out.push_back(p[i + (i & 1)]);
+                out.push_back(p[i + 1 - (i & 1)]);
+                out.push_back(p[i + 2]);
+            }
+            break;
+        case GL_QUADS:
+            for (int i = 0; i + 3 < n; i += 4) {
+                const BatchVertex quad[6] = {p[i], p[i + 1], p[i + 2], p[i], p[i + 2], p[i + 3]};
+                out.insert(out.end(), quad, quad + 6);
+            }
+            break;
+        case GL_QUAD_STRIP:
+            for (int i = 0; i + 3 < n; i += 2) {
+                const BatchVertex quad[6] = {p[i], p[i + 1], p[i + 3], p[i], p[i + 3], p[i + 2]};
+                out.insert(out.end(), quad, quad + 6);
+            }
+            break;
+        default:  // GL_TRIANGLE_FAN, GL_POLYGON (convex)
+            for (int i = 1; i + 1 < n; i++) {
+                out.push_back(p[0]);
+                out.push_back(p[i]);
+                out.push_back(p[i + 1]);
+            }
+            break;
+    }
+    int count = (int)(out.size() - start);
+    if (count > 0) extendRun(batch, mode, size, count);
+}
+
+// Create the ring: persistently mapped when buffer storage is available
+static void createRing(VertexBatch& batch, GLsizeiptr size) {
+    if (batch.buffer) pglDeleteBuffers(1, &batch.buffer);  // GL keeps it alive for pending draws
+    for (int i = 0; i < kRingSegments; i++) {
+        if (batch.fences[i]) pglDeleteSync(batch.fences[i]);
+        batch.fences[i] = 0;
+    }
+    pglGenBuffers(1, &batch.buffer);
+    pglBindBuffer(GL_ARRAY_BUFFER, batch.buffer);
+    batch.bufferSize = size;
+    batch.head = 0;
+    batch.segment = 0;
+    batch.mapped = 0;
+    if (glExtHasBufferStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        pglBufferStorage(GL_ARRAY_BUFFER, size, 0, flags);
+        batch.mapped = (unsigned char*)pglMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    } else {
+        pglBufferData(GL_ARRAY_BUFFER, size, 0, GL_STREAM_DRAW);
+    }
+}
+
+// Copy the batch's vertices into the streaming buffer (bound on return);
+// returns their byte offset
+static GLintptr uploadVertices(VertexBatch& batch) {
+    GLsizeiptr bytes = (GLsizeiptr)(batch.vertices.size() * sizeof(BatchVertex));
+    if (!batch.buffer || bytes > batch.bufferSize / kRingSegments) {
+        GLsizeiptr size = batch.bufferSize ? batch.bufferSize : kInitialRingSize;
+        while (bytes > size / kRingSegments) size *= 2;
+        createRing(batch, size);
+    }
+    pglBindBuffer(GL_ARRAY_BUFFER, batch.buffer);
+
+    if (!batch.mapped) {
+        // Orphan the buffer when full: the driver hands out fresh storage
+        // while earlier draws still read the old one
+        if (batch.head + bytes > batch.bufferSize) {
+            pglBufferData(GL_ARRAY_BUFFER, batch.bufferSize, 0, GL_STREAM_DRAW);
+            batch.head = 0;
+        }
+        GLintptr offset = batch.head;
+        pglBufferSubData(GL_ARRAY_BUFFER, offset, bytes, batch.vertices.data());
+        batch.head += bytes;
+        return offset;
+    }
+
+    // Persistent ring: keep each flush inside one segment
+    GLsizeiptr segmentSize = batch.bufferSize / kRingSegments;
+    if (batch.head % segmentSize + bytes > segmentSize) {
+        batch.head = (batch.head / segmentSize + 1) * segmentSize;
+    }
+    if (batch.head >= batch.bufferSize) batch.head = 0;
+    int segment = (int)(batch.head / segmentSize);
+    if (segment != batch.segment) {
+        batch.fences[batch.segment] = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        batch.segment = segment;
+        if (batch.fences[segment]) {
+            pglClientWaitSync(batch.fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            pglDeleteSync(batch.fences[segment]);
+            batch.fences[segment] = 0;
+        }
+    }
+    GLintptr offset = batch.head;
+    memcpy(batch.mapped + offset, batch.vertices.data(), bytes);
+    batch.head += bytes;
+    return offset;
+}
+
+void batchFlush(VertexBatch& batch) {
+    if (batch.runs.empty()) return;
+
+    // Vertices are in eye space already
+    glPushAttrib(GL_LINE_BIT | GL_POINT_BIT | GL_TRANSFORM_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    const unsigned char* base = (const unsigned char*)batch.vertices.data();
+    bool buffered = glExtHasBuffers && !softBackend;
+    if (buffered) base = (const unsigned char*)(size_t)uploadVertices(batch);  // Offset into the buffer
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(BatchVertex), base + offsetof(BatchVertex, rgba));
+    glNormalPointer(GL_FLOAT, sizeof(BatchVertex), base + offsetof(BatchVertex, normal));
+    glVertexPointer(3, GL_FLOAT, sizeof(BatchVertex), base + offsetof(BatchVertex, position));
+
+    for (size_t i = 0; i < batch.runs.size(); i++) {
+        const BatchRun& run = batch.runs[i];
+        if (run.mode == GL_LINES) glLineWidth(run.size);
+        if (run.mode == GL_POINTS) glPointSize(run.size);
+        if (softBackend) {
+            const BatchVertex* first = &batch.vertices[run.first];
+            RasterArrays arrays = {};
+            arrays.position = first->position;
+            arrays.positionSize = 3;
+            arrays.positionStride = sizeof(BatchVertex);
+            arrays.normal = first->normal;
+            arrays.normalStride = sizeof(BatchVertex);
+            arrays.rgba = first->rgba;
+            arrays.rgbaStride = sizeof(BatchVertex);
+            softBackendDraw(run.mode, arrays, run.count);
+        } else {
+            glDrawArrays(run.mode, run.first, run.count);
+        }
+    }
+    batch.drawCalls += (int)batch.runs.size();
+    batch.drawnVertices += (int)batch.vertices.size();
+
+    if (buffered) pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    glPopMatrix();
+    glPopClientAttrib();
+    glPopAttrib();
+
+    batch.vertices.clear();
+    batch.runs.clear();
+}
+
+void batchEndFrame(VertexBatch& batch) {
+    batch.frameDrawCalls = batch.drawCalls;
+    batch.frameVertices = batch.drawnVertices;
+    batch.drawCalls = 0;
+    batch.drawnVertices = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef VERTEX_BATCH_H
+#define VERTEX_BATCH_H
+
+#include <GL/glut.h>
+#include <GL/glext.h>
+#include <vector>
+
+// Batched replacement for glBegin()/glVertex()/glEnd(). Primitives are
+// recorded on the CPU, already transformed by the modelview matrix current
+// at batchBegin(), and turned into triangle, line or point lists. Consecutive
+// primitives of the same kind (and line width / point size) form one run;
+// batchFlush() uploads the whole batch into a streaming vertex buffer and
+// draws each run with one glDrawArrays(). The buffer is a persistently mapped
+// ring with fences on OpenGL 4.4, an orphaned buffer object on older drivers,
+// and plain client memory without buffer objects.
+//
+// A flush draws everything with the projection, lighting, blending and
+// polygon mode current at the time, so flush before changing any of them.
+// With the software backend on (soft_backend.h), the runs go to its
+// rasterizer instead.
+
+// Vertex layout: color, eye-space normal and eye-space position
+struct BatchVertex {
+    unsigned char rgba[4];
+    float normal[3];
+    float position[3];
+};
+
+// Consecutive vertices drawn by one glDrawArrays()
+struct BatchRun {
+    GLenum mode;                       // GL_TRIANGLES, GL_LINES or GL_POINTS
+    float size;                        // Line width or point size
+    int first, count;
+};
+
+struct VertexBatch {
+    std::vector<BatchVertex> vertices; // Everything recorded since the last flush
+    std::vector<BatchRun> runs;
+    std::vector<BatchVertex> primitive;  // Vertices of the open batchBegin()
+    GLenum primitiveMode;
+    float transform[16];               // Modelview at batchBegin()
+    unsigned char rgba[4];             // Current color, as glColor
+    float normal[3];                   // Current normal (object space), as glNormal
+    float lineWidth, pointSize;        // As glLineWidth() / glPointSize()
+
+    // Streaming buffer (see vertex_batch.cpp)
+    GLuint buffer;
+    GLsizeiptr bufferSize;
+    GLintptr head;                     // Next free byte
+    unsigned char* mapped;             // Persistent mapping, or null
+    int segment;                       // Ring segment being written
+    GLsync fences[4];                  // Draws that still read each segment
+
+    int drawCalls, drawnVertices;      // Issued by flushes this frame
+    int frameDrawCalls, frameVertices; // Totals of the last finished frame
+};
+
+// Start a new batch: white, normal (0, 0, 1), width and size 1
+void batchInit(VertexBatch& batch);
+
+// Immediate-mode equivalents. Every mode of glBegin() is accepted; quads,
+// strips, fans and polygons become triangles, loops and strips become lines.
+void batchBegin(VertexBatch& batch, GLenum mode);
+void batchEnd(VertexBatch& batch);
+void batchColor(VertexBatch& batch, float r, float g, float b, float a = 1.0f);
+void batchColor(VertexBatch& batch, const float rgb[3]);
+void batchNormal(VertexBatch& batch, float x, float y, float z);
+void batchVertex(VertexBatch& batch, float x, float y, float z = 0.0f);
+void batchLineWidth(VertexBatch& batch, float width);
+void batchPointSize(VertexBatch& batch, float size);
+
+// Draw and clear everything recorded so far
+void batchFlush(VertexBatch& batch);
+
+// Move this frame's draw call and vertex counts to frameDrawCalls/frameVertices
+void batchEndFrame(VertexBatch& batch);
+
+#endif